@@ -0,0 +1,226 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "bench/bench_utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <regex>
+#include <sstream>
+
+#include "cpu_timer.h"
+#include "file_io.h"
+#include "include/ark.h"
+#include "json.h"
+#include "logging.h"
+
+namespace ark {
+namespace bench {
+
+// Every benchmark takes at least this number of samples, however slow.
+static const size_t min_samples = 5;
+static const size_t max_samples = 1000000;
+
+std::string to_json(const std::vector<Result> &results) {
+    nlohmann::json benchmarks = nlohmann::json::array();
+    for (auto &res : results) {
+        benchmarks.push_back({{"name", res.name},
+                              {"iters", res.iters},
+                              {"mean", res.mean},
+                              {"median", res.median},
+                              {"min", res.min},
+                              {"stddev", res.stddev}});
+    }
+    nlohmann::json j;
+    j["benchmarks"] = std::move(benchmarks);
+    return j.dump(4);
+}
+
+std::vector<Result> from_json(const std::string &json_str) {
+    std::vector<Result> results;
+    nlohmann::json j;
+    try {
+        j = nlohmann::json::parse(json_str);
+        for (auto &b : j.at("benchmarks")) {
+            Result res;
+            res.name = b.at("name").get<std::string>();
+            res.iters = b.at("iters").get<size_t>();
+            res.mean = b.at("mean").get<double>();
+            res.median = b.at("median").get<double>();
+            res.min = b.at("min").get<double>();
+            res.stddev = b.at("stddev").get<double>();
+            results.emplace_back(std::move(res));
+        }
+    } catch (const nlohmann::json::exception &e) {
+        ERR(InvalidUsageError, "invalid benchmark results: ", e.what());
+    }
+    return results;
+}
+
+std::vector<Regression> compare(const std::vector<Result> &baseline,
+                                const std::vector<Result> &current,
+                                double threshold) {
+    std::map<std::string, double> baseline_medians;
+    for (auto &res : baseline) {
+        baseline_medians[res.name] = res.median;
+    }
+    std::vector<Regression> regressions;
+    for (auto &res : current) {
+        auto it = baseline_medians.find(res.name);
+        if (it == baseline_medians.end()) continue;
+        if (res.median > it->second * (1 + threshold)) {
+            regressions.push_back({res.name, it->second, res.median});
+        }
+    }
+    return regressions;
+}
+
+Suite::Suite(int argc, char **argv) {
+    auto value = [&](int &i) -> std::string {
+        if (i + 1 >= argc) {
+            ERR(InvalidUsageError, "missing value of ", argv[i]);
+        }
+        return argv[++i];
+    };
+    auto number = [&](int &i) {
+        std::string opt = argv[i];
+        std::string str = value(i);
+        char *end;
+        double val = std::strtod(str.c_str(), &end);
+        if (str.empty() || *end != '\0' || val < 0) {
+            ERR(InvalidUsageError, "invalid value of ", opt, ": ", str);
+        }
+        return val;
+    };
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--filter") {
+            filter_ = value(i);
+        } else if (arg == "--min-time") {
+            min_time_ = number(i);
+        } else if (arg == "--json") {
+            json_path_ = value(i);
+        } else if (arg == "--compare") {
+            compare_path_ = value(i);
+        } else if (arg == "--threshold") {
+            threshold_ = number(i);
+        } else if (arg == "--list") {
+            list_ = true;
+        } else {
+            ERR(InvalidUsageError, "unknown option: ", arg);
+        }
+    }
+}
+
+void Suite::add(const std::string &name, std::function<void()> run,
+                std::function<void()> setup) {
+    benches_.push_back({name, std::move(run), std::move(setup)});
+}
+
+Result Suite::measure(const Bench &bench) const {
+    // Warm up caches and lazily initialized state.
+    if (bench.setup) bench.setup();
+    bench.run();
+
+    std::vector<double> samples;
+    double timed = 0;
+    double start = cpu_timer();
+    while (samples.size() < max_samples) {
+        if (samples.size() >= min_samples &&
+            (timed >= min_time_ || cpu_timer() - start >= 10 * min_time_)) {
+            break;
+        }
+        if (bench.setup) bench.setup();
+        double t = cpu_timer();
+        bench.run();
+        t = cpu_timer() - t;
+        samples.push_back(t);
+        timed += t;
+    }
+
+    Result res;
+    res.name = bench.name;
+    res.iters = samples.size();
+    res.mean = timed / samples.size();
+    double var = 0;
+    for (double t : samples) {
+        var += (t - res.mean) * (t - res.mean);
+    }
+    res.stddev = std::sqrt(var / samples.size());
+    std::sort(samples.begin(), samples.end());
+    res.min = samples.front();
+    size_t mid = samples.size() / 2;
+    res.median = (samples.size() % 2 == 1)
+                     ? samples[mid]
+                     : (samples[mid - 1] + samples[mid]) / 2;
+    return res;
+}
+
+// Print a time in seconds with a readable unit.
+static std::string format_time(double sec) {
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(3);
+    if (sec < 1e-3) {
+        ss << sec * 1e6 << " us";
+    } else if (sec < 1) {
+        ss << sec * 1e3 << " ms";
+    } else {
+        ss << sec << " s";
+    }
+    return ss.str();
+}
+
+int Suite::run() {
+    std::regex filter{filter_};
+    // Keep stdout machine-readable if the results are written there.
+    std::ostream &os = (json_path_ == "-") ? std::cerr : std::cout;
+    std::vector<Result> results;
+    for (auto &bench : benches_) {
+        if (!filter_.empty() && !std::regex_search(bench.name, filter)) {
+            continue;
+        }
+        if (list_) {
+            std::cout << bench.name << std::endl;
+            continue;
+        }
+        Result res = measure(bench);
+        os << std::left << std::setw(40) << res.name << std::right
+           << " median " << std::setw(12) << format_time(res.median)
+           << "  min " << std::setw(12) << format_time(res.min) << "  stddev "
+           << std::setw(12) << format_time(res.stddev) << "  iters "
+           << res.iters << std::endl;
+        results.emplace_back(std::move(res));
+    }
+    if (list_) return 0;
+
+    if (json_path_ == "-") {
+        std::cout << to_json(results) << std::endl;
+    } else if (!json_path_.empty()) {
+        write_file(json_path_, to_json(results));
+    }
+    if (compare_path_.empty()) return 0;
+
+    auto regressions =
+        compare(from_json(read_file(compare_path_)), results, threshold_);
+    for (auto &reg : regressions) {
+        os << "REGRESSION " << reg.name << ": " << format_time(reg.baseline)
+           << " -> " << format_time(reg.current) << " (+" << std::fixed
+           << std::setprecision(1)
+           << (reg.current / reg.baseline - 1) * 100 << "%)" << std::endl;
+    }
+    if (!regressions.empty()) {
+        os << regressions.size() << " of " << results.size()
+           << " benchmarks regressed by more than " << threshold_ * 100 << "%"
+           << std::endl;
+        return 1;
+    }
+    os << "no regression against " << compare_path_ << std::endl;
+    return 0;
+}
+
+}  // namespace bench
+}  // namespace ark
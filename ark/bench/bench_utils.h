@@ -0,0 +1,89 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#ifndef ARK_BENCH_BENCH_UTILS_H_
+#define ARK_BENCH_BENCH_UTILS_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace ark {
+namespace bench {
+
+/// Timing of a benchmark. Times are in seconds per iteration.
+struct Result {
+    std::string name;
+    size_t iters = 0;
+    double mean = 0;
+    double median = 0;
+    double min = 0;
+    double stddev = 0;
+};
+
+/// A benchmark of @p name whose median became slower than the baseline.
+struct Regression {
+    std::string name;
+    double baseline;
+    double current;
+};
+
+/// Serialize @p results into a JSON object of the form
+/// `{"benchmarks": [{"name": ..., "iters": ..., "mean": ..., ...}, ...]}`.
+std::string to_json(const std::vector<Result> &results);
+
+/// Parse the output of @ref to_json().
+std::vector<Result> from_json(const std::string &json_str);
+
+/// Benchmarks of @p current whose median is more than `1 + threshold` times
+/// that of the same benchmark in @p baseline. Benchmarks that are missing in
+/// either of them are ignored.
+std::vector<Regression> compare(const std::vector<Result> &baseline,
+                                const std::vector<Result> &current,
+                                double threshold);
+
+/// A set of benchmarks that runs from the command line.
+///
+/// Options:
+///   --filter REGEX     run only the benchmarks whose name matches REGEX
+///   --min-time SEC     time each benchmark for at least SEC seconds (0.5)
+///   --json PATH        write the results to PATH, or stdout if PATH is "-"
+///   --compare PATH     compare against the results in PATH and fail if any
+///                      benchmark regressed
+///   --threshold FRAC   allowed slowdown of the median in --compare (0.1)
+///   --list             print the benchmark names and exit
+class Suite {
+   public:
+    Suite(int argc, char **argv);
+
+    /// Add a benchmark that times @p run. @p setup, if given, runs before
+    /// every call of @p run and is not timed, e.g., to rebuild the state
+    /// that @p run consumes.
+    void add(const std::string &name, std::function<void()> run,
+             std::function<void()> setup = nullptr);
+
+    /// Run the benchmarks and return the exit code of the process.
+    int run();
+
+   private:
+    struct Bench {
+        std::string name;
+        std::function<void()> run;
+        std::function<void()> setup;
+    };
+
+    Result measure(const Bench &bench) const;
+
+    std::vector<Bench> benches_;
+    std::string filter_;
+    double min_time_ = 0.5;
+    std::string json_path_;
+    std::string compare_path_;
+    double threshold_ = 0.1;
+    bool list_ = false;
+};
+
+}  // namespace bench
+}  // namespace ark
+
+#endif  // ARK_BENCH_BENCH_UTILS_H_
@@ -0,0 +1,1004 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "cpu_executor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <set>
+
+#include "bfloat16.h"
+#include "half.h"
+#include "logging.h"
+#include "math_utils.h"
+#include "model.h"
+
+namespace ark {
+
+// A thread takes at least this number of elements of an op at a time, so that
+// small ops do not pay for waking up the threads.
+static const DimType min_elems_per_chunk = 16384;
+
+// Number of rows and columns of the output that a matmul computes at a time.
+static const DimType matmul_block_rows = 4;
+static const DimType matmul_block_cols = 512;
+
+CpuThreadPool::CpuThreadPool(int num_threads) {
+    for (int i = 1; i < num_threads; ++i) {
+        threads_.emplace_back([this] { this->work(); });
+    }
+}
+
+CpuThreadPool::~CpuThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = true;
+    }
+    job_cv_.notify_all();
+    for (auto &t : threads_) {
+        t.join();
+    }
+}
+
+void CpuThreadPool::parallel_for(
+    DimType num, DimType grain,
+    const std::function<void(DimType, DimType)> &func) {
+    if (num <= 0) return;
+    grain = std::max<DimType>(grain, 1);
+    if (threads_.empty() || num <= grain) {
+        func(0, num);
+        return;
+    }
+    // A few chunks per thread balance the ranges that take longer.
+    DimType num_chunks = (DimType)(threads_.size() + 1) * 4;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        func_ = &func;
+        num_ = num;
+        chunk_ = std::max(grain, (num + num_chunks - 1) / num_chunks);
+        next_ = 0;
+        num_busy_ = (int)threads_.size();
+        ++job_id_;
+    }
+    job_cv_.notify_all();
+    this->run_chunks();
+    std::unique_lock<std::mutex> lock(mtx_);
+    done_cv_.wait(lock, [this] { return num_busy_ == 0; });
+    func_ = nullptr;
+}
+
+void CpuThreadPool::work() {
+    unsigned long long seen_job_id = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            job_cv_.wait(lock,
+                         [&] { return stop_ || job_id_ != seen_job_id; });
+            if (stop_) return;
+            seen_job_id = job_id_;
+        }
+        this->run_chunks();
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (--num_busy_ == 0) {
+            done_cv_.notify_one();
+        }
+    }
+}
+
+void CpuThreadPool::run_chunks() {
+    for (;;) {
+        DimType begin = next_.fetch_add(chunk_);
+        if (begin >= num_) break;
+        (*func_)(begin, std::min(begin + chunk_, num_));
+    }
+}
+
+template <typename T>
+struct CpuTypeTag {
+    using type = T;
+};
+
+// Call @p func with a `CpuTypeTag` of the C++ type of @p type.
+template <typename Func>
+static void visit_cpu_type(CpuType type, Func &&func) {
+    switch (type) {
+        case CPU_FP32:
+            func(CpuTypeTag<float>{});
+            break;
+        case CPU_FP16:
+            func(CpuTypeTag<half_t>{});
+            break;
+        case CPU_BF16:
+            func(CpuTypeTag<bfloat16_t>{});
+            break;
+        case CPU_INT32:
+            func(CpuTypeTag<int32_t>{});
+            break;
+        case CPU_UINT32:
+            func(CpuTypeTag<uint32_t>{});
+            break;
+        case CPU_INT8:
+            func(CpuTypeTag<int8_t>{});
+            break;
+        case CPU_UINT8:
+            func(CpuTypeTag<uint8_t>{});
+            break;
+    }
+}
+
+static CpuType to_cpu_type(const TensorType &type) {
+    if (type == FP32) return CPU_FP32;
+    if (type == FP16) return CPU_FP16;
+    if (type == BF16) return CPU_BF16;
+    if (type == INT32) return CPU_INT32;
+    if (type == UINT32) return CPU_UINT32;
+    if (type == INT8) return CPU_INT8;
+    if (type == UINT8 || type == BYTE) return CPU_UINT8;
+    ERR(InvalidUsageError, "unsupported data type on CPU: ", type);
+    return CPU_FP32;
+}
+
+// View of the data range of a tensor of @p shape, @p ldims and @p offs whose
+// buffer starts at @p base.
+static CpuView make_view(const Dims &shape, const Dims &ldims, const Dims &offs,
+                         const TensorType &type, char *base) {
+    CpuView view;
+    view.type = to_cpu_type(type);
+    view.type_bytes = type.bytes();
+    int ndims = shape.ndims();
+    Dims ld = ldims.dims4();
+    DimType off[4] = {0, 0, 0, 0};
+    for (int i = 0; i < ndims; ++i) {
+        view.shape[4 - ndims + i] = shape[i];
+        off[4 - ndims + i] = offs[i];
+    }
+    view.stride[3] = 1;
+    view.stride[2] = ld[3];
+    view.stride[1] = ld[2] * ld[3];
+    view.stride[0] = ld[1] * ld[2] * ld[3];
+    view.data = base + view.offset(off[0], off[1], off[2], off[3]) *
+                           view.type_bytes;
+    return view;
+}
+
+// @p view broadcast to @p shape in NumPy's rules.
+static CpuView broadcast_view(CpuView view, const DimType *shape) {
+    for (int i = 0; i < 4; ++i) {
+        if (view.shape[i] != shape[i]) {
+            view.shape[i] = shape[i];
+            view.stride[i] = 0;
+        }
+    }
+    return view;
+}
+
+// Indices of the first three dimensions of row @p row of @p view.
+static void unravel_row(const CpuView &view, DimType row, DimType &i0,
+                        DimType &i1, DimType &i2) {
+    i2 = row % view.shape[2];
+    row /= view.shape[2];
+    i1 = row % view.shape[1];
+    i0 = row / view.shape[1];
+}
+
+// Rows of @p elems_per_row elements each that a thread takes at least at a
+// time.
+static DimType grain_rows(DimType elems_per_row) {
+    return std::max<DimType>(
+        1, min_elems_per_chunk / std::max<DimType>(elems_per_row, 1));
+}
+
+// Convert @p n elements of @p view that are @p stride apart from @p offset
+// into FP32.
+static void load(const CpuView &view, DimType offset, DimType stride,
+                 float *dst, DimType n) {
+    visit_cpu_type(view.type, [&](auto tag) {
+        using T = typename decltype(tag)::type;
+        const T *src = reinterpret_cast<const T *>(view.data) + offset;
+        if (stride == 1) {
+            for (DimType i = 0; i < n; ++i) dst[i] = float(src[i]);
+        } else if (stride == 0) {
+            std::fill(dst, dst + n, float(src[0]));
+        } else {
+            for (DimType i = 0; i < n; ++i) dst[i] = float(src[i * stride]);
+        }
+    });
+}
+
+// Like `load()`, but returns the elements in place if they are already
+// contiguous in FP32, and otherwise converts them into @p buf.
+static const float *load_row(const CpuView &view, DimType offset,
+                             DimType stride, float *buf, DimType n) {
+    if (view.type == CPU_FP32 && stride == 1) {
+        return reinterpret_cast<const float *>(view.data) + offset;
+    }
+    load(view, offset, stride, buf, n);
+    return buf;
+}
+
+// Round @p n elements in FP32 into contiguous elements of @p view from
+// @p offset.
+static void store(const CpuView &view, DimType offset, const float *src,
+                  DimType n) {
+    visit_cpu_type(view.type, [&](auto tag) {
+        using T = typename decltype(tag)::type;
+        T *dst = reinterpret_cast<T *>(view.data) + offset;
+        for (DimType i = 0; i < n; ++i) dst[i] = T(src[i]);
+    });
+}
+
+static float cpu_relu(float x) { return std::max(x, 0.0f); }
+
+// The tanh approximation that the GPU kernels use.
+static float cpu_gelu(float x) {
+    return 0.5f * x *
+           (1.0f + std::tanh(0.7978845608f * (x + 0.044715f * x * x * x)));
+}
+
+static float cpu_sigmoid(float x) { return 1.0f / (1.0f + std::exp(-x)); }
+
+static float cpu_exp(float x) { return std::exp(x); }
+
+static float cpu_sqrt(float x) { return std::sqrt(x); }
+
+static float cpu_rsqrt(float x) { return 1.0f / std::sqrt(x); }
+
+using RowUnary = void (*)(float *y, const float *x, DimType n);
+
+template <float (*F)(float)>
+static void row_unary(float *y, const float *x, DimType n) {
+    for (DimType i = 0; i < n; ++i) y[i] = F(x[i]);
+}
+
+// Row function of an element-wise op of @p type, or nullptr if none.
+static RowUnary get_row_unary(int type) {
+    switch (type) {
+        case OP_RELU:
+            return row_unary<cpu_relu>;
+        case OP_GELU:
+            return row_unary<cpu_gelu>;
+        case OP_SIGMOID:
+            return row_unary<cpu_sigmoid>;
+        case OP_EXP:
+            return row_unary<cpu_exp>;
+        case OP_SQRT:
+            return row_unary<cpu_sqrt>;
+        case OP_RSQRT:
+            return row_unary<cpu_rsqrt>;
+        default:
+            return nullptr;
+    }
+}
+
+using RowBinary = void (*)(float *y, const float *a, const float *b,
+                           DimType n);
+
+template <typename F>
+static void row_binary(float *y, const float *a, const float *b, DimType n) {
+    for (DimType i = 0; i < n; ++i) y[i] = F{}(a[i], b[i]);
+}
+
+static RowBinary get_row_binary(int type) {
+    switch (type) {
+        case OP_ADD:
+            return row_binary<std::plus<float>>;
+        case OP_SUB:
+            return row_binary<std::minus<float>>;
+        case OP_MUL:
+            return row_binary<std::multiplies<float>>;
+        case OP_DIV:
+            return row_binary<std::divides<float>>;
+        default:
+            return nullptr;
+    }
+}
+
+/// Computes a row of the output from the rows of the inputs, all of @p n
+/// elements in FP32.
+using RowFunc =
+    std::function<void(float *y, const float *const *xs, DimType n)>;
+
+// Compute the rows of @p out by @p func from those of @p ins, which are
+// broadcast to @p out.
+static void run_ewise(CpuThreadPool &pool, const CpuView &out,
+                      const std::vector<CpuView> &ins, const RowFunc &func) {
+    DimType w = out.shape[3];
+    size_t num_ins = ins.size();
+    pool.parallel_for(
+        out.num_rows(), grain_rows(w), [&](DimType begin, DimType end) {
+            std::vector<float> bufs((num_ins + 1) * w);
+            std::vector<const float *> xs(num_ins);
+            float *y = bufs.data() + num_ins * w;
+            for (DimType row = begin; row < end; ++row) {
+                DimType i0, i1, i2;
+                unravel_row(out, row, i0, i1, i2);
+                for (size_t k = 0; k < num_ins; ++k) {
+                    xs[k] = load_row(ins[k], ins[k].offset(i0, i1, i2),
+                                     ins[k].stride[3], &bufs[k * w], w);
+                }
+                func(y, xs.data(), w);
+                store(out, out.offset(i0, i1, i2), y, w);
+            }
+        });
+}
+
+template <typename U>
+static void copy_elems(char *dst, const char *src, DimType stride,
+                       DimType n) {
+    U *d = reinterpret_cast<U *>(dst);
+    const U *s = reinterpret_cast<const U *>(src);
+    for (DimType i = 0; i < n; ++i) d[i] = s[i * stride];
+}
+
+// Copy the elements of @p src into @p dst of the same shape and data type
+// without conversion.
+static void copy_view(CpuThreadPool &pool, const CpuView &dst,
+                      const CpuView &src) {
+    DimType w = dst.shape[3];
+    int bytes = dst.type_bytes;
+    pool.parallel_for(
+        dst.num_rows(), grain_rows(w), [&](DimType begin, DimType end) {
+            for (DimType row = begin; row < end; ++row) {
+                DimType i0, i1, i2;
+                unravel_row(dst, row, i0, i1, i2);
+                char *d = dst.data + dst.offset(i0, i1, i2) * bytes;
+                const char *s = src.data + src.offset(i0, i1, i2) * bytes;
+                DimType stride = src.stride[3];
+                if (stride == 1) {
+                    std::memmove(d, s, w * bytes);
+                } else if (bytes == 1) {
+                    copy_elems<uint8_t>(d, s, stride, w);
+                } else if (bytes == 2) {
+                    copy_elems<uint16_t>(d, s, stride, w);
+                } else {
+                    copy_elems<uint32_t>(d, s, stride, w);
+                }
+            }
+        });
+}
+
+// Convert the elements of @p src into the data type of @p dst of the same
+// shape. The conversion goes through FP64 so that integers are exact.
+static void cast_view(CpuThreadPool &pool, const CpuView &dst,
+                      const CpuView &src) {
+    DimType w = dst.shape[3];
+    pool.parallel_for(
+        dst.num_rows(), grain_rows(w), [&](DimType begin, DimType end) {
+            visit_cpu_type(src.type, [&](auto src_tag) {
+                using From = typename decltype(src_tag)::type;
+                visit_cpu_type(dst.type, [&](auto dst_tag) {
+                    using To = typename decltype(dst_tag)::type;
+                    for (DimType row = begin; row < end; ++row) {
+                        DimType i0, i1, i2;
+                        unravel_row(dst, row, i0, i1, i2);
+                        const From *s =
+                            reinterpret_cast<const From *>(src.data) +
+                            src.offset(i0, i1, i2);
+                        To *d = reinterpret_cast<To *>(dst.data) +
+                                dst.offset(i0, i1, i2);
+                        for (DimType i = 0; i < w; ++i) {
+                            d[i] = To(double(s[i * src.stride[3]]));
+                        }
+                    }
+                });
+            });
+        });
+}
+
+// Reduce @p in along @p axis of its 4D shape into @p out, whose dimension of
+// @p axis is 1.
+static void run_reduce(CpuThreadPool &pool, const CpuView &out,
+                       const CpuView &in, int axis, OpType type) {
+    bool is_max = (type == OP_REDUCE_E_MAX || type == OP_REDUCE_W_MAX);
+    bool is_mean = (type == OP_REDUCE_E_MEAN || type == OP_REDUCE_W_MEAN);
+    DimType len = in.shape[axis];
+    DimType w = out.shape[3];
+    DimType elems_per_row = w * len;
+    pool.parallel_for(
+        out.num_rows(), grain_rows(elems_per_row),
+        [&](DimType begin, DimType end) {
+            std::vector<float> buf(std::max(w, len));
+            std::vector<float> acc(w);
+            for (DimType row = begin; row < end; ++row) {
+                DimType idx[4] = {0, 0, 0, 0};
+                unravel_row(out, row, idx[0], idx[1], idx[2]);
+                if (axis == 3) {
+                    const float *x = load_row(
+                        in, in.offset(idx[0], idx[1], idx[2]), in.stride[3],
+                        buf.data(), len);
+                    float r = x[0];
+                    for (DimType i = 1; i < len; ++i) {
+                        r = is_max ? std::max(r, x[i]) : r + x[i];
+                    }
+                    acc[0] = r;
+                } else {
+                    for (DimType k = 0; k < len; ++k) {
+                        idx[axis] = k;
+                        const float *x = load_row(
+                            in, in.offset(idx[0], idx[1], idx[2], idx[3]),
+                            in.stride[3], buf.data(), w);
+                        if (k == 0) {
+                            std::copy(x, x + w, acc.begin());
+                        } else if (is_max) {
+                            for (DimType i = 0; i < w; ++i) {
+                                acc[i] = std::max(acc[i], x[i]);
+                            }
+                        } else {
+                            for (DimType i = 0; i < w; ++i) acc[i] += x[i];
+                        }
+                    }
+                    idx[axis] = 0;
+                }
+                if (is_mean) {
+                    for (DimType i = 0; i < w; ++i) acc[i] /= len;
+                }
+                store(out, out.offset(idx[0], idx[1], idx[2]), acc.data(), w);
+            }
+        });
+}
+
+// Normalize each row of @p in over the last dimension into @p out.
+static void run_layernorm(CpuThreadPool &pool, const CpuView &out,
+                          const CpuView &in) {
+    DimType w = out.shape[3];
+    pool.parallel_for(
+        out.num_rows(), grain_rows(w), [&](DimType begin, DimType end) {
+            std::vector<float> buf(w);
+            std::vector<float> y(w);
+            for (DimType row = begin; row < end; ++row) {
+                DimType i0, i1, i2;
+                unravel_row(out, row, i0, i1, i2);
+                const float *x = load_row(in, in.offset(i0, i1, i2),
+                                          in.stride[3], buf.data(), w);
+                float mean = 0;
+                for (DimType i = 0; i < w; ++i) mean += x[i];
+                mean /= w;
+                float var = 0;
+                for (DimType i = 0; i < w; ++i) {
+                    y[i] = x[i] - mean;
+                    var += y[i] * y[i];
+                }
+                var /= w;
+                float rstd = 1.0f / std::sqrt(var + 1e-5f);
+                for (DimType i = 0; i < w; ++i) y[i] *= rstd;
+                store(out, out.offset(i0, i1, i2), y.data(), w);
+            }
+        });
+}
+
+// Copy the rows of @p weight that the indices in @p in select into @p out.
+// An index of -i selects the row i from the last.
+static void run_embedding(CpuThreadPool &pool, const CpuView &out,
+                          const CpuView &in, const CpuView &weight) {
+    DimType w = out.shape[3];
+    DimType num_emb = weight.shape[2];
+    int bytes = out.type_bytes;
+    pool.parallel_for(
+        out.num_rows(), grain_rows(w), [&](DimType begin, DimType end) {
+            for (DimType row = begin; row < end; ++row) {
+                DimType i0, i1, i2;
+                unravel_row(out, row, i0, i1, i2);
+                DimType idx = reinterpret_cast<const int32_t *>(
+                    in.data)[in.offset(0, i0, i1, i2)];
+                if (idx < 0) idx += num_emb;
+                char *d = out.data + out.offset(i0, i1, i2) * bytes;
+                if (idx < 0 || idx >= num_emb) {
+                    // Out of range, which the GPU kernel does not check.
+                    std::memset(d, 0, w * bytes);
+                    continue;
+                }
+                std::memcpy(d, weight.data + weight.offset(0, 0, idx) * bytes,
+                            w * bytes);
+            }
+        });
+}
+
+struct CpuMatmul {
+    CpuView a;
+    CpuView b;
+    CpuView y;
+    CpuView bias;
+    CpuView residual;
+    bool has_bias;
+    bool has_residual;
+    RowUnary activation;
+    DimType m;
+    DimType n;
+    DimType k;
+    // Distance between the rows and the columns of A (M x K) and B (K x N).
+    DimType a_row_stride;
+    DimType a_col_stride;
+    DimType b_row_stride;
+    DimType b_col_stride;
+};
+
+// Index of the matrix of batch [i0][i1] of the output in @p view, whose
+// first two dimensions are either 1 or those of the output.
+static DimType matmul_batch(const CpuView &view, DimType i0, DimType i1) {
+    return (view.shape[0] == 1 ? 0 : i0) * view.shape[1] +
+           (view.shape[1] == 1 ? 0 : i1);
+}
+
+// Multiply the matrices in FP32 and apply the epilogue. Both operands are
+// converted into row-major matrices first, so that the inner loop runs over
+// contiguous columns of B and the output.
+static void run_matmul(CpuThreadPool &pool, const CpuMatmul &mm) {
+    const DimType m = mm.m;
+    const DimType n = mm.n;
+    const DimType k = mm.k;
+    DimType num_a = mm.a.shape[0] * mm.a.shape[1];
+    DimType num_b = mm.b.shape[0] * mm.b.shape[1];
+    std::vector<float> pa(num_a * m * k);
+    std::vector<float> pb(num_b * k * n);
+    pool.parallel_for(num_a * m, grain_rows(k),
+                      [&](DimType begin, DimType end) {
+                          for (DimType r = begin; r < end; ++r) {
+                              DimType batch = r / m;
+                              DimType off =
+                                  mm.a.offset(batch / mm.a.shape[1],
+                                              batch % mm.a.shape[1], 0) +
+                                  (r % m) * mm.a_row_stride;
+                              load(mm.a, off, mm.a_col_stride, &pa[r * k], k);
+                          }
+                      });
+    pool.parallel_for(num_b * k, grain_rows(n),
+                      [&](DimType begin, DimType end) {
+                          for (DimType r = begin; r < end; ++r) {
+                              DimType batch = r / k;
+                              DimType off =
+                                  mm.b.offset(batch / mm.b.shape[1],
+                                              batch % mm.b.shape[1], 0) +
+                                  (r % k) * mm.b_row_stride;
+                              load(mm.b, off, mm.b_col_stride, &pb[r * n], n);
+                          }
+                      });
+    std::vector<float> bias(mm.has_bias ? n : 0);
+    if (mm.has_bias) {
+        load(mm.bias, mm.bias.offset(0, 0, 0), mm.bias.stride[3], bias.data(),
+             n);
+    }
+
+    DimType num_batches = mm.y.shape[0] * mm.y.shape[1];
+    DimType num_blocks = math::div_up(m, matmul_block_rows);
+    pool.parallel_for(
+        num_batches * num_blocks, 1, [&](DimType begin, DimType end) {
+            std::vector<float> acc(matmul_block_rows * matmul_block_cols);
+            std::vector<float> res(matmul_block_cols);
+            for (DimType blk = begin; blk < end; ++blk) {
+                DimType batch = blk / num_blocks;
+                DimType y0 = batch / mm.y.shape[1];
+                DimType y1 = batch % mm.y.shape[1];
+                DimType row0 = (blk % num_blocks) * matmul_block_rows;
+                DimType rows = std::min(matmul_block_rows, m - row0);
+                const float *a =
+                    &pa[(matmul_batch(mm.a, y0, y1) * m + row0) * k];
+                const float *b = &pb[matmul_batch(mm.b, y0, y1) * k * n];
+                for (DimType col0 = 0; col0 < n; col0 += matmul_block_cols) {
+                    DimType cols = std::min(matmul_block_cols, n - col0);
+                    std::fill(acc.begin(), acc.end(), 0.0f);
+                    for (DimType kk = 0; kk < k; ++kk) {
+                        const float *b_row = b + kk * n + col0;
+                        for (DimType r = 0; r < rows; ++r) {
+                            float a_val = a[r * k + kk];
+                            float *acc_row = &acc[r * matmul_block_cols];
+                            for (DimType j = 0; j < cols; ++j) {
+                                acc_row[j] += a_val * b_row[j];
+                            }
+                        }
+                    }
+                    for (DimType r = 0; r < rows; ++r) {
+                        float *acc_row = &acc[r * matmul_block_cols];
+                        if (mm.has_bias) {
+                            for (DimType j = 0; j < cols; ++j) {
+                                acc_row[j] += bias[col0 + j];
+                            }
+                        }
+                        if (mm.activation != nullptr) {
+                            mm.activation(acc_row, acc_row, cols);
+                        }
+                        if (mm.has_residual) {
+                            const float *x = load_row(
+                                mm.residual,
+                                mm.residual.offset(y0, y1, row0 + r) + col0,
+                                mm.residual.stride[3], res.data(), cols);
+                            for (DimType j = 0; j < cols; ++j) {
+                                acc_row[j] += x[j];
+                            }
+                        }
+                        store(mm.y, mm.y.offset(y0, y1, row0 + r) + col0,
+                              acc_row, cols);
+                    }
+                }
+            }
+        });
+}
+
+// A term of the postfix expression of a fused element-wise op.
+struct CpuFusedTerm {
+    int type;
+    // Index of the input if `type` is `OP_TENSOR`.
+    int idx;
+    // Factor if `type` is `OP_SCALE`.
+    float val;
+};
+
+// Evaluate @p terms over rows of @p n elements, using @p stack to keep the
+// intermediate rows.
+static void eval_fused(const std::vector<CpuFusedTerm> &terms, float *y,
+                       const float *const *xs, DimType n,
+                       std::vector<float> &stack) {
+    size_t top = 0;
+    for (auto &term : terms) {
+        if (term.type == OP_TENSOR) {
+            if (stack.size() < (top + 1) * n) stack.resize((top + 1) * n);
+            std::copy(xs[term.idx], xs[term.idx] + n, &stack[top * n]);
+            ++top;
+            continue;
+        }
+        float *x = &stack[(top - 1) * n];
+        if (term.type == OP_SCALE) {
+            for (DimType i = 0; i < n; ++i) x[i] *= term.val;
+        } else if (RowUnary unary = get_row_unary(term.type)) {
+            unary(x, x, n);
+        } else {
+            float *a = &stack[(top - 2) * n];
+            get_row_binary(term.type)(a, a, x, n);
+            --top;
+        }
+    }
+    std::copy(&stack[0], &stack[0] + n, y);
+}
+
+CpuExecutor::Impl::Impl(const Model &model, int num_threads)
+    : pool_{num_threads > 0
+                ? num_threads
+                : std::max(1, (int)std::thread::hardware_concurrency())} {
+    const Model::Impl &impl = *model.impl;
+    // Tensors that share a TensorBuf may have different leading dimensions
+    // before scheduling, so the buffer covers all of them.
+    std::map<const TensorBuf *, DimType> buf_bytes;
+    for (Tensor *tns : impl.get_tensors()) {
+        DimType &bytes = buf_bytes[tns->buf];
+        bytes = std::max({bytes, tns->buf->bytes, tns->ldims_bytes()});
+    }
+    for (auto &p : buf_bytes) {
+        bufs_[p.first].resize(p.second);
+    }
+    for (Tensor *tns : impl.get_tensors()) {
+        views_[tns] = make_view(tns->shape, tns->ldims, tns->offs, tns->type,
+                                bufs_[tns->buf].data());
+    }
+    for (const Op *op : this->sort_ops(impl)) {
+        this->add_step(*op);
+    }
+}
+
+std::vector<const Op *> CpuExecutor::Impl::sort_ops(
+    const Model::Impl &impl) const {
+    // Graph passes may append ops that produce the inputs of earlier ones, so
+    // the ops run in a topological order that prefers the order of creation.
+    std::map<const Op *, size_t> order;
+    std::vector<const Op *> ops;
+    for (const Op *op : impl.get_ops()) {
+        order[op] = ops.size();
+        ops.push_back(op);
+    }
+    std::vector<int> num_producers(ops.size(), 0);
+    std::vector<std::vector<size_t>> users(ops.size());
+    for (size_t i = 0; i < ops.size(); ++i) {
+        std::set<const Op *> producers;
+        for (const Op *producer : impl.get_producer_ops(ops[i])) {
+            producers.insert(producer);
+        }
+        for (const Op *producer : producers) {
+            users[order.at(producer)].push_back(i);
+            ++num_producers[i];
+        }
+    }
+    std::priority_queue<size_t, std::vector<size_t>, std::greater<size_t>>
+        ready;
+    for (size_t i = 0; i < ops.size(); ++i) {
+        if (num_producers[i] == 0) ready.push(i);
+    }
+    std::vector<const Op *> sorted;
+    while (!ready.empty()) {
+        size_t i = ready.top();
+        ready.pop();
+        sorted.push_back(ops[i]);
+        for (size_t user : users[i]) {
+            if (--num_producers[user] == 0) ready.push(user);
+        }
+    }
+    if (sorted.size() != ops.size()) {
+        ERR(ModelError, "the model has a cyclic dependency");
+    }
+    return sorted;
+}
+
+const CpuView &CpuExecutor::Impl::get_view(const Tensor *tns) const {
+    auto it = views_.find(tns);
+    if (it == views_.end()) {
+        ERR(InvalidUsageError, "tensor ", tns->name,
+            " is not in the model of this executor");
+    }
+    return it->second;
+}
+
+void CpuExecutor::Impl::add_step(const Op &op) {
+    if (op.is_virtual()) return;
+    if (op.outputs.empty()) {
+        ERR(InvalidUsageError, "op ", op.name, " of type ", op.type,
+            " is not supported on CPU");
+    }
+    CpuThreadPool *pool = &pool_;
+    CpuView out = this->get_view(op.outputs[0]);
+    switch (op.type) {
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL:
+        case OP_DIV: {
+            std::vector<CpuView> ins{
+                broadcast_view(this->get_view(op.inputs[0]), out.shape),
+                broadcast_view(this->get_view(op.inputs[1]), out.shape)};
+            RowBinary binary = get_row_binary(op.type);
+            steps_.emplace_back([=] {
+                run_ewise(*pool, out, ins,
+                          [binary](float *y, const float *const *xs,
+                                   DimType n) { binary(y, xs[0], xs[1], n); });
+            });
+            break;
+        }
+        case OP_RELU:
+        case OP_GELU:
+        case OP_SIGMOID:
+        case OP_EXP:
+        case OP_SQRT:
+        case OP_RSQRT: {
+            std::vector<CpuView> ins{this->get_view(op.inputs[0])};
+            RowUnary unary = get_row_unary(op.type);
+            steps_.emplace_back([=] {
+                run_ewise(*pool, out, ins,
+                          [unary](float *y, const float *const *xs,
+                                  DimType n) { unary(y, xs[0], n); });
+            });
+            break;
+        }
+        case OP_SCALE: {
+            std::vector<CpuView> ins{this->get_view(op.inputs[0])};
+            float val;
+            op.args.get(&val, 0);
+            steps_.emplace_back([=] {
+                run_ewise(*pool, out, ins,
+                          [val](float *y, const float *const *xs, DimType n) {
+                              for (DimType i = 0; i < n; ++i) {
+                                  y[i] = xs[0][i] * val;
+                              }
+                          });
+            });
+            break;
+        }
+        case OP_COPY: {
+            CpuView in =
+                broadcast_view(this->get_view(op.inputs[0]), out.shape);
+            steps_.emplace_back([=] { copy_view(*pool, out, in); });
+            break;
+        }
+        case OP_CAST: {
+            CpuView in = this->get_view(op.inputs[0]);
+            steps_.emplace_back([=] { cast_view(*pool, out, in); });
+            break;
+        }
+        case OP_FUSED_EWISE: {
+            std::vector<CpuView> ins;
+            for (Tensor *tns : op.inputs) {
+                ins.emplace_back(broadcast_view(this->get_view(tns), out.shape));
+            }
+            std::vector<CpuFusedTerm> terms;
+            size_t num_args = op.args.get_args().size();
+            for (size_t i = 0; i < num_args; ++i) {
+                CpuFusedTerm term{0, 0, 0};
+                op.args.get(&term.type, i);
+                if (term.type == OP_TENSOR) {
+                    op.args.get(&term.idx, ++i);
+                } else if (term.type == OP_SCALE) {
+                    op.args.get(&term.val, ++i);
+                } else if (get_row_unary(term.type) == nullptr &&
+                           get_row_binary(term.type) == nullptr) {
+                    ERR(ModelError,
+                        "unsupported op type in a fused expression: ",
+                        term.type);
+                }
+                terms.push_back(term);
+            }
+            steps_.emplace_back([=] {
+                run_ewise(*pool, out, ins,
+                          [&terms](float *y, const float *const *xs,
+                                   DimType n) {
+                              thread_local std::vector<float> stack;
+                              eval_fused(terms, y, xs, n, stack);
+                          });
+            });
+            break;
+        }
+        case OP_REDUCE_E_SUM:
+        case OP_REDUCE_E_MEAN:
+        case OP_REDUCE_E_MAX:
+        case OP_REDUCE_W_SUM:
+        case OP_REDUCE_W_MEAN:
+        case OP_REDUCE_W_MAX: {
+            int axis;
+            bool keepdims;
+            op.args.get(&axis, 0);
+            op.args.get(&keepdims, 1);
+            Tensor *input = op.inputs[0];
+            Tensor *output = op.outputs[0];
+            if (!keepdims) {
+                // View the output as if it kept the reduced dimension.
+                Dims shape = output->shape;
+                Dims ldims = output->ldims;
+                Dims offs = output->offs;
+                shape.insert(axis, 1);
+                ldims.insert(axis, 1);
+                offs.insert(axis, 0);
+                out = make_view(shape, ldims, offs, output->type,
+                                bufs_[output->buf].data());
+            }
+            CpuView in = this->get_view(input);
+            int axis4 = axis + 4 - input->shape.ndims();
+            OpType type = op.type;
+            steps_.emplace_back(
+                [=] { run_reduce(*pool, out, in, axis4, type); });
+            break;
+        }
+        case OP_LAYERNORM: {
+            CpuView in = this->get_view(op.inputs[0]);
+            steps_.emplace_back([=] { run_layernorm(*pool, out, in); });
+            break;
+        }
+        case OP_ROPE: {
+            std::vector<CpuView> ins{
+                broadcast_view(this->get_view(op.inputs[0]), out.shape),
+                broadcast_view(this->get_view(op.inputs[1]), out.shape)};
+            steps_.emplace_back([=] {
+                run_ewise(*pool, out, ins,
+                          [](float *y, const float *const *xs, DimType n) {
+                              const float *a = xs[0];
+                              const float *b = xs[1];
+                              for (DimType i = 0; i + 1 < n; i += 2) {
+                                  y[i] = a[i] * b[i] - a[i + 1] * b[i + 1];
+                                  y[i + 1] = a[i] * b[i + 1] + a[i + 1] * b[i];
+                              }
+                          });
+            });
+            break;
+        }
+        case OP_TRANSPOSE: {
+            int tp_type;
+            op.args.get(&tp_type, 0);
+            int perm[4] = {tp_type / 1000, tp_type / 100 % 10,
+                           tp_type / 10 % 10, tp_type % 10};
+            // The input viewed in the order of the output dimensions.
+            CpuView in = this->get_view(op.inputs[0]);
+            CpuView src = in;
+            for (int i = 0; i < 4; ++i) {
+                src.shape[i] = in.shape[perm[i]];
+                src.stride[i] = in.stride[perm[i]];
+            }
+            steps_.emplace_back([=] { copy_view(*pool, out, src); });
+            break;
+        }
+        case OP_EMBEDDING: {
+            CpuView in = this->get_view(op.inputs[0]);
+            CpuView weight = this->get_view(op.inputs[1]);
+            if (in.type != CPU_INT32) {
+                ERR(InvalidUsageError, "embedding indices should be INT32: ",
+                    op.inputs[0]->type);
+            }
+            steps_.emplace_back(
+                [=] { run_embedding(*pool, out, in, weight); });
+            break;
+        }
+        case OP_MATMUL: {
+            CpuMatmul mm;
+            bool trans_a;
+            bool trans_b;
+            int activation;
+            op.args.get(&trans_a, 4);
+            op.args.get(&trans_b, 5);
+            op.args.get(&activation, 6);
+            op.args.get(&mm.has_bias, 7);
+            op.args.get(&mm.has_residual, 8);
+            mm.a = this->get_view(op.inputs[0]);
+            mm.b = this->get_view(op.inputs[1]);
+            mm.y = out;
+            if (op.inputs[1]->shape.ndims() == 1) {
+                // A vector is a matrix of a single column.
+                mm.b.shape[2] = mm.b.shape[3];
+                mm.b.stride[2] = mm.b.stride[3];
+                mm.b.shape[3] = 1;
+            }
+            size_t idx = 2;
+            if (mm.has_bias) mm.bias = this->get_view(op.inputs[idx++]);
+            if (mm.has_residual) {
+                mm.residual = this->get_view(op.inputs[idx++]);
+            }
+            mm.activation = get_row_unary(activation);
+            mm.m = trans_a ? mm.a.shape[3] : mm.a.shape[2];
+            mm.k = trans_a ? mm.a.shape[2] : mm.a.shape[3];
+            mm.n = trans_b ? mm.b.shape[2] : mm.b.shape[3];
+            mm.a_row_stride = mm.a.stride[trans_a ? 3 : 2];
+            mm.a_col_stride = mm.a.stride[trans_a ? 2 : 3];
+            mm.b_row_stride = mm.b.stride[trans_b ? 3 : 2];
+            mm.b_col_stride = mm.b.stride[trans_b ? 2 : 3];
+            DimType k_b = trans_b ? mm.b.shape[3] : mm.b.shape[2];
+            if (mm.k != k_b || mm.m != out.shape[2] || mm.n != out.shape[3]) {
+                ERR(ModelError, "unexpected shapes of matmul ", op.name);
+            }
+            steps_.emplace_back([=] { run_matmul(*pool, mm); });
+            break;
+        }
+        default:
+            ERR(InvalidUsageError, "op ", op.name, " of type ", op.type,
+                " is not supported on CPU");
+    }
+}
+
+void CpuExecutor::Impl::tensor_write(const Tensor *tns, const void *buf) {
+    if (buf == nullptr) {
+        ERR(InvalidUsageError, "the given host buffer is null");
+    }
+    const CpuView &view = this->get_view(tns);
+    const char *src = static_cast<const char *>(buf);
+    size_t row_bytes = view.shape[3] * view.type_bytes;
+    for (DimType row = 0; row < view.num_rows(); ++row) {
+        DimType i0, i1, i2;
+        unravel_row(view, row, i0, i1, i2);
+        std::memcpy(view.data + view.offset(i0, i1, i2) * view.type_bytes,
+                    src + row * row_bytes, row_bytes);
+    }
+}
+
+void CpuExecutor::Impl::tensor_read(const Tensor *tns, void *buf) {
+    if (buf == nullptr) {
+        ERR(InvalidUsageError, "the given host buffer is null");
+    }
+    const CpuView &view = this->get_view(tns);
+    char *dst = static_cast<char *>(buf);
+    size_t row_bytes = view.shape[3] * view.type_bytes;
+    for (DimType row = 0; row < view.num_rows(); ++row) {
+        DimType i0, i1, i2;
+        unravel_row(view, row, i0, i1, i2);
+        std::memcpy(dst + row * row_bytes,
+                    view.data + view.offset(i0, i1, i2) * view.type_bytes,
+                    row_bytes);
+    }
+}
+
+void CpuExecutor::Impl::run(int iter) {
+    for (int i = 0; i < iter; ++i) {
+        for (auto &step : steps_) {
+            step();
+        }
+    }
+}
+
+CpuExecutor::CpuExecutor(const Model &model, int num_threads)
+    : impl_{std::make_unique<CpuExecutor::Impl>(model, num_threads)} {}
+
+CpuExecutor::~CpuExecutor() = default;
+
+void CpuExecutor::tensor_write(const Tensor *tns, const void *buf) {
+    impl_->tensor_write(tns, buf);
+}
+
+void CpuExecutor::tensor_read(const Tensor *tns, void *buf) {
+    impl_->tensor_read(tns, buf);
+}
+
+void CpuExecutor::run(int iter) { impl_->run(iter); }
+
+}  // namespace ark
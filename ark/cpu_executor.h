@@ -0,0 +1,114 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#ifndef ARK_CPU_EXECUTOR_H
+#define ARK_CPU_EXECUTOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "include/ark.h"
+#include "ops/ops_common.h"
+
+namespace ark {
+
+/// Data types that the CPU kernels read and write.
+typedef enum {
+    CPU_FP32,
+    CPU_FP16,
+    CPU_BF16,
+    CPU_INT32,
+    CPU_UINT32,
+    CPU_INT8,
+    CPU_UINT8,
+} CpuType;
+
+/// Elements of a tensor in host memory as a 4D array. A stride of 0
+/// broadcasts the only element of the dimension.
+struct CpuView {
+    /// Address of the element [0][0][0][0].
+    char *data = nullptr;
+    CpuType type = CPU_FP32;
+    int type_bytes = 4;
+    DimType shape[4] = {1, 1, 1, 1};
+    /// Distance between consecutive indices of each dimension in elements.
+    DimType stride[4] = {0, 0, 0, 1};
+
+    /// Offset to the element [i0][i1][i2][i3] in elements.
+    DimType offset(DimType i0, DimType i1, DimType i2, DimType i3 = 0) const {
+        return i0 * stride[0] + i1 * stride[1] + i2 * stride[2] +
+               i3 * stride[3];
+    }
+
+    /// Number of rows, i.e., the product of the first three dimensions.
+    DimType num_rows() const { return shape[0] * shape[1] * shape[2]; }
+};
+
+/// Host threads that run the chunks of a loop together with the caller.
+class CpuThreadPool {
+   public:
+    /// @param num_threads Number of threads including the caller.
+    CpuThreadPool(int num_threads);
+    ~CpuThreadPool();
+    CpuThreadPool(const CpuThreadPool &) = delete;
+    CpuThreadPool &operator=(const CpuThreadPool &) = delete;
+
+    /// Call @p func(begin, end) over the ranges that cover [0, @p num) and
+    /// return when all calls finish. Each range has at least @p grain
+    /// iterations unless it is the last one.
+    void parallel_for(DimType num, DimType grain,
+                      const std::function<void(DimType, DimType)> &func);
+
+   private:
+    void work();
+    void run_chunks();
+
+    std::vector<std::thread> threads_;
+    std::mutex mtx_;
+    std::condition_variable job_cv_;
+    std::condition_variable done_cv_;
+    // The current loop.
+    const std::function<void(DimType, DimType)> *func_ = nullptr;
+    DimType num_ = 0;
+    DimType chunk_ = 1;
+    std::atomic<DimType> next_{0};
+    // Number of workers that have not finished the current loop.
+    int num_busy_ = 0;
+    unsigned long long job_id_ = 0;
+    bool stop_ = false;
+};
+
+class CpuExecutor::Impl {
+   public:
+    Impl(const Model &model, int num_threads);
+    ~Impl() = default;
+
+    void tensor_write(const Tensor *tns, const void *buf);
+    void tensor_read(const Tensor *tns, void *buf);
+    void run(int iter);
+
+   private:
+    // Ops of @p impl in the order of execution.
+    std::vector<const Op *> sort_ops(const Model::Impl &impl) const;
+    // Translate @p op into a step of `steps_`.
+    void add_step(const Op &op);
+    const CpuView &get_view(const Tensor *tns) const;
+
+    CpuThreadPool pool_;
+    // Host memory of each TensorBuf.
+    std::map<const TensorBuf *, std::vector<char>> bufs_;
+    std::map<const Tensor *, CpuView> views_;
+    // Ops in the order of execution.
+    std::vector<std::function<void()>> steps_;
+};
+
+}  // namespace ark
+
+#endif  // ARK_CPU_EXECUTOR_H
@@ -0,0 +1,553 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include <cmath>
+#include <vector>
+
+#include "bfloat16.h"
+#include "half.h"
+#include "include/ark.h"
+#include "random.h"
+#include "sched/sched_fusion.h"
+#include "sched/sched_pass.h"
+#include "unittest/unittest_utils.h"
+
+template <typename T>
+static std::vector<T> rand_data(size_t num, float min_val = -1,
+                                float max_val = 1) {
+    std::vector<T> data(num);
+    for (auto &v : data) {
+        v = ark::rand<T>(min_val, max_val);
+    }
+    return data;
+}
+
+template <typename T>
+static std::vector<T> read(ark::CpuExecutor &exe, ark::Tensor *tns) {
+    std::vector<T> data(tns->shape.size());
+    exe.tensor_read(tns, data.data());
+    return data;
+}
+
+// Row-major offset of [i0][i1][i2][i3] in @p shape, which broadcasts the
+// dimensions of 1.
+static size_t bcast_idx(const ark::Dims &shape, ark::DimType i0,
+                        ark::DimType i1, ark::DimType i2, ark::DimType i3) {
+    ark::Dims s = shape.dims4();
+    ark::DimType idx[4] = {i0, i1, i2, i3};
+    size_t off = 0;
+    for (int i = 0; i < 4; ++i) {
+        off = off * s[i] + (s[i] == 1 ? 0 : idx[i]);
+    }
+    return off;
+}
+
+// Y[m][n] = sum_k A[m][k] * B[k][n] of a batch of 2D matrices in FP64.
+static std::vector<double> naive_matmul(const std::vector<float> &a,
+                                        const std::vector<float> &b,
+                                        ark::DimType m, ark::DimType n,
+                                        ark::DimType k, bool trans_b) {
+    std::vector<double> y(m * n, 0);
+    for (ark::DimType i = 0; i < m; ++i) {
+        for (ark::DimType j = 0; j < n; ++j) {
+            double sum = 0;
+            for (ark::DimType kk = 0; kk < k; ++kk) {
+                float b_val = trans_b ? b[j * k + kk] : b[kk * n + j];
+                sum += (double)a[i * k + kk] * b_val;
+            }
+            y[i * n + j] = sum;
+        }
+    }
+    return y;
+}
+
+ark::unittest::State test_cpu_executor_arithmetic() {
+    ark::Model model;
+    ark::Tensor *a = model.tensor({2, 3, 1, 64}, ark::FP32);
+    ark::Tensor *b = model.tensor({3, 5, 1}, ark::FP32);
+    std::vector<ark::Tensor *> outs{model.add(a, b), model.sub(a, b),
+                                    model.mul(a, b), model.div(a, b)};
+    UNITTEST_EQ(outs[0]->shape, ark::Dims(2, 3, 5, 64));
+
+    ark::CpuExecutor exe{model, 4};
+    auto a_data = rand_data<float>(a->shape.size());
+    auto b_data = rand_data<float>(b->shape.size(), 1, 2);
+    exe.tensor_write(a, a_data.data());
+    exe.tensor_write(b, b_data.data());
+    exe.run();
+
+    std::vector<std::vector<float>> res;
+    for (auto out : outs) {
+        res.emplace_back(read<float>(exe, out));
+    }
+    size_t idx = 0;
+    for (ark::DimType i0 = 0; i0 < 2; ++i0) {
+        for (ark::DimType i1 = 0; i1 < 3; ++i1) {
+            for (ark::DimType i2 = 0; i2 < 5; ++i2) {
+                for (ark::DimType i3 = 0; i3 < 64; ++i3, ++idx) {
+                    float x = a_data[bcast_idx(a->shape, i0, i1, i2, i3)];
+                    float y = b_data[bcast_idx(b->shape, i0, i1, i2, i3)];
+                    UNITTEST_EQ(res[0][idx], x + y);
+                    UNITTEST_EQ(res[1][idx], x - y);
+                    UNITTEST_EQ(res[2][idx], x * y);
+                    UNITTEST_EQ(res[3][idx], x / y);
+                }
+            }
+        }
+    }
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_cpu_executor_matmul_fp32() {
+    const ark::DimType m = 33, n = 45, k = 70;
+    ark::Model model;
+    ark::Tensor *a = model.tensor({3, m, k}, ark::FP32);
+    ark::Tensor *b = model.tensor({k, n}, ark::FP32);
+    ark::Tensor *b_t = model.tensor({n, k}, ark::FP32);
+    ark::Tensor *y = model.matmul(a, b);
+    ark::Tensor *y_t = model.matmul(a, b_t, nullptr, 1, false, true);
+
+    ark::CpuExecutor exe{model, 4};
+    auto a_data = rand_data<float>(a->shape.size());
+    auto b_data = rand_data<float>(b->shape.size());
+    auto b_t_data = rand_data<float>(b_t->shape.size());
+    exe.tensor_write(a, a_data.data());
+    exe.tensor_write(b, b_data.data());
+    exe.tensor_write(b_t, b_t_data.data());
+    exe.run();
+
+    auto y_data = read<float>(exe, y);
+    auto y_t_data = read<float>(exe, y_t);
+    for (int batch = 0; batch < 3; ++batch) {
+        std::vector<float> a_mat(a_data.begin() + batch * m * k,
+                                 a_data.begin() + (batch + 1) * m * k);
+        auto gt = naive_matmul(a_mat, b_data, m, n, k, false);
+        auto gt_t = naive_matmul(a_mat, b_t_data, m, n, k, true);
+        for (ark::DimType i = 0; i < m * n; ++i) {
+            UNITTEST_TRUE(std::abs(y_data[batch * m * n + i] - gt[i]) < 1e-4);
+            UNITTEST_TRUE(std::abs(y_t_data[batch * m * n + i] - gt_t[i]) <
+                          1e-4);
+        }
+    }
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_cpu_executor_matmul_broadcast() {
+    // The N dimension of A and the C dimension of B are broadcast.
+    const ark::DimType m = 17, n = 9, k = 24;
+    ark::Model model;
+    ark::Tensor *a = model.tensor({2, 1, m, k}, ark::FP32);
+    ark::Tensor *b = model.tensor({1, 3, k, n}, ark::FP32);
+    ark::Tensor *y = model.matmul(a, b);
+    UNITTEST_EQ(y->shape, ark::Dims(2, 3, m, n));
+
+    ark::CpuExecutor exe{model, 2};
+    auto a_data = rand_data<float>(a->shape.size());
+    auto b_data = rand_data<float>(b->shape.size());
+    exe.tensor_write(a, a_data.data());
+    exe.tensor_write(b, b_data.data());
+    exe.run();
+
+    auto y_data = read<float>(exe, y);
+    for (int i0 = 0; i0 < 2; ++i0) {
+        for (int i1 = 0; i1 < 3; ++i1) {
+            std::vector<float> a_mat(a_data.begin() + i0 * m * k,
+                                     a_data.begin() + (i0 + 1) * m * k);
+            std::vector<float> b_mat(b_data.begin() + i1 * k * n,
+                                     b_data.begin() + (i1 + 1) * k * n);
+            auto gt = naive_matmul(a_mat, b_mat, m, n, k, false);
+            const float *res = &y_data[(i0 * 3 + i1) * m * n];
+            for (ark::DimType i = 0; i < m * n; ++i) {
+                UNITTEST_TRUE(std::abs(res[i] - gt[i]) < 1e-4);
+            }
+        }
+    }
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_cpu_executor_matmul_fp16_epilogue() {
+    const ark::DimType m = 64, n = 96, k = 128;
+    ark::Model model;
+    ark::Tensor *a = model.tensor({m, k}, ark::FP16);
+    ark::Tensor *b = model.tensor({k, n}, ark::FP16);
+    ark::Tensor *bias = model.tensor({n}, ark::FP16);
+    ark::Tensor *residual = model.tensor({m, n}, ark::FP16);
+    ark::Tensor *y =
+        model.matmul(a, b, nullptr, 1, false, false, "matmul", -1,
+                     ark::MatmulEpilogue{bias, "relu", residual, ark::FP32});
+    UNITTEST_EQ(y->type, ark::FP32);
+
+    ark::CpuExecutor exe{model};
+    auto a_data = rand_data<ark::half_t>(a->shape.size());
+    auto b_data = rand_data<ark::half_t>(b->shape.size());
+    auto bias_data = rand_data<ark::half_t>(bias->shape.size());
+    auto res_data = rand_data<ark::half_t>(residual->shape.size());
+    exe.tensor_write(a, a_data.data());
+    exe.tensor_write(b, b_data.data());
+    exe.tensor_write(bias, bias_data.data());
+    exe.tensor_write(residual, res_data.data());
+    exe.run();
+
+    auto y_data = read<float>(exe, y);
+    std::vector<float> a_f(a_data.begin(), a_data.end());
+    std::vector<float> b_f(b_data.begin(), b_data.end());
+    auto gt = naive_matmul(a_f, b_f, m, n, k, false);
+    for (ark::DimType i = 0; i < m; ++i) {
+        for (ark::DimType j = 0; j < n; ++j) {
+            double v = std::max(gt[i * n + j] + float(bias_data[j]), 0.0) +
+                       float(res_data[i * n + j]);
+            // The epilogue result is stored in FP16 before the cast.
+            UNITTEST_TRUE(std::abs(y_data[i * n + j] - v) <
+                          std::abs(v) * 1e-3 + 1e-4);
+        }
+    }
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_cpu_executor_matmul_split_k() {
+    // Split-K runs the shards of K as separate matmuls and adds them up.
+    const ark::DimType m = 16, n = 32, k = 256;
+    ark::Model model;
+    ark::Tensor *a = model.tensor({m, k}, ark::FP32);
+    ark::Tensor *b = model.tensor({k, n}, ark::FP32);
+    ark::Tensor *y = model.matmul(a, b, nullptr, 4);
+
+    ark::CpuExecutor exe{model};
+    auto a_data = rand_data<float>(a->shape.size());
+    auto b_data = rand_data<float>(b->shape.size());
+    exe.tensor_write(a, a_data.data());
+    exe.tensor_write(b, b_data.data());
+    exe.run();
+
+    auto y_data = read<float>(exe, y);
+    auto gt = naive_matmul(a_data, b_data, m, n, k, false);
+    for (ark::DimType i = 0; i < m * n; ++i) {
+        UNITTEST_TRUE(std::abs(y_data[i] - gt[i]) < 1e-4);
+    }
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_cpu_executor_reduce() {
+    ark::Model model;
+    ark::Tensor *x = model.tensor({4, 6, 10}, ark::FP32);
+    ark::Tensor *sum0 = model.reduce_sum(x, 0);
+    ark::Tensor *mean1 = model.reduce_mean(x, 1, false);
+    ark::Tensor *max2 = model.reduce_max(x, -1);
+    UNITTEST_EQ(sum0->shape, ark::Dims(1, 6, 10));
+    UNITTEST_EQ(mean1->shape, ark::Dims(4, 10));
+    UNITTEST_EQ(max2->shape, ark::Dims(4, 6, 1));
+
+    ark::CpuExecutor exe{model, 3};
+    auto x_data = rand_data<float>(x->shape.size());
+    exe.tensor_write(x, x_data.data());
+    exe.run();
+
+    auto sum0_data = read<float>(exe, sum0);
+    auto mean1_data = read<float>(exe, mean1);
+    auto max2_data = read<float>(exe, max2);
+    auto at = [&](int i, int j, int l) { return x_data[(i * 6 + j) * 10 + l]; };
+    for (int j = 0; j < 6; ++j) {
+        for (int l = 0; l < 10; ++l) {
+            float sum = 0;
+            for (int i = 0; i < 4; ++i) sum += at(i, j, l);
+            UNITTEST_TRUE(std::abs(sum0_data[j * 10 + l] - sum) < 1e-5);
+        }
+    }
+    for (int i = 0; i < 4; ++i) {
+        for (int l = 0; l < 10; ++l) {
+            float sum = 0;
+            for (int j = 0; j < 6; ++j) sum += at(i, j, l);
+            UNITTEST_TRUE(std::abs(mean1_data[i * 10 + l] - sum / 6) < 1e-5);
+        }
+        for (int j = 0; j < 6; ++j) {
+            float max = at(i, j, 0);
+            for (int l = 1; l < 10; ++l) max = std::max(max, at(i, j, l));
+            UNITTEST_EQ(max2_data[i * 6 + j], max);
+        }
+    }
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_cpu_executor_layernorm_bf16() {
+    const int rows = 8, cols = 256;
+    ark::Model model;
+    ark::Tensor *x = model.tensor({rows, cols}, ark::BF16);
+    ark::Tensor *y = model.layernorm(x);
+
+    ark::CpuExecutor exe{model};
+    auto x_data = rand_data<ark::bfloat16_t>(x->shape.size());
+    exe.tensor_write(x, x_data.data());
+    exe.run();
+
+    auto y_data = read<ark::bfloat16_t>(exe, y);
+    for (int r = 0; r < rows; ++r) {
+        double mean = 0;
+        for (int c = 0; c < cols; ++c) mean += float(x_data[r * cols + c]);
+        mean /= cols;
+        double var = 0;
+        for (int c = 0; c < cols; ++c) {
+            double d = float(x_data[r * cols + c]) - mean;
+            var += d * d;
+        }
+        var /= cols;
+        for (int c = 0; c < cols; ++c) {
+            double gt =
+                (float(x_data[r * cols + c]) - mean) / std::sqrt(var + 1e-5);
+            UNITTEST_TRUE(std::abs(float(y_data[r * cols + c]) - gt) < 2e-2);
+        }
+    }
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_cpu_executor_softmax_fp16() {
+    // A softmax out of element-wise ops and reductions, as in attention.
+    const int rows = 32, cols = 100;
+    ark::Model model;
+    ark::Tensor *x = model.tensor({2, rows, cols}, ark::FP16);
+    ark::Tensor *s = model.scale(x, 0.5f);
+    ark::Tensor *e = model.exp(model.sub(s, model.reduce_max(s, -1)));
+    ark::Tensor *y = model.div(e, model.reduce_sum(e, -1));
+
+    ark::CpuExecutor exe{model};
+    auto x_data = rand_data<ark::half_t>(x->shape.size(), -4, 4);
+    exe.tensor_write(x, x_data.data());
+    exe.run();
+
+    auto y_data = read<ark::half_t>(exe, y);
+    for (int r = 0; r < 2 * rows; ++r) {
+        double max = -INFINITY;
+        for (int c = 0; c < cols; ++c) {
+            max = std::max(max, 0.5 * float(x_data[r * cols + c]));
+        }
+        double sum = 0;
+        for (int c = 0; c < cols; ++c) {
+            sum += std::exp(0.5 * float(x_data[r * cols + c]) - max);
+        }
+        for (int c = 0; c < cols; ++c) {
+            double gt = std::exp(0.5 * float(x_data[r * cols + c]) - max) / sum;
+            UNITTEST_TRUE(std::abs(float(y_data[r * cols + c]) - gt) < 1e-3);
+        }
+    }
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_cpu_executor_transpose() {
+    ark::Model model;
+    ark::Tensor *x = model.tensor({2, 3, 4, 5}, ark::FP16);
+    ark::Tensor *y = model.transpose(x, {0, 2, 3, 1});
+    UNITTEST_EQ(y->shape, ark::Dims(2, 4, 5, 3));
+
+    ark::CpuExecutor exe{model, 2};
+    auto x_data = rand_data<ark::half_t>(x->shape.size());
+    exe.tensor_write(x, x_data.data());
+    exe.run();
+
+    auto y_data = read<ark::half_t>(exe, y);
+    for (int n = 0; n < 2; ++n) {
+        for (int c = 0; c < 3; ++c) {
+            for (int h = 0; h < 4; ++h) {
+                for (int w = 0; w < 5; ++w) {
+                    auto v = x_data[((n * 3 + c) * 4 + h) * 5 + w];
+                    auto t = y_data[((n * 4 + h) * 5 + w) * 3 + c];
+                    UNITTEST_EQ(t.storage, v.storage);
+                }
+            }
+        }
+    }
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_cpu_executor_embedding() {
+    const int num_emb = 10, emb_dim = 16;
+    ark::Model model;
+    ark::Tensor *idx = model.tensor({2, 5}, ark::INT32);
+    ark::Tensor *weight = model.tensor({num_emb, emb_dim}, ark::FP32);
+    ark::Tensor *y = model.embedding(idx, weight);
+    UNITTEST_EQ(y->shape, ark::Dims(2, 5, emb_dim));
+
+    ark::CpuExecutor exe{model};
+    std::vector<int> idx_data{0, 3, 9, -1, -10, 5, 5, 2, 1, 8};
+    auto w_data = rand_data<float>(weight->shape.size());
+    exe.tensor_write(idx, idx_data.data());
+    exe.tensor_write(weight, w_data.data());
+    exe.run();
+
+    auto y_data = read<float>(exe, y);
+    for (size_t i = 0; i < idx_data.size(); ++i) {
+        int row = idx_data[i] < 0 ? idx_data[i] + num_emb : idx_data[i];
+        for (int d = 0; d < emb_dim; ++d) {
+            UNITTEST_EQ(y_data[i * emb_dim + d], w_data[row * emb_dim + d]);
+        }
+    }
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_cpu_executor_cast() {
+    ark::Model model;
+    ark::Tensor *x = model.tensor({3, 40}, ark::FP32);
+    ark::Tensor *to_fp16 = model.cast(x, ark::FP16);
+    ark::Tensor *to_int = model.cast(x, ark::INT32);
+    ark::Tensor *back = model.cast(to_fp16, ark::FP32);
+
+    ark::CpuExecutor exe{model};
+    auto x_data = rand_data<float>(x->shape.size(), -100, 100);
+    exe.tensor_write(x, x_data.data());
+    exe.run();
+
+    auto fp16_data = read<ark::half_t>(exe, to_fp16);
+    auto int_data = read<int>(exe, to_int);
+    auto back_data = read<float>(exe, back);
+    for (size_t i = 0; i < x_data.size(); ++i) {
+        UNITTEST_EQ(fp16_data[i].storage, ark::half_t(x_data[i]).storage);
+        UNITTEST_EQ(int_data[i], int(x_data[i]));
+        UNITTEST_EQ(back_data[i], float(ark::half_t(x_data[i])));
+    }
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_cpu_executor_rope() {
+    ark::Model model;
+    ark::Tensor *x = model.tensor({1, 2, 4, 8}, ark::FP32);
+    ark::Tensor *freq = model.tensor({1, 1, 4, 8}, ark::FP32);
+    ark::Tensor *y = model.rope(x, freq);
+
+    ark::CpuExecutor exe{model};
+    auto x_data = rand_data<float>(x->shape.size());
+    auto f_data = rand_data<float>(freq->shape.size());
+    exe.tensor_write(x, x_data.data());
+    exe.tensor_write(freq, f_data.data());
+    exe.run();
+
+    auto y_data = read<float>(exe, y);
+    for (int c = 0; c < 2; ++c) {
+        for (int i = 0; i < 4 * 8; i += 2) {
+            const float *a = &x_data[c * 32 + i];
+            const float *b = &f_data[i];
+            UNITTEST_EQ(y_data[c * 32 + i], a[0] * b[0] - a[1] * b[1]);
+            UNITTEST_EQ(y_data[c * 32 + i + 1], a[0] * b[1] + a[1] * b[0]);
+        }
+    }
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_cpu_executor_layout() {
+    // `part` is a [4, 8] window at [1, 4] of the [6, 16] buffer of `whole`.
+    ark::Model model;
+    ark::Tensor *whole = model.tensor({6, 16}, ark::FP32);
+    ark::Tensor *part =
+        model.tensor({4, 8}, ark::FP32, whole->buf, {6, 16}, {1, 4});
+    ark::Tensor *y = model.scale(part, 2.0f);
+    // The output is written into a window of another buffer.
+    ark::Tensor *out_whole = model.tensor({8, 32}, ark::FP32);
+    ark::Tensor *out_part =
+        model.tensor({4, 8}, ark::FP32, out_whole->buf, {8, 32}, {2, 16});
+    model.scale(part, -1.0f, out_part);
+
+    ark::CpuExecutor exe{model, 4};
+    std::vector<float> whole_data(whole->shape.size());
+    for (size_t i = 0; i < whole_data.size(); ++i) whole_data[i] = i;
+    exe.tensor_write(whole, whole_data.data());
+    exe.run();
+
+    auto y_data = read<float>(exe, y);
+    auto out_data = read<float>(exe, out_whole);
+    for (int r = 0; r < 4; ++r) {
+        for (int c = 0; c < 8; ++c) {
+            float v = whole_data[(r + 1) * 16 + c + 4];
+            UNITTEST_EQ(y_data[r * 8 + c], 2 * v);
+        }
+    }
+    for (int r = 0; r < 8; ++r) {
+        for (int c = 0; c < 32; ++c) {
+            bool inside = (r >= 2 && r < 6 && c >= 16 && c < 24);
+            float v = inside ? -whole_data[(r - 1) * 16 + c - 12] : 0;
+            UNITTEST_EQ(out_data[r * 32 + c], v);
+        }
+    }
+
+    // Writing a window keeps the rest of the buffer.
+    std::vector<float> part_data(part->shape.size(), -1);
+    exe.tensor_write(part, part_data.data());
+    auto whole_res = read<float>(exe, whole);
+    for (int r = 0; r < 6; ++r) {
+        for (int c = 0; c < 16; ++c) {
+            bool inside = (r >= 1 && r < 5 && c >= 4 && c < 12);
+            UNITTEST_EQ(whole_res[r * 16 + c],
+                        inside ? -1 : whole_data[r * 16 + c]);
+        }
+    }
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_cpu_executor_graph_passes() {
+    // Results before and after fusing the ops by graph passes.
+    ark::Model model;
+    ark::Tensor *a = model.tensor({4, 64, 256}, ark::FP32);
+    ark::Tensor *b = model.tensor({1, 256}, ark::FP32);
+    ark::Tensor *w = model.tensor({256, 128}, ark::FP32);
+    ark::Tensor *bias = model.tensor({128}, ark::FP32);
+    ark::Tensor *t = model.relu(model.scale(model.add(a, b), 2));
+    ark::Tensor *y = model.sigmoid(model.mul(t, a));
+    ark::Tensor *z = model.relu(model.add(model.matmul(y, w), bias));
+
+    // Translated before the passes rewrite the model.
+    ark::CpuExecutor ref{model};
+    ark::GraphPassManager passes;
+    passes.add(std::make_unique<ark::EwiseFusionPass>());
+    passes.add(std::make_unique<ark::MatmulEpiloguePass>());
+    UNITTEST_TRUE(passes.run(model) > 0);
+    ark::CpuExecutor fused{model};
+
+    auto a_data = rand_data<float>(a->shape.size());
+    auto b_data = rand_data<float>(b->shape.size());
+    auto w_data = rand_data<float>(w->shape.size());
+    auto bias_data = rand_data<float>(bias->shape.size());
+    for (ark::CpuExecutor *exe : {&ref, &fused}) {
+        exe->tensor_write(a, a_data.data());
+        exe->tensor_write(b, b_data.data());
+        exe->tensor_write(w, w_data.data());
+        exe->tensor_write(bias, bias_data.data());
+        exe->run();
+    }
+    auto z_ref = read<float>(ref, z);
+    auto z_fused = read<float>(fused, z);
+    for (size_t i = 0; i < z_ref.size(); ++i) {
+        UNITTEST_TRUE(std::abs(z_ref[i] - z_fused[i]) < 1e-5);
+    }
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_cpu_executor_invalid() {
+    ark::Model model;
+    ark::Tensor *x = model.tensor({1, 3, 8, 8}, ark::FP16);
+    model.im2col(x, 3, 3, 1, 1, 1, 1, 1, 1);
+    UNITTEST_THROW(ark::CpuExecutor(model), ark::InvalidUsageError);
+
+    ark::Model model2;
+    ark::Tensor *y = model2.relu(model2.tensor({8}, ark::FP32));
+    ark::CpuExecutor exe{model2};
+    std::vector<ark::half_t> buf(x->shape.size());
+    UNITTEST_THROW(exe.tensor_read(x, buf.data()), ark::InvalidUsageError);
+    UNITTEST_THROW(exe.tensor_write(y, nullptr), ark::InvalidUsageError);
+    return ark::unittest::SUCCESS;
+}
+
+int main() {
+    ark::init();
+    UNITTEST(test_cpu_executor_arithmetic);
+    UNITTEST(test_cpu_executor_matmul_fp32);
+    UNITTEST(test_cpu_executor_matmul_broadcast);
+    UNITTEST(test_cpu_executor_matmul_fp16_epilogue);
+    UNITTEST(test_cpu_executor_matmul_split_k);
+    UNITTEST(test_cpu_executor_reduce);
+    UNITTEST(test_cpu_executor_layernorm_bf16);
+    UNITTEST(test_cpu_executor_softmax_fp16);
+    UNITTEST(test_cpu_executor_transpose);
+    UNITTEST(test_cpu_executor_embedding);
+    UNITTEST(test_cpu_executor_cast);
+    UNITTEST(test_cpu_executor_rope);
+    UNITTEST(test_cpu_executor_layout);
+    UNITTEST(test_cpu_executor_graph_passes);
+    UNITTEST(test_cpu_executor_invalid);
+    return 0;
+}
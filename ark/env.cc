@@ -17,10 +17,26 @@
 #define DEFAULT_ARK_DISABLE_P2P_MEMCPY false
 #define DEFAULT_ARK_DISABLE_IB false
 #define DEFAULT_ARK_DISABLE_GRAPH_OPT false
+#define DEFAULT_ARK_DISABLE_GRAPH_PASSES ""
+#define DEFAULT_ARK_ENABLE_GRAPH_PASSES ""
 #define DEFAULT_ARK_IGNORE_BINARY_CACHE false
+#define DEFAULT_ARK_CACHE_DIR_NAME "cache"
+#define DEFAULT_ARK_CACHE_MAX_MB 4096
 #define DEFAULT_ARK_SHM_NAME_PREFIX "ark."
 #define DEFAULT_ARK_ENFORCE_KERNEL_CODE_PATH ""
 #define DEFAULT_ARK_MSCCLPP_PORT 50051
+#define DEFAULT_ARK_TUNE_DB ""
+#define DEFAULT_ARK_TUNE_EXPLORE false
+#define DEFAULT_ARK_REUSE_BUFFERS false
+#define DEFAULT_ARK_SCHED_POLICY "greedy"
+#define DEFAULT_ARK_NUM_COMM_SMS 1
+#define DEFAULT_ARK_NUM_COMM_STREAMS 1
+#define DEFAULT_ARK_DISPATCH "static"
+#define DEFAULT_ARK_SHARE_OPSEQ_CODE true
+#define DEFAULT_ARK_NUM_CODE_SHARDS 1
+#define DEFAULT_ARK_STAGING_POOL_MB 1024
+#define DEFAULT_ARK_TRACE ""
+#define DEFAULT_ARK_TRACE_RECORDS_PER_SM 4096
 
 template <typename T>
 T env(const std::string &env_name, const T &default_val) {
@@ -68,9 +84,22 @@ Env::Env() {
     // If `ARK_DISABLE_GRAPH_OPT=1`, we disable graph optimization.
     this->disable_graph_opt =
         env<bool>("ARK_DISABLE_GRAPH_OPT", DEFAULT_ARK_DISABLE_GRAPH_OPT);
+    // Names of graph passes to disable, e.g., `ARK_DISABLE_GRAPH_PASSES=a,b`.
+    this->disable_graph_passes = env<std::string>(
+        "ARK_DISABLE_GRAPH_PASSES", DEFAULT_ARK_DISABLE_GRAPH_PASSES);
+    // Names of opt-in graph passes to enable, e.g.,
+    // `ARK_ENABLE_GRAPH_PASSES=a,b`.
+    this->enable_graph_passes = env<std::string>(
+        "ARK_ENABLE_GRAPH_PASSES", DEFAULT_ARK_ENABLE_GRAPH_PASSES);
     // If `ARK_IGNORE_BINARY_CACHE=1`, we ignore compiled binary cache.
     this->ignore_binary_cache =
         env<bool>("ARK_IGNORE_BINARY_CACHE", DEFAULT_ARK_IGNORE_BINARY_CACHE);
+    // Get the directory of compiled binary cache, which is under `ARK_TMP` by
+    // default.
+    this->cache_dir = env<std::string>(
+        "ARK_CACHE_DIR", this->path_tmp_dir + "/" DEFAULT_ARK_CACHE_DIR_NAME);
+    // Get the size limit of compiled binary cache.
+    this->cache_max_mb = env<int>("ARK_CACHE_MAX_MB", DEFAULT_ARK_CACHE_MAX_MB);
     //
     this->shm_name_prefix =
         env<std::string>("ARK_SHM_NAME_PREFIX", DEFAULT_ARK_SHM_NAME_PREFIX);
@@ -79,6 +108,38 @@ Env::Env() {
         "ARK_ENFORCE_KERNEL_CODE_PATH", DEFAULT_ARK_ENFORCE_KERNEL_CODE_PATH);
     // Get the port number of MSCCLPP.
     this->mscclpp_port = env<int>("ARK_MSCCLPP_PORT", DEFAULT_ARK_MSCCLPP_PORT);
+    // Get the path to the tuning database.
+    this->tune_db_path = env<std::string>("ARK_TUNE_DB", DEFAULT_ARK_TUNE_DB);
+    // If true, try the choices that the tuning database has not measured.
+    this->tune_explore =
+        env<bool>("ARK_TUNE_EXPLORE", DEFAULT_ARK_TUNE_EXPLORE);
+    // If true, buffers of disjoint lifetimes share GPU memory.
+    this->reuse_buffers =
+        env<bool>("ARK_REUSE_BUFFERS", DEFAULT_ARK_REUSE_BUFFERS);
+    // Get the policy of placing uops on SMs.
+    this->sched_policy =
+        env<std::string>("ARK_SCHED_POLICY", DEFAULT_ARK_SCHED_POLICY);
+    // Get the number of SMs for communication.
+    this->num_comm_sms = env<int>("ARK_NUM_COMM_SMS", DEFAULT_ARK_NUM_COMM_SMS);
+    // Get the number of concurrent communication streams.
+    this->num_comm_streams =
+        env<int>("ARK_NUM_COMM_STREAMS", DEFAULT_ARK_NUM_COMM_STREAMS);
+    // Get the mode of dispatching uops to warps.
+    this->dispatch = env<std::string>("ARK_DISPATCH", DEFAULT_ARK_DISPATCH);
+    // If true, opseqs of the same structure share code.
+    this->share_opseq_code =
+        env<bool>("ARK_SHARE_OPSEQ_CODE", DEFAULT_ARK_SHARE_OPSEQ_CODE);
+    // Get the number of translation units of the generated code.
+    this->num_code_shards =
+        env<int>("ARK_NUM_CODE_SHARDS", DEFAULT_ARK_NUM_CODE_SHARDS);
+    // Get the size limit of the free pinned staging buffers.
+    this->staging_pool_mb =
+        env<int>("ARK_STAGING_POOL_MB", DEFAULT_ARK_STAGING_POOL_MB);
+    // Get the path of the uop trace.
+    this->trace_path = env<std::string>("ARK_TRACE", DEFAULT_ARK_TRACE);
+    // Get the number of trace records that each SM keeps.
+    this->trace_records_per_sm = env<int>("ARK_TRACE_RECORDS_PER_SM",
+                                          DEFAULT_ARK_TRACE_RECORDS_PER_SM);
 }
 
 // Global Env.
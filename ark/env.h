@@ -31,14 +31,49 @@ struct Env {
     bool disable_ib;
     // Disable the heuristic ARK graph optimization.
     bool disable_graph_opt;
+    // Comma-separated names of graph passes to disable.
+    std::string disable_graph_passes;
+    // Comma-separated names of opt-in graph passes to enable.
+    std::string enable_graph_passes;
     // Ignore compiled binary cache.
     bool ignore_binary_cache;
+    // Directory of the compiled binary cache.
+    std::string cache_dir;
+    // Size limit of the compiled binary cache in MiB, or zero for no limit.
+    int cache_max_mb;
     // Prefix of shared memory file names.
     std::string shm_name_prefix;
     // Enforce to compile a specific kernel code file.
     std::string enforce_kernel_code_path;
     // MSCCL++ bootstrap port.
     int mscclpp_port;
+    // Path to the tuning database. Empty if disabled.
+    std::string tune_db_path;
+    // Try the candidates that the tuning database has not measured yet.
+    bool tune_explore;
+    // Let buffers of disjoint lifetimes share GPU memory.
+    bool reuse_buffers;
+    // Policy of placing uops on SMs ("greedy" or "lpt").
+    std::string sched_policy;
+    // Number of SMs for communication, or zero to choose automatically.
+    int num_comm_sms;
+    // Number of concurrent communication streams.
+    int num_comm_streams;
+    // Mode of dispatching uops to warps ("static", "dynamic", or "auto").
+    std::string dispatch;
+    // If true, opseqs of the same structure share code.
+    bool share_opseq_code;
+    // Number of translation units of the generated code, or zero to choose
+    // automatically. One by default, as calls across them are not inlined.
+    int num_code_shards;
+    // Size limit of the free pinned staging buffers of asynchronous tensor
+    // copies in MiB.
+    int staging_pool_mb;
+    // Path of the Chrome trace of uops recorded by the loop kernel. Empty if
+    // disabled.
+    std::string trace_path;
+    // Number of trace records that each SM keeps.
+    int trace_records_per_sm;
 };
 
 // Get the global Env.
@@ -4,34 +4,98 @@
 #include "executor.h"
 
 #include <algorithm>
+#include <map>
+#include <sstream>
 #include <string>
 
 #include "env.h"
 #include "include/ark.h"
+#include "file_io.h"
+#include "host_trace.h"
 #include "logging.h"
 #include "sched/sched.h"
+#include "sched/sched_exec_plan.h"
 
 namespace ark {
 
 Executor::Impl::Impl(int rank, int world_size, Model &model,
-                     const std::string &name, int num_warps_per_sm)
+                     const std::string &name, int num_warps_per_sm,
+                     const std::string &plan_path)
     : rank_{rank}, world_size_{world_size} {
+    HostTraceScope scope{"Executor"};
     gpu_id_ = rank_ % get_env().num_ranks_per_host;
-    sched_.reset(static_cast<BaseScheduler *>(new DefaultScheduler{
-        model, gpu_id_, rank_, world_size_, num_warps_per_sm}));
-
-    sched_->schedule();
-    ctx_ = sched_->create_context();
+    std::vector<std::string> codes;
+    if (plan_path.empty()) {
+        codes = this->schedule(model, num_warps_per_sm);
+    } else {
+        // The scheduler modifies the model, so capture it beforehand.
+        ExecPlan::ModelRef ref{model};
+        std::string hash = ExecPlan::model_hash(model);
+        // Each rank has its own plan.
+        std::string path = plan_path;
+        if (rank_ != 0) {
+            path += "." + std::to_string(rank_);
+        }
+        std::unique_ptr<ExecPlan> plan;
+        if (is_file(path)) {
+            HostTraceScope load_scope{"ExecPlan::load"};
+            try {
+                plan = std::make_unique<ExecPlan>(ExecPlan::load(path));
+                plan->validate(hash,
+                               GpuManager::get_instance(gpu_id_)->info(),
+                               rank_, world_size_, num_warps_per_sm);
+            } catch (const InvalidUsageError &e) {
+                LOG(WARN, "ignore execution plan ", path, ": ",
+                    e.what());
+                plan.reset();
+            }
+        }
+        if (plan != nullptr) {
+            LOG(INFO, "using execution plan ", path);
+            HostTraceScope ctx_scope{"create_context"};
+            ctx_ = GpuContext::get_context(rank_, world_size_);
+            plan->create_context(ref, ctx_);
+            codes = plan->codes;
+        } else {
+            codes = this->schedule(model, num_warps_per_sm);
+            HostTraceScope save_scope{"ExecPlan::save"};
+            ExecPlan(ref, *sched_, codes, hash).save(path);
+            LOG(INFO, "saved execution plan ", path);
+        }
+    }
     const GpuManager::Info &ginfo = ctx_->get_gpu_manager()->info();
     stream_ = ctx_->get_gpu_manager()->create_stream();
     glk_ = std::make_unique<GpuLoopKernel>(
-        ctx_, name, sched_->gen_code(), ginfo.num_sm, num_warps_per_sm,
+        ctx_, name, codes, ginfo.num_sm, num_warps_per_sm,
         (unsigned int)ginfo.smem_block_total);
 }
 
-void Executor::Impl::compile() { glk_->compile(); }
+std::vector<std::string> Executor::Impl::schedule(Model &model,
+                                                  int num_warps_per_sm) {
+    {
+        HostTraceScope scope{"DefaultScheduler"};
+        sched_.reset(static_cast<BaseScheduler *>(new DefaultScheduler{
+            model, gpu_id_, rank_, world_size_, num_warps_per_sm}));
+    }
+    {
+        HostTraceScope scope{"schedule"};
+        sched_->schedule();
+    }
+    {
+        HostTraceScope scope{"create_context"};
+        ctx_ = sched_->create_context();
+    }
+    HostTraceScope scope{"gen_code"};
+    return sched_->gen_code();
+}
+
+void Executor::Impl::compile() {
+    HostTraceScope scope{"compile"};
+    glk_->compile();
+}
 
 void Executor::Impl::launch() {
+    HostTraceScope scope{"launch"};
     glk_->load();
     glk_->launch(stream_, false);
 }
@@ -42,13 +106,76 @@ void Executor::Impl::wait() { glk_->wait(); }
 
 float Executor::Impl::stop() {
     glk_->stop();
+    if (glk_->is_traced() && !get_env().trace_path.empty()) {
+        this->dump_trace();
+    }
     return glk_->get_elapsed_msec();
 }
 
+void Executor::Impl::dump_trace() {
+    GpuTrace trace = glk_->get_trace();
+    if (trace.num_dropped > 0) {
+        LOG(WARN, trace.num_dropped,
+            " trace records are overwritten. Increase "
+            "ARK_TRACE_RECORDS_PER_SM to keep them.");
+    }
+    // Opseqs are named after their ops if the executor has scheduled them.
+    std::vector<std::string> names;
+    if (sched_ != nullptr) {
+        for (auto &opseq : sched_->get_opseqs()) {
+            std::string name = opseq->get_name();
+            if (!name.empty() && name.back() == ';') {
+                name.pop_back();
+            }
+            names.emplace_back(std::move(name));
+        }
+    }
+    std::string path = get_env().trace_path;
+    if (rank_ != 0) {
+        path += "." + std::to_string(rank_);
+    }
+    std::stringstream ss;
+    trace.dump_chrome(ss, names);
+    write_file(path, ss.str());
+    LOG(INFO, "wrote a trace of ", trace.events.size(), " uops to ", path);
+}
+
+void Executor::Impl::record_timing(float elapsed_msec) {
+    if (sched_ == nullptr) {
+        ERR(InvalidUsageError,
+            "cannot record timing of an executor created from an execution "
+            "plan, which makes no scheduling decisions.");
+    }
+    // Time each opseq by the trace if there is one: the span of its uops in
+    // an iteration, averaged over the iterations.
+    std::map<int, double> opseq_usec;
+    if (glk_->is_traced()) {
+        std::map<std::pair<int, int>, std::pair<uint64_t, uint64_t>> spans;
+        for (auto &ev : glk_->get_trace().events) {
+            auto res = spans.emplace(std::make_pair(ev.opseq_id, ev.iter),
+                                     std::make_pair(ev.start, ev.end));
+            auto &span = res.first->second;
+            span.first = std::min(span.first, ev.start);
+            span.second = std::max(span.second, ev.end);
+        }
+        std::map<int, int> num_iters;
+        for (auto &p : spans) {
+            int opseq_id = p.first.first;
+            opseq_usec[opseq_id] += (p.second.second - p.second.first) * 1e-3;
+            num_iters[opseq_id]++;
+        }
+        for (auto &p : opseq_usec) {
+            p.second /= num_iters[p.first];
+        }
+    }
+    sched_->record_timing(elapsed_msec * 1e3, opseq_usec);
+}
+
 Executor::Executor(int rank, int world_size, Model &model,
-                   const std::string &name, int num_warps_per_sm)
+                   const std::string &name, int num_warps_per_sm,
+                   const std::string &plan_path)
     : impl_{std::make_unique<Executor::Impl>(rank, world_size, model, name,
-                                             num_warps_per_sm)} {}
+                                             num_warps_per_sm, plan_path)} {}
 
 Executor::~Executor() = default;
 
@@ -62,4 +189,8 @@ void Executor::wait() { impl_->wait(); }
 
 float Executor::stop() { return impl_->stop(); }
 
+void Executor::record_timing(float elapsed_msec) {
+    impl_->record_timing(elapsed_msec);
+}
+
 }  // namespace ark
@@ -14,7 +14,7 @@ namespace ark {
 class Executor::Impl {
    public:
     Impl(int rank, int world_size, Model &model, const std::string &name,
-         int num_warps_per_sm);
+         int num_warps_per_sm, const std::string &plan_path);
     ~Impl() = default;
 
     void compile();
@@ -22,13 +22,20 @@ class Executor::Impl {
     void run(int iter);
     void wait();
     float stop();
+    void record_timing(float elapsed_msec);
 
    private:
+    // Schedule @p model from scratch and return the generated code.
+    std::vector<std::string> schedule(Model &model, int num_warps_per_sm);
+    // Write the trace of uops of the last run into `ARK_TRACE`.
+    void dump_trace();
+
     const int rank_;
     const int world_size_;
     int gpu_id_;
 
     std::shared_ptr<GpuContext> ctx_;
+    // nullptr if the executor is created from a saved execution plan.
     std::unique_ptr<BaseScheduler> sched_;
     std::unique_ptr<GpuLoopKernel> glk_;
     std::shared_ptr<GpuStream> stream_;
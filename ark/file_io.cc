@@ -3,6 +3,11 @@
 
 #include "file_io.h"
 
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include <cerrno>
 #include <filesystem>
 #include <fstream>
 #include <sstream>
@@ -86,4 +91,32 @@ std::string get_dir(const std::string &path) {
     return fs::path(path).parent_path().string();
 }
 
+FileLock::FileLock(const std::string &path, bool blocking) {
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+    if (fd_ < 0) {
+        ERR(SystemError, "Failed to open a lock file: ", path, " (errno ",
+            errno, ")");
+    }
+    int op = blocking ? LOCK_EX : (LOCK_EX | LOCK_NB);
+    for (;;) {
+        if (::flock(fd_, op) == 0) {
+            locked_ = true;
+            break;
+        }
+        if (errno == EINTR) continue;
+        if (!blocking && errno == EWOULDBLOCK) break;
+        int err = errno;
+        ::close(fd_);
+        ERR(SystemError, "Failed to lock a file: ", path, " (errno ", err,
+            ")");
+    }
+}
+
+FileLock::~FileLock() {
+    if (locked_) {
+        ::flock(fd_, LOCK_UN);
+    }
+    ::close(fd_);
+}
+
 }  // namespace ark
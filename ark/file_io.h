@@ -23,6 +23,24 @@ void write_file(const std::string &path, const std::string &data);
 int remove_file(const std::string &path);
 std::string get_dir(const std::string &path);
 
+/// Exclusive advisory lock on a file, held until destruction. The file is
+/// created if it does not exist.
+class FileLock {
+   public:
+    /// Lock @p path. If @p blocking is false, return without waiting if
+    /// another process holds the lock, which @ref is_locked() tells.
+    FileLock(const std::string &path, bool blocking = true);
+    ~FileLock();
+    FileLock(const FileLock &) = delete;
+    FileLock &operator=(const FileLock &) = delete;
+
+    bool is_locked() const { return locked_; }
+
+   private:
+    int fd_;
+    bool locked_ = false;
+};
+
 }  // namespace ark
 
 #endif  // ARK_FILE_IO_H_
@@ -141,6 +141,8 @@ ARK_GPU_DEFINE_FUNC_ALIAS(gpuFree, cudaFree, hipFree);
 ARK_GPU_DEFINE_FUNC_ALIAS(gpuMemGetInfo, cudaMemGetInfo, hipMemGetInfo);
 ARK_GPU_DEFINE_FUNC_ALIAS(gpuMemcpy, cudaMemcpy, hipMemcpy);
 ARK_GPU_DEFINE_FUNC_ALIAS(gpuMemcpyAsync, cudaMemcpyAsync, hipMemcpyAsync);
+ARK_GPU_DEFINE_FUNC_ALIAS(gpuMemcpy2DAsync, cudaMemcpy2DAsync,
+                          hipMemcpy2DAsync);
 ARK_GPU_DEFINE_FUNC_ALIAS(gpuMemsetAsync, cudaMemsetAsync, hipMemsetAsync);
 ARK_GPU_DEFINE_FUNC_ALIAS(gpuSetDevice, cudaSetDevice, hipSetDevice);
 ARK_GPU_DEFINE_FUNC_ALIAS(gpuStreamCreateWithFlags, cudaStreamCreateWithFlags,
@@ -154,6 +156,9 @@ ARK_GPU_DEFINE_FUNC_ALIAS(gpuEventCreateWithFlags, cudaEventCreateWithFlags,
                           hipEventCreateWithFlags);
 ARK_GPU_DEFINE_FUNC_ALIAS(gpuEventDestroy, cudaEventDestroy, hipEventDestroy);
 ARK_GPU_DEFINE_FUNC_ALIAS(gpuEventRecord, cudaEventRecord, hipEventRecord);
+ARK_GPU_DEFINE_FUNC_ALIAS(gpuEventQuery, cudaEventQuery, hipEventQuery);
+ARK_GPU_DEFINE_FUNC_ALIAS(gpuEventSynchronize, cudaEventSynchronize,
+                          hipEventSynchronize);
 ARK_GPU_DEFINE_FUNC_ALIAS(gpuEventElapsedTime, cudaEventElapsedTime,
                           hipEventElapsedTime);
 
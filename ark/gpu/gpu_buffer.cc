@@ -50,6 +50,22 @@ void GpuBuffer::to_host(void* dst, size_t dst_offset, size_t src_offset,
     memory_->memcpy_to(host_ptr, offset_ + src_offset, bytes);
 }
 
+void GpuBuffer::from_host_2d(size_t dst_offset, size_t dst_pitch,
+                             const void* src, size_t src_pitch, size_t width,
+                             size_t height, bool async) {
+    memory_->memcpy_from_2d(src, src_pitch, offset_ + dst_offset, dst_pitch,
+                            width, height, async);
+}
+
+void GpuBuffer::to_host_2d(void* dst, size_t dst_pitch, size_t src_offset,
+                           size_t src_pitch, size_t width, size_t height,
+                           bool async) {
+    memory_->memcpy_to_2d(dst, dst_pitch, offset_ + src_offset, src_pitch,
+                          width, height, async);
+}
+
+void GpuBuffer::sync() const { memory_->sync(); }
+
 void GpuBuffer::from_buffer(size_t dst_offset, const GpuBuffer& src,
                             size_t src_offset, size_t bytes) {
     memory_->memcpy_from((void*)src.ref(src_offset), offset_ + dst_offset,
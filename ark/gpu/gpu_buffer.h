@@ -25,6 +25,14 @@ class GpuBuffer {
     void from_host(size_t dst_offset, const void* src, size_t src_offset,
                    size_t bytes);
     void to_host(void* dst, size_t dst_offset, size_t src_offset, size_t bytes);
+    // Copy `height` rows of `width` bytes, which are `*_pitch` bytes apart.
+    void from_host_2d(size_t dst_offset, size_t dst_pitch, const void* src,
+                      size_t src_pitch, size_t width, size_t height,
+                      bool async = false);
+    void to_host_2d(void* dst, size_t dst_pitch, size_t src_offset,
+                    size_t src_pitch, size_t width, size_t height,
+                    bool async = false);
+    void sync() const;
     void from_buffer(size_t dst_offset, const GpuBuffer& src, size_t src_offset,
                      size_t bytes);
 
@@ -8,22 +8,27 @@
 #include <unistd.h>
 
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <functional>
-#include <iomanip>
+#include <memory>
 #include <mutex>
+#include <sstream>
 #include <thread>
 
 #include "cpu_timer.h"
 #include "env.h"
 #include "file_io.h"
 #include "gpu/gpu_logging.h"
+#include "gpu/gpu_kernel_cache.h"
+#include "hash.h"
+#include "host_trace.h"
 #include "include/ark.h"
-#include "random.h"
 
 #define ARK_DEBUG_KERNEL 0
 
@@ -58,24 +63,39 @@ static void para_exec(std::vector<ItemType> &items, int max_num_threads,
     }
 }
 
-// TODO: use a stronger hash function
-static std::string fnv1a_hash(const std::string &str) {
-    const uint64_t FNV_prime = 1099511628211u;
-    const uint64_t FNV_offset_basis = 14695981039346656037u;
-    uint64_t hash = FNV_offset_basis;
-    for (const auto &c : str) {
-        hash ^= static_cast<uint64_t>(c);
-        hash *= FNV_prime;
-    }
-    std::stringstream ss;
-    ss << std::hex << std::setfill('0') << std::setw(16) << hash;
-    return ss.str();
+// Path of the compiler.
+static const std::string gpu_compiler_path() {
+#if defined(ARK_CUDA)
+    // TODO: use the compiler found by cmake.
+    return "/usr/local/cuda/bin/nvcc";
+#elif defined(ARK_ROCM)
+    return "/usr/bin/hipcc";
+#endif
+}
+
+static const std::string join_args(const std::vector<std::string> &args) {
+    std::stringstream cmd;
+    cmd << args[0];
+    for (size_t i = 1; i < args.size(); ++i) {
+        cmd << " " << args[i];
+    }
+    return cmd.str();
+}
+
+// Path of the relocatable object compiled from @p code_file_path.
+static const std::string object_file_path(const std::string &code_file_path) {
+    std::string path = code_file_path;
+    size_t pos = path.rfind('.');
+    if (pos != std::string::npos) {
+        path = path.substr(0, pos);
+    }
+    return path + ".o";
 }
 
 static const std::string gpu_compile_command(
     const std::string &code_file_path, const std::string &ark_root,
     const std::string &arch, [[maybe_unused]] unsigned int max_reg_cnt,
-    const std::string &output_file_path) {
+    const std::string &output_file_path, bool relocatable) {
 #if defined(ARK_CUDA)
     // Remove prepending "cuda_" from arch to get the compute capability
     if (arch.size() < 5 || arch.substr(0, 5) != "cuda_") {
@@ -85,9 +105,9 @@ static const std::string gpu_compile_command(
 
     std::vector<std::string> args;
 
-    // TODO: use the compiler found by cmake.
-    args.emplace_back("/usr/local/cuda/bin/nvcc");
-    args.emplace_back("-cubin");
+    args.emplace_back(gpu_compiler_path());
+    // Relocatable device code is linked by `gpu_link_command`.
+    args.emplace_back(relocatable ? "-dc" : "-cubin");
 #if (ARK_DEBUG_KERNEL)
     args.emplace_back("-G");
 #endif  // (ARK_DEBUG_KERNEL)
@@ -106,6 +126,10 @@ static const std::string gpu_compile_command(
     args.emplace_back("2>&1");
 
 #elif defined(ARK_ROCM)
+    if (relocatable) {
+        ERR(InvalidUsageError,
+            "Relocatable device code is not supported on ROCm");
+    }
     // Remove prepending "rocm_" from arch to get the compute capability
     if (arch.size() < 5 || arch.substr(0, 5) != "rocm_") {
         ERR(InvalidUsageError, "Invalid architecture: ", arch);
@@ -114,8 +138,7 @@ static const std::string gpu_compile_command(
 
     std::vector<std::string> args;
 
-    // TODO: use the compiler found by cmake.
-    args.emplace_back("LANG=C /usr/bin/hipcc");
+    args.emplace_back("LANG=C " + gpu_compiler_path());
     args.emplace_back("--genco");
 #if (ARK_DEBUG_KERNEL)
     args.emplace_back("-O0");
@@ -131,80 +154,248 @@ static const std::string gpu_compile_command(
 #endif
 
     // Compile command.
-    std::stringstream compile_cmd;
-    compile_cmd << args[0];
-    for (size_t i = 1; i < args.size(); ++i) {
-        compile_cmd << " " << args[i];
+    return join_args(args);
+}
+
+static const std::string gpu_link_command(
+    [[maybe_unused]] const std::vector<std::string> &object_file_paths,
+    [[maybe_unused]] const std::string &arch,
+    [[maybe_unused]] const std::string &output_file_path) {
+#if defined(ARK_CUDA)
+    if (arch.size() < 5 || arch.substr(0, 5) != "cuda_") {
+        ERR(InvalidUsageError, "Invalid architecture: ", arch);
     }
-    return compile_cmd.str();
+    std::string cc = arch.substr(5);
+
+    std::vector<std::string> args;
+    args.emplace_back(gpu_compiler_path());
+    args.emplace_back("-dlink");
+    args.emplace_back("-cubin");
+    args.emplace_back("-gencode arch=compute_" + cc + ",code=sm_" + cc);
+    args.emplace_back("-o " + output_file_path);
+    for (auto &path : object_file_paths) {
+        args.emplace_back(path);
+    }
+    args.emplace_back("2>&1");
+    return join_args(args);
+#else
+    ERR(InvalidUsageError, "Relocatable device code is not supported on ROCm");
+    return "";
+#endif
+}
+
+const std::vector<std::string> gpu_compile_commands(
+    const std::vector<std::string> &code_file_paths, const std::string &arch,
+    unsigned int max_reg_cnt, const std::string &bin_file_path) {
+    const std::string &ark_root = get_env().path_root_dir;
+    std::vector<std::string> cmds;
+    if (code_file_paths.size() == 1) {
+        cmds.emplace_back(gpu_compile_command(code_file_paths[0], ark_root,
+                                              arch, max_reg_cnt,
+                                              bin_file_path, false));
+        return cmds;
+    }
+    std::vector<std::string> object_file_paths;
+    for (auto &path : code_file_paths) {
+        object_file_paths.emplace_back(object_file_path(path));
+        cmds.emplace_back(gpu_compile_command(path, ark_root, arch,
+                                              max_reg_cnt,
+                                              object_file_paths.back(), true));
+    }
+    cmds.emplace_back(gpu_link_command(object_file_paths, arch, bin_file_path));
+    return cmds;
+}
+
+// Run @p cmd and return what it prints.
+static const std::string read_command(const std::string &cmd) {
+    std::array<char, 4096> buffer;
+    std::stringstream exec_print;
+    std::unique_ptr<FILE, decltype(&pclose)> pipe(popen(cmd.c_str(), "r"),
+                                                  pclose);
+    if (!pipe) {
+        ERR(SystemError, "popen() failed");
+    }
+    while (fgets(buffer.data(), buffer.size(), pipe.get()) != nullptr) {
+        exec_print << buffer.data();
+    }
+    return exec_print.str();
+}
+
+// Run @p cmd and raise an error if it prints anything.
+static void run_command(const std::string &cmd) {
+    std::string exec_print_str = read_command(cmd);
+    if (exec_print_str.size() > 0) {
+        ERR(ExecutorError, "\n", cmd, "\n", exec_print_str, "\n");
+    }
+}
+
+// Identity of the compiler and of the kernel headers that the generated code
+// includes, which are part of every cache key.
+static const std::string &gpu_toolchain_id() {
+    static std::once_flag flag;
+    static std::string id;
+    std::call_once(flag, [] {
+        Sha256 sha;
+        sha.update(read_command(gpu_compiler_path() + " --version 2>&1"));
+        std::string include_dir = get_env().path_root_dir + "/include";
+        std::vector<std::string> paths;
+        std::error_code ec;
+        for (const auto &entry :
+             std::filesystem::recursive_directory_iterator(include_dir, ec)) {
+            if (entry.is_regular_file()) {
+                paths.emplace_back(entry.path().string());
+            }
+        }
+        std::sort(paths.begin(), paths.end());
+        for (auto &path : paths) {
+            std::string content = read_file(path);
+            sha.update(path.substr(include_dir.size()))
+                .update(std::to_string(content.size()))
+                .update(content);
+        }
+        id = sha.hex_digest();
+        LOG(DEBUG, "Compiler and ", paths.size(), " headers under ",
+            include_dir, " hashed into ", id);
+    });
+    return id;
+}
+
+// Cache key of a binary built by @p cmd from @p inputs. The command is given
+// with placeholder paths, so it only carries the compiler flags.
+static const std::string cache_key(const std::string &kind,
+                                   const std::string &cmd,
+                                   const std::vector<std::string> &inputs) {
+    Sha256 sha;
+    sha.update(kind).update("\n").update(gpu_toolchain_id());
+    sha.update("\n").update(cmd).update("\n");
+    for (auto &input : inputs) {
+        sha.update(std::to_string(input.size())).update("\n").update(input);
+    }
+    return sha.hex_digest();
+}
+
+// Remove a temporary file unless temporary files are kept.
+static void remove_tmp(const std::string &path) {
+    if (get_env().keep_tmp || !is_exist(path)) {
+        return;
+    }
+    remove_file(path);
 }
 
 const std::string gpu_compile(const std::vector<std::string> &codes,
                               const std::string &arch,
                               unsigned int max_reg_cnt) {
-    const std::string &ark_root = get_env().path_root_dir;
+    if (codes.empty()) {
+        ERR(InvalidUsageError, "No code to compile");
+    }
+    HostTraceScope scope{"gpu_compile"};
+    GpuKernelCache &cache = get_gpu_kernel_cache();
+    const std::string &tmp_dir = get_env().path_tmp_dir;
+    bool rebuild = get_env().ignore_binary_cache;
+    double start = cpu_timer();
+    auto stats_before = cache.get_stats();
+
+    // Compile `code` by `cmd` that reads `code_file_path` and writes
+    // `output_file_path`, and return the output.
+    auto compile = [](const std::string &code, const std::string &cmd,
+                      const std::string &code_file_path,
+                      const std::string &output_file_path) {
+        HostTraceScope unit_scope{"compile_unit"};
+        write_file(code_file_path, code);
+        double unit_start = cpu_timer();
+        LOG(INFO, "Compiling: ", code_file_path);
+        LOG(DEBUG, cmd);
+        run_command(cmd);
+        LOG(INFO, "Compile succeed: ", code_file_path, " (",
+            cpu_timer() - unit_start, " seconds)");
+        std::string output = read_file(output_file_path);
+        remove_tmp(code_file_path);
+        remove_tmp(output_file_path);
+        return output;
+    };
 
-    // (code, file name prefix) pairs
-    std::vector<std::pair<std::string, std::string> > items;
-    items.reserve(codes.size());
-    srand();
-    for (auto &code : codes) {
-        std::string hash_str = fnv1a_hash(code);
-        items.emplace_back(code, "/tmp/ark_" + hash_str);
-    }
-    assert(items.size() == 1);
-    para_exec<std::pair<std::string, std::string> >(
-        items, 20,
-        [&arch, &ark_root,
-         max_reg_cnt](std::pair<std::string, std::string> &item) {
-            std::string code_file_path = item.second + ".cu";
-            std::string bin_file_path = item.second + ".cubin";
-            if (is_exist(code_file_path) && is_exist(bin_file_path)) {
-                if (!get_env().ignore_binary_cache) {
-                    LOG(INFO, "Reusing cached binary for ", code_file_path);
-                    return;
+    std::string bin;
+    if (codes.size() == 1) {
+        // A single translation unit is compiled directly into the binary.
+        const std::string cmd =
+            gpu_compile_commands({"ark.cu"}, arch, max_reg_cnt, "ark.cubin")[0];
+        const std::string key = cache_key("bin", cmd, codes);
+        bin = cache.get_or_build(
+            key,
+            [&] {
+                std::string prefix = tmp_dir + "/ark_" + key;
+                return compile(codes[0],
+                               gpu_compile_commands({prefix + ".cu"}, arch,
+                                                    max_reg_cnt,
+                                                    prefix + ".cubin")[0],
+                               prefix + ".cu", prefix + ".cubin");
+            },
+            rebuild);
+    } else {
+        // Compile the translation units in parallel, each cached by itself,
+        // and link them.
+        const std::vector<std::string> cmds = gpu_compile_commands(
+            {"ark_0.cu", "ark_1.cu"}, arch, max_reg_cnt, "ark.cubin");
+        std::vector<std::string> keys(codes.size());
+        std::vector<std::string> code_file_paths(codes.size());
+        std::vector<size_t> indices(codes.size());
+        for (size_t i = 0; i < codes.size(); ++i) {
+            keys[i] = cache_key("obj", cmds[0], {codes[i]});
+            code_file_paths[i] = tmp_dir + "/ark_" + keys[i] + ".cu";
+            indices[i] = i;
+        }
+        const std::string key = cache_key("link", cmds.back(), keys);
+        const std::string bin_file_path = tmp_dir + "/ark_" + key + ".cubin";
+        const std::vector<std::string> unit_cmds = gpu_compile_commands(
+            code_file_paths, arch, max_reg_cnt, bin_file_path);
+        // The objects are linked from files named after the link, because
+        // another link that shares a translation unit may write the object
+        // of the unit at the same time.
+        std::vector<std::string> link_paths(codes.size());
+        for (size_t i = 0; i < codes.size(); ++i) {
+            link_paths[i] =
+                tmp_dir + "/ark_" + key + "_" + std::to_string(i) + ".o";
+        }
+        const std::string link_cmd =
+            gpu_link_command(link_paths, arch, bin_file_path);
+        bin = cache.get_or_build(
+            key,
+            [&] {
+                int num_threads =
+                    std::max(1, (int)std::thread::hardware_concurrency());
+                std::vector<std::string> objs(codes.size());
+                para_exec<size_t>(indices, num_threads, [&](size_t &idx) {
+                    objs[idx] = cache.get_or_build(
+                        keys[idx],
+                        [&] {
+                            return compile(
+                                codes[idx], unit_cmds[idx],
+                                code_file_paths[idx],
+                                object_file_path(code_file_paths[idx]));
+                        },
+                        rebuild);
+                });
+                // The objects may come from the cache, so write them out.
+                for (size_t i = 0; i < codes.size(); ++i) {
+                    write_file(link_paths[i], objs[i]);
                 }
-                // Remove the cached binary.
-                int err = remove_file(bin_file_path);
-                if (err != 0) {
-                    ERR(SystemError,
-                        "Failed to remove a cache file: ", bin_file_path,
-                        " (errno ", err, ")");
+                LOG(DEBUG, link_cmd);
+                HostTraceScope link_scope{"link"};
+                run_command(link_cmd);
+                std::string output = read_file(bin_file_path);
+                for (size_t i = 0; i < codes.size(); ++i) {
+                    remove_tmp(link_paths[i]);
                 }
-            }
-            // Write GPU kernel code file.
-            {
-                std::ofstream code_file(code_file_path,
-                                        std::ios::out | std::ios::trunc);
-                code_file << item.first;
-            }
-            const std::string compile_cmd =
-                gpu_compile_command(code_file_path, ark_root, arch, max_reg_cnt,
-                                    item.second + ".cubin");
-            double start = cpu_timer();
-            LOG(INFO, "Compiling: ", code_file_path);
-            LOG(DEBUG, compile_cmd);
-            // Run the command.
-            std::array<char, 4096> buffer;
-            std::stringstream exec_print;
-            std::unique_ptr<FILE, decltype(&pclose)> pipe(
-                popen(compile_cmd.c_str(), "r"), pclose);
-            if (!pipe) {
-                ERR(SystemError, "popen() failed");
-            }
-            while (fgets(buffer.data(), buffer.size(), pipe.get()) != nullptr) {
-                exec_print << buffer.data();
-            }
-            std::string exec_print_str = exec_print.str();
-            if (exec_print_str.size() > 0) {
-                ERR(ExecutorError, "\n", compile_cmd, "\n", exec_print_str,
-                    "\n");
-            }
-            LOG(INFO, "Compile succeed: ", code_file_path, " (",
-                cpu_timer() - start, " seconds)");
-        });
-    std::string gpubin_file_path = items[0].second + ".cubin";
-    return read_file(gpubin_file_path);
+                remove_tmp(bin_file_path);
+                return output;
+            },
+            rebuild);
+    }
+    auto stats = cache.get_stats();
+    LOG(INFO, "Kernel binary of ", codes.size(), " translation units ready (",
+        cpu_timer() - start, " seconds, ", stats.hits - stats_before.hits,
+        " cache hits, ", stats.misses - stats_before.misses, " misses)");
+    return bin;
 }
 
 }  // namespace ark
@@ -9,6 +9,16 @@
 
 namespace ark {
 
+/// Commands to build the binary @p bin_file_path from @p code_file_paths. A
+/// single code file is compiled directly into the binary. Multiple code files
+/// are compiled into relocatable device code, one command each, followed by a
+/// command that links them into the binary.
+const std::vector<std::string> gpu_compile_commands(
+    const std::vector<std::string> &code_file_paths, const std::string &arch,
+    unsigned int max_reg_cnt, const std::string &bin_file_path);
+
+/// Compile @p codes, which are the translation units of a kernel, in parallel
+/// and return the binary.
 const std::string gpu_compile(const std::vector<std::string> &codes,
                               const std::string &arch,
                               unsigned int max_reg_cnt);
@@ -1,47 +1,24 @@
 #include "gpu/gpu_context.h"
 
 #include <cassert>
-#include <list>
 #include <set>
 #include <unordered_map>
 
 #include "env.h"
 #include "gpu/gpu_comm_sw.h"
 #include "gpu/gpu_logging.h"
+#include "gpu/gpu_offset_allocator.h"
 #include "gpu_context.h"
+#include "host_trace.h"
 #include "math_utils.h"
 
 namespace {
 constexpr size_t GPU_PAGE_SHIFT = 16;
 constexpr size_t GPU_PAGE_SIZE = (1ULL << GPU_PAGE_SHIFT);
-
-int get_align(size_t bytes, int align) {
-    if (bytes == 0) {
-        return 0;
-    }
-    int al;
-    if (bytes > 32768) {
-        al = 65536;
-    } else if (bytes > 64) {
-        al = 128;
-    } else {
-        al = 128;
-    }
-    if (al < align) {
-        al = align;
-    }
-    return al;
-}
 }  // namespace
 
 namespace ark {
 
-struct Chunk {
-    Chunk(size_t begin, size_t end) : begin(begin), end(end) {}
-    size_t begin;
-    size_t end;
-};
-
 class GpuContext::Impl {
    public:
     Impl(int rank, int world_size);
@@ -62,16 +39,14 @@ class GpuContext::Impl {
     std::shared_ptr<GpuManager> manager_;
     std::shared_ptr<GpuCommSw> comm_sw_;
     std::shared_ptr<GpuMemory> memory_;
-    std::list<Chunk> chunks_;
+    GpuOffsetAllocator allocator_;
     std::set<int> id_in_use_;
-    std::unordered_map<int, Chunk> in_use_chunks_;
     std::vector<std::pair<int, size_t>> export_id_offsets_;
     std::unordered_map<int, std::vector<std::shared_ptr<GpuBuffer>>>
         import_gid_buffers_;
     int rank_;
     int world_size_;
     unsigned int next_id_ = 0;
-    size_t total_bytes_ = 0;
 };
 
 GpuContext::Impl::Impl(int rank, int world_size)
@@ -79,6 +54,7 @@ GpuContext::Impl::Impl(int rank, int world_size)
     int gpu_id = rank % get_env().num_ranks_per_host;
     manager_ = GpuManager::get_instance(gpu_id);
     memory_ = manager_->malloc(0, GPU_PAGE_SIZE);
+    HostTraceScope scope{"GpuCommSw"};
     comm_sw_ = std::make_shared<GpuCommSw>("comm_sw", manager_->get_gpu_id(),
                                            rank_, world_size_, memory_);
 }
@@ -88,50 +64,9 @@ std::shared_ptr<GpuBuffer> GpuContext::Impl::allocate_buffer(size_t bytes,
     if (bytes == 0) {
         return nullptr;
     }
-    int real_align = get_align(bytes, align);
-    size_t size = math::pad(bytes, (size_t)real_align);
-    size_t offset;
     int id = this->next_id_;
     id_in_use_.insert(this->next_id_++);
-    std::list<Chunk>::iterator it = this->chunks_.begin();
-    for (; it != this->chunks_.end(); ++it) {
-        size_t begin = math::pad(it->begin, real_align);
-        if ((it->end - begin) >= size) {
-            offset = begin;
-            this->in_use_chunks_.emplace(id, Chunk(offset, offset + size));
-            if (it->begin != begin) {
-                this->chunks_.emplace(it, it->begin, begin);
-            }
-            if ((it->end - offset) > size) {
-                it->begin = offset + size;
-            } else {
-                this->chunks_.erase(it);
-            }
-            break;
-        }
-    }
-    if (it == this->chunks_.end()) {
-        // No more segment available.
-        // If the last byte is unused, enlarge the last segment.
-        // Otherwise, create a new segment.
-        if ((this->chunks_.size() > 0) &&
-            (this->chunks_.back().end == this->total_bytes_)) {
-            Chunk &chunk = this->chunks_.back();
-            offset = math::pad(chunk.begin, real_align);
-            if (offset != chunk.begin) {
-                chunk.end = offset;
-            } else {
-                this->chunks_.pop_back();
-            }
-        } else {
-            offset = math::pad(total_bytes_, real_align);
-            if (offset != total_bytes_) {
-                this->chunks_.emplace_back(total_bytes_, offset);
-            }
-        }
-        total_bytes_ = offset + size;
-        this->in_use_chunks_.emplace(id, Chunk(offset, offset + size));
-    }
+    size_t offset = allocator_.allocate(id, bytes, align);
     LOG(DEBUG, "Allocated ", bytes, " bytes of GPU memory at offset ", offset,
         " rank ", rank_);
     return std::make_shared<GpuBuffer>(manager_->get_gpu_id(), memory_, id,
@@ -146,31 +81,7 @@ void GpuContext::Impl::free_buffer(std::shared_ptr<GpuBuffer> buffer) {
             " because it is not in use");
     }
     id_in_use_.erase(id);
-    auto it = in_use_chunks_.find(id);
-    if (it == in_use_chunks_.end()) {
-        ERR(ExecutorError, "Cannot free buffer ", id, " no chunk found");
-    }
-    Chunk &chunk = it->second;
-    auto it2 = chunks_.begin();
-    for (; it2 != chunks_.end(); ++it2) {
-        if (it2->end >= chunk.begin) {
-            if (it2->end == chunk.begin && std::next(it2) != chunks_.end() &&
-                std::next(it2)->begin == chunk.end) {
-                it2->end = std::next(it2)->end;
-            } else if (it2->begin == chunk.end) {
-                it2->begin = chunk.begin;
-            } else if (it2->end == chunk.begin) {
-                it2->end = chunk.end;
-            } else {
-                chunks_.emplace(it2, chunk.begin, chunk.end);
-            }
-        }
-        break;
-    }
-    if (it2 == chunks_.end()) {
-        chunks_.emplace_back(chunk.begin, chunk.end);
-    }
-    in_use_chunks_.erase(it);
+    allocator_.free(id);
     LOG(DEBUG, "Freed buffer ", id, " offset ", buffer->get_offset(), " rank ",
         rank_);
 }
@@ -200,14 +111,17 @@ std::shared_ptr<GpuBuffer> GpuContext::Impl::import_buffer(size_t bytes,
 }
 
 void GpuContext::Impl::freeze(bool expose) {
-    if (total_bytes_ > manager_->info().gmem_total) {
-        ERR(SystemError, "out of GPU memory. Requested ", total_bytes_,
+    size_t total_bytes = allocator_.get_total_bytes();
+    if (total_bytes > manager_->info().gmem_total) {
+        ERR(SystemError, "out of GPU memory. Requested ", total_bytes,
             " bytes, available ", manager_->info().gmem_total, " bytes");
     }
-    if (total_bytes_ > 0) {
-        LOG(INFO, "Allocating ", total_bytes_, " bytes of GPU memory");
-        memory_->resize(total_bytes_, expose);
+    if (total_bytes > 0) {
+        LOG(INFO, "Allocating ", total_bytes, " bytes of GPU memory");
+        HostTraceScope scope{"GpuMemory::resize"};
+        memory_->resize(total_bytes, expose);
     }
+    HostTraceScope scope{"GpuCommSw::configure"};
     comm_sw_->configure(export_id_offsets_, import_gid_buffers_);
 }
 
@@ -230,7 +144,9 @@ int GpuContext::world_size() const { return pimpl_->world_size_; }
 
 int GpuContext::gpu_id() const { return pimpl_->manager_->get_gpu_id(); }
 
-size_t GpuContext::get_total_bytes() const { return pimpl_->total_bytes_; }
+size_t GpuContext::get_total_bytes() const {
+    return pimpl_->allocator_.get_total_bytes();
+}
 
 std::shared_ptr<GpuMemory> GpuContext::get_data_memory(int gpu_id) {
     if (gpu_id == -1) {
@@ -16,6 +16,8 @@ class GpuEvent::Impl {
     Impl& operator=(const Impl&) = delete;
 
     void record(std::shared_ptr<GpuStream> stream);
+    void sync() const { GLOG(gpuEventSynchronize(event_)); }
+    gpuError query() const { return gpuEventQuery(event_); }
     float elapsed_msec(const GpuEvent& other) const;
 
    private:
@@ -51,6 +53,10 @@ void GpuEvent::record(std::shared_ptr<GpuStream> stream) {
     pimpl_->record(stream);
 }
 
+void GpuEvent::sync() const { pimpl_->sync(); }
+
+gpuError GpuEvent::query() const { return pimpl_->query(); }
+
 float GpuEvent::elapsed_msec(const GpuEvent& other) const {
     return pimpl_->elapsed_msec(other);
 }
@@ -17,6 +17,8 @@ class GpuEvent {
     GpuEvent &operator=(const GpuEvent &) = delete;
 
     void record(std::shared_ptr<GpuStream> stream);
+    void sync() const;
+    gpuError query() const;
     float elapsed_msec(const GpuEvent &other) const;
 
    private:
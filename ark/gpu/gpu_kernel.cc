@@ -18,7 +18,7 @@ GpuKernel::GpuKernel(
     size_t smem_bytes, const std::string& kernel_name,
     std::initializer_list<std::pair<std::shared_ptr<void>, size_t>> args)
     : ctx_(ctx),
-      codes_(codes),
+      codes_{codes},
       block_dim_(block_dim),
       grid_dim_(grid_dim),
       smem_bytes_(smem_bytes),
@@ -51,7 +51,7 @@ void GpuKernel::compile() {
     if (max_reg_cnt >= max_reg_per_thread) {
         max_reg_cnt = max_reg_per_thread - 1;
     }
-    bin_ = gpu_compile({codes_}, manager->info().arch, max_reg_cnt);
+    bin_ = gpu_compile(codes_, manager->info().arch, max_reg_cnt);
     GLOG_DRV(gpuModuleLoadData(&module_, bin_.c_str()));
     GLOG_DRV(gpuModuleGetFunction(&function_, module_, kernel_name_.c_str()));
 
@@ -6,6 +6,7 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "gpu/gpu_buffer.h"
 #include "gpu/gpu_context.h"
@@ -26,7 +27,9 @@ class GpuKernel {
 
    protected:
     std::shared_ptr<GpuContext> ctx_;
-    std::string codes_;
+    // Translation units of the kernel, which are linked together if there are
+    // more than one.
+    std::vector<std::string> codes_;
     std::array<int, 3> block_dim_;
     std::array<int, 3> grid_dim_;
     int smem_bytes_;
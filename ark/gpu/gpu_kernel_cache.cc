@@ -0,0 +1,217 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "gpu/gpu_kernel_cache.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "env.h"
+#include "file_io.h"
+#include "include/ark.h"
+#include "logging.h"
+
+#define ENTRY_SUFFIX ".bin"
+#define BUILD_LOCK_PREFIX ".build."
+#define LOCK_SUFFIX ".lock"
+#define EVICT_LOCK_NAME ".evict.lock"
+
+namespace fs = std::filesystem;
+
+namespace ark {
+
+GpuKernelCache::GpuKernelCache(const std::string &dir, size_t max_bytes)
+    : dir_(dir), max_bytes_(max_bytes) {
+    if (!is_exist(dir_)) {
+        int err = create_dir(dir_);
+        if (err != 0) {
+            ERR(SystemError, "Failed to create the kernel cache directory: ",
+                dir_, " (errno ", err, ")");
+        }
+    }
+}
+
+std::string GpuKernelCache::entry_path(const std::string &key) const {
+    return dir_ + "/" + key + ENTRY_SUFFIX;
+}
+
+std::string GpuKernelCache::build_lock_path(const std::string &key) const {
+    // FNV-1a, which unlike std::hash is the same for every build of ARK that
+    // shares the directory.
+    uint64_t hash = 14695981039346656037ULL;
+    for (char c : key) {
+        hash = (hash ^ (unsigned char)c) * 1099511628211ULL;
+    }
+    return dir_ + "/" BUILD_LOCK_PREFIX +
+           std::to_string(hash % NUM_BUILD_LOCKS) + LOCK_SUFFIX;
+}
+
+// Read the entry at @p path without updating statistics.
+static bool read_entry(const std::string &path, std::string &data) {
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::stringstream ss;
+    ss << file.rdbuf();
+    data = ss.str();
+    if (data.empty()) {
+        return false;
+    }
+    // Mark as recently used.
+    std::error_code ec;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+    return true;
+}
+
+bool GpuKernelCache::get(const std::string &key, std::string &data) {
+    bool found = read_entry(this->entry_path(key), data);
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (found) {
+        ++stats_.hits;
+    } else {
+        ++stats_.misses;
+    }
+    return found;
+}
+
+void GpuKernelCache::put(const std::string &key, const std::string &data) {
+    std::string path = this->entry_path(key);
+    std::stringstream tmp_path;
+    tmp_path << path << ".tmp." << ::getpid() << "."
+             << std::hash<std::thread::id>{}(std::this_thread::get_id());
+    {
+        std::ofstream file(tmp_path.str(),
+                           std::ios::out | std::ios::trunc | std::ios::binary);
+        file << data;
+        if (!file) {
+            ERR(SystemError, "Failed to write a kernel cache entry: ",
+                tmp_path.str());
+        }
+    }
+    if (std::rename(tmp_path.str().c_str(), path.c_str()) != 0) {
+        int err = errno;
+        remove_file(tmp_path.str());
+        ERR(SystemError, "Failed to rename a kernel cache entry: ", path,
+            " (errno ", err, ")");
+    }
+}
+
+std::string GpuKernelCache::get_or_build(
+    const std::string &key, const std::function<std::string()> &build,
+    bool rebuild) {
+    std::string data;
+    if (!rebuild && read_entry(this->entry_path(key), data)) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        ++stats_.hits;
+        return data;
+    }
+    {
+        // Another process may be building the same entry. Unrelated keys
+        // may share the lock, which only serializes their builds.
+        FileLock file_lock(this->build_lock_path(key));
+        if (!rebuild && read_entry(this->entry_path(key), data)) {
+            std::lock_guard<std::mutex> lock(mtx_);
+            ++stats_.hits;
+            return data;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            ++stats_.misses;
+        }
+        data = build();
+        this->put(key, data);
+    }
+    this->evict();
+    return data;
+}
+
+size_t GpuKernelCache::evict() {
+    if (max_bytes_ == 0) {
+        return 0;
+    }
+    // Skip if another process is evicting.
+    FileLock file_lock(dir_ + "/" EVICT_LOCK_NAME, false);
+    if (!file_lock.is_locked()) {
+        return 0;
+    }
+    struct Entry {
+        fs::path path;
+        size_t bytes;
+        fs::file_time_type time;
+    };
+    std::vector<Entry> entries;
+    size_t total_bytes = 0;
+    std::error_code ec;
+    for (const auto &it : fs::directory_iterator(dir_, ec)) {
+        if (it.path().extension() != ENTRY_SUFFIX) continue;
+        std::error_code ec_entry;
+        size_t bytes = it.file_size(ec_entry);
+        auto time = it.last_write_time(ec_entry);
+        if (ec_entry) continue;
+        entries.push_back({it.path(), bytes, time});
+        total_bytes += bytes;
+    }
+    if (total_bytes <= max_bytes_) {
+        return 0;
+    }
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry &a, const Entry &b) { return a.time < b.time; });
+    size_t num_evicted = 0;
+    for (auto &entry : entries) {
+        if (total_bytes <= max_bytes_) break;
+        std::error_code ec_entry;
+        if (fs::remove(entry.path, ec_entry)) {
+            total_bytes -= entry.bytes;
+            ++num_evicted;
+            LOG(DEBUG, "Evicted kernel cache entry: ", entry.path.string());
+        }
+    }
+    std::lock_guard<std::mutex> lock(mtx_);
+    stats_.evictions += num_evicted;
+    return num_evicted;
+}
+
+size_t GpuKernelCache::get_total_bytes() const {
+    size_t total_bytes = 0;
+    std::error_code ec;
+    for (const auto &it : fs::directory_iterator(dir_, ec)) {
+        if (it.path().extension() != ENTRY_SUFFIX) continue;
+        std::error_code ec_entry;
+        size_t bytes = it.file_size(ec_entry);
+        if (!ec_entry) {
+            total_bytes += bytes;
+        }
+    }
+    return total_bytes;
+}
+
+GpuKernelCache::Stats GpuKernelCache::get_stats() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return stats_;
+}
+
+GpuKernelCache &get_gpu_kernel_cache() {
+    static std::mutex mtx;
+    static std::unique_ptr<GpuKernelCache> cache;
+    const std::lock_guard<std::mutex> lock(mtx);
+    const Env &env = get_env();
+    size_t max_bytes = (size_t)std::max(env.cache_max_mb, 0) << 20;
+    if (cache == nullptr || cache->get_dir() != env.cache_dir ||
+        cache->get_max_bytes() != max_bytes) {
+        cache = std::make_unique<GpuKernelCache>(env.cache_dir, max_bytes);
+    }
+    return *cache;
+}
+
+}  // namespace ark
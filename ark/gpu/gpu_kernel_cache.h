@@ -0,0 +1,89 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#ifndef ARK_GPU_KERNEL_CACHE_H_
+#define ARK_GPU_KERNEL_CACHE_H_
+
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+
+namespace ark {
+
+/// Content-addressed cache of compiled kernel binaries in a directory that
+/// processes on the same host share.
+///
+/// Each entry is a file named after its key, which is expected to be a strong
+/// hash of everything that affects the binary. Entries are written to a
+/// temporary file and renamed into place, so readers never see a partial
+/// binary, and @ref get_or_build holds an exclusive lock on the key across
+/// processes, so that concurrent ranks build each unique kernel only once.
+/// Keys share a fixed set of @ref NUM_BUILD_LOCKS lock files, so the
+/// directory does not fill up with a lock file per key. When the entries
+/// exceed the size limit, the least recently used ones are removed.
+class GpuKernelCache {
+   public:
+    /// Number of lock files that serialize the builds of the same key.
+    static constexpr int NUM_BUILD_LOCKS = 64;
+
+    /// Statistics of this process.
+    struct Stats {
+        /// Number of lookups that found the entry.
+        size_t hits = 0;
+        /// Number of lookups that did not find the entry.
+        size_t misses = 0;
+        /// Number of entries removed to respect the size limit.
+        size_t evictions = 0;
+    };
+
+    /// @param dir Directory of the cache, created if it does not exist.
+    /// @param max_bytes Limit of the total bytes of the entries, or zero for
+    /// no limit.
+    GpuKernelCache(const std::string &dir, size_t max_bytes);
+    GpuKernelCache(const GpuKernelCache &) = delete;
+    GpuKernelCache &operator=(const GpuKernelCache &) = delete;
+
+    /// Read the entry of @p key into @p data. Returns false if not cached.
+    bool get(const std::string &key, std::string &data);
+
+    /// Atomically write @p data as the entry of @p key.
+    void put(const std::string &key, const std::string &data);
+
+    /// Return the entry of @p key, or build, store, and return it if it is not
+    /// cached or @p rebuild is true. Other processes that ask for the same key
+    /// wait until the build finishes.
+    std::string get_or_build(const std::string &key,
+                             const std::function<std::string()> &build,
+                             bool rebuild = false);
+
+    /// Remove the least recently used entries until the total bytes of the
+    /// entries are within the limit. Returns the number of removed entries.
+    size_t evict();
+
+    /// Total bytes of the entries.
+    size_t get_total_bytes() const;
+
+    Stats get_stats() const;
+
+    const std::string &get_dir() const { return dir_; }
+
+    size_t get_max_bytes() const { return max_bytes_; }
+
+   private:
+    std::string entry_path(const std::string &key) const;
+
+    std::string build_lock_path(const std::string &key) const;
+
+    std::string dir_;
+    size_t max_bytes_;
+    mutable std::mutex mtx_;
+    Stats stats_;
+};
+
+/// The kernel cache of this process, configured by the environment.
+GpuKernelCache &get_gpu_kernel_cache();
+
+}  // namespace ark
+
+#endif  // ARK_GPU_KERNEL_CACHE_H_
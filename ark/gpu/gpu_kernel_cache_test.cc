@@ -0,0 +1,132 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "gpu/gpu_kernel_cache.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+#include "env.h"
+#include "file_io.h"
+#include "include/ark.h"
+#include "unittest/unittest_utils.h"
+
+static std::string test_cache_dir(const std::string &name) {
+    std::string dir = ark::get_env().path_tmp_dir + "/.test_" + name;
+    ark::remove_dir(dir);
+    return dir;
+}
+
+ark::unittest::State test_gpu_kernel_cache_basic() {
+    std::string dir = test_cache_dir("gpu_kernel_cache_basic");
+    ark::GpuKernelCache cache(dir, 0);
+    std::string data;
+    UNITTEST_FALSE(cache.get("key0", data));
+    cache.put("key0", "binary0");
+    UNITTEST_TRUE(cache.get("key0", data));
+    UNITTEST_EQ(data, "binary0");
+    UNITTEST_EQ(cache.get_total_bytes(), 7UL);
+
+    int num_builds = 0;
+    auto build = [&num_builds]() {
+        ++num_builds;
+        return std::string("binary1");
+    };
+    UNITTEST_EQ(cache.get_or_build("key1", build), "binary1");
+    UNITTEST_EQ(cache.get_or_build("key1", build), "binary1");
+    UNITTEST_EQ(num_builds, 1);
+    UNITTEST_EQ(cache.get_or_build("key1", build, true), "binary1");
+    UNITTEST_EQ(num_builds, 2);
+
+    auto stats = cache.get_stats();
+    UNITTEST_EQ(stats.hits, 2UL);
+    UNITTEST_EQ(stats.misses, 3UL);
+    UNITTEST_EQ(stats.evictions, 0UL);
+
+    // Another cache on the same directory sees the entries.
+    ark::GpuKernelCache cache2(dir, 0);
+    UNITTEST_TRUE(cache2.get("key1", data));
+    UNITTEST_EQ(data, "binary1");
+
+    // Lock files do not grow with the number of keys.
+    for (int i = 0; i < 4 * ark::GpuKernelCache::NUM_BUILD_LOCKS; ++i) {
+        cache.get_or_build("many" + std::to_string(i), build);
+    }
+    int num_locks = 0;
+    for (const auto &it : std::filesystem::directory_iterator(dir)) {
+        num_locks += (it.path().extension() == ".lock");
+    }
+    UNITTEST_TRUE(num_locks > 1);
+    UNITTEST_TRUE(num_locks <= ark::GpuKernelCache::NUM_BUILD_LOCKS);
+
+    ark::remove_dir(dir);
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_gpu_kernel_cache_evict() {
+    std::string dir = test_cache_dir("gpu_kernel_cache_evict");
+    ark::GpuKernelCache cache(dir, 3000);
+    std::string data;
+    for (int i = 0; i < 3; ++i) {
+        cache.put("key" + std::to_string(i), std::string(1000, 'a' + i));
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    UNITTEST_EQ(cache.evict(), 0UL);
+
+    // `key0` becomes the most recently used.
+    UNITTEST_TRUE(cache.get("key0", data));
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    UNITTEST_EQ(cache.get_or_build("key3",
+                                   [] { return std::string(1000, 'd'); }),
+                std::string(1000, 'd'));
+    UNITTEST_EQ(cache.get_stats().evictions, 1UL);
+    UNITTEST_TRUE(cache.get_total_bytes() <= 3000UL);
+    UNITTEST_FALSE(cache.get("key1", data));
+    UNITTEST_TRUE(cache.get("key0", data));
+    UNITTEST_TRUE(cache.get("key2", data));
+    UNITTEST_TRUE(cache.get("key3", data));
+
+    ark::remove_dir(dir);
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_gpu_kernel_cache_multi_process() {
+    std::string dir = test_cache_dir("gpu_kernel_cache_multi_process");
+    std::string log_path = dir + ".log";
+    ark::remove_file(log_path);
+    for (int i = 0; i < 4; ++i) {
+        ark::unittest::spawn_process([dir, log_path]() {
+            ark::GpuKernelCache cache(dir, 0);
+            std::string data = cache.get_or_build("key", [&log_path] {
+                std::ofstream log(log_path, std::ios::app);
+                log << ::getpid() << "\n";
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+                return std::string("binary");
+            });
+            UNITTEST_EQ(data, "binary");
+            return ark::unittest::SUCCESS;
+        });
+    }
+    ark::unittest::wait_all_processes();
+
+    // Only one process built the entry.
+    std::string log = ark::read_file(log_path);
+    UNITTEST_EQ(std::count(log.begin(), log.end(), '\n'), 1);
+
+    ark::remove_file(log_path);
+    ark::remove_dir(dir);
+    return ark::unittest::SUCCESS;
+}
+
+int main() {
+    ark::init();
+    UNITTEST(test_gpu_kernel_cache_basic);
+    UNITTEST(test_gpu_kernel_cache_evict);
+    UNITTEST(test_gpu_kernel_cache_multi_process);
+    return 0;
+}
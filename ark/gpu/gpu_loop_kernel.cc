@@ -49,7 +49,7 @@ GpuLoopKernel::GpuLoopKernel(std::shared_ptr<GpuContext> ctx,
     auto& code_path = get_env().enforce_kernel_code_path;
     if (!code_path.empty()) {
         LOG(INFO, "Enforce kernel code path: ", code_path);
-        codes_ = std::move(read_file(code_path));
+        codes_ = {read_file(code_path)};
     } else if (codes_body.size() > 0) {
         const std::string* ark_loop_body_code = nullptr;
         for (auto& code : codes_body) {
@@ -99,7 +99,22 @@ GpuLoopKernel::GpuLoopKernel(std::shared_ptr<GpuContext> ctx,
         "  }\n"
         "}\n";
         // clang-format on
-        codes_ = std::move(ss.str());
+        codes_ = {ss.str()};
+
+        // The other translation units define the functions that
+        // `ark_loop_body` calls.
+        for (auto& code : codes_body) {
+            if (&code == ark_loop_body_code) continue;
+            std::stringstream ss_unit;
+            // clang-format off
+            ss_unit <<
+            "// THIS KERNEL IS MACHINE-GENERATED BY ARK.\n"
+            "#define ARK_THREADS_PER_BLOCK " << block_dim_[0] << "\n"
+            "#include \"ark_kernels.h\"\n"
+            << code;
+            // clang-format on
+            codes_.emplace_back(ss_unit.str());
+        }
     }
 }
 
@@ -125,23 +140,19 @@ void GpuLoopKernel::load() {
                          sizeof(int) * data.size());
     manager->memcpy_htod((void*)buf_ptr_addr, 0, &buf_ptr_val, 0,
                          sizeof(GpuPtr));
-    // TODO: remove this hack
-    GpuPtr lss_0_ptr_addr;
-    GpuPtr lss_1_ptr_addr;
-    gpuDrvError ret =
-        gpuModuleGetGlobal(&lss_0_ptr_addr, &tmp, module_, ARK_LSS_NAME "_0");
-    if (ret == gpuDrvSuccess) {
-        manager->memcpy_htod((void*)lss_0_ptr_addr, 0, data.data(), 0,
-                             sizeof(int) * data.size());
-    } else if (ret != gpuErrorNotFound) {
+    // Reset the sync states of every stream, which are ARK_LSS_NAME "_0",
+    // "_1", ... up to the number of streams.
+    for (int stream_id = 0;; ++stream_id) {
+        GpuPtr lss_k_ptr_addr;
+        std::string lss_k_name = ARK_LSS_NAME "_" + std::to_string(stream_id);
+        gpuDrvError ret = gpuModuleGetGlobal(&lss_k_ptr_addr, &tmp, module_,
+                                             lss_k_name.c_str());
+        if (ret == gpuErrorNotFound) {
+            break;
+        }
         GLOG_DRV(ret);
-    }
-    ret = gpuModuleGetGlobal(&lss_1_ptr_addr, &tmp, module_, ARK_LSS_NAME "_1");
-    if (ret == gpuDrvSuccess) {
-        manager->memcpy_htod((void*)lss_1_ptr_addr, 0, data.data(), 0,
+        manager->memcpy_htod((void*)lss_k_ptr_addr, 0, data.data(), 0,
                              sizeof(int) * data.size());
-    } else if (ret != gpuErrorNotFound) {
-        GLOG_DRV(ret);
     }
     // set the data buffer pointers of remote gpus
     int nrph = get_env().num_ranks_per_host;
@@ -167,6 +178,18 @@ void GpuLoopKernel::load() {
                              sizeof(GpuPtr));
     }
 
+    // Reset the trace of uops if the code records it.
+    gpuDrvError trace_ret = gpuModuleGetGlobal(&trace_addr_, &trace_bytes_,
+                                               module_, ARK_TRACE_NAME);
+    if (trace_ret == gpuErrorNotFound) {
+        trace_addr_ = 0;
+    } else {
+        GLOG_DRV(trace_ret);
+        GLOG_DRV(gpuModuleGetGlobal(&trace_counts_addr_, &trace_counts_bytes_,
+                                    module_, ARK_TRACE_COUNTS_NAME));
+        manager->memset((void*)trace_counts_addr_, 0, trace_counts_bytes_);
+    }
+
     std::shared_ptr<GpuCommSw> comm = ctx_->get_comm_sw();
     if (comm->get_proxy_channels_num() > 0) {
         GpuPtr channel_addr;
@@ -274,4 +297,21 @@ float GpuLoopKernel::get_elapsed_msec() const {
     return elapsed_msec_;
 }
 
+GpuTrace GpuLoopKernel::get_trace() const {
+    if (!is_traced()) {
+        ERR(InvalidUsageError, "The kernel code does not record a trace.");
+    } else if (stream_ != nullptr) {
+        ERR(InvalidUsageError, "Need to stop the kernel first.");
+    }
+    std::shared_ptr<GpuManager> manager = ctx_->get_gpu_manager();
+    std::vector<GpuTraceRecord> records(trace_bytes_ / sizeof(GpuTraceRecord));
+    std::vector<unsigned int> counts(trace_counts_bytes_ /
+                                     sizeof(unsigned int));
+    manager->memcpy_dtoh(records.data(), 0, (void*)trace_addr_, 0,
+                         records.size() * sizeof(GpuTraceRecord));
+    manager->memcpy_dtoh(counts.data(), 0, (void*)trace_counts_addr_, 0,
+                         counts.size() * sizeof(unsigned int));
+    return GpuTrace::decode(records, counts);
+}
+
 }  // namespace ark
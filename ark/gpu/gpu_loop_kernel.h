@@ -7,9 +7,14 @@
 #include <memory>
 
 #include "gpu/gpu_kernel.h"
+#include "gpu/gpu_trace.h"
 
 #define ARK_BUF_NAME "ARK_BUF"
 #define ARK_LSS_NAME "ARK_LOOP_SYNC_STATE"
+#define ARK_WQ_NAME "ARK_WORK_QUEUE"
+#define ARK_WQ_SLOTS_NAME "ARK_WORK_QUEUE_SLOTS"
+#define ARK_TRACE_NAME "ARK_TRACE"
+#define ARK_TRACE_COUNTS_NAME "ARK_TRACE_COUNTS"
 
 namespace ark {
 
@@ -28,6 +33,12 @@ class GpuLoopKernel : public GpuKernel {
 
     float get_elapsed_msec() const;
 
+    /// Whether the loaded code records a trace of uops.
+    bool is_traced() const { return trace_addr_ != 0; }
+
+    /// Read the trace of uops recorded since the last @ref load.
+    GpuTrace get_trace() const;
+
    private:
     std::shared_ptr<GpuEvent> timer_begin_;
     std::shared_ptr<GpuEvent> timer_end_;
@@ -38,6 +49,13 @@ class GpuLoopKernel : public GpuKernel {
     std::shared_ptr<GpuStream> stream_ = nullptr;
     bool is_recording_ = false;
     float elapsed_msec_ = -1;
+
+    // Device addresses of the trace records and their counts per SM, or 0 if
+    // the code does not record a trace.
+    GpuPtr trace_addr_ = 0;
+    GpuPtr trace_counts_addr_ = 0;
+    size_t trace_bytes_ = 0;
+    size_t trace_counts_bytes_ = 0;
 };
 }  // namespace ark
 
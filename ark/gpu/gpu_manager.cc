@@ -3,9 +3,12 @@
 
 #include "gpu/gpu_manager.h"
 
+#include <limits>
+#include <mutex>
 #include <unordered_map>
 
 #include "gpu/gpu_logging.h"
+#include "gpu/gpu_staging_pool.h"
 
 namespace ark {
 class GpuManager::Impl {
@@ -21,6 +24,9 @@ class GpuManager::Impl {
     int gpu_id_;
     GpuManager::Info info_;
     std::shared_ptr<GpuStream> main_stream_;
+    // Created on demand. Declared last to be destroyed first.
+    std::mutex staging_pool_mtx_;
+    std::unique_ptr<GpuStagingPool> staging_pool_;
 
     void launch(gpuFunction kernel, const std::array<int, 3> &grid_dim,
                 const std::array<int, 3> &block_dim, int smem_bytes,
@@ -32,6 +38,9 @@ class GpuManager::Impl {
                            size_t src_offset, size_t bytes) const;
     void memcpy_dtod_async(void *dst, size_t dst_offset, void *src,
                            size_t src_offset, size_t bytes) const;
+    void memcpy_2d_async(void *dst, size_t dpitch, const void *src,
+                         size_t spitch, size_t width, size_t height,
+                         bool to_device, gpuStream stream) const;
     void memset_async(void *dst, unsigned int val, size_t bytes) const;
     void memset_d32_async(void *dst, unsigned int val, size_t num) const;
 };
@@ -117,6 +126,26 @@ void GpuManager::Impl::memcpy_dtod_async(void *dst, size_t dst_offset,
                         main_stream_->get()));
 }
 
+void GpuManager::Impl::memcpy_2d_async(void *dst, size_t dpitch,
+                                       const void *src, size_t spitch,
+                                       size_t width, size_t height,
+                                       bool to_device, gpuStream stream) const {
+    auto kind = to_device ? gpuMemcpyHostToDevice : gpuMemcpyDeviceToHost;
+    // Pitches of 2D copies are limited to `int`. Fall back to a copy per row
+    // beyond that, which only happens with very large padded tensors.
+    constexpr size_t max_pitch = std::numeric_limits<int>::max();
+    if (dpitch <= max_pitch && spitch <= max_pitch) {
+        GLOG(gpuMemcpy2DAsync(dst, dpitch, src, spitch, width, height, kind,
+                              stream));
+        return;
+    }
+    for (size_t i = 0; i < height; ++i) {
+        GLOG(gpuMemcpyAsync(static_cast<char *>(dst) + i * dpitch,
+                            static_cast<const char *>(src) + i * spitch, width,
+                            kind, stream));
+    }
+}
+
 void GpuManager::Impl::memset_async(void *dst, unsigned int val,
                                     size_t bytes) const {
     GLOG(gpuMemsetAsync(dst, val, bytes, main_stream_->get()));
@@ -172,6 +201,14 @@ std::shared_ptr<GpuStream> GpuManager::create_stream() {
     return std::shared_ptr<GpuStream>(new GpuStream(*this));
 }
 
+GpuStagingPool &GpuManager::staging_pool() {
+    std::lock_guard<std::mutex> lock(pimpl_->staging_pool_mtx_);
+    if (!pimpl_->staging_pool_) {
+        pimpl_->staging_pool_.reset(new GpuStagingPool(*this));
+    }
+    return *pimpl_->staging_pool_;
+}
+
 int GpuManager::get_gpu_id() const { return pimpl_->gpu_id_; }
 
 const GpuManager::Info &GpuManager::info() const { return pimpl_->info_; }
@@ -226,6 +263,36 @@ void GpuManager::memcpy_dtod(void *dst, size_t dst_offset, void *src,
     }
 }
 
+void GpuManager::memcpy_htod_2d(void *dst, size_t dpitch, const void *src,
+                                size_t spitch, size_t width, size_t height,
+                                bool async,
+                                std::shared_ptr<GpuStream> stream) const {
+    this->set_current();
+    if (!stream) {
+        stream = pimpl_->main_stream_;
+    }
+    pimpl_->memcpy_2d_async(dst, dpitch, src, spitch, width, height, true,
+                            stream->get());
+    if (!async) {
+        stream->sync();
+    }
+}
+
+void GpuManager::memcpy_dtoh_2d(void *dst, size_t dpitch, const void *src,
+                                size_t spitch, size_t width, size_t height,
+                                bool async,
+                                std::shared_ptr<GpuStream> stream) const {
+    this->set_current();
+    if (!stream) {
+        stream = pimpl_->main_stream_;
+    }
+    pimpl_->memcpy_2d_async(dst, dpitch, src, spitch, width, height, false,
+                            stream->get());
+    if (!async) {
+        stream->sync();
+    }
+}
+
 void GpuManager::launch(gpuFunction function,
                         const std::array<int, 3> &grid_dim,
                         const std::array<int, 3> &block_dim, int smem_bytes,
@@ -12,6 +12,9 @@
 #include "gpu/gpu_stream.h"
 
 namespace ark {
+
+class GpuStagingPool;
+
 class GpuManager {
    public:
     static std::shared_ptr<GpuManager> get_instance(int gpu_id);
@@ -27,6 +30,10 @@ class GpuManager {
                                                unsigned int flags = 0);
     std::shared_ptr<GpuEvent> create_event(bool disable_timing = false);
     std::shared_ptr<GpuStream> create_stream();
+    /// Pinned staging buffers and a copy stream of this GPU, which are kept
+    /// as long as this manager. Use @ref GpuStagingPool::get_instance() to
+    /// share the ownership.
+    GpuStagingPool &staging_pool();
 
     void memset(void *dst, unsigned int val, size_t bytes,
                 bool async = false) const;
@@ -38,6 +45,17 @@ class GpuManager {
                      size_t bytes, bool async = false) const;
     void memcpy_dtod(void *dst, size_t dst_offset, void *src, size_t src_offset,
                      size_t bytes, bool async = false) const;
+    // Copy `height` rows of `width` bytes, which start every `spitch` bytes
+    // in `src` and every `dpitch` bytes in `dst`. The copy is issued on
+    // `stream` if given, or on the main stream otherwise.
+    void memcpy_htod_2d(void *dst, size_t dpitch, const void *src,
+                        size_t spitch, size_t width, size_t height,
+                        bool async = false,
+                        std::shared_ptr<GpuStream> stream = nullptr) const;
+    void memcpy_dtoh_2d(void *dst, size_t dpitch, const void *src,
+                        size_t spitch, size_t width, size_t height,
+                        bool async = false,
+                        std::shared_ptr<GpuStream> stream = nullptr) const;
 
     int get_gpu_id() const;
     void launch(gpuFunction function, const std::array<int, 3> &grid_dim,
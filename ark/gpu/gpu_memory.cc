@@ -22,6 +22,10 @@ class GpuMemory::Impl {
     void to_host(void* dst, size_t offset, size_t bytes, bool async) const;
     void from_host(const void* src, size_t offset, size_t bytes, bool async);
     void from_device(const void* src, size_t offset, size_t bytes, bool async);
+    void to_host_2d(void* dst, size_t dst_pitch, size_t offset, size_t pitch,
+                    size_t width, size_t height, bool async) const;
+    void from_host_2d(const void* src, size_t src_pitch, size_t offset,
+                      size_t pitch, size_t width, size_t height, bool async);
     void sync() const;
     void memset(int value, size_t offset, size_t bytes);
     void memset_d32(int value, size_t offset, size_t nelems);
@@ -124,6 +128,28 @@ void GpuMemory::Impl::from_host(const void* src, size_t offset, size_t bytes,
     manager_.memcpy_htod(dev_ptr, 0, const_cast<void*>(src), 0, bytes, async);
 }
 
+void GpuMemory::Impl::to_host_2d(void* dst, size_t dst_pitch, size_t offset,
+                                 size_t pitch, size_t width, size_t height,
+                                 bool async) const {
+    if (is_remote_) {
+        LOG(ERROR, "cannot copy from remote memory.");
+    }
+    void* dev_ptr = reinterpret_cast<void*>((size_t)dev_ptr_aligned_ + offset);
+    manager_.memcpy_dtoh_2d(dst, dst_pitch, dev_ptr, pitch, width, height,
+                            async);
+}
+
+void GpuMemory::Impl::from_host_2d(const void* src, size_t src_pitch,
+                                   size_t offset, size_t pitch, size_t width,
+                                   size_t height, bool async) {
+    if (is_remote_) {
+        LOG(ERROR, "cannot copy to remote memory.");
+    }
+    void* dev_ptr = reinterpret_cast<void*>((size_t)dev_ptr_aligned_ + offset);
+    manager_.memcpy_htod_2d(dev_ptr, pitch, src, src_pitch, width, height,
+                            async);
+}
+
 void GpuMemory::Impl::from_device(const void* src, size_t offset, size_t bytes,
                                   bool async) {
     if (is_remote_ &&
@@ -199,6 +225,18 @@ void GpuMemory::memcpy_to(void* dst, size_t offset, size_t bytes) {
     pimpl_->to_host(dst, offset, bytes, false);
 }
 
+void GpuMemory::memcpy_from_2d(const void* src, size_t src_pitch, size_t offset,
+                               size_t pitch, size_t width, size_t height,
+                               bool async) {
+    pimpl_->from_host_2d(src, src_pitch, offset, pitch, width, height, async);
+}
+
+void GpuMemory::memcpy_to_2d(void* dst, size_t dst_pitch, size_t offset,
+                             size_t pitch, size_t width, size_t height,
+                             bool async) const {
+    pimpl_->to_host_2d(dst, dst_pitch, offset, pitch, width, height, async);
+}
+
 void* GpuMemory::ref_impl(size_t offset) const {
     return reinterpret_cast<void*>(
         reinterpret_cast<long long unsigned int>(pimpl_->dev_ptr_aligned_) +
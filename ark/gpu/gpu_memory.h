@@ -44,6 +44,11 @@ class GpuMemory {
     void memcpy_from(const void* src, size_t offset, size_t bytes,
                      bool from_device = false);
     void memcpy_to(void* dst, size_t offset, size_t bytes);
+    void memcpy_from_2d(const void* src, size_t src_pitch, size_t offset,
+                        size_t pitch, size_t width, size_t height,
+                        bool async = false);
+    void memcpy_to_2d(void* dst, size_t dst_pitch, size_t offset, size_t pitch,
+                      size_t width, size_t height, bool async = false) const;
 
    private:
     friend class GpuManager;
@@ -0,0 +1,158 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "gpu/gpu_offset_allocator.h"
+
+#include "include/ark.h"
+#include "logging.h"
+#include "math_utils.h"
+
+namespace ark {
+
+int GpuOffsetAllocator::get_align(size_t bytes, int align) {
+    if (bytes == 0) {
+        return 0;
+    }
+    int al;
+    if (bytes > 32768) {
+        al = EXPORT_ALIGN;
+    } else {
+        al = BASE_ALIGN;
+    }
+    if (al < align) {
+        al = align;
+    }
+    return al;
+}
+
+void GpuOffsetAllocator::insert_free(size_t begin, size_t end) {
+    free_ranges_.emplace(begin, end);
+    free_sizes_.emplace(end - begin, begin);
+    size_t export_begin = math::pad(begin, EXPORT_ALIGN);
+    if (export_begin < end) {
+        free_export_sizes_.emplace(end - export_begin, begin);
+    }
+}
+
+std::map<size_t, size_t>::iterator GpuOffsetAllocator::erase_free(
+    std::map<size_t, size_t>::iterator it) {
+    size_t begin = it->first;
+    size_t end = it->second;
+    free_sizes_.erase({end - begin, begin});
+    size_t export_begin = math::pad(begin, EXPORT_ALIGN);
+    if (export_begin < end) {
+        free_export_sizes_.erase({end - export_begin, begin});
+    }
+    return free_ranges_.erase(it);
+}
+
+size_t GpuOffsetAllocator::allocate(int id, size_t bytes, int align) {
+    if (in_use_ranges_.find(id) != in_use_ranges_.end()) {
+        ERR(ExecutorError, "Buffer ", id, " is already allocated");
+    }
+    if (bytes == 0) {
+        ERR(ExecutorError, "Cannot allocate zero bytes for buffer ", id);
+    }
+    int real_align = get_align(bytes, align);
+    size_t size = math::pad(bytes, (size_t)real_align);
+
+    // Find the smallest free range that fits.
+    bool found = false;
+    size_t begin = 0;
+    if (real_align == EXPORT_ALIGN) {
+        auto it = free_export_sizes_.lower_bound({size, 0});
+        if (it != free_export_sizes_.end()) {
+            begin = it->second;
+            found = true;
+        }
+    } else {
+        // Ranges start at multiples of BASE_ALIGN in common, so this stops at
+        // the first candidate unless a larger alignment is requested. A range
+        // of (size + real_align - 1) bytes or more always fits.
+        auto it = free_sizes_.lower_bound({size, 0});
+        for (; it != free_sizes_.end(); ++it) {
+            if (math::pad(it->second, real_align) + size <=
+                it->second + it->first) {
+                begin = it->second;
+                found = true;
+                break;
+            }
+        }
+    }
+
+    size_t offset;
+    if (found) {
+        auto it = free_ranges_.find(begin);
+        size_t end = it->second;
+        erase_free(it);
+        offset = math::pad(begin, real_align);
+        if (offset != begin) {
+            insert_free(begin, offset);
+        }
+        if (offset + size != end) {
+            insert_free(offset + size, end);
+        }
+    } else if (!free_ranges_.empty() &&
+               free_ranges_.rbegin()->second == total_bytes_) {
+        // No free range fits. Enlarge the last free range.
+        auto it = std::prev(free_ranges_.end());
+        begin = it->first;
+        erase_free(it);
+        offset = math::pad(begin, real_align);
+        if (offset != begin) {
+            insert_free(begin, offset);
+        }
+        total_bytes_ = offset + size;
+    } else {
+        // No free range fits. Append a new range.
+        offset = math::pad(total_bytes_, real_align);
+        if (offset != total_bytes_) {
+            insert_free(total_bytes_, offset);
+        }
+        total_bytes_ = offset + size;
+    }
+    in_use_ranges_.emplace(id, std::make_pair(offset, offset + size));
+    used_bytes_ += size;
+    return offset;
+}
+
+void GpuOffsetAllocator::free(int id) {
+    auto it = in_use_ranges_.find(id);
+    if (it == in_use_ranges_.end()) {
+        ERR(ExecutorError, "Cannot free buffer ", id, " no chunk found");
+    }
+    size_t begin = it->second.first;
+    size_t end = it->second.second;
+    in_use_ranges_.erase(it);
+    used_bytes_ -= end - begin;
+
+    // Merge with the free ranges right after and right before.
+    auto next = free_ranges_.lower_bound(begin);
+    if (next != free_ranges_.end() && next->first == end) {
+        end = next->second;
+        next = erase_free(next);
+    }
+    if (next != free_ranges_.begin()) {
+        auto prev = std::prev(next);
+        if (prev->second == begin) {
+            begin = prev->first;
+            erase_free(prev);
+        }
+    }
+    insert_free(begin, end);
+}
+
+GpuOffsetAllocator::Stats GpuOffsetAllocator::get_stats() const {
+    Stats stats;
+    stats.total_bytes = total_bytes_;
+    stats.used_bytes = used_bytes_;
+    stats.free_bytes = total_bytes_ - used_bytes_;
+    if (!free_sizes_.empty()) {
+        stats.largest_free_bytes = free_sizes_.rbegin()->first;
+    }
+    stats.num_free_ranges = free_ranges_.size();
+    stats.num_used_ranges = in_use_ranges_.size();
+    return stats;
+}
+
+}  // namespace ark
@@ -0,0 +1,103 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#ifndef ARK_GPU_OFFSET_ALLOCATOR_H_
+#define ARK_GPU_OFFSET_ALLOCATOR_H_
+
+#include <cstddef>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <utility>
+
+namespace ark {
+
+/// Host-only bookkeeping of byte offsets inside a single linear GPU memory
+/// region. It does not own any device memory, so the same layout logic is
+/// shared by @ref GpuContext and by plan-only scheduling without a device.
+///
+/// Free ranges are indexed by their offsets and by their sizes, so that
+/// @ref allocate finds the smallest free range that fits (best-fit) and
+/// @ref free merges a released range with its free neighbors on both sides,
+/// both in O(log n) of the number of free ranges. Requests aligned to
+/// @ref EXPORT_ALIGN, which exported buffers use, are served from a separate
+/// index of the bytes that each free range has after that alignment.
+class GpuOffsetAllocator {
+   public:
+    /// Minimum alignment of every reserved range.
+    static constexpr int BASE_ALIGN = 128;
+    /// Alignment of buffers exported to other GPUs.
+    static constexpr int EXPORT_ALIGN = 65536;
+
+    /// Statistics of the region.
+    struct Stats {
+        /// Bytes of the region, same as @ref get_total_bytes.
+        size_t total_bytes = 0;
+        /// Bytes of the reserved ranges.
+        size_t used_bytes = 0;
+        /// Bytes of the free ranges inside the region.
+        size_t free_bytes = 0;
+        /// Bytes of the largest free range.
+        size_t largest_free_bytes = 0;
+        /// Number of free ranges.
+        size_t num_free_ranges = 0;
+        /// Number of reserved ranges.
+        size_t num_used_ranges = 0;
+
+        /// Fraction of the free bytes that are not in the largest free range,
+        /// which is zero if the free bytes are contiguous.
+        double fragmentation() const {
+            if (free_bytes == 0) {
+                return 0;
+            }
+            return 1 - (double)largest_free_bytes / free_bytes;
+        }
+    };
+
+    GpuOffsetAllocator() = default;
+    ~GpuOffsetAllocator() = default;
+    GpuOffsetAllocator(const GpuOffsetAllocator &) = delete;
+    GpuOffsetAllocator &operator=(const GpuOffsetAllocator &) = delete;
+
+    /// Reserve a range of at least @p bytes bytes for the buffer @p id.
+    /// @param id unique id of the buffer.
+    /// @param bytes requested number of bytes, which should be positive.
+    /// @param align minimum alignment of the returned offset.
+    /// @return offset of the reserved range.
+    size_t allocate(int id, size_t bytes, int align = 1);
+
+    /// Release the range reserved for the buffer @p id.
+    void free(int id);
+
+    /// Total number of bytes that the region needs to hold every range that
+    /// has ever been reserved.
+    size_t get_total_bytes() const { return total_bytes_; }
+
+    /// Current statistics of the region.
+    Stats get_stats() const;
+
+    /// Alignment that @ref allocate applies for a request of @p bytes bytes.
+    static int get_align(size_t bytes, int align);
+
+   private:
+    // A free range [begin, end).
+    void insert_free(size_t begin, size_t end);
+    std::map<size_t, size_t>::iterator erase_free(
+        std::map<size_t, size_t>::iterator it);
+
+    // Offset -> end of each free range.
+    std::map<size_t, size_t> free_ranges_;
+    // (size, offset) of each free range.
+    std::set<std::pair<size_t, size_t>> free_sizes_;
+    // (size after aligning the offset to EXPORT_ALIGN, offset) of each free
+    // range that has any byte after the alignment.
+    std::set<std::pair<size_t, size_t>> free_export_sizes_;
+    // Buffer id -> reserved range [begin, end).
+    std::unordered_map<int, std::pair<size_t, size_t>> in_use_ranges_;
+    size_t total_bytes_ = 0;
+    size_t used_bytes_ = 0;
+};
+
+}  // namespace ark
+
+#endif  // ARK_GPU_OFFSET_ALLOCATOR_H_
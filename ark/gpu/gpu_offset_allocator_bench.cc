@@ -0,0 +1,68 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+// Throughput and fragmentation of GpuOffsetAllocator under random churn.
+// Usage: gpu_offset_allocator_bench [num_buffers] [num_iters]
+
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "cpu_timer.h"
+#include "gpu/gpu_offset_allocator.h"
+#include "include/ark.h"
+#include "logging.h"
+
+int main(int argc, char **argv) {
+    int num_buffers = (argc > 1) ? std::atoi(argv[1]) : 10000;
+    int num_iters = (argc > 2) ? std::atoi(argv[2]) : 1000000;
+    if (num_buffers <= 0 || num_iters <= 0) {
+        LOG(ark::ERROR, "invalid arguments");
+    }
+    ark::init();
+
+    // Mostly small buffers with a few large ones, and some of them are
+    // aligned for export.
+    std::mt19937 gen(0);
+    std::uniform_int_distribution<int> kind_dist(0, 99);
+    std::uniform_int_distribution<size_t> small_dist(1, 32768);
+    std::uniform_int_distribution<size_t> large_dist(32769, 1 << 24);
+    auto request = [&](size_t &bytes, int &align) {
+        int kind = kind_dist(gen);
+        bytes = (kind < 90) ? small_dist(gen) : large_dist(gen);
+        align = (kind % 10 == 0) ? ark::GpuOffsetAllocator::EXPORT_ALIGN : 1;
+    };
+
+    ark::GpuOffsetAllocator allocator;
+    std::vector<int> ids(num_buffers);
+    size_t bytes;
+    int align;
+    double start = ark::cpu_timer();
+    for (int i = 0; i < num_buffers; ++i) {
+        request(bytes, align);
+        ids[i] = i;
+        allocator.allocate(i, bytes, align);
+    }
+    double fill_elapsed = ark::cpu_timer() - start;
+
+    int next_id = num_buffers;
+    start = ark::cpu_timer();
+    for (int i = 0; i < num_iters; ++i) {
+        int &id = ids[gen() % num_buffers];
+        allocator.free(id);
+        request(bytes, align);
+        id = next_id++;
+        allocator.allocate(id, bytes, align);
+    }
+    double churn_elapsed = ark::cpu_timer() - start;
+
+    auto stats = allocator.get_stats();
+    LOG(ark::INFO, "buffers: ", num_buffers, ", fill: ",
+        fill_elapsed * 1e9 / num_buffers, " ns/alloc, churn: ",
+        churn_elapsed * 1e9 / num_iters, " ns/(free + alloc)");
+    LOG(ark::INFO, "total: ", stats.total_bytes, " bytes, used: ",
+        stats.used_bytes, " bytes, free ranges: ", stats.num_free_ranges,
+        ", largest free: ", stats.largest_free_bytes,
+        " bytes, fragmentation: ", stats.fragmentation());
+    return 0;
+}
@@ -0,0 +1,168 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "gpu/gpu_offset_allocator.h"
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include "include/ark.h"
+#include "unittest/unittest_utils.h"
+
+ark::unittest::State test_gpu_offset_allocator_basic() {
+    ark::GpuOffsetAllocator allocator;
+    UNITTEST_EQ(allocator.allocate(0, 4), 0UL);
+    UNITTEST_EQ(allocator.allocate(1, 4), 128UL);
+    UNITTEST_EQ(allocator.allocate(2, 100000), 65536UL);
+    UNITTEST_EQ(allocator.get_total_bytes(), 65536UL + 131072UL);
+    UNITTEST_EQ(allocator.allocate(3, 4, 65536), 196608UL);
+
+    // The alignment gap is reused.
+    UNITTEST_EQ(allocator.allocate(4, 256), 256UL);
+
+    UNITTEST_THROW(allocator.allocate(0, 4), ark::ExecutorError);
+    UNITTEST_THROW(allocator.allocate(5, 0), ark::ExecutorError);
+    UNITTEST_THROW(allocator.free(5), ark::ExecutorError);
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_gpu_offset_allocator_best_fit() {
+    ark::GpuOffsetAllocator allocator;
+    for (int i = 0; i < 6; ++i) {
+        allocator.allocate(i, (i == 1) ? 1024 : 256);
+    }
+    // Free ranges: [256, 1280) and [1536, 1792).
+    allocator.free(1);
+    allocator.free(3);
+    UNITTEST_EQ(allocator.allocate(6, 200), 1536UL);
+    UNITTEST_EQ(allocator.allocate(7, 1000), 256UL);
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_gpu_offset_allocator_coalesce() {
+    ark::GpuOffsetAllocator allocator;
+    for (int i = 0; i < 4; ++i) {
+        allocator.allocate(i, 128);
+    }
+    // Free a range between two free ranges.
+    allocator.free(0);
+    allocator.free(2);
+    UNITTEST_EQ(allocator.get_stats().num_free_ranges, 2UL);
+    allocator.free(1);
+    auto stats = allocator.get_stats();
+    UNITTEST_EQ(stats.num_free_ranges, 1UL);
+    UNITTEST_EQ(stats.largest_free_bytes, 384UL);
+    UNITTEST_EQ(stats.fragmentation(), 0.0);
+    UNITTEST_EQ(allocator.allocate(4, 384), 0UL);
+    UNITTEST_EQ(allocator.get_total_bytes(), 512UL);
+
+    // Free the last range and then the one before it.
+    allocator.allocate(5, 128);
+    allocator.free(5);
+    allocator.free(3);
+    UNITTEST_EQ(allocator.get_stats().num_free_ranges, 1UL);
+    UNITTEST_EQ(allocator.allocate(6, 256), 384UL);
+    UNITTEST_EQ(allocator.get_total_bytes(), 640UL);
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_gpu_offset_allocator_stats() {
+    ark::GpuOffsetAllocator allocator;
+    auto stats = allocator.get_stats();
+    UNITTEST_EQ(stats.total_bytes, 0UL);
+    UNITTEST_EQ(stats.fragmentation(), 0.0);
+
+    for (int i = 0; i < 4; ++i) {
+        allocator.allocate(i, 128);
+    }
+    allocator.free(0);
+    allocator.free(2);
+    stats = allocator.get_stats();
+    UNITTEST_EQ(stats.total_bytes, 512UL);
+    UNITTEST_EQ(stats.used_bytes, 256UL);
+    UNITTEST_EQ(stats.free_bytes, 256UL);
+    UNITTEST_EQ(stats.largest_free_bytes, 128UL);
+    UNITTEST_EQ(stats.num_free_ranges, 2UL);
+    UNITTEST_EQ(stats.num_used_ranges, 2UL);
+    UNITTEST_EQ(stats.fragmentation(), 0.5);
+    return ark::unittest::SUCCESS;
+}
+
+// Random allocations and frees, checked against a simple model.
+ark::unittest::State test_gpu_offset_allocator_stress() {
+    std::mt19937 gen(1234);
+    std::uniform_int_distribution<int> op_dist(0, 99);
+    std::uniform_int_distribution<size_t> small_dist(1, 4096);
+    std::uniform_int_distribution<size_t> large_dist(32769, 1 << 22);
+
+    ark::GpuOffsetAllocator allocator;
+    // id -> (offset, bytes, align)
+    std::map<int, std::tuple<size_t, size_t, int>> live;
+    int next_id = 0;
+    for (int step = 0; step < 20000; ++step) {
+        int op = op_dist(gen);
+        if (op < 55 || live.empty()) {
+            size_t bytes = (op % 4 == 0) ? large_dist(gen) : small_dist(gen);
+            int align = (op % 7 == 0) ? 65536 : 1;
+            int id = next_id++;
+            size_t offset = allocator.allocate(id, bytes, align);
+            live[id] = std::make_tuple(offset, bytes, align);
+        } else {
+            auto it = live.begin();
+            std::advance(it, gen() % live.size());
+            allocator.free(it->first);
+            live.erase(it);
+        }
+        if (step % 100 != 0) {
+            continue;
+        }
+        std::vector<std::pair<size_t, size_t>> ranges;
+        size_t used = 0;
+        for (auto &p : live) {
+            size_t offset = std::get<0>(p.second);
+            size_t bytes = std::get<1>(p.second);
+            int align = ark::GpuOffsetAllocator::get_align(
+                bytes, std::get<2>(p.second));
+            UNITTEST_EQ(offset % align, 0UL);
+            size_t size = (bytes + align - 1) / align * align;
+            ranges.emplace_back(offset, offset + size);
+            used += size;
+        }
+        std::sort(ranges.begin(), ranges.end());
+        for (size_t i = 1; i < ranges.size(); ++i) {
+            UNITTEST_TRUE(ranges[i - 1].second <= ranges[i].first);
+        }
+        auto stats = allocator.get_stats();
+        UNITTEST_TRUE(ranges.empty() ||
+                      ranges.back().second <= stats.total_bytes);
+        UNITTEST_EQ(stats.used_bytes, used);
+        UNITTEST_EQ(stats.num_used_ranges, live.size());
+        UNITTEST_EQ(stats.used_bytes + stats.free_bytes, stats.total_bytes);
+        // Free ranges are coalesced, so there is at most one free range
+        // between two live ranges.
+        UNITTEST_TRUE(stats.num_free_ranges <= ranges.size() + 1);
+    }
+
+    // Everything merges back into a single free range.
+    for (auto &p : live) {
+        allocator.free(p.first);
+    }
+    auto stats = allocator.get_stats();
+    UNITTEST_EQ(stats.used_bytes, 0UL);
+    UNITTEST_EQ(stats.num_free_ranges, 1UL);
+    UNITTEST_EQ(stats.largest_free_bytes, stats.total_bytes);
+    return ark::unittest::SUCCESS;
+}
+
+int main() {
+    ark::init();
+    UNITTEST(test_gpu_offset_allocator_basic);
+    UNITTEST(test_gpu_offset_allocator_best_fit);
+    UNITTEST(test_gpu_offset_allocator_coalesce);
+    UNITTEST(test_gpu_offset_allocator_stats);
+    UNITTEST(test_gpu_offset_allocator_stress);
+    return 0;
+}
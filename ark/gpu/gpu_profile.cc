@@ -0,0 +1,146 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "gpu/gpu_profile.h"
+
+#include <algorithm>
+#include <map>
+
+#include "file_io.h"
+#include "include/ark.h"
+#include "json.h"
+#include "logging.h"
+
+namespace ark {
+
+// Built-in profiles. Values are what the CUDA/HIP runtime reports on the
+// corresponding devices.
+static const std::map<std::string, std::string> builtin_profiles = {
+    {"a100", R"({
+        "arch": "cuda_80", "cc_major": 8, "cc_minor": 0,
+        "gmem_total": 85899345920, "smem_total": 167936,
+        "smem_block_total": 166912, "num_sm": 108, "clk_rate": 1410000,
+        "threads_per_warp": 32, "max_registers_per_block": 65536,
+        "max_threads_per_block": 1024
+    })"},
+    {"h100", R"({
+        "arch": "cuda_90", "cc_major": 9, "cc_minor": 0,
+        "gmem_total": 85899345920, "smem_total": 233472,
+        "smem_block_total": 232448, "num_sm": 132, "clk_rate": 1980000,
+        "threads_per_warp": 32, "max_registers_per_block": 65536,
+        "max_threads_per_block": 1024
+    })"},
+    {"mi250x", R"({
+        "arch": "rocm_90a", "cc_major": 9, "cc_minor": 0,
+        "gmem_total": 68702699520, "smem_total": 65536,
+        "smem_block_total": 65536, "num_sm": 110, "clk_rate": 1700000,
+        "threads_per_warp": 64, "max_registers_per_block": 65536,
+        "max_threads_per_block": 1024
+    })"},
+    {"mi300x", R"({
+        "arch": "rocm_942", "cc_major": 9, "cc_minor": 4,
+        "gmem_total": 206141652992, "smem_total": 65536,
+        "smem_block_total": 65536, "num_sm": 304, "clk_rate": 2100000,
+        "threads_per_warp": 64, "max_registers_per_block": 65536,
+        "max_threads_per_block": 1024
+    })"},
+};
+
+template <typename T>
+static T get_field(const nlohmann::json &j, const std::string &key) {
+    auto it = j.find(key);
+    if (it == j.end()) {
+        ERR(InvalidUsageError, "GPU profile misses the field \"", key, "\"");
+    }
+    return it->get<T>();
+}
+
+GpuManager::Info gpu_profile_from_json(const std::string &json_str) {
+    nlohmann::json j;
+    try {
+        j = nlohmann::json::parse(json_str);
+    } catch (const nlohmann::json::exception &e) {
+        ERR(InvalidUsageError, "failed to parse GPU profile: ", e.what());
+    }
+    if (!j.is_object()) {
+        ERR(InvalidUsageError, "GPU profile should be a JSON object");
+    }
+    GpuManager::Info info;
+    try {
+        info.arch = get_field<std::string>(j, "arch");
+        info.cc_major = get_field<int>(j, "cc_major");
+        info.cc_minor = get_field<int>(j, "cc_minor");
+        info.gmem_total = get_field<size_t>(j, "gmem_total");
+        info.smem_total = get_field<int>(j, "smem_total");
+        info.smem_block_total = get_field<int>(j, "smem_block_total");
+        info.num_sm = get_field<int>(j, "num_sm");
+        info.clk_rate = get_field<int>(j, "clk_rate");
+        info.threads_per_warp = get_field<int>(j, "threads_per_warp");
+        info.max_registers_per_block =
+            get_field<int>(j, "max_registers_per_block");
+        info.max_threads_per_block = get_field<int>(j, "max_threads_per_block");
+        info.max_registers_per_thread =
+            j.value("max_registers_per_thread", 256);
+        info.min_threads_per_block =
+            j.value("min_threads_per_block", info.max_registers_per_block /
+                                                 info.max_registers_per_thread);
+        info.smem_align = j.value("smem_align", 128);
+    } catch (const nlohmann::json::exception &e) {
+        ERR(InvalidUsageError, "invalid GPU profile: ", e.what());
+    }
+    if (info.num_sm <= 0 || info.threads_per_warp <= 0 ||
+        info.max_threads_per_block < info.threads_per_warp ||
+        info.smem_align <= 0) {
+        ERR(InvalidUsageError, "invalid GPU profile: ", json_str);
+    }
+    return info;
+}
+
+GpuManager::Info gpu_profile_from_file(const std::string &path) {
+    if (!is_file(path)) {
+        ERR(InvalidUsageError, "GPU profile file not found: ", path);
+    }
+    return gpu_profile_from_json(read_file(path));
+}
+
+std::string gpu_profile_to_json(const GpuManager::Info &info) {
+    nlohmann::json j;
+    j["arch"] = info.arch;
+    j["cc_major"] = info.cc_major;
+    j["cc_minor"] = info.cc_minor;
+    j["gmem_total"] = info.gmem_total;
+    j["smem_total"] = info.smem_total;
+    j["smem_block_total"] = info.smem_block_total;
+    j["num_sm"] = info.num_sm;
+    j["clk_rate"] = info.clk_rate;
+    j["threads_per_warp"] = info.threads_per_warp;
+    j["max_registers_per_block"] = info.max_registers_per_block;
+    j["max_threads_per_block"] = info.max_threads_per_block;
+    j["max_registers_per_thread"] = info.max_registers_per_thread;
+    j["min_threads_per_block"] = info.min_threads_per_block;
+    j["smem_align"] = info.smem_align;
+    return j.dump(4);
+}
+
+GpuManager::Info gpu_profile(const std::string &name) {
+    std::string lower = name;
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+    auto it = builtin_profiles.find(lower);
+    if (it != builtin_profiles.end()) {
+        return gpu_profile_from_json(it->second);
+    }
+    if (!is_file(name)) {
+        ERR(InvalidUsageError, "unknown GPU profile: ", name);
+    }
+    return gpu_profile_from_file(name);
+}
+
+std::vector<std::string> gpu_profile_names() {
+    std::vector<std::string> names;
+    for (auto &p : builtin_profiles) {
+        names.emplace_back(p.first);
+    }
+    return names;
+}
+
+}  // namespace ark
@@ -0,0 +1,43 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#ifndef ARK_GPU_PROFILE_H_
+#define ARK_GPU_PROFILE_H_
+
+#include <string>
+#include <vector>
+
+#include "gpu/gpu_manager.h"
+
+namespace ark {
+
+/// Synthetic device profiles that describe a GPU without touching it. They
+/// are used to schedule and generate code for a device that is not present
+/// on this host (plan-only mode).
+///
+/// A profile is a JSON object whose keys are the fields of
+/// @ref GpuManager::Info, e.g.
+/// {"arch": "cuda_80", "num_sm": 108, "smem_block_total": 166912, ...}.
+/// `max_registers_per_thread` and `smem_align` are optional, and
+/// `min_threads_per_block` is derived if not given.
+
+/// Parse a device profile from a JSON string.
+GpuManager::Info gpu_profile_from_json(const std::string &json_str);
+
+/// Load a device profile from a JSON file.
+GpuManager::Info gpu_profile_from_file(const std::string &path);
+
+/// Serialize a device profile into a JSON string.
+std::string gpu_profile_to_json(const GpuManager::Info &info);
+
+/// Get a built-in device profile by name (case-insensitive), e.g. "a100",
+/// "h100" or "mi300x". If @p name is not a built-in profile, it is
+/// regarded as a path to a JSON profile file.
+GpuManager::Info gpu_profile(const std::string &name);
+
+/// Names of all built-in device profiles.
+std::vector<std::string> gpu_profile_names();
+
+}  // namespace ark
+
+#endif  // ARK_GPU_PROFILE_H_
@@ -0,0 +1,59 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "gpu/gpu_staging_pool.h"
+
+#include <algorithm>
+
+#include "env.h"
+#include "logging.h"
+#include "math_utils.h"
+
+namespace ark {
+
+// Allocation unit of staging buffers, so that tensors of similar sizes reuse
+// the same buffers.
+static const size_t staging_unit_bytes = 1 << 16;
+
+std::shared_ptr<GpuStagingPool> GpuStagingPool::get_instance(int gpu_id) {
+    std::shared_ptr<GpuManager> manager = GpuManager::get_instance(gpu_id);
+    return std::shared_ptr<GpuStagingPool>(manager, &manager->staging_pool());
+}
+
+GpuStagingPool::GpuStagingPool(GpuManager &manager)
+    : manager_(manager), stream_(manager_.create_stream()) {}
+
+GpuStagingPool::Staging GpuStagingPool::acquire(size_t bytes) {
+    size_t alloc_bytes = math::pad(std::max(bytes, (size_t)1),
+                                   staging_unit_bytes);
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = free_.lower_bound(bytes);
+        if (it != free_.end() && it->first <= 2 * alloc_bytes) {
+            Staging staging{it->first, it->second};
+            free_bytes_ -= it->first;
+            free_.erase(it);
+            return staging;
+        }
+    }
+    LOG(DEBUG, "allocating a staging buffer of ", alloc_bytes, " bytes");
+    return Staging{alloc_bytes, manager_.malloc_host(alloc_bytes)};
+}
+
+void GpuStagingPool::release(Staging staging) {
+    size_t max_bytes = (size_t)get_env().staging_pool_mb << 20;
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (free_bytes_ + staging.bytes > max_bytes) {
+        // Freed when `staging` goes out of scope.
+        return;
+    }
+    free_bytes_ += staging.bytes;
+    free_.emplace(staging.bytes, std::move(staging.memory));
+}
+
+size_t GpuStagingPool::free_bytes() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return free_bytes_;
+}
+
+}  // namespace ark
@@ -0,0 +1,65 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#ifndef ARK_GPU_STAGING_POOL_H_
+#define ARK_GPU_STAGING_POOL_H_
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "gpu/gpu_manager.h"
+
+namespace ark {
+
+/// Reusable pinned host buffers and a copy stream of a GPU, which stage
+/// asynchronous copies between pageable host memory and the GPU.
+///
+/// Copies on the copy stream are not ordered with the main stream of
+/// @ref GpuManager nor with running kernels, so they can overlap with them.
+///
+/// The pool of a GPU is owned by its @ref GpuManager, so the buffers are
+/// reused as long as the manager is alive, e.g., while an @ref Executor runs
+/// on the GPU.
+class GpuStagingPool {
+   public:
+    /// The pool of @p gpu_id, which shares the ownership of its manager.
+    static std::shared_ptr<GpuStagingPool> get_instance(int gpu_id);
+    GpuStagingPool(const GpuStagingPool &) = delete;
+    GpuStagingPool &operator=(const GpuStagingPool &) = delete;
+
+    /// A pinned host buffer of at least `bytes` bytes.
+    struct Staging {
+        size_t bytes;
+        std::shared_ptr<GpuHostMemory> memory;
+    };
+
+    /// Take the smallest free buffer that holds @p bytes, or allocate one.
+    /// A free buffer of more than twice the size to allocate for @p bytes is
+    /// not taken, so that small copies do not pin large buffers.
+    Staging acquire(size_t bytes);
+
+    /// Return a buffer taken by @ref acquire to the pool. The caller should
+    /// make sure that no pending copy accesses it.
+    void release(Staging staging);
+
+    /// Total bytes of the free buffers in the pool.
+    size_t free_bytes() const;
+
+    GpuManager &manager() const { return manager_; }
+    std::shared_ptr<GpuStream> stream() const { return stream_; }
+
+   private:
+    friend class GpuManager;
+    GpuStagingPool(GpuManager &manager);
+
+    GpuManager &manager_;
+    std::shared_ptr<GpuStream> stream_;
+    mutable std::mutex mtx_;
+    std::multimap<size_t, std::shared_ptr<GpuHostMemory>> free_;
+    size_t free_bytes_ = 0;
+};
+
+}  // namespace ark
+
+#endif  // ARK_GPU_STAGING_POOL_H_
@@ -0,0 +1,96 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "gpu/gpu_trace.h"
+
+#include <algorithm>
+#include <set>
+
+#include "include/ark.h"
+#include "json.h"
+#include "logging.h"
+
+namespace ark {
+
+GpuTrace GpuTrace::decode(const std::vector<GpuTraceRecord> &records,
+                          const std::vector<unsigned int> &counts) {
+    if (counts.empty() || records.size() % counts.size() != 0) {
+        ERR(InvalidUsageError, "cannot split ", records.size(),
+            " trace records among ", counts.size(), " SMs");
+    }
+    size_t records_per_sm = records.size() / counts.size();
+    GpuTrace trace;
+    for (size_t sm_id = 0; sm_id < counts.size(); ++sm_id) {
+        size_t count = counts[sm_id];
+        size_t num = std::min(count, records_per_sm);
+        trace.num_dropped += count - num;
+        // The oldest record that is not overwritten comes first.
+        for (size_t pos = count - num; pos < count; ++pos) {
+            const GpuTraceRecord &rec =
+                records[sm_id * records_per_sm + pos % records_per_sm];
+            trace.events.push_back({(int)sm_id, rec.warp_id, rec.opseq_id,
+                                    rec.uop_id, rec.iter, rec.start,
+                                    rec.end});
+        }
+    }
+    std::stable_sort(trace.events.begin(), trace.events.end(),
+                     [](const GpuTraceEvent &a, const GpuTraceEvent &b) {
+                         return a.start < b.start;
+                     });
+    return trace;
+}
+
+void GpuTrace::dump_chrome(std::ostream &os,
+                           const std::vector<std::string> &opseq_names) const {
+    nlohmann::json events = nlohmann::json::array();
+    uint64_t origin = this->events.empty() ? 0 : this->events.front().start;
+    std::set<std::pair<int, int>> threads;
+    for (auto &ev : this->events) {
+        nlohmann::json j;
+        if (ev.opseq_id >= 0 && (size_t)ev.opseq_id < opseq_names.size()) {
+            j["name"] = opseq_names[ev.opseq_id];
+        } else {
+            j["name"] = "op" + std::to_string(ev.opseq_id);
+        }
+        j["cat"] = "uop";
+        j["ph"] = "X";
+        j["pid"] = ev.sm_id;
+        j["tid"] = ev.warp_id;
+        // Chrome traces are in microseconds.
+        j["ts"] = (double)(ev.start - origin) * 1e-3;
+        j["dur"] = (double)(ev.end - ev.start) * 1e-3;
+        j["args"] = {{"opseq", ev.opseq_id},
+                     {"uop", ev.uop_id},
+                     {"iter", ev.iter}};
+        events.emplace_back(std::move(j));
+        threads.emplace(ev.sm_id, ev.warp_id);
+    }
+    int prev_sm_id = -1;
+    for (auto &p : threads) {
+        if (p.first != prev_sm_id) {
+            std::string name = "SM " + std::to_string(p.first);
+            events.push_back({{"name", "process_name"},
+                              {"ph", "M"},
+                              {"pid", p.first},
+                              {"args", {{"name", name}}}});
+            events.push_back({{"name", "process_sort_index"},
+                              {"ph", "M"},
+                              {"pid", p.first},
+                              {"args", {{"sort_index", p.first}}}});
+            prev_sm_id = p.first;
+        }
+        events.push_back(
+            {{"name", "thread_name"},
+             {"ph", "M"},
+             {"pid", p.first},
+             {"tid", p.second},
+             {"args", {{"name", "warp " + std::to_string(p.second)}}}});
+    }
+    nlohmann::json j;
+    j["traceEvents"] = std::move(events);
+    j["displayTimeUnit"] = "ns";
+    j["otherData"] = {{"num_dropped", this->num_dropped}};
+    os << j.dump();
+}
+
+}  // namespace ark
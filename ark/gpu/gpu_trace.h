@@ -0,0 +1,66 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#ifndef ARK_GPU_TRACE_H_
+#define ARK_GPU_TRACE_H_
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ark {
+
+/// A uop that an SM has run, as the loop kernel records it in GPU memory.
+/// The layout should be the same as `ark::TraceRecord` in the kernels.
+struct GpuTraceRecord {
+    uint64_t start;
+    uint64_t end;
+    int32_t opseq_id;
+    int32_t uop_id;
+    int32_t warp_id;
+    int32_t iter;
+};
+
+static_assert(sizeof(GpuTraceRecord) == 32, "");
+
+/// A decoded @ref GpuTraceRecord.
+struct GpuTraceEvent {
+    int sm_id;
+    /// The first warp of the uop.
+    int warp_id;
+    int opseq_id;
+    int uop_id;
+    /// The iteration of the loop body in a run.
+    int iter;
+    /// Start and end time in nanoseconds on the GPU clock.
+    uint64_t start;
+    uint64_t end;
+};
+
+/// Uops that a traced loop kernel has run.
+struct GpuTrace {
+    /// Events in the order of their start time.
+    std::vector<GpuTraceEvent> events;
+    /// Number of records overwritten before they were read.
+    size_t num_dropped = 0;
+
+    /// Decode the rings of trace records of every SM. SM `i` owns the
+    /// records [i * R, (i + 1) * R) where R is `records.size() /
+    /// counts.size()`, and has written `counts[i]` records into them in
+    /// a round-robin manner.
+    static GpuTrace decode(const std::vector<GpuTraceRecord> &records,
+                           const std::vector<unsigned int> &counts);
+
+    /// Write the events in the Chrome trace format, which Perfetto and
+    /// chrome://tracing can open. Each SM is a process, and each group of
+    /// warps is a thread named by its first warp. Events are named by
+    /// @p opseq_names indexed by the opseq ID if given, or by the opseq ID
+    /// otherwise.
+    void dump_chrome(std::ostream &os,
+                     const std::vector<std::string> &opseq_names = {}) const;
+};
+
+}  // namespace ark
+
+#endif  // ARK_GPU_TRACE_H_
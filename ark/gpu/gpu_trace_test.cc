@@ -0,0 +1,90 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "gpu/gpu_trace.h"
+
+#include <sstream>
+
+#include "include/ark.h"
+#include "json.h"
+#include "unittest/unittest_utils.h"
+
+ark::unittest::State test_gpu_trace_decode() {
+    // Two SMs with rings of three records. SM 0 has written two records, and
+    // SM 1 has written five, so its first two are overwritten.
+    std::vector<ark::GpuTraceRecord> records(6);
+    records[0] = {100, 200, 0, 0, 0, 0};
+    records[1] = {300, 400, 1, 0, 0, 0};
+    records[3] = {350, 360, 2, 3, 4, 1};  // 4th record
+    records[4] = {370, 380, 2, 4, 4, 1};  // 5th record
+    records[5] = {150, 250, 2, 2, 4, 0};  // 3rd record
+    ark::GpuTrace trace = ark::GpuTrace::decode(records, {2, 5});
+    UNITTEST_EQ(trace.num_dropped, 2UL);
+    UNITTEST_EQ(trace.events.size(), 5UL);
+    // Sorted by the start time.
+    UNITTEST_EQ(trace.events[0].start, 100UL);
+    UNITTEST_EQ(trace.events[1].start, 150UL);
+    UNITTEST_EQ(trace.events[2].start, 300UL);
+    UNITTEST_EQ(trace.events[3].start, 350UL);
+    UNITTEST_EQ(trace.events[4].start, 370UL);
+    UNITTEST_EQ(trace.events[1].sm_id, 1);
+    UNITTEST_EQ(trace.events[1].warp_id, 4);
+    UNITTEST_EQ(trace.events[1].opseq_id, 2);
+    UNITTEST_EQ(trace.events[1].uop_id, 2);
+    UNITTEST_EQ(trace.events[2].sm_id, 0);
+    UNITTEST_EQ(trace.events[4].iter, 1);
+
+    // Records that do not split evenly among SMs.
+    UNITTEST_THROW(ark::GpuTrace::decode(records, {0, 0, 0, 0}),
+                   ark::InvalidUsageError);
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_gpu_trace_chrome() {
+    std::vector<ark::GpuTraceRecord> records(4);
+    records[0] = {1000, 3000, 0, 5, 0, 0};
+    records[2] = {2000, 2500, 1, 7, 2, 0};
+    ark::GpuTrace trace = ark::GpuTrace::decode(records, {1, 1});
+
+    std::stringstream ss;
+    trace.dump_chrome(ss, {"matmul;relu"});
+    auto j = nlohmann::json::parse(ss.str());
+    UNITTEST_EQ(j["otherData"]["num_dropped"].get<size_t>(), 0UL);
+    int num_uops = 0;
+    int num_procs = 0;
+    int num_threads = 0;
+    for (auto &ev : j["traceEvents"]) {
+        std::string ph = ev["ph"];
+        if (ph == "M") {
+            if (ev["name"] == "process_name") ++num_procs;
+            if (ev["name"] == "thread_name") ++num_threads;
+            continue;
+        }
+        UNITTEST_EQ(ph, "X");
+        ++num_uops;
+        if (ev["pid"] == 0) {
+            UNITTEST_EQ(ev["name"].get<std::string>(), "matmul;relu");
+            UNITTEST_EQ(ev["tid"].get<int>(), 0);
+            UNITTEST_EQ(ev["ts"].get<double>(), 0.0);
+            UNITTEST_EQ(ev["dur"].get<double>(), 2.0);
+            UNITTEST_EQ(ev["args"]["uop"].get<int>(), 5);
+        } else {
+            // Not in the given names.
+            UNITTEST_EQ(ev["name"].get<std::string>(), "op1");
+            UNITTEST_EQ(ev["tid"].get<int>(), 2);
+            UNITTEST_EQ(ev["ts"].get<double>(), 1.0);
+            UNITTEST_EQ(ev["dur"].get<double>(), 0.5);
+        }
+    }
+    UNITTEST_EQ(num_uops, 2);
+    UNITTEST_EQ(num_procs, 2);
+    UNITTEST_EQ(num_threads, 2);
+    return ark::unittest::SUCCESS;
+}
+
+int main() {
+    ark::init();
+    UNITTEST(test_gpu_trace_decode);
+    UNITTEST(test_gpu_trace_chrome);
+    return 0;
+}
@@ -0,0 +1,38 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#ifndef ARK_HASH_H_
+#define ARK_HASH_H_
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+namespace ark {
+
+/// Incremental SHA-256.
+class Sha256 {
+   public:
+    Sha256();
+
+    /// Append @p data to the message.
+    Sha256 &update(const std::string &data);
+
+    /// Finish the message and return its digest as a hexadecimal string.
+    std::string hex_digest();
+
+   private:
+    void compress(const uint8_t *block);
+
+    std::array<uint32_t, 8> state_;
+    std::array<uint8_t, 64> block_;
+    size_t block_len_;
+    uint64_t total_len_;
+};
+
+/// Hexadecimal SHA-256 digest of @p data.
+std::string sha256(const std::string &data);
+
+}  // namespace ark
+
+#endif  // ARK_HASH_H_
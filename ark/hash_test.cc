@@ -0,0 +1,37 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "hash.h"
+
+#include "include/ark.h"
+#include "unittest/unittest_utils.h"
+
+ark::unittest::State test_sha256() {
+    UNITTEST_EQ(
+        ark::sha256(""),
+        "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    UNITTEST_EQ(
+        ark::sha256("abc"),
+        "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    UNITTEST_EQ(
+        ark::sha256("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"),
+        "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+
+    // Incremental updates across block boundaries.
+    ark::Sha256 sha;
+    for (int i = 0; i < 1000; ++i) {
+        sha.update(std::string(1000, 'a'));
+    }
+    UNITTEST_EQ(
+        sha.hex_digest(),
+        "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+    UNITTEST_EQ(ark::Sha256().update("ab").update("c").hex_digest(),
+                ark::sha256("abc"));
+    return ark::unittest::SUCCESS;
+}
+
+int main() {
+    ark::init();
+    UNITTEST(test_sha256);
+    return 0;
+}
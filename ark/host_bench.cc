@@ -0,0 +1,205 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+// Microbenchmarks of the host-side work of an executor, without a GPU:
+// building models, the op graph, scheduling, code generation, and lookups in
+// the kernel binary cache.
+// Usage: host_bench [--filter REGEX] [--min-time SEC] [--json PATH]
+//                   [--compare PATH] [--threshold FRAC] [--list]
+// e.g., compare a change against the baseline of the parent commit:
+//   host_bench --json base.json   # on the parent commit
+//   host_bench --compare base.json
+
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench/bench_utils.h"
+#include "env.h"
+#include "file_io.h"
+#include "gpu/gpu_compile.h"
+#include "gpu/gpu_kernel_cache.h"
+#include "gpu/gpu_profile.h"
+#include "include/ark.h"
+#include "logging.h"
+#include "sched/sched.h"
+#include "sched/sched_branch.h"
+#include "sched/sched_stream.h"
+
+static const int seq_len = 512;
+static const int d_model = 1024;
+static const int num_heads = 16;
+static const int d_ff = 4096;
+
+/// A multi-head attention layer followed by a feed-forward layer, each with a
+/// residual connection and a layer norm, like a transformer encoder layer.
+static ark::Tensor *transformer_layer(ark::Model &m, ark::Tensor *x) {
+    const int d_head = d_model / num_heads;
+    auto weight = [&](int rows, int cols) {
+        return m.tensor({rows, cols}, ark::FP16);
+    };
+    // [1, seq_len, d_model] -> [num_heads, seq_len, d_head]
+    auto heads = [&](ark::Tensor *t) {
+        t = m.reshape(t, {1, seq_len, num_heads, d_head});
+        t = m.transpose(t, {0, 2, 1, 3});
+        return m.reshape(t, {num_heads, seq_len, d_head});
+    };
+    ark::Tensor *q = heads(m.matmul(x, weight(d_model, d_model)));
+    ark::Tensor *k = heads(m.matmul(x, weight(d_model, d_model)));
+    ark::Tensor *v = heads(m.matmul(x, weight(d_model, d_model)));
+
+    ark::Tensor *scores = m.matmul(q, k, nullptr, 1, false, true);
+    scores = m.scale(scores, 1.0f / 8);
+    // Softmax over the last axis.
+    ark::Tensor *max = m.reduce_max(scores, 2);
+    ark::Tensor *attn = m.exp(m.sub(scores, max));
+    attn = m.div(attn, m.reduce_sum(attn, 2));
+
+    ark::Tensor *ctx = m.matmul(attn, v);
+    ctx = m.reshape(ctx, {1, num_heads, seq_len, d_head});
+    ctx = m.transpose(ctx, {0, 2, 1, 3});
+    ctx = m.reshape(ctx, {1, seq_len, d_model});
+    ark::Tensor *out = m.matmul(ctx, weight(d_model, d_model));
+    x = m.layernorm(m.add(out, x));
+
+    ark::Tensor *ff = m.gelu(m.matmul(x, weight(d_model, d_ff)));
+    ff = m.matmul(ff, weight(d_ff, d_model));
+    return m.layernorm(m.add(ff, x));
+}
+
+static void build_transformer(ark::Model &m, int num_layers) {
+    ark::Tensor *x = m.tensor({1, seq_len, d_model}, ark::FP16);
+    for (int l = 0; l < num_layers; ++l) {
+        x = transformer_layer(m, x);
+    }
+}
+
+/// Items like those of matmuls and element-wise ops: a few warps each, some
+/// with shared memory, and many uops per item.
+static std::vector<ark::SchedItem> random_items(int num_items) {
+    std::mt19937 gen(0);
+    std::vector<ark::SchedItem> items;
+    for (int i = 0; i < num_items; ++i) {
+        bool heavy = gen() % 4 == 0;
+        int num_warps = heavy ? 4 : 1 << (gen() % 3);
+        double cost = (heavy ? 10 : 1) * (1.0 + gen() % 10);
+        items.push_back({/*opseq_id*/ i,
+                         /*num_uops*/ 1 + (int)(gen() % 1024),
+                         /*num_warps_per_uop*/ num_warps,
+                         /*smem_bytes_per_uop*/ heavy ? 49152 : 0,
+                         /*cost_per_uop*/ cost,
+                         /*priority*/ (double)(gen() % 100)});
+    }
+    return items;
+}
+
+int main(int argc, char **argv) {
+    ark::init();
+    ark::bench::Suite suite{argc, argv};
+    const ark::GpuManager::Info gpu_info = ark::gpu_profile("a100");
+    const int num_warps_per_sm = 16;
+
+    for (int num_layers : {1, 8, 32}) {
+        std::string param = "/layers=" + std::to_string(num_layers);
+
+        suite.add("model_build" + param, [=] {
+            ark::Model m;
+            build_transformer(m, num_layers);
+        });
+
+        auto model = std::make_shared<ark::Model>();
+        build_transformer(*model, num_layers);
+        suite.add("opgraph" + param, [=] { ark::OpGraph graph(*model); });
+
+        // Scheduling passes rewrite the model, so every run starts from a
+        // fresh one.
+        auto fresh = std::make_shared<std::unique_ptr<ark::Model>>();
+        suite.add(
+            "schedule" + param,
+            [=] {
+                ark::DefaultScheduler sched{**fresh, gpu_info, 0, 1};
+                sched.schedule();
+            },
+            [=] {
+                fresh->reset(new ark::Model);
+                build_transformer(**fresh, num_layers);
+            });
+
+        auto sched_model = std::make_shared<ark::Model>();
+        build_transformer(*sched_model, num_layers);
+        auto sched = std::make_shared<ark::DefaultScheduler>(*sched_model,
+                                                             gpu_info, 0, 1);
+        sched->schedule();
+        sched->plan_context();
+        suite.add("codegen" + param,
+                  [sched_model, sched] { sched->gen_code(); });
+    }
+
+    for (int num_items : {16, 256, 1024}) {
+        auto items = std::make_shared<std::vector<ark::SchedItem>>(
+            random_items(num_items));
+        for (auto policy : {ark::SCHED_POLICY_GREEDY, ark::SCHED_POLICY_LPT}) {
+            std::string name =
+                std::string("sched_stream/") +
+                (policy == ark::SCHED_POLICY_LPT ? "lpt" : "greedy") +
+                "/items=" + std::to_string(num_items);
+            suite.add(name, [=] {
+                ark::SchedStream stream{0, gpu_info.num_sm, num_warps_per_sm,
+                                        gpu_info.smem_block_total, policy};
+                stream.add_items(*items);
+                stream.get_streams();
+            });
+        }
+    }
+
+    for (int num_uops : {1024, 16384, 262144}) {
+        suite.add("sched_branch/uops=" + std::to_string(num_uops), [=] {
+            // Uops of 4 warps each, spread over the SMs in turn, of an opseq
+            // per 1024 uops.
+            ark::SchedBranch sb;
+            std::map<int, int> sm_id_to_smem_per_warp;
+            for (int uop_id = 0; uop_id < num_uops; ++uop_id) {
+                int sm_id = uop_id % gpu_info.num_sm;
+                int warp_id = (uop_id / gpu_info.num_sm) % 4 * 4;
+                sb.add(uop_id / 1024, uop_id % 1024, sm_id, warp_id,
+                       warp_id + 4);
+                sm_id_to_smem_per_warp[sm_id] = 0;
+            }
+            sb.get_branches(sm_id_to_smem_per_warp);
+        });
+    }
+
+    std::string cache_dir = ark::get_env().path_tmp_dir + "/host_bench_cache";
+    auto cache = std::make_shared<ark::GpuKernelCache>(cache_dir, 0);
+    for (size_t bytes : {1 << 16, 1 << 20, 1 << 24}) {
+        std::string key = "host_bench_" + std::to_string(bytes);
+        cache->put(key, std::string(bytes, 'x'));
+        suite.add("kernel_cache_get/bytes=" + std::to_string(bytes), [=] {
+            std::string data;
+            if (!cache->get(key, data)) {
+                ERR(ark::RuntimeError, "missing cache entry ", key);
+            }
+        });
+    }
+
+    // A cache hit of `gpu_compile()` hashes the code and the compiler flags
+    // and reads the binary back. The code is padded to a size like that of a
+    // generated loop kernel, and compiled once before the runs.
+    auto codes = std::make_shared<std::vector<std::string>>();
+    codes->push_back("// " + std::string(1 << 20, '-') +
+                     "\nextern \"C\" __global__ void host_bench() {}\n");
+    std::string arch = gpu_info.arch;
+    unsigned int max_reg_cnt = gpu_info.max_registers_per_block /
+                               (num_warps_per_sm * gpu_info.threads_per_warp);
+    try {
+        ark::gpu_compile(*codes, arch, max_reg_cnt);
+        suite.add("gpu_compile_hit",
+                  [=] { ark::gpu_compile(*codes, arch, max_reg_cnt); });
+    } catch (const std::runtime_error &e) {
+        LOG(ark::WARN, "skip gpu_compile_hit: ", e.what());
+    }
+
+    return suite.run();
+}
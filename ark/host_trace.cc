@@ -0,0 +1,101 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "host_trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "cpu_timer.h"
+#include "include/ark.h"
+#include "json.h"
+#include "logging.h"
+
+namespace ark {
+
+// Phases beyond this number are dropped, so that a long-running process that
+// keeps creating executors does not grow without bound.
+static const size_t max_host_trace_spans = 1 << 16;
+
+struct HostTraceState {
+    std::mutex mtx;
+    std::vector<HostTraceSpan> spans;
+    size_t num_dropped = 0;
+};
+
+static HostTraceState &get_host_trace_state() {
+    static HostTraceState state;
+    return state;
+}
+
+static thread_local int host_trace_depth = 0;
+
+static int host_trace_thread_id() {
+    static std::atomic<int> next_id{0};
+    static thread_local int id = next_id++;
+    return id;
+}
+
+HostTraceScope::HostTraceScope(const std::string &name)
+    : name_{name}, start_{cpu_timer()}, depth_{host_trace_depth++} {}
+
+HostTraceScope::~HostTraceScope() {
+    double end = cpu_timer();
+    --host_trace_depth;
+    int thread_id = host_trace_thread_id();
+    HostTraceState &state = get_host_trace_state();
+    std::lock_guard<std::mutex> lock(state.mtx);
+    if (state.spans.size() >= max_host_trace_spans) {
+        if (state.num_dropped++ == 0) {
+            LOG(WARN, "host trace is full, dropping phases");
+        }
+        return;
+    }
+    state.spans.push_back({name_, start_, end, depth_, thread_id});
+}
+
+std::vector<HostTraceSpan> host_trace() {
+    std::vector<HostTraceSpan> spans;
+    {
+        HostTraceState &state = get_host_trace_state();
+        std::lock_guard<std::mutex> lock(state.mtx);
+        spans = state.spans;
+    }
+    // A phase is recorded when it ends, so enclosing phases come later.
+    std::stable_sort(spans.begin(), spans.end(),
+                     [](const HostTraceSpan &a, const HostTraceSpan &b) {
+                         return a.start < b.start ||
+                                (a.start == b.start && a.depth < b.depth);
+                     });
+    return spans;
+}
+
+void host_trace_clear() {
+    HostTraceState &state = get_host_trace_state();
+    std::lock_guard<std::mutex> lock(state.mtx);
+    state.spans.clear();
+    state.num_dropped = 0;
+}
+
+std::string host_trace_json() {
+    std::vector<HostTraceSpan> spans = host_trace();
+    double origin = spans.empty() ? 0 : spans.front().start;
+    nlohmann::json events = nlohmann::json::array();
+    for (auto &span : spans) {
+        // Chrome traces are in microseconds.
+        events.push_back({{"name", span.name},
+                          {"cat", "host"},
+                          {"ph", "X"},
+                          {"pid", 0},
+                          {"tid", span.thread_id},
+                          {"ts", (span.start - origin) * 1e6},
+                          {"dur", (span.end - span.start) * 1e6}});
+    }
+    nlohmann::json j;
+    j["traceEvents"] = std::move(events);
+    return j.dump();
+}
+
+}  // namespace ark
@@ -0,0 +1,29 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#ifndef ARK_HOST_TRACE_H_
+#define ARK_HOST_TRACE_H_
+
+#include <string>
+
+namespace ark {
+
+/// Record a phase of host-side work from the construction until the
+/// destruction of this object, which @ref host_trace() returns. Scopes nest
+/// on each thread.
+class HostTraceScope {
+   public:
+    HostTraceScope(const std::string &name);
+    ~HostTraceScope();
+    HostTraceScope(const HostTraceScope &) = delete;
+    HostTraceScope &operator=(const HostTraceScope &) = delete;
+
+   private:
+    std::string name_;
+    double start_;
+    int depth_;
+};
+
+}  // namespace ark
+
+#endif  // ARK_HOST_TRACE_H_
@@ -0,0 +1,115 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "host_trace.h"
+
+#include <set>
+#include <thread>
+
+#include "cpu_timer.h"
+#include "gpu/gpu_profile.h"
+#include "include/ark.h"
+#include "json.h"
+#include "sched/sched.h"
+#include "unittest/unittest_utils.h"
+
+ark::unittest::State test_host_trace_nested() {
+    ark::host_trace_clear();
+    {
+        ark::HostTraceScope outer{"outer"};
+        {
+            ark::HostTraceScope inner{"inner"};
+            ark::cpu_timer_sleep(0.001);
+        }
+        ark::HostTraceScope inner2{"inner2"};
+    }
+    auto spans = ark::host_trace();
+    UNITTEST_EQ(spans.size(), 3UL);
+    // In the order of the start time, though the outer one ends the last.
+    UNITTEST_EQ(spans[0].name, "outer");
+    UNITTEST_EQ(spans[1].name, "inner");
+    UNITTEST_EQ(spans[2].name, "inner2");
+    UNITTEST_EQ(spans[0].depth, 0);
+    UNITTEST_EQ(spans[1].depth, 1);
+    UNITTEST_EQ(spans[2].depth, 1);
+    UNITTEST_TRUE(spans[1].end - spans[1].start >= 0.001);
+    UNITTEST_TRUE(spans[0].start <= spans[1].start);
+    UNITTEST_TRUE(spans[0].end >= spans[2].end);
+    UNITTEST_TRUE(spans[1].end <= spans[2].start);
+
+    ark::host_trace_clear();
+    UNITTEST_EQ(ark::host_trace().size(), 0UL);
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_host_trace_threads() {
+    ark::host_trace_clear();
+    ark::HostTraceScope main_scope{"main"};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([] { ark::HostTraceScope scope{"worker"}; });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    auto spans = ark::host_trace();
+    UNITTEST_EQ(spans.size(), 4UL);
+    std::set<int> thread_ids;
+    for (auto &span : spans) {
+        UNITTEST_EQ(span.name, "worker");
+        // Scopes of other threads do not nest in `main_scope`.
+        UNITTEST_EQ(span.depth, 0);
+        thread_ids.insert(span.thread_id);
+    }
+    UNITTEST_EQ(thread_ids.size(), 4UL);
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_host_trace_json() {
+    ark::host_trace_clear();
+    {
+        ark::HostTraceScope outer{"outer"};
+        ark::HostTraceScope inner{"inner"};
+    }
+    auto j = nlohmann::json::parse(ark::host_trace_json());
+    auto &events = j["traceEvents"];
+    UNITTEST_EQ(events.size(), 2UL);
+    UNITTEST_EQ(events[0]["name"].get<std::string>(), "outer");
+    UNITTEST_EQ(events[0]["ph"].get<std::string>(), "X");
+    UNITTEST_EQ(events[0]["ts"].get<double>(), 0.0);
+    UNITTEST_TRUE(events[0]["dur"].get<double>() >=
+                  events[1]["dur"].get<double>());
+    UNITTEST_EQ(events[1]["name"].get<std::string>(), "inner");
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_host_trace_scheduler() {
+    ark::host_trace_clear();
+    ark::Model m;
+    ark::Tensor *a = m.tensor({256, 256}, ark::FP16);
+    ark::Tensor *b = m.tensor({256, 256}, ark::FP16);
+    m.relu(m.add(a, b));
+
+    ark::DefaultScheduler sched{m, ark::gpu_profile("a100"), 0, 1};
+    sched.schedule();
+    std::set<std::string> names;
+    for (auto &span : ark::host_trace()) {
+        names.insert(span.name);
+    }
+    UNITTEST_EQ(names.count("graph_passes"), 1UL);
+    UNITTEST_EQ(names.count("OpGraph"), 1UL);
+    UNITTEST_EQ(names.count("OpGraph::merge_nodes"), 1UL);
+    UNITTEST_EQ(names.count("schedule_nodes"), 1UL);
+    UNITTEST_EQ(names.count("SchedStream::add_items"), 1UL);
+    UNITTEST_EQ(names.count("configure_gpu_buf"), 1UL);
+    return ark::unittest::SUCCESS;
+}
+
+int main() {
+    ark::init();
+    UNITTEST(test_host_trace_nested);
+    UNITTEST(test_host_trace_threads);
+    UNITTEST(test_host_trace_json);
+    UNITTEST(test_host_trace_scheduler);
+    return 0;
+}
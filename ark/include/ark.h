@@ -142,6 +142,33 @@ class TensorBuf {
 
     friend class Tensor;
     friend class BaseScheduler;
+    friend class ExecPlan;
+};
+
+/// Completion handle of an asynchronous copy issued by
+/// @ref Tensor::write_async or @ref Tensor::read_async. Copies of a handle
+/// refer to the same copy, and the last one to be destroyed waits for the copy
+/// to complete.
+class TensorIoHandle {
+   public:
+    TensorIoHandle(const TensorIoHandle &) = default;
+    TensorIoHandle &operator=(const TensorIoHandle &) = default;
+
+    /// Returns true if the copy has completed, without blocking. For a read,
+    /// the host buffer is filled when this returns true.
+    bool done();
+
+    /// Block until the copy completes. For a read, the host buffer is filled
+    /// when this returns.
+    void wait();
+
+   private:
+    class Impl;
+    std::shared_ptr<Impl> impl_;
+
+    TensorIoHandle(std::shared_ptr<Impl> impl);
+
+    friend class Tensor;
 };
 
 /// Tensor is a view of a TensorBuf.
@@ -201,6 +228,33 @@ class Tensor {
     ///
     void *read(void *buf = nullptr);
 
+    /// Asynchronous version of @ref write.
+    ///
+    /// The data is staged through a pinned host buffer and copied to the GPU
+    /// on a dedicated copy stream, so that the copy may overlap with a running
+    /// @ref Executor. @p buf can be reused as soon as this returns. The copy
+    /// is not ordered with the kernels of any @ref Executor, so the caller
+    /// should make sure that they do not access the tensor until the copy
+    /// completes.
+    ///
+    /// @param buf The host buffer to copy from.
+    /// @return The handle to wait for the copy.
+    ///
+    TensorIoHandle write_async(const void *buf);
+
+    /// Asynchronous version of @ref read.
+    ///
+    /// The data is copied from the GPU into a pinned host buffer on a
+    /// dedicated copy stream and then into @p buf when the returned handle
+    /// completes. @p buf must stay valid until then. The copy is not ordered
+    /// with the kernels of any @ref Executor.
+    ///
+    /// @param buf The host buffer to copy to. The buffer must be large enough
+    /// to hold the data.
+    /// @return The handle to wait for the copy.
+    ///
+    TensorIoHandle read_async(void *buf);
+
     /// Copy all the underlying buffer data (including padding) to a contiguous
     /// host buffer.
     ///
@@ -286,6 +340,36 @@ class Tensor {
     friend class SchedOp;
 };
 
+/// Element-wise ops that @ref Model::matmul applies on its result before
+/// writing it, so that the result is not re-read by separate ops:
+///
+///   output = activation(input x other + bias) + residual
+///
+/// which is stored in `output_type`. The epilogue is computed in the data
+/// type of the inputs, and a different `output_type` is converted into by a
+/// separate `cast` op.
+struct MatmulEpilogue {
+    MatmulEpilogue(Tensor *bias = nullptr, const std::string &activation = "",
+                   Tensor *residual = nullptr,
+                   const TensorType &output_type = NONE)
+        : bias{bias},
+          activation{activation},
+          residual{residual},
+          output_type{output_type} {}
+
+    /// Whether no op is applied.
+    bool empty() const;
+
+    /// A row vector added to every row of the result, or nullptr.
+    Tensor *bias;
+    /// "relu", "gelu", or empty for no activation.
+    std::string activation;
+    /// A tensor of the output shape added after the activation, or nullptr.
+    Tensor *residual;
+    /// Data type of the output. @ref NONE keeps the data type of the inputs.
+    TensorType output_type;
+};
+
 class Model {
    public:
     // Constructors.
@@ -384,11 +468,13 @@ class Model {
     Tensor *transpose(Tensor *input, Dims perm, Tensor *output = nullptr,
                       const std::string &name = "transpose");
     // Performs matrix multiplication between the `input` tensor and another
-    // `other` tensor, storing the result in `output`.
+    // `other` tensor, storing the result in `output`. The `epilogue` ops are
+    // applied on the result before it is stored.
     Tensor *matmul(Tensor *input, Tensor *other, Tensor *output = nullptr,
                    DimType splitk = 1, bool trans_input = false,
                    bool trans_other = false, const std::string &name = "matmul",
-                   int gran_lev = -1);
+                   int gran_lev = -1,
+                   const MatmulEpilogue &epilogue = MatmulEpilogue());
     // Implements the 'im2col' method for 2D convolution layers, which takes an
     // `input` tensor and reshapes it to a 2D matrix by extracting image patches
     // from the input tensor based on the provided parameters.
@@ -545,10 +631,28 @@ class Model {
     /// @return true if the model is valid, false otherwise.
     bool verify() const;
 
+    /// Save the graph of this model, which includes the tensors, the sharing
+    /// of @ref TensorBuf among them, and the operators with their arguments,
+    /// into a binary file. The data of the tensors is not saved.
+    /// @param path Path of the file.
+    void save(const std::string &path) const;
+
+    /// Load a graph saved by @ref save() into this model, which should be
+    /// empty and of the same rank as the saved one. This does not go through
+    /// the operator APIs, so it is much faster than building the model again.
+    /// @param path Path of the file.
+    /// @return The tensors of the model in the order of their creation, which
+    /// is the same order in which the saved model created them.
+    std::vector<Tensor *> load(const std::string &path);
+
    protected:
     class Impl;
     friend class OpGraph;
     friend class DefaultScheduler;
+    friend class GraphPass;
+    friend class GraphPassManager;
+    friend class ExecPlan;
+    friend class CpuExecutor;
 
    private:
     std::unique_ptr<Impl> impl;
@@ -558,8 +662,15 @@ class Model {
 class Executor {
    public:
     /// Constructor.
+    ///
+    /// If `plan_path` is given and the file is an execution plan saved for
+    /// the same model and GPU under the same scheduling settings, e.g.,
+    /// `ARK_DISPATCH` or `ARK_TRACE`, the model is run as the plan describes
+    /// without scheduling it again. Otherwise, the model is scheduled and the
+    /// plan is saved into `plan_path`. Ranks other than 0 use `plan_path`
+    /// followed by `.<rank>` instead.
     Executor(int rank, int world_size, Model &model, const std::string &name,
-             int num_warps_per_sm = 16);
+             int num_warps_per_sm = 16, const std::string &plan_path = "");
     ~Executor();
     /// Compile the model. This must be called before `launch()`.
     void compile();
@@ -572,14 +683,80 @@ class Executor {
     void wait();
     /// Stop the model and return the elapsed time in milliseconds.
     /// Once this is called, we need to call `launch()` again to run the model
-    /// again.
+    /// again. If `ARK_TRACE` is set, this also writes the trace of the uops
+    /// that ran since `launch()`.
     float stop();
+    /// Record the elapsed time of an iteration in milliseconds into the
+    /// tuning database (`ARK_TUNE_DB`) for the scheduling decisions of this
+    /// model. The time is split among the operators by the trace of the last
+    /// run if `ARK_TRACE` is set, or by estimates otherwise. Not available if
+    /// the executor runs a saved execution plan.
+    void record_timing(float elapsed_msec);
 
    private:
     class Impl;
     std::unique_ptr<Impl> impl_;
 };
 
+/// Runs a model on the host op by op, as a reference for the results of
+/// @ref Executor on machines without a GPU. Ops compute in FP32 and round the
+/// results to the data type of their outputs, on a pool of host threads.
+///
+/// The model is translated when this is constructed and is not referred to
+/// afterwards, so the same model may be given to an @ref Executor later,
+/// which rewrites it during scheduling. The data of tensors is in host memory
+/// owned by this object, which @ref tensor_write() and @ref tensor_read()
+/// access instead of @ref Tensor::write() and @ref Tensor::read().
+/// Communication ops, `im2col` and `max_pool` are not supported.
+class CpuExecutor {
+   public:
+    /// Constructor.
+    /// @param model The model to run.
+    /// @param num_threads Number of host threads that run the ops, or 0 for
+    /// the number of cores.
+    CpuExecutor(const Model &model, int num_threads = 0);
+    ~CpuExecutor();
+    /// Copy contiguous data from a host buffer into the data range of
+    /// @p tns, like @ref Tensor::write().
+    void tensor_write(const Tensor *tns, const void *buf);
+    /// Copy the data range of @p tns into a contiguous host buffer, like
+    /// @ref Tensor::read().
+    void tensor_read(const Tensor *tns, void *buf);
+    /// Run the model for `iter` iterations and return when they finish.
+    void run(int iter = 1);
+
+   private:
+    class Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+/// A phase of host-side work, such as scheduling or compiling a model, that
+/// has finished.
+struct HostTraceSpan {
+    /// Name of the phase.
+    std::string name;
+    /// Start and end time in seconds on a monotonic clock.
+    double start;
+    double end;
+    /// Number of phases that enclose this one on the same thread.
+    int depth;
+    /// Index of the host thread in the order that threads first recorded a
+    /// phase.
+    int thread_id;
+};
+
+/// Phases of host-side work recorded so far in this process, in the order of
+/// their start time. These cover the construction, compilation, and launch
+/// of @ref Executor and their steps.
+std::vector<HostTraceSpan> host_trace();
+
+/// Discard the phases recorded so far.
+void host_trace_clear();
+
+/// Phases recorded so far in the Chrome trace format, which Perfetto and
+/// chrome://tracing can open.
+std::string host_trace_json();
+
 class InvalidUsageError : public std::runtime_error {
    public:
     InvalidUsageError(const std::string &msg) : std::runtime_error(msg) {}
@@ -9,8 +9,11 @@
 #include "arithmetic.h"
 #include "cast.h"
 #include "comm.h"
+#include "common/trace.h"
+#include "common/work_queue.h"
 #include "copy.h"
 #include "embedding.h"
+#include "fused_ewise.h"
 #include "im2col.h"
 #include "layernorm.h"
 #include "math_functions.h"
@@ -0,0 +1,68 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#ifndef ARK_KERNELS_TRACE_H_
+#define ARK_KERNELS_TRACE_H_
+
+#include "arch.h"
+#include "device.h"
+#include "static_math.h"
+
+namespace ark {
+
+// A uop that an SM has run. The layout should be the same as
+// `GpuTraceRecord` on the host.
+struct TraceRecord {
+    // Start and end time in nanoseconds.
+    unsigned long long start;
+    unsigned long long end;
+    int opseq_id;
+    int uop_id;
+    // The first warp of the uop.
+    int warp_id;
+    // The iteration of the loop body.
+    int iter;
+};
+
+// Current time in nanoseconds, which is consistent across SMs.
+DEVICE unsigned long long trace_clock() {
+#if defined(ARK_TARGET_CUDA_ARCH)
+    unsigned long long t;
+    asm volatile("mov.u64 %0, %%globaltimer;" : "=l"(t));
+    return t;
+#elif defined(ARK_TARGET_ROCM_ARCH)
+    // The constant clock runs at 100 MHz.
+    return wall_clock64() * 10;
+#endif
+}
+
+// Run `uop(uop_id)` on a group of `NumWarps` warps and record it. Each SM
+// has a ring of `RecordsPerSm` records in `records`, and `counts` has the
+// number of records that each SM has written so far.
+//
+// The first thread of the group records the uop, so the end time does not
+// include the other warps of the group that finish later.
+template <int NumWarps, int RecordsPerSm, typename UopFunc>
+DEVICE void trace_uop(TraceRecord *records, unsigned int *counts, int iter,
+                      int opseq_id, int uop_id, UopFunc uop) {
+    constexpr int NumThreads = NumWarps * Arch::ThreadsPerWarp;
+    bool is_leader = (math::mod<NumThreads>(threadIdx.x) == 0);
+    unsigned long long start = is_leader ? trace_clock() : 0;
+    uop(uop_id);
+    if (is_leader) {
+        unsigned long long end = trace_clock();
+        unsigned int pos = atomicAdd(&counts[blockIdx.x], 1U);
+        TraceRecord &rec = records[blockIdx.x * RecordsPerSm +
+                                   math::mod<RecordsPerSm>(pos)];
+        rec.start = start;
+        rec.end = end;
+        rec.opseq_id = opseq_id;
+        rec.uop_id = uop_id;
+        rec.warp_id = warp_id();
+        rec.iter = iter;
+    }
+}
+
+}  // namespace ark
+
+#endif  // ARK_KERNELS_TRACE_H_
@@ -0,0 +1,69 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#ifndef ARK_KERNELS_WORK_QUEUE_H_
+#define ARK_KERNELS_WORK_QUEUE_H_
+
+#include "arch.h"
+#include "device.h"
+#include "static_math.h"
+#include "sync.h"
+
+namespace ark {
+
+namespace sync {
+
+struct WorkQueue {
+    // The next uop ID to grab.
+    int next;
+    // The number of groups that have found the queue empty.
+    int done;
+};
+
+}  // namespace sync
+
+// Run the uops of an opseq that are dispatched dynamically. `NumGroups`
+// groups of `NumWarps` warps share `queue`, and each group repeatedly grabs
+// `ChunkSize` consecutive uop IDs out of [0, NumUops) and runs `uop` for each
+// of them, so that groups that finish early take more uops instead of idling
+// until the next synchronization.
+//
+// `slots` has an int for each warp of the GPU, which the first warp of the
+// group uses to broadcast the grabbed ID to the other warps. The last group
+// that finds the queue empty resets it for the next iteration.
+template <int NumUops, int ChunkSize, int NumGroups, int NumWarps,
+          typename UopFunc>
+DEVICE void work_queue(sync::WorkQueue &queue, int *slots, UopFunc uop) {
+    static_assert(ChunkSize > 0, "");
+    constexpr int NumThreads = NumWarps * Arch::ThreadsPerWarp;
+    constexpr int NumWarpsPerSm = ARK_THREADS_PER_BLOCK / Arch::ThreadsPerWarp;
+    bool is_leader = (math::mod<NumThreads>(threadIdx.x) == 0);
+    volatile int *slot =
+        &slots[blockIdx.x * NumWarpsPerSm + math::gm<NumWarps>(warp_id())];
+    for (;;) {
+        // Wait until every warp of the group has read the previous ID.
+        sync_warps<NumWarps>();
+        if (is_leader) {
+            *slot = atomicAdd(&queue.next, ChunkSize);
+        }
+        sync_warps<NumWarps>();
+        int begin = *slot;
+        if (begin >= NumUops) {
+            break;
+        }
+        int end = (begin + ChunkSize < NumUops) ? begin + ChunkSize : NumUops;
+        for (int i = begin; i < end; ++i) {
+            uop(i);
+        }
+    }
+    if (is_leader && atomicAdd(&queue.done, 1) == NumGroups - 1) {
+        // No other group touches the queue until the next iteration, which
+        // starts after a `sync_gpu()` that makes the reset visible.
+        queue.next = 0;
+        queue.done = 0;
+    }
+}
+
+}  // namespace ark
+
+#endif  // ARK_KERNELS_WORK_QUEUE_H_
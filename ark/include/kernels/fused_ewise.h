@@ -0,0 +1,139 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#ifndef ARK_KERNELS_FUSED_EWISE_H_
+#define ARK_KERNELS_FUSED_EWISE_H_
+
+#include "common/broadcast.h"
+#include "math_functions.h"
+
+namespace ark {
+
+namespace fused {
+
+// Expression nodes of a fused element-wise kernel. Each node evaluates one
+// element of its result at the output coordinate (n, c, h, w) in `float`, so
+// intermediate results stay in registers.
+
+/// Element of the `Idx`-th input. Follows NumPy-style broadcasting.
+template <int Idx, typename InDims, typename InShape>
+struct In {
+    template <typename DataType>
+    static DEVICE float eval(const DataType *const *in, int n, int c, int h,
+                             int w) {
+        int idx = ((InShape::W == 1) ? 0 : w) +
+                  ((InShape::H == 1) ? 0 : h) * InDims::W +
+                  ((InShape::C == 1) ? 0 : c) * InDims::HW +
+                  ((InShape::N == 1) ? 0 : n) * InDims::CHW;
+        return type::Cast::compute<float>(in[Idx][idx]);
+    }
+};
+
+/// `Intrinsic` applied on the result of `X`.
+template <typename Intrinsic, typename X>
+struct Unary {
+    template <typename DataType>
+    static DEVICE float eval(const DataType *const *in, int n, int c, int h,
+                             int w) {
+        return Intrinsic::compute(X::eval(in, n, c, h, w));
+    }
+};
+
+/// `Intrinsic` applied on the results of `X` and `Y`.
+template <typename Intrinsic, typename X, typename Y>
+struct Binary {
+    template <typename DataType>
+    static DEVICE float eval(const DataType *const *in, int n, int c, int h,
+                             int w) {
+        return Intrinsic::compute(X::eval(in, n, c, h, w),
+                                  Y::eval(in, n, c, h, w));
+    }
+};
+
+/// The result of `X` multiplied by a constant, given as the bit pattern of
+/// a `float` because a `float` cannot be a template argument.
+template <typename X, unsigned int ValBits>
+struct Scale {
+    template <typename DataType>
+    static DEVICE float eval(const DataType *const *in, int n, int c, int h,
+                             int w) {
+        union {
+            unsigned int u;
+            float f;
+        } val{ValBits};
+        return X::eval(in, n, c, h, w) * val.f;
+    }
+};
+
+struct Relu {
+    static DEVICE float compute(float input) {
+        return type::Max::compute(input, 0.0f);
+    }
+};
+
+}  // namespace fused
+
+/// Element-wise computation of the expression `Expr` over the inputs, which
+/// are written as a single output without intermediate tensors.
+///
+/// Inputs are not deduced from the call, so all of `InDataTypes` should be
+/// given as template arguments.
+template <typename OutDims, typename OutShape, typename UnitOutDims,
+          int NumWarps, int SmemBytes, typename Expr, typename OutDataType,
+          typename... InDataTypes>
+DEVICE void fused_ewise(OutDataType *out, const InDataTypes *...in,
+                        int uop_idx, int) {
+    using UnitOp = UnitOp<OutDims, OutShape, UnitOutDims, NumWarps, SmemBytes>;
+    using InDataType = typename std::common_type<InDataTypes...>::type;
+    static_assert(sizeof...(InDataTypes) > 0, "no input");
+    static_assert((std::is_same<InDataTypes, InDataType>::value && ...),
+                  "all inputs should have the same data type");
+    constexpr int NelemPerThread =
+        DefaultNelemPerThread<OutDims, OutDataType, UnitOutDims>::value;
+    constexpr bool IsHConsec = (OutDims::W == 1 && UnitOutDims::W == 1);
+
+    const InDataType *ins[] = {in...};
+
+    int un = UnitOp::uop_idx_n(uop_idx);
+    int uc = UnitOp::uop_idx_c(uop_idx);
+    int uh = UnitOp::uop_idx_h(uop_idx);
+    int uw = UnitOp::uop_idx_w(uop_idx);
+
+    for (int tid = UnitOp::thread_id();; tid += UnitOp::NumThreads) {
+        int tid_w = (tid * NelemPerThread) % UnitOutDims::W;
+        int tid_h = ((tid * NelemPerThread) / UnitOutDims::W) % UnitOutDims::H;
+        int tid_c = ((tid * NelemPerThread) / UnitOutDims::HW) % UnitOutDims::C;
+        int tid_n = (tid * NelemPerThread) / UnitOutDims::CHW;
+
+        if (tid_n >= UnitOutDims::N) {
+            break;
+        }
+
+        int idx_n = tid_n + un * UnitOutDims::N;
+        int idx_c = tid_c + uc * UnitOutDims::C;
+        int idx_h = tid_h + uh * UnitOutDims::H;
+        int idx_w = tid_w + uw * UnitOutDims::W;
+        int idx_out = idx_w + idx_h * OutDims::W + idx_c * OutDims::HW +
+                      idx_n * OutDims::CHW;
+
+        OutDataType result[NelemPerThread];
+#pragma unroll
+        for (int i = 0; i < NelemPerThread; ++i) {
+            float val;
+            if constexpr (IsHConsec) {
+                val = Expr::eval(ins, idx_n, idx_c, idx_h + i, idx_w);
+            } else {
+                val = Expr::eval(ins, idx_n, idx_c, idx_h, idx_w + i);
+            }
+            result[i] = type::Cast::compute<OutDataType>(val);
+        }
+        ark::store<NelemPerThread * sizeof(OutDataType)>(&out[idx_out],
+                                                         result);
+    }
+
+    UnitOp::sync_threads();
+}
+
+}  // namespace ark
+
+#endif  // ARK_KERNELS_FUSED_EWISE_H_
@@ -11,6 +11,7 @@
 #include "ck/tensor_operation/gpu/device/impl/device_gemm_xdl_cshuffle.hpp"
 #include "common/checker.h"
 #include "common/unit_op.h"
+#include "gemm_epilogue.h"
 
 /// Common aliases for CK GeMM configurations.
 
@@ -509,20 +510,26 @@ struct CkGemm {
 
 ////////////////////////////////////////////////////////////////////////////////
 
-/// Row-major GeMM.
+/// Row-major GeMM. @p epilogue is applied on the output tile of @p uop_idx
+/// after the tile is written into @p C.
 template <typename DataTypeA, int LeadingDimA, bool IsColumnA,
           typename DataTypeB, int LeadingDimB, bool IsColumnB,
           typename DataTypeC, int LeadingDimC, int ProblemSizeM,
           int ProblemSizeN, int ProblemSizeK, int TileSizeM, int TileSizeN,
-          int TileSizeK, typename UnitOp>
+          int TileSizeK, typename UnitOp,
+          typename Epilogue = GemmEpilogueIdentity>
 DEVICE void gemm_ck(DataTypeC *C, DataTypeA *A, DataTypeB *B, int uop_idx,
-                    int smem_per_warp) {
+                    int smem_per_warp, const Epilogue &epilogue = Epilogue()) {
     using CkGemm =
         CkGemm<DataTypeA, LeadingDimA, IsColumnA, DataTypeB, LeadingDimB,
                IsColumnB, DataTypeC, LeadingDimC, ProblemSizeM, ProblemSizeN,
                ProblemSizeK, TileSizeM, TileSizeN, TileSizeK, UnitOp>;
     CkGemm gemm;
     gemm.Run(C, A, B, uop_idx, smem_per_warp);
+    if constexpr (!Epilogue::IsIdentity) {
+        UnitOp::sync_threads();
+        epilogue.template run<UnitOp, TileSizeM, TileSizeN>(uop_idx);
+    }
 }
 
 }  // namespace ark
@@ -22,6 +22,7 @@
 
 #include "common/checker.h"
 #include "common/unit_op.h"
+#include "gemm_epilogue.h"
 
 namespace ark {
 
@@ -964,14 +965,17 @@ DEVICE void gemm_cuda(DataTypeC *C, DataTypeA *A, DataTypeB *B, int uop_idx,
     gemm_kernel(params, *ps);
 }
 
-/// Row-major GeMM.
+/// Row-major GeMM. @p epilogue is applied on the output tile of @p uop_idx
+/// after the tile is written into @p C.
 template <typename DataTypeA, int LeadingDimA, bool IsColumnA,
           typename DataTypeB, int LeadingDimB, bool IsColumnB,
           typename DataTypeC, int LeadingDimC, int ProblemSizeM,
           int ProblemSizeN, int ProblemSizeK, int TileSizeM, int TileSizeN,
-          int TileSizeK, typename UnitOp>
+          int TileSizeK, typename UnitOp,
+          typename Epilogue = GemmEpilogueIdentity>
 DEVICE void gemm_cutlass(DataTypeC *C, DataTypeA *A, DataTypeB *B, int uop_idx,
-                         int smem_per_warp) {
+                         int smem_per_warp,
+                         const Epilogue &epilogue = Epilogue()) {
     using CutDataTypeA = typename cutlass::platform::conditional<
         std::is_same<DataTypeA, fp16>::value, cutlass::half_t,
         typename cutlass::platform::conditional<
@@ -1008,6 +1012,10 @@ DEVICE void gemm_cutlass(DataTypeC *C, DataTypeA *A, DataTypeB *B, int uop_idx,
 #else
     static_assert(false, "Unsupported CUDA arch.");
 #endif
+    if constexpr (!Epilogue::IsIdentity) {
+        UnitOp::sync_threads();
+        epilogue.template run<UnitOp, TileSizeM, TileSizeN>(uop_idx);
+    }
 }
 
 }  // namespace ark
@@ -0,0 +1,108 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#ifndef ARK_KERNELS_GEMM_EPILOGUE_H_
+#define ARK_KERNELS_GEMM_EPILOGUE_H_
+
+#include "common/unit_op.h"
+#include "math_functions.h"
+
+namespace ark {
+
+/// Activations of @ref GemmEpilogue. `ark::Gelu` can be also used.
+struct GemmActIdentity {
+    static DEVICE float compute(float input) { return input; }
+};
+
+struct GemmActRelu {
+    static DEVICE float compute(float input) {
+        return type::Max::compute(input, 0.0f);
+    }
+};
+
+/// Leaves the GeMM result as it is.
+struct GemmEpilogueIdentity {
+    static constexpr bool IsIdentity = true;
+
+    template <typename UnitOp, int TileSizeM, int TileSizeN>
+    DEVICE void run(int) const {}
+};
+
+/// Element-wise epilogue of a GeMM, which is applied on each output tile
+/// right after the tile is computed by the same threads:
+///
+///   Out = Activation(C + Bias) + Residual
+///
+/// where `Bias` is a row vector broadcast over rows. The computation is done
+/// in `float` and converted into `DataTypeOut` at last. `Out` may be the same
+/// as `C`.
+///
+/// This is not an output functor of CUTLASS or CK: those see the accumulator
+/// fragments without the coordinates needed to index `Bias` and `Residual`,
+/// so the epilogue re-reads the tile of `C` that the GeMM has just written.
+///
+/// @tparam CDims (ark::Vec) Leading dimensions of the GeMM result `C`.
+/// @tparam OutDims (ark::Vec) Leading dimensions of `Out`.
+/// @tparam ResidualDims (ark::Vec) Leading dimensions of `Residual`.
+/// @tparam OutShape (ark::Vec) Shape of `Out`, which is also the shape of `C`
+/// and `Residual`.
+/// @tparam Activation Type of the activation.
+/// @tparam HasBias (bool) Whether to add `Bias`.
+/// @tparam HasResidual (bool) Whether to add `Residual`.
+///
+template <typename CDims, typename OutDims, typename ResidualDims,
+          typename OutShape, typename Activation, bool HasBias,
+          bool HasResidual, typename DataTypeC_, typename DataTypeOut_>
+struct GemmEpilogue {
+    using DataTypeC = DataTypeC_;
+    using DataTypeOut = DataTypeOut_;
+    static constexpr bool IsIdentity = false;
+
+    DataTypeOut *out;
+    const DataTypeC *c;
+    const DataTypeC *bias;
+    const DataTypeC *residual;
+
+    DEVICE GemmEpilogue(DataTypeOut *out, const DataTypeC *c,
+                        const DataTypeC *bias, const DataTypeC *residual)
+        : out(out), c(c), bias(bias), residual(residual) {}
+
+    template <typename LDims>
+    static DEVICE int offset(int n, int ch, int h, int w) {
+        return w + h * LDims::W + ch * LDims::HW + n * LDims::CHW;
+    }
+
+    /// Applies the epilogue on the (TileSizeM x TileSizeN) tile of
+    /// @p uop_idx. Elements out of `OutShape` are skipped.
+    template <typename UnitOp, int TileSizeM, int TileSizeN>
+    DEVICE void run(int uop_idx) const {
+        int un = UnitOp::uop_idx_n(uop_idx);
+        int uc = UnitOp::uop_idx_c(uop_idx);
+        int m0 = UnitOp::uop_idx_h(uop_idx) * TileSizeM;
+        int n0 = UnitOp::uop_idx_w(uop_idx) * TileSizeN;
+        for (int i = UnitOp::thread_id(); i < TileSizeM * TileSizeN;
+             i += UnitOp::NumThreads) {
+            int m = m0 + i / TileSizeN;
+            int n = n0 + i % TileSizeN;
+            if (m >= OutShape::H || n >= OutShape::W) {
+                continue;
+            }
+            float val = type::Cast::compute<float>(
+                c[offset<CDims>(un, uc, m, n)]);
+            if constexpr (HasBias) {
+                val += type::Cast::compute<float>(bias[n]);
+            }
+            val = Activation::compute(val);
+            if constexpr (HasResidual) {
+                val += type::Cast::compute<float>(
+                    residual[offset<ResidualDims>(un, uc, m, n)]);
+            }
+            out[offset<OutDims>(un, uc, m, n)] =
+                type::Cast::compute<DataTypeOut>(val);
+        }
+    }
+};
+
+}  // namespace ark
+
+#endif  // ARK_KERNELS_GEMM_EPILOGUE_H_
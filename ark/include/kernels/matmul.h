@@ -4,6 +4,8 @@
 #ifndef ARK_KERNELS_MATMUL_H_
 #define ARK_KERNELS_MATMUL_H_
 
+#include "gemm_epilogue.h"
+
 #if defined(ARK_TARGET_CUDA_ARCH)
 #include "gemm_cutlass.h"
 #elif defined(ARK_TARGET_ROCM_ARCH)
@@ -32,14 +34,16 @@ namespace ark {
 /// @tparam IsColumnB (bool) Whether matrix B is column-major.
 /// @tparam NumWarps (int) The number of warps per uop.
 /// @tparam SmemBytes (int) The size of shared memory per uop.
+/// @tparam Epilogue (ark::GemmEpilogue) Element-wise ops applied on each
+/// output tile.
 ///
 template <typename OutDims, typename NCA, typename NCB, typename Shape,
           typename ProblemSize, typename LeadingDims, int InnerLdimA,
           int InnerLdimB, bool IsColumnA, bool IsColumnB, int NumWarps,
           int SmemBytes, typename DataTypeA, typename DataTypeB,
-          typename DataTypeC>
+          typename DataTypeC, typename Epilogue = GemmEpilogueIdentity>
 DEVICE void matmul(DataTypeC *C, DataTypeA *A, DataTypeB *B, int uop_idx,
-                   int smem_per_warp) {
+                   int smem_per_warp, const Epilogue &epilogue = Epilogue()) {
     static_assert(NCA::D2 == 1 && NCA::D3 == 1,
                   "NCA should be two dimensional.");
     static_assert(NCB::D2 == 1 && NCB::D3 == 1,
@@ -103,17 +107,40 @@ DEVICE void matmul(DataTypeC *C, DataTypeA *A, DataTypeB *B, int uop_idx,
 #if defined(ARK_TARGET_CUDA_ARCH)
     gemm_cutlass<DataTypeA, LeadingDimA, IsColumnA, DataTypeB, LeadingDimB,
                  IsColumnB, DataTypeC, LeadingDimC, ProblemSizeM, ProblemSizeN,
-                 ProblemSizeK, TileSizeM, TileSizeN, TileSizeK, UnitOp>(
-        pC, pA, pB, uop_idx, smem_per_warp);
+                 ProblemSizeK, TileSizeM, TileSizeN, TileSizeK, UnitOp,
+                 Epilogue>(pC, pA, pB, uop_idx, smem_per_warp, epilogue);
 #elif defined(ARK_TARGET_ROCM_ARCH)
     gemm_ck<DataTypeA, LeadingDimA, IsColumnA, DataTypeB, LeadingDimB,
             IsColumnB, DataTypeC, LeadingDimC, ProblemSizeM, ProblemSizeN,
-            ProblemSizeK, TileSizeM, TileSizeN, TileSizeK, UnitOp>(
-        pC, pA, pB, uop_idx, smem_per_warp);
+            ProblemSizeK, TileSizeM, TileSizeN, TileSizeK, UnitOp, Epilogue>(
+        pC, pA, pB, uop_idx, smem_per_warp, epilogue);
 #endif
     UnitOp::sync_threads();
 }
 
+/// Matrix multiplication followed by an element-wise epilogue. The product
+/// is written into @p C, and the final result into @p Out. @p Out may be the
+/// same as @p C. @p Bias and @p Residual are ignored unless @p Epilogue uses
+/// them.
+///
+/// All template arguments should be given explicitly, see the other
+/// overload for the description.
+///
+template <typename OutDims, typename NCA, typename NCB, typename Shape,
+          typename ProblemSize, typename LeadingDims, int InnerLdimA,
+          int InnerLdimB, bool IsColumnA, bool IsColumnB, int NumWarps,
+          int SmemBytes, typename DataTypeA, typename DataTypeB,
+          typename DataTypeC, typename Epilogue>
+DEVICE void matmul(typename Epilogue::DataTypeOut *Out, DataTypeA *A,
+                   DataTypeB *B, const DataTypeC *Bias,
+                   const DataTypeC *Residual, DataTypeC *C, int uop_idx,
+                   int smem_per_warp) {
+    matmul<OutDims, NCA, NCB, Shape, ProblemSize, LeadingDims, InnerLdimA,
+           InnerLdimB, IsColumnA, IsColumnB, NumWarps, SmemBytes, DataTypeA,
+           DataTypeB, DataTypeC, Epilogue>(C, A, B, uop_idx, smem_per_warp,
+                                           Epilogue{Out, C, Bias, Residual});
+}
+
 }  // namespace ark
 
 #endif  // ARK_KERNELS_MATMUL_H_
@@ -15,28 +15,44 @@ namespace ark {
 TensorBuf *Model::Impl::create_tensor_buf(const DimType bytes) {
     this->tns_bufs_storage.emplace_back(
         std::make_unique<TensorBuf>(bytes, (int)this->tns_bufs_storage.size()));
-    return this->tns_bufs_storage.back().get();
+    TensorBuf *buf = this->tns_bufs_storage.back().get();
+    this->buf_to_iter[buf] = std::prev(this->tns_bufs_storage.end());
+    return buf;
 }
 
 // Remove a TensorBuf object from the model.
 void Model::Impl::destroy_tensor_buf(const TensorBuf *buf) {
-    for (auto &tns : this->tns_storage) {
-        if (tns->buf == buf) {
-            ERR(ModelError, "dangling tensor detected");
-        }
-    }
-    bool is_found = false;
-    auto it = this->tns_bufs_storage.begin();
-    for (; it != this->tns_bufs_storage.end(); ++it) {
-        if (it->get() == buf) {
-            this->tns_bufs_storage.erase(it);
-            is_found = true;
-            break;
-        }
+    this->take_tensor_buf(buf);
+}
+
+void Model::Impl::retire_tensor_buf(const TensorBuf *buf) {
+    this->retired_bufs_storage.emplace_back(this->take_tensor_buf(buf));
+}
+
+std::unique_ptr<TensorBuf> Model::Impl::take_tensor_buf(const TensorBuf *buf) {
+    auto cnt = this->buf_num_tensors.find(buf);
+    if (cnt != this->buf_num_tensors.end() && cnt->second > 0) {
+        ERR(ModelError, "dangling tensor detected");
     }
-    if (!is_found) {
+    auto it = this->buf_to_iter.find(buf);
+    if (it == this->buf_to_iter.end()) {
         ERR(ModelError, "the given TensorBuf is not found");
     }
+    std::unique_ptr<TensorBuf> owned = std::move(*it->second);
+    this->tns_bufs_storage.erase(it->second);
+    this->buf_to_iter.erase(it);
+    if (cnt != this->buf_num_tensors.end()) {
+        this->buf_num_tensors.erase(cnt);
+    }
+    return owned;
+}
+
+Tensor *Model::Impl::store_tensor(std::unique_ptr<Tensor> tns) {
+    this->tns_storage.emplace_back(std::move(tns));
+    Tensor *tns_ptr = this->tns_storage.back().get();
+    this->tns_to_iter[tns_ptr] = std::prev(this->tns_storage.end());
+    this->buf_num_tensors[tns_ptr->buf]++;
+    return tns_ptr;
 }
 
 std::vector<Tensor *> Model::Impl::add_op(
@@ -66,6 +82,7 @@ std::vector<Tensor *> Model::Impl::add_op(Op &op) {
     this->ops_storage.emplace_back(std::make_unique<Op>(op));
 
     Op *op_ptr = this->ops_storage.back().get();
+    this->op_to_iter[op_ptr] = std::prev(this->ops_storage.end());
     for (auto &tns : op_ptr->inputs) {
         this->tns_to_users[tns].insert(op_ptr);
     }
@@ -91,11 +108,10 @@ std::vector<Tensor *> Model::Impl::add_op(Op &op) {
         // can be only one producer Op for each tensor). To avoid this,
         // we create an identical tensor and set the producer of the new tensor
         // to be the current Op.
-        this->tns_storage.emplace_back(std::make_unique<Tensor>(
+        Tensor *output_tensor = this->store_tensor(std::make_unique<Tensor>(
             tns->shape, tns->type, tns->buf, tns->ldims, tns->offs, tns->pads,
             tns->exported, tns->imported_rank, (int)this->tns_storage.size(),
             tns->name));
-        Tensor *output_tensor = this->tns_storage.back().get();
         output_tensor->buf->immutable = false;
 
         this->tns_to_producer[output_tensor] = op_ptr;
@@ -139,19 +155,6 @@ void Model::Impl::delete_op(Op *op) {
         }
         this->tns_to_producer.erase(search);
     }
-    // Remove the operator from the model.
-    bool is_found = false;
-    auto it = this->ops_storage.begin();
-    for (; it != this->ops_storage.end(); ++it) {
-        if (it->get() == op) {
-            this->ops_storage.erase(it);
-            is_found = true;
-            break;
-        }
-    }
-    if (!is_found) {
-        ERR(ModelError, "the given Op is not found");
-    }
     auto search = this->name_cnts.find(op->name);
     if (search != this->name_cnts.end()) {
         if (search->second == 1) {
@@ -161,6 +164,13 @@ void Model::Impl::delete_op(Op *op) {
         // decrease the counter to avoid conflicts when creating new operators
         // with the same name.
     }
+    // Remove the operator from the model.
+    auto it = this->op_to_iter.find(op);
+    if (it == this->op_to_iter.end()) {
+        ERR(ModelError, "the given Op is not found");
+    }
+    this->ops_storage.erase(it->second);
+    this->op_to_iter.erase(it);
 }
 
 /// Replace a @ref Tensor with another @ref Tensor.
@@ -196,9 +206,16 @@ void Model::Impl::replace_tensor(Tensor *tns, Tensor *new_tns) {
 
 /// Delete a @ref Tensor from the model.
 /// @param tns the @ref Tensor to be deleted.
-void Model::Impl::delete_tensor(Tensor *tns) {
+void Model::Impl::delete_tensor(Tensor *tns) { this->take_tensor(tns); }
+
+void Model::Impl::retire_tensor(Tensor *tns) {
+    this->retired_tns_storage.emplace_back(this->take_tensor(tns));
+}
+
+std::unique_ptr<Tensor> Model::Impl::take_tensor(Tensor *tns) {
     // Should not delete if there is any user of this tensor.
-    if (!this->is_no_user(tns)) {
+    auto users = this->tns_to_users.find(tns);
+    if (users != this->tns_to_users.end() && !users->second.empty()) {
         ERR(ModelError,
             "Cannot delete a tensor that has users. Use "
             "replace_tensor() first to replace the tensor with another one.");
@@ -210,18 +227,18 @@ void Model::Impl::delete_tensor(Tensor *tns) {
             "replace_tensor() or delete_op() first to delete the producer.");
     }
     // Remove the tensor from the model.
-    bool is_found = false;
-    auto it = this->tns_storage.begin();
-    for (; it != this->tns_storage.end(); ++it) {
-        if (it->get() == tns) {
-            this->tns_storage.erase(it);
-            is_found = true;
-            break;
-        }
-    }
-    if (!is_found) {
+    auto it = this->tns_to_iter.find(tns);
+    if (it == this->tns_to_iter.end()) {
         ERR(ModelError, "the given Tensor is not found");
     }
+    if (users != this->tns_to_users.end()) {
+        this->tns_to_users.erase(users);
+    }
+    this->buf_num_tensors[tns->buf]--;
+    std::unique_ptr<Tensor> owned = std::move(*it->second);
+    this->tns_storage.erase(it->second);
+    this->tns_to_iter.erase(it);
+    return owned;
 }
 
 std::list<TensorBuf *> Model::Impl::get_tensor_bufs() const {
@@ -248,6 +265,10 @@ std::list<Op *> Model::Impl::get_ops() const {
     return ops;
 };
 
+bool Model::Impl::has_op(const Op *op) const {
+    return this->op_to_iter.find(op) != this->op_to_iter.end();
+}
+
 // Returns the latest-declared operator that has the given tensor as its output.
 const Op *Model::Impl::get_producer(Tensor *tns) const {
     auto search = this->tns_to_producer.find(tns);
@@ -7,6 +7,7 @@
 #include <list>
 #include <map>
 #include <set>
+#include <unordered_map>
 
 #include "include/ark.h"
 #include "ops/ops_common.h"
@@ -30,6 +31,11 @@ class Model::Impl {
     /// Remove a @ref TensorBuf object from the model.
     void destroy_tensor_buf(const TensorBuf *buf);
 
+    /// Remove a @ref TensorBuf object from the model like
+    /// @ref destroy_tensor_buf, but keep the object until the model is
+    /// destroyed. The scheduler does not allocate memory for it.
+    void retire_tensor_buf(const TensorBuf *buf);
+
     /// Add a new @ref Op to the model.
     /// @param type the type of the @ref Op.
     /// @param prec_type the precision type of the @ref Op.
@@ -80,6 +86,14 @@ class Model::Impl {
     /// @param tns the @ref Tensor to be deleted.
     void delete_tensor(Tensor *tns);
 
+    /// Remove a @ref Tensor from the model like @ref delete_tensor, but keep
+    /// the object until the model is destroyed, so that the pointers that the
+    /// user holds stay valid. Graph passes retire the tensors that they
+    /// compute away. Once its buffer is retired too, the tensor has no
+    /// memory, so reading or writing it raises an error instead.
+    /// @param tns the @ref Tensor to be retired.
+    void retire_tensor(Tensor *tns);
+
     /// Get references to all @ref TensorBuf objects.
     /// @return a list of @ref TensorBuf pointers.
     std::list<TensorBuf *> get_tensor_bufs() const;
@@ -92,6 +106,10 @@ class Model::Impl {
     /// @return a list of @ref Op pointers.
     std::list<Op *> get_ops() const;
 
+    /// True if @p op is an @ref Op of this model.
+    /// @param op the @ref Op to query.
+    bool has_op(const Op *op) const;
+
     /// Get the producer @ref Op of @p tns.
     /// @param tns the @ref Tensor to query.
     const Op *get_producer(Tensor *tns) const;
@@ -138,6 +156,17 @@ class Model::Impl {
     friend class Model;
 
    private:
+    /// Take the ownership of @p tns.
+    /// @param tns the @ref Tensor to store.
+    /// @return the stored @ref Tensor.
+    Tensor *store_tensor(std::unique_ptr<Tensor> tns);
+
+    /// Remove @p buf from the model and return its ownership.
+    std::unique_ptr<TensorBuf> take_tensor_buf(const TensorBuf *buf);
+
+    /// Remove @p tns from the model and return its ownership.
+    std::unique_ptr<Tensor> take_tensor(Tensor *tns);
+
     /// Append a postfix to a name to make it unique.
     /// @param name the name to append postfix.
     /// @return the name with postfix.
@@ -145,14 +174,31 @@ class Model::Impl {
 
     /// Stores all tensor buffers.
     std::list<std::unique_ptr<TensorBuf>> tns_bufs_storage;
+    /// Maps a TensorBuf to its position in `tns_bufs_storage`.
+    std::unordered_map<const TensorBuf *,
+                       std::list<std::unique_ptr<TensorBuf>>::iterator>
+        buf_to_iter;
+    /// Number of tensors that refer to each TensorBuf.
+    std::unordered_map<const TensorBuf *, int> buf_num_tensors;
     /// Stores all tensors.
     std::list<std::unique_ptr<Tensor>> tns_storage;
+    /// Maps a tensor to its position in `tns_storage`.
+    std::unordered_map<const Tensor *,
+                       std::list<std::unique_ptr<Tensor>>::iterator>
+        tns_to_iter;
     /// Stores all Ops.
     std::list<std::unique_ptr<Op>> ops_storage;
+    /// Maps an Op to its position in `ops_storage`.
+    std::unordered_map<const Op *, std::list<std::unique_ptr<Op>>::iterator>
+        op_to_iter;
     /// Maps a tensor to its producer Op.
     std::map<Tensor *, Op *> tns_to_producer;
     /// Maps a tensor to its user Ops.
     std::map<Tensor *, std::set<Op *>> tns_to_users;
+    /// Stores the tensors and tensor buffers removed by
+    /// @ref retire_tensor and @ref retire_tensor_buf.
+    std::list<std::unique_ptr<Tensor>> retired_tns_storage;
+    std::list<std::unique_ptr<TensorBuf>> retired_bufs_storage;
     /// Count the number of tensors requested the same name.
     std::map<std::string, int> name_cnts;
 };
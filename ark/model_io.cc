@@ -0,0 +1,414 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include <array>
+#include <cstring>
+#include <type_traits>
+#include <unordered_map>
+
+#include "file_io.h"
+#include "logging.h"
+#include "model.h"
+
+namespace ark {
+
+extern const OpConfigMap Broadcast1ConfigMap;
+extern const OpConfigMap Broadcast2ConfigMap;
+extern const OpConfigMap ConfigMap;
+extern const OpConfigMap DeviceSyncConfigMap;
+extern const OpConfigMap EmbeddingConfigMap;
+extern const OpConfigMap FusedEwiseConfigMap;
+extern const OpConfigMap GatherFromPeersConfigMap;
+extern const OpConfigMap Im2colConfigMap;
+extern const OpConfigMap LayernormConfigMap;
+extern const OpConfigMap MatmulConfigMap;
+extern const OpConfigMap PacketConfigMap;
+extern const OpConfigMap ReadAndReduceConfigMap;
+extern const OpConfigMap ReduceWConfigMap;
+extern const OpConfigMap TransposeConfigMap;
+
+// File layout (little-endian, strings and lists are prefixed by their length):
+//
+//   magic "ARKM", version
+//   rank, next_eid, reduce_packet_flag, name counters
+//   TensorBufs: bytes, immutable
+//   Tensors: id, name, type, TensorBuf index, shape, ldims, offs, pads,
+//            exported, imported_rank
+//   Ops: type, prec_type, name, config map, gran_lev, force_inline,
+//        input/output/output_ref tensor indices, args
+//
+// Objects refer to each other by their indices in the file.
+static const char MODEL_FILE_MAGIC[4] = {'A', 'R', 'K', 'M'};
+// Bump this if the file layout changes.
+static const int MODEL_FILE_VERSION = 1;
+
+// Config maps are identified by name in the file, as their addresses differ
+// across processes. Add new config maps here.
+static const std::vector<std::pair<std::string, const OpConfigMap *>>
+    &config_maps() {
+    static const std::vector<std::pair<std::string, const OpConfigMap *>>
+        maps = {
+            {"broadcast1", &Broadcast1ConfigMap},
+            {"broadcast2", &Broadcast2ConfigMap},
+            {"sendrecv", &ConfigMap},
+            {"device_sync", &DeviceSyncConfigMap},
+            {"embedding", &EmbeddingConfigMap},
+            {"fused_ewise", &FusedEwiseConfigMap},
+            {"gather_from_peers", &GatherFromPeersConfigMap},
+            {"im2col", &Im2colConfigMap},
+            {"layernorm", &LayernormConfigMap},
+            {"matmul", &MatmulConfigMap},
+            {"packet", &PacketConfigMap},
+            {"read_and_reduce", &ReadAndReduceConfigMap},
+            {"reduce_w", &ReduceWConfigMap},
+            {"transpose", &TransposeConfigMap},
+        };
+    return maps;
+}
+
+static const TensorType &tensor_type_from_name(const std::string &name) {
+    static const std::vector<const TensorType *> types = {
+        &NONE, &FP32, &FP16, &BF16, &INT32, &UINT32, &INT8, &UINT8, &BYTE};
+    for (auto type : types) {
+        if (type->name() == name) {
+            return *type;
+        }
+    }
+    ERR(InvalidUsageError, "unknown tensor type ", name);
+    return NONE;
+}
+
+namespace {
+
+class ModelWriter {
+   public:
+    template <typename T>
+    void put(const T &val) {
+        static_assert(std::is_trivially_copyable<T>::value, "");
+        data_.append(reinterpret_cast<const char *>(&val), sizeof(T));
+    }
+    void put(const std::string &str) {
+        put<uint64_t>(str.size());
+        data_.append(str);
+    }
+    void put(const Dims &dims) {
+        for (int i = 0; i < DIMS_LEN; ++i) put<int64_t>(dims.data[i]);
+    }
+    const std::string &data() const { return data_; }
+
+   private:
+    std::string data_;
+};
+
+class ModelReader {
+   public:
+    ModelReader(const std::string &data, const std::string &path)
+        : data_{data}, path_{path} {}
+
+    template <typename T>
+    T get() {
+        static_assert(std::is_trivially_copyable<T>::value, "");
+        T val;
+        std::memcpy(&val, take(sizeof(T)), sizeof(T));
+        return val;
+    }
+    std::string get_str() {
+        uint64_t size = get<uint64_t>();
+        return std::string(take(size), size);
+    }
+    Dims get_dims() {
+        Dims dims;
+        for (int i = 0; i < DIMS_LEN; ++i) dims.data[i] = get<int64_t>();
+        return dims;
+    }
+    // Read a count of objects that take at least @p min_bytes each, so that
+    // a corrupted count does not cause a huge allocation.
+    size_t get_count(size_t min_bytes = 1) {
+        uint64_t cnt = get<uint64_t>();
+        if (cnt > (data_.size() - pos_) / min_bytes) {
+            ERR(InvalidUsageError, "corrupted model file ", path_);
+        }
+        return cnt;
+    }
+    bool done() const { return pos_ == data_.size(); }
+
+   private:
+    const char *take(size_t bytes) {
+        if (bytes > data_.size() - pos_) {
+            ERR(InvalidUsageError, "truncated model file ", path_);
+        }
+        const char *ptr = data_.data() + pos_;
+        pos_ += bytes;
+        return ptr;
+    }
+
+    const std::string &data_;
+    const std::string &path_;
+    size_t pos_ = 0;
+};
+
+}  // namespace
+
+void Model::save(const std::string &path) const {
+    std::unordered_map<const TensorBuf *, int64_t> buf_idx;
+    std::unordered_map<const Tensor *, int64_t> tns_idx;
+    auto tensor_index = [&tns_idx](const Tensor *tns) {
+        auto it = tns_idx.find(tns);
+        if (it == tns_idx.end()) {
+            ERR(ModelError, "tensor ", tns->name, " is not in the model");
+        }
+        return it->second;
+    };
+    ModelWriter w;
+    w.put(MODEL_FILE_MAGIC);
+    w.put<int32_t>(MODEL_FILE_VERSION);
+    w.put<int32_t>(this->impl->rank);
+    w.put<int32_t>(this->impl->next_eid);
+    w.put<uint32_t>(this->impl->reduce_packet_flag);
+    w.put<uint64_t>(this->impl->name_cnts.size());
+    for (auto &p : this->impl->name_cnts) {
+        w.put(p.first);
+        w.put<int32_t>(p.second);
+    }
+
+    w.put<uint64_t>(this->impl->tns_bufs_storage.size());
+    for (auto &buf : this->impl->tns_bufs_storage) {
+        buf_idx.emplace(buf.get(), (int64_t)buf_idx.size());
+        w.put<int64_t>(buf->bytes);
+        w.put<uint8_t>(buf->immutable);
+    }
+
+    w.put<uint64_t>(this->impl->tns_storage.size());
+    for (auto &tns : this->impl->tns_storage) {
+        tns_idx.emplace(tns.get(), (int64_t)tns_idx.size());
+        auto it = buf_idx.find(tns->buf);
+        if (it == buf_idx.end()) {
+            ERR(ModelError, "the TensorBuf of tensor ", tns->name,
+                " is not in the model");
+        }
+        w.put<int32_t>(tns->id);
+        w.put(tns->name);
+        w.put(tns->type.name());
+        w.put<int64_t>(it->second);
+        w.put(tns->shape);
+        w.put(tns->ldims);
+        w.put(tns->offs);
+        w.put(tns->pads);
+        w.put<uint8_t>(tns->exported);
+        w.put<int32_t>(tns->imported_rank);
+    }
+
+    w.put<uint64_t>(this->impl->ops_storage.size());
+    for (auto &op : this->impl->ops_storage) {
+        std::string cfg_map_name;
+        if (op->cfg_map != nullptr) {
+            for (auto &p : config_maps()) {
+                if (p.second == op->cfg_map) {
+                    cfg_map_name = p.first;
+                    break;
+                }
+            }
+            if (cfg_map_name.empty()) {
+                ERR(ModelError, "unknown config map of op ", op->name);
+            }
+        }
+        w.put<int32_t>(op->type);
+        w.put(op->prec_type);
+        w.put(op->name);
+        w.put(cfg_map_name);
+        w.put<int32_t>(op->gran_lev);
+        w.put<uint8_t>(op->force_inline);
+        for (auto tensors : {&op->inputs, &op->outputs, &op->output_refs}) {
+            w.put<uint64_t>(tensors->size());
+            for (auto tns : *tensors) w.put<int64_t>(tensor_index(tns));
+        }
+        auto &args = op->args.get_args();
+        w.put<uint64_t>(args.size());
+        for (auto &arg : args) {
+            w.put<int32_t>(arg.type);
+            switch (arg.type) {
+                case OP_ARG_INT:
+                    w.put<int32_t>(*static_cast<int *>(arg.val));
+                    break;
+                case OP_ARG_INT64:
+                    w.put<int64_t>(*static_cast<long long int *>(arg.val));
+                    break;
+                case OP_ARG_UINT64:
+                    w.put<uint64_t>(*static_cast<uint64_t *>(arg.val));
+                    break;
+                case OP_ARG_BOOL:
+                    w.put<uint8_t>(*static_cast<bool *>(arg.val));
+                    break;
+                case OP_ARG_FLOAT:
+                    w.put<float>(*static_cast<float *>(arg.val));
+                    break;
+                case OP_ARG_DIMS:
+                    w.put(*static_cast<Dims *>(arg.val));
+                    break;
+                case OP_ARG_TENSOR:
+                    w.put<int64_t>(
+                        tensor_index(static_cast<Tensor *>(arg.val)));
+                    break;
+                default:
+                    ERR(ModelError, "invalid argument type ", arg.type,
+                        " of op ", op->name);
+            }
+        }
+    }
+    write_file(path, w.data());
+    LOG(DEBUG, "saved a model of ", tns_idx.size(), " tensors and ",
+        this->impl->ops_storage.size(), " ops into ", path,
+        " (", w.data().size(), " bytes)");
+}
+
+std::vector<Tensor *> Model::load(const std::string &path) {
+    if (!this->impl->tns_bufs_storage.empty() ||
+        !this->impl->tns_storage.empty() || !this->impl->ops_storage.empty()) {
+        ERR(InvalidUsageError, "cannot load ", path, " into a non-empty model");
+    }
+    if (!is_file(path)) {
+        ERR(InvalidUsageError, "model file ", path, " does not exist");
+    }
+    const std::string data = read_file(path);
+    ModelReader r{data, path};
+    auto magic = r.get<std::array<char, 4>>();
+    if (std::memcmp(magic.data(), MODEL_FILE_MAGIC, 4) != 0) {
+        ERR(InvalidUsageError, path, " is not an ARK model file");
+    }
+    int version = r.get<int32_t>();
+    if (version != MODEL_FILE_VERSION) {
+        ERR(InvalidUsageError, "model file ", path, " is of version ", version,
+            ", but version ", MODEL_FILE_VERSION, " is expected");
+    }
+    int rank = r.get<int32_t>();
+    if (rank != this->impl->rank) {
+        ERR(InvalidUsageError, "model file ", path, " is saved by rank ", rank,
+            ", but this model is of rank ", this->impl->rank);
+    }
+    this->impl->next_eid = r.get<int32_t>();
+    this->impl->reduce_packet_flag = r.get<uint32_t>();
+    size_t num_names = r.get_count();
+    for (size_t i = 0; i < num_names; ++i) {
+        std::string name = r.get_str();
+        this->impl->name_cnts[name] = r.get<int32_t>();
+    }
+
+    std::vector<TensorBuf *> bufs(r.get_count());
+    for (auto &buf : bufs) {
+        buf = this->impl->create_tensor_buf(r.get<int64_t>());
+        buf->immutable = r.get<uint8_t>();
+    }
+
+    std::vector<Tensor *> tensors(r.get_count());
+    auto tensor_at = [&tensors, &path](int64_t idx) {
+        if (idx < 0 || idx >= (int64_t)tensors.size() ||
+            tensors[idx] == nullptr) {
+            ERR(InvalidUsageError, "corrupted model file ", path,
+                ": invalid tensor index ", idx);
+        }
+        return tensors[idx];
+    };
+    for (auto &tns : tensors) {
+        int id = r.get<int32_t>();
+        std::string name = r.get_str();
+        const TensorType &type = tensor_type_from_name(r.get_str());
+        int64_t buf_idx = r.get<int64_t>();
+        if (buf_idx < 0 || buf_idx >= (int64_t)bufs.size()) {
+            ERR(InvalidUsageError, "corrupted model file ", path,
+                ": invalid TensorBuf index ", buf_idx);
+        }
+        Dims shape = r.get_dims();
+        Dims ldims = r.get_dims();
+        Dims offs = r.get_dims();
+        Dims pads = r.get_dims();
+        bool exported = r.get<uint8_t>();
+        int imported_rank = r.get<int32_t>();
+        tns = this->impl->store_tensor(std::make_unique<Tensor>(
+            shape, type, bufs[buf_idx], ldims, offs, pads, exported,
+            imported_rank, id, name));
+    }
+
+    size_t num_ops = r.get_count();
+    for (size_t i = 0; i < num_ops; ++i) {
+        auto op = std::make_unique<Op>();
+        op->type = (OpType)r.get<int32_t>();
+        op->prec_type = r.get_str();
+        op->name = r.get_str();
+        std::string cfg_map_name = r.get_str();
+        op->cfg_map = nullptr;
+        if (!cfg_map_name.empty()) {
+            for (auto &p : config_maps()) {
+                if (p.first == cfg_map_name) {
+                    op->cfg_map = p.second;
+                    break;
+                }
+            }
+            if (op->cfg_map == nullptr) {
+                ERR(InvalidUsageError, "unknown config map ", cfg_map_name,
+                    " of op ", op->name, " in ", path);
+            }
+        }
+        op->gran_lev = r.get<int32_t>();
+        op->force_inline = r.get<uint8_t>();
+        for (auto op_tensors : {&op->inputs, &op->outputs, &op->output_refs}) {
+            op_tensors->resize(r.get_count(sizeof(int64_t)));
+            for (auto &tns : *op_tensors) tns = tensor_at(r.get<int64_t>());
+        }
+        size_t num_args = r.get_count();
+        for (size_t j = 0; j < num_args; ++j) {
+            auto type = (OpArgType)r.get<int32_t>();
+            switch (type) {
+                case OP_ARG_INT:
+                    op->args.put(OpArg((int)r.get<int32_t>()));
+                    break;
+                case OP_ARG_INT64:
+                    op->args.put(OpArg((long long int)r.get<int64_t>()));
+                    break;
+                case OP_ARG_UINT64:
+                    op->args.put(OpArg(r.get<uint64_t>()));
+                    break;
+                case OP_ARG_BOOL:
+                    op->args.put(OpArg((bool)r.get<uint8_t>()));
+                    break;
+                case OP_ARG_FLOAT:
+                    op->args.put(OpArg(r.get<float>()));
+                    break;
+                case OP_ARG_DIMS:
+                    op->args.put(OpArg(r.get_dims()));
+                    break;
+                case OP_ARG_TENSOR:
+                    op->args.put(OpArg(tensor_at(r.get<int64_t>())));
+                    break;
+                default:
+                    ERR(InvalidUsageError, "corrupted model file ", path,
+                        ": invalid argument type ", type);
+            }
+        }
+
+        // Same bookkeeping as Model::Impl::add_op(), without creating the
+        // output tensors that are already in the file.
+        this->impl->ops_storage.emplace_back(std::move(op));
+        Op *op_ptr = this->impl->ops_storage.back().get();
+        this->impl->op_to_iter[op_ptr] =
+            std::prev(this->impl->ops_storage.end());
+        for (auto tns : op_ptr->inputs) {
+            this->impl->tns_to_users[tns].insert(op_ptr);
+        }
+        for (auto tns : op_ptr->output_refs) {
+            this->impl->tns_to_users[tns].insert(op_ptr);
+        }
+        for (auto tns : op_ptr->outputs) {
+            this->impl->tns_to_producer[tns] = op_ptr;
+            this->impl->tns_to_users[tns];
+        }
+    }
+    if (!r.done()) {
+        ERR(InvalidUsageError, "corrupted model file ", path,
+            ": unexpected trailing data");
+    }
+    LOG(DEBUG, "loaded a model of ", tensors.size(), " tensors and ", num_ops,
+        " ops from ", path);
+    return tensors;
+}
+
+}  // namespace ark
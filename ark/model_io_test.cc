@@ -0,0 +1,81 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "env.h"
+#include "file_io.h"
+#include "include/ark.h"
+#include "sched/sched_exec_plan.h"
+#include "unittest/unittest_utils.h"
+
+static void build(ark::Model &m) {
+    ark::Tensor *x = m.tensor({4, 64, 128}, ark::FP16);
+    ark::Tensor *w = m.tensor({128, 256}, ark::FP16);
+    ark::Tensor *b = m.tensor({256}, ark::FP16);
+    ark::Tensor *y = m.matmul(x, w, nullptr, 1, false, false, "matmul", -1,
+                              ark::MatmulEpilogue{b, "gelu"});
+    y = m.layernorm(m.scale(y, 0.125f));
+    ark::Tensor *z = m.reshape(y, {4, 64, 16, 16});
+    z = m.transpose(z, {0, 2, 1, 3});
+    m.add(z, m.tensor({4, 16, 64, 16}, ark::FP16));
+    // Views that share a TensorBuf.
+    ark::Tensor *s = m.tensor({4, 64, 256}, ark::FP32);
+    m.tensor({2, 64, 256}, ark::FP32, s->buf, {4, 64, 256}, {2, 0, 0});
+    m.reduce_sum(s, 2);
+}
+
+ark::unittest::State test_model_io() {
+    std::string path = ark::get_env().path_tmp_dir + "/.test_model_io";
+    ark::Model m;
+    build(m);
+    m.save(path);
+
+    ark::Model m2;
+    std::vector<ark::Tensor *> tensors = m2.load(path);
+    UNITTEST_TRUE(m2.verify());
+    UNITTEST_EQ(ark::ExecPlan::model_hash(m2), ark::ExecPlan::model_hash(m));
+
+    // Tensors come in the order of their creation.
+    ark::Model m3;
+    build(m3);
+    ark::ExecPlan::ModelRef ref{m3};
+    UNITTEST_EQ(tensors.size(), ref.tensors.size());
+    for (size_t i = 0; i < tensors.size(); ++i) {
+        UNITTEST_EQ(tensors[i]->name, ref.tensors[i]->name);
+        UNITTEST_EQ(tensors[i]->shape, ref.tensors[i]->shape);
+        UNITTEST_EQ(tensors[i]->ldims, ref.tensors[i]->ldims);
+        UNITTEST_EQ(tensors[i]->offs, ref.tensors[i]->offs);
+        UNITTEST_TRUE(tensors[i]->type == ref.tensors[i]->type);
+    }
+    // So does the sharing of TensorBufs among them.
+    for (size_t i = 0; i < tensors.size(); ++i) {
+        for (size_t j = 0; j < i; ++j) {
+            UNITTEST_EQ(tensors[i]->buf == tensors[j]->buf,
+                        ref.tensors[i]->buf == ref.tensors[j]->buf);
+        }
+    }
+
+    // The loaded model can be extended like the original one.
+    m2.scale(tensors.back(), 2.0f);
+    m3.scale(ref.tensors.back(), 2.0f);
+    UNITTEST_EQ(ark::ExecPlan::model_hash(m2), ark::ExecPlan::model_hash(m3));
+
+    UNITTEST_THROW(m2.load(path), ark::InvalidUsageError);
+    ark::Model m4{1};
+    UNITTEST_THROW(m4.load(path), ark::InvalidUsageError);
+
+    std::string data = ark::read_file(path);
+    ark::write_file(path, data.substr(0, data.size() / 2));
+    ark::Model m5;
+    UNITTEST_THROW(m5.load(path), ark::InvalidUsageError);
+    ark::write_file(path, "not a model");
+    ark::Model m6;
+    UNITTEST_THROW(m6.load(path), ark::InvalidUsageError);
+    ark::remove_file(path);
+    return ark::unittest::SUCCESS;
+}
+
+int main() {
+    ark::init();
+    UNITTEST(test_model_io);
+    return 0;
+}
@@ -409,6 +409,8 @@ std::string Op::function_name(const OpConfig &cfg) const {
         case OP_GET_FROM_PACKET:
             return static_cast<const GetFromPacketOp *>(this)->function_name(
                 cfg);
+        case OP_FUSED_EWISE:
+            return static_cast<const FusedEwiseOp *>(this)->function_name(cfg);
         default:
             ERR(ModelError, "invalid op type ", this->type);
             return "";
@@ -421,6 +423,9 @@ OpArgs Op::function_call_args(const OpConfig &cfg) const {
     switch (this->type) {
         case OP_SCALE:
             return static_cast<const ScaleOp *>(this)->function_call_args(cfg);
+        case OP_MATMUL:
+            return static_cast<const MatmulOp *>(this)->function_call_args(
+                cfg);
         case OP_SEND:
             return static_cast<const SendOp *>(this)->function_call_args(cfg);
         case OP_SEND_DONE:
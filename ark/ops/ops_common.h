@@ -131,6 +131,7 @@ typedef enum {
     OP_PUT_PACKET,
     OP_REDUCE_AND_WRITE_PACKET,
     OP_GET_FROM_PACKET,
+    OP_FUSED_EWISE,
 } OpType;
 
 /// Type of hardware architecture support.
@@ -385,13 +386,27 @@ class LayernormOp : public Op {
     std::string function_name(const OpConfig &cfg) const;
 };
 
+/// Matrix multiplication, optionally followed by an epilogue that computes
+/// `mat_y = activation(mat_a x mat_b + bias) + residual`.
+///
+/// Inputs are `mat_a`, `mat_b`, and then `bias` and `residual` if they are
+/// given. The epilogue runs in place on `mat_y`, whose data type is the same
+/// as that of the inputs. Args are `nca`, `ncb`, `problem_size`,
+/// `leading_dims`, `is_column_a`, `is_column_b`, the activation (`OP_RELU`,
+/// `OP_GELU` or `OP_UNKNOWN` for none), and whether `bias` and `residual` are
+/// given.
 class MatmulOp : public Op {
    public:
     MatmulOp(const std::string &prec_type, Tensor *mat_a, Tensor *mat_b,
              Tensor *mat_y, Dims nca, Dims ncb, Dims problem_size,
              Dims leading_dims, bool is_column_a, bool is_column_b,
-             const std::string &name, int gran_lev);
+             const std::string &name, int gran_lev, Tensor *bias = nullptr,
+             OpType activation = OP_UNKNOWN, Tensor *residual = nullptr);
     std::string function_name(const OpConfig &cfg) const;
+    OpArgs function_call_args(const OpConfig &) const;
+
+    /// True if @p op is a matmul with an epilogue.
+    static bool has_epilogue(const Op &op);
 };
 
 class MaxPoolOp : public Op {
@@ -585,6 +600,24 @@ class CastOp : public Op {
     std::string function_name(const OpConfig &cfg) const;
 };
 
+/// Maximum number of inputs of a @ref FusedEwiseOp.
+const int FUSED_EWISE_MAX_INPUTS = 8;
+
+/// A chain of element-wise operators computed by a single kernel.
+///
+/// `args` is the expression in postfix order. An input is `OP_TENSOR`
+/// followed by its index in `inputs`, a scale is `OP_SCALE` followed by the
+/// scale factor, and `OP_ADD`, `OP_SUB`, `OP_MUL`, `OP_DIV`, `OP_RELU`,
+/// `OP_GELU`, `OP_SIGMOID` and `OP_EXP` take their operands from the results
+/// of the preceding terms.
+class FusedEwiseOp : public Op {
+   public:
+    FusedEwiseOp(const std::string &prec_type,
+                 const std::vector<Tensor *> &inputs, Tensor *output,
+                 const OpArgs &expr, const std::string &name);
+    std::string function_name(const OpConfig &cfg) const;
+};
+
 }  // namespace ark
 
 #endif  // ARK_OPS_COMMON_H_
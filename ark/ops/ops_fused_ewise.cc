@@ -0,0 +1,132 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include <cstring>
+#include <sstream>
+
+#include "logging.h"
+#include "model.h"
+
+namespace ark {
+
+extern const OpConfigMap FusedEwiseConfigMap;
+
+FusedEwiseOp::FusedEwiseOp(const std::string &prec_type,
+                           const std::vector<Tensor *> &inputs, Tensor *output,
+                           const OpArgs &expr, const std::string &name)
+    : Op{OP_FUSED_EWISE, prec_type, inputs, {output}, expr, name,
+         &FusedEwiseConfigMap, -1, true} {
+    if (inputs.empty() || (int)inputs.size() > FUSED_EWISE_MAX_INPUTS) {
+        ERR(ModelError, "invalid number of inputs: ", inputs.size());
+    }
+}
+
+std::string FusedEwiseOp::function_name(const OpConfig &cfg) const {
+    Tensor *output = this->outputs[0];
+
+    int ndims = output->shape.ndims();
+    OpTile tile_out = cfg.output_tiles[0];
+    if (tile_out.x < 0) tile_out.x = output->ldims.dims4()[2];
+    if (tile_out.y < 0) tile_out.y = output->ldims.dims4()[3];
+    CHECK(output->ldims[ndims - 1] % tile_out.y == 0);
+    if (ndims > 1) {
+        CHECK(output->ldims[ndims - 2] % tile_out.x == 0);
+    } else {
+        CHECK(tile_out.x == 1);
+    }
+
+    // Build the expression type from the postfix terms.
+    std::vector<std::string> stack;
+    size_t num_args = this->args.get_args().size();
+    for (size_t i = 0; i < num_args; ++i) {
+        int type;
+        this->args.get(&type, i);
+        std::stringstream ss;
+        if (type == OP_TENSOR) {
+            int idx;
+            this->args.get(&idx, ++i);
+            CHECK(idx >= 0 && idx < (int)this->inputs.size());
+            Tensor *input = this->inputs[idx];
+            ss << "ark::fused::In<" << idx << ", ark::Vec"
+               << input->ldims.dims4() << ", ark::Vec" << input->shape.dims4()
+               << ">";
+            stack.emplace_back(ss.str());
+            continue;
+        }
+        CHECK(!stack.empty());
+        std::string x = stack.back();
+        stack.pop_back();
+        if (type == OP_SCALE) {
+            float val;
+            this->args.get(&val, ++i);
+            unsigned int bits;
+            std::memcpy(&bits, &val, sizeof(bits));
+            ss << "ark::fused::Scale<" << x << ", " << bits << "u>";
+        } else if (type == OP_RELU || type == OP_GELU || type == OP_SIGMOID ||
+                   type == OP_EXP) {
+            std::string intrinsic = (type == OP_RELU)   ? "ark::fused::Relu"
+                                    : (type == OP_GELU) ? "ark::Gelu"
+                                    : (type == OP_SIGMOID)
+                                        ? "ark::Sigmoid"
+                                        : "ark::type::Exp";
+            ss << "ark::fused::Unary<" << intrinsic << ", " << x << ">";
+        } else if (type == OP_ADD || type == OP_SUB || type == OP_MUL ||
+                   type == OP_DIV) {
+            CHECK(!stack.empty());
+            std::string y = x;
+            x = stack.back();
+            stack.pop_back();
+            std::string intrinsic = (type == OP_ADD)   ? "ark::type::Add"
+                                    : (type == OP_SUB) ? "ark::type::Sub"
+                                    : (type == OP_MUL) ? "ark::type::Mul"
+                                                       : "ark::type::Div";
+            ss << "ark::fused::Binary<" << intrinsic << ", " << x << ", " << y
+               << ">";
+        } else {
+            ERR(ModelError, "unsupported op type in a fused expression: ",
+                type);
+        }
+        stack.emplace_back(ss.str());
+    }
+    CHECK(stack.size() == 1);
+
+    Dims unit_out_dims{1, 1, tile_out.x, tile_out.y};
+    std::stringstream ss;
+    ss << "ark::fused_ewise<ark::Vec" << output->ldims.dims4()  // OutDims
+       << ", ark::Vec" << output->shape.dims4()                // OutShape
+       << ", ark::Vec" << unit_out_dims                        // UnitOutDims
+       << ", " << cfg.num_warps                                // NumWarps
+       << ", " << cfg.smem_bytes                               // SmemBytes
+       << ", " << stack.back()                                 // Expr
+       << ", " << output->type.type_str();                     // OutDataType
+    for (Tensor *input : this->inputs) {
+        ss << ", " << input->type.type_str();  // InDataTypes
+    }
+    ss << ">";
+    return ss.str();
+}
+
+const OpConfigMap FusedEwiseConfigMap = {
+    {{OP_ARCH_ANY, "any"},
+     {
+         // NumWarps, SmemBytes, InDepsTiles, OutDepsTiles, SyncPre, SyncPost
+         {1, 0, std::vector<OpTile>(FUSED_EWISE_MAX_INPUTS, {1, 512}),
+          {{1, 512}}, false, false},
+         {1, 0, std::vector<OpTile>(FUSED_EWISE_MAX_INPUTS, {512, 1}),
+          {{512, 1}}, false, false},
+         {1, 0, std::vector<OpTile>(FUSED_EWISE_MAX_INPUTS, {1, 256}),
+          {{1, 256}}, false, false},
+         {1, 0, std::vector<OpTile>(FUSED_EWISE_MAX_INPUTS, {256, 1}),
+          {{256, 1}}, false, false},
+         {1, 0, std::vector<OpTile>(FUSED_EWISE_MAX_INPUTS, {1, 128}),
+          {{1, 128}}, false, false},
+         {1, 0, std::vector<OpTile>(FUSED_EWISE_MAX_INPUTS, {128, 1}),
+          {{128, 1}}, false, false},
+         {1, 0, std::vector<OpTile>(FUSED_EWISE_MAX_INPUTS, {1, 64}),
+          {{1, 64}}, false, false},
+         {1, 0, std::vector<OpTile>(FUSED_EWISE_MAX_INPUTS, {64, 1}),
+          {{64, 1}}, false, false},
+     }},
+};
+
+}  // namespace ark
@@ -0,0 +1,101 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include "include/ark.h"
+#include "ops_test_common.h"
+#include "unittest/unittest_utils.h"
+
+// out = sigmoid(relu(scale(a + b, 2)) * a), where `b` is broadcast.
+template <typename T>
+void baseline_fused_ewise(std::vector<void *> &outputs,
+                          const std::vector<ark::Dims> &output_shapes,
+                          const std::vector<void *> &inputs,
+                          const std::vector<ark::Dims> &input_shapes, int) {
+    T *out = static_cast<T *>(outputs[0]);
+    T *a = static_cast<T *>(inputs[0]);
+    T *b = static_cast<T *>(inputs[1]);
+    ark::DimType bsize = input_shapes[1].size();
+    for (ark::DimType i = 0; i < output_shapes[0].size(); ++i) {
+        float x = float(a[i]);
+        float v = (x + float(b[i % bsize])) * 2;
+        v = std::max(v, 0.0f) * x;
+        out[i] = T(1.0f / (1.0f + std::exp(-v)));
+    }
+};
+
+ark::unittest::State test_fused_ewise_fp32() {
+    ark::Model m;
+    ark::Tensor *a = m.tensor(ark::Dims(4, 2, 1024), ark::FP32);
+    ark::Tensor *b = m.tensor(ark::Dims(1024), ark::FP32);
+    ark::Tensor *t = m.relu(m.scale(m.add(a, b), 2));
+    ark::Tensor *out = m.sigmoid(m.mul(t, a));
+
+    auto result = ark::op_test("fused_ewise_fp32", m, {a, b}, {out},
+                               baseline_fused_ewise<float>);
+    UNITTEST_LOG(result);
+    UNITTEST_TRUE(result.max_diff[0] < 1e-5f);
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_fused_ewise_fp16() {
+    ark::Model m;
+    ark::Tensor *a = m.tensor(ark::Dims(4, 2, 1024), ark::FP16);
+    ark::Tensor *b = m.tensor(ark::Dims(1024), ark::FP16);
+    ark::Tensor *t = m.relu(m.scale(m.add(a, b), 2));
+    ark::Tensor *out = m.sigmoid(m.mul(t, a));
+
+    auto result = ark::op_test("fused_ewise_fp16", m, {a, b}, {out},
+                               baseline_fused_ewise<ark::half_t>);
+    UNITTEST_LOG(result);
+    UNITTEST_TRUE(result.max_diff[0] < 1e-2f);
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_fused_ewise_intermediate() {
+    // Fusion is opt-in, so the intermediate tensor `t` keeps its memory and
+    // can be read after running the model by default.
+    ark::Model m;
+    ark::Tensor *a = m.tensor(ark::Dims(4, 2, 1024), ark::FP32);
+    ark::Tensor *b = m.tensor(ark::Dims(1024), ark::FP32);
+    ark::Tensor *t = m.relu(m.scale(m.add(a, b), 2));
+    m.sigmoid(m.mul(t, a));
+
+    ark::Executor exe{0, 1, m, "test_fused_ewise_intermediate"};
+    exe.compile();
+    std::vector<float> a_data(a->shape.size());
+    std::vector<float> b_data(b->shape.size());
+    for (size_t i = 0; i < a_data.size(); ++i) {
+        a_data[i] = float(i % 13) - 6;
+    }
+    for (size_t i = 0; i < b_data.size(); ++i) {
+        b_data[i] = float(i % 7) - 3;
+    }
+    a->write(a_data.data());
+    b->write(b_data.data());
+    exe.launch();
+    exe.run(1);
+    exe.wait();
+    exe.stop();
+
+    std::vector<float> t_data(t->shape.size());
+    t->read(t_data.data());
+    for (size_t i = 0; i < t_data.size(); ++i) {
+        float v = (a_data[i] + b_data[i % b_data.size()]) * 2;
+        UNITTEST_EQ(t_data[i], std::max(v, 0.0f));
+    }
+    return ark::unittest::SUCCESS;
+}
+
+int main() {
+    ark::init();
+    UNITTEST(test_fused_ewise_intermediate);
+    ::setenv("ARK_ENABLE_GRAPH_PASSES", "ewise_fusion", 1);
+    ark::init();
+    UNITTEST(test_fused_ewise_fp32);
+    UNITTEST(test_fused_ewise_fp16);
+    return 0;
+}
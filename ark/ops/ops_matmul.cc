@@ -1,6 +1,8 @@
 // Copyright (c) Microsoft Corporation.
 // Licensed under the MIT license.
 
+#include <sstream>
+
 #include "logging.h"
 #include "math_utils.h"
 #include "model.h"
@@ -9,23 +11,65 @@ namespace ark {
 
 extern const OpConfigMap MatmulConfigMap;
 
+bool MatmulEpilogue::empty() const {
+    return this->bias == nullptr && this->activation.empty() &&
+           this->residual == nullptr && this->output_type == NONE;
+}
+
+static std::vector<Tensor *> matmul_inputs(Tensor *mat_a, Tensor *mat_b,
+                                           Tensor *bias, Tensor *residual) {
+    std::vector<Tensor *> inputs{mat_a, mat_b};
+    for (Tensor *tns : {bias, residual}) {
+        if (tns != nullptr) {
+            inputs.emplace_back(tns);
+        }
+    }
+    return inputs;
+}
+
 MatmulOp::MatmulOp(const std::string &prec_type, Tensor *mat_a, Tensor *mat_b,
                    Tensor *mat_y, Dims nca, Dims ncb, Dims problem_size,
                    Dims leading_dims, bool is_column_a, bool is_column_b,
-                   const std::string &name, int gran_lev)
+                   const std::string &name, int gran_lev, Tensor *bias,
+                   OpType activation, Tensor *residual)
     : Op{OP_MATMUL,
          prec_type,
-         {mat_a, mat_b},
+         matmul_inputs(mat_a, mat_b, bias, residual),
          {mat_y},
-         {{nca, ncb, problem_size, leading_dims, is_column_a, is_column_b}},
+         {{nca, ncb, problem_size, leading_dims, is_column_a, is_column_b,
+           (int)activation, bias != nullptr, residual != nullptr}},
          name,
          &MatmulConfigMap,
          gran_lev} {}
 
+bool MatmulOp::has_epilogue(const Op &op) {
+    if (op.type != OP_MATMUL) {
+        return false;
+    }
+    int activation;
+    op.args.get(&activation, 6);
+    return op.inputs.size() > 2 || activation != OP_UNKNOWN;
+}
+
+// Returns the bias and the residual of a matmul op.
+static void get_epilogue_tensors(const Op &op, Tensor *&bias,
+                                 Tensor *&residual) {
+    bool has_bias;
+    bool has_residual;
+    op.args.get(&has_bias, 7);
+    op.args.get(&has_residual, 8);
+    size_t idx = 2;
+    bias = has_bias ? op.inputs[idx++] : nullptr;
+    residual = has_residual ? op.inputs[idx++] : nullptr;
+}
+
 std::string MatmulOp::function_name(const OpConfig &cfg) const {
     Tensor *mat_a = this->inputs[0];
     Tensor *mat_b = this->inputs[1];
     Tensor *mat_y = this->outputs[0];
+    Tensor *bias;
+    Tensor *residual;
+    get_epilogue_tensors(*this, bias, residual);
 
     int ndims_y = mat_y->shape.ndims();
     OpTile tile_out = cfg.output_tiles[0];
@@ -79,26 +123,72 @@ std::string MatmulOp::function_name(const OpConfig &cfg) const {
     problem_size[1] = math::pad(problem_size[1], tile_out.y);
     problem_size[2] = math::pad(problem_size[2], tile_in0.y);
 
-    return Op::function_name("ark::matmul",
-                             {{
-                                 mat_y->ldims.dims4(),  // OutDims
-                                 nca,                   // NCA
-                                 ncb,                   // NCB
-                                 shape,                 // Shape
-                                 problem_size,          // ProblemSize
-                                 leading_dims,          // LeadingDims
-                                 in_ldim_a,             // InnerLdimA
-                                 in_ldim_b,             // InnerLdimB
-                                 is_column_a,           // IsColumnA
-                                 is_column_b,           // IsColumnB
-                                 cfg.num_warps,         // NumWarps
-                                 cfg.smem_bytes,        // SmemBytes
-                             }});
+    OpArgs template_args{{
+        mat_y->ldims.dims4(),  // OutDims
+        nca,                   // NCA
+        ncb,                   // NCB
+        shape,                 // Shape
+        problem_size,          // ProblemSize
+        leading_dims,          // LeadingDims
+        in_ldim_a,             // InnerLdimA
+        in_ldim_b,             // InnerLdimB
+        is_column_a,           // IsColumnA
+        is_column_b,           // IsColumnB
+        cfg.num_warps,         // NumWarps
+        cfg.smem_bytes,        // SmemBytes
+    }};
+    std::string func = Op::function_name("ark::matmul", template_args);
+    if (!MatmulOp::has_epilogue(*this)) {
+        return func;
+    }
+
+    // With an epilogue, the data types cannot be deduced from the arguments.
+    int activation;
+    this->args.get(&activation, 6);
+    std::string act = (activation == OP_RELU)   ? "ark::GemmActRelu"
+                      : (activation == OP_GELU) ? "ark::Gelu"
+                                                : "ark::GemmActIdentity";
+    Tensor *res = (residual != nullptr) ? residual : mat_y;
+    func.pop_back();
+    std::stringstream ss;
+    ss << func << ", " << mat_a->type.type_str()             // DataTypeA
+       << ", " << mat_b->type.type_str()                     // DataTypeB
+       << ", " << mat_y->type.type_str()                     // DataTypeC
+       << ", ark::GemmEpilogue<ark::Vec" << ldims_y.dims4()  // CDims
+       << ", ark::Vec" << mat_y->ldims.dims4()               // OutDims
+       << ", ark::Vec" << res->ldims.dims4()                 // ResidualDims
+       << ", ark::Vec" << mat_y->shape.dims4()               // OutShape
+       << ", " << act                                        // Activation
+       << ", " << (bias != nullptr ? "true" : "false")       // HasBias
+       << ", " << (residual != nullptr ? "true" : "false")   // HasResidual
+       << ", " << mat_y->type.type_str()                     // DataTypeC
+       << ", " << mat_y->type.type_str() << ">>";            // DataTypeOut
+    return ss.str();
+}
+
+OpArgs MatmulOp::function_call_args(const OpConfig &) const {
+    Tensor *bias;
+    Tensor *residual;
+    get_epilogue_tensors(*this, bias, residual);
+    Tensor *mat_y = this->outputs[0];
+    OpArgs opargs;
+    opargs.put(mat_y);
+    opargs.put(this->inputs[0]);
+    opargs.put(this->inputs[1]);
+    if (MatmulOp::has_epilogue(*this)) {
+        // The epilogue runs in place on `mat_y`. Unused operands are bound
+        // to `mat_y` to keep the signature.
+        opargs.put(bias != nullptr ? bias : mat_y);
+        opargs.put(residual != nullptr ? residual : mat_y);
+        opargs.put(mat_y);
+    }
+    return opargs;
 }
 
 Tensor *Model::matmul(Tensor *mat_a, Tensor *mat_b, Tensor *mat_y,
                       DimType split_k, bool trans_a, bool trans_b,
-                      const std::string &name, int gran_lev) {
+                      const std::string &name, int gran_lev,
+                      const MatmulEpilogue &epilogue) {
     CHECK(mat_a != nullptr);
     CHECK(mat_b != nullptr);
     CHECK(split_k >= 1);
@@ -190,13 +280,55 @@ Tensor *Model::matmul(Tensor *mat_a, Tensor *mat_b, Tensor *mat_y,
         output_shape = Dims{m, n};
     }
 
+    // Epilogue verification.
+    const TensorType &output_type =
+        (epilogue.output_type == NONE) ? mat_a->type : epilogue.output_type;
+    if (output_type != mat_a->type && output_type != FP32 &&
+        output_type != FP16 && output_type != BF16) {
+        ERR(InvalidUsageError, "unsupported epilogue output type: ",
+            output_type);
+    }
+    OpType activation = OP_UNKNOWN;
+    if (epilogue.activation == "relu") {
+        activation = OP_RELU;
+    } else if (epilogue.activation == "gelu") {
+        activation = OP_GELU;
+    } else if (!epilogue.activation.empty()) {
+        ERR(InvalidUsageError, "unsupported epilogue activation: ",
+            epilogue.activation);
+    }
+    Tensor *bias = epilogue.bias;
+    if (bias != nullptr) {
+        if (bias->type != mat_a->type) {
+            ERR(InvalidUsageError, "bias data type mismatch: ", bias->type,
+                " and ", mat_a->type);
+        }
+        const Dims &shp_bias = bias->shape;
+        if (shp_bias[shp_bias.ndims() - 1] != n ||
+            shp_bias.size() != (DimType)n) {
+            ERR(InvalidUsageError, "bias should be a row vector of ", n,
+                " elements: ", shp_bias);
+        }
+    }
+    Tensor *residual = epilogue.residual;
+    if (residual != nullptr) {
+        if (residual->type != mat_a->type) {
+            ERR(InvalidUsageError, "residual data type mismatch: ",
+                residual->type, " and ", mat_a->type);
+        }
+        if (residual->shape != output_shape) {
+            ERR(InvalidUsageError, "residual shape mismatch: ",
+                residual->shape, " and ", output_shape);
+        }
+    }
+
     // Create an output Tensor.
     if (mat_y == nullptr) {
-        mat_y = this->tensor(output_shape, mat_a->type);
+        mat_y = this->tensor(output_shape, output_type);
     } else {
-        if (mat_y->type != mat_a->type) {
+        if (mat_y->type != output_type) {
             ERR(InvalidUsageError, "output data type mismatch: ", mat_y->type,
-                " and ", mat_a->type);
+                " and ", output_type);
         }
         if (mat_y->shape != output_shape) {
             ERR(InvalidUsageError, "output shape mismatch: ", mat_y->shape,
@@ -204,6 +336,15 @@ Tensor *Model::matmul(Tensor *mat_a, Tensor *mat_b, Tensor *mat_y,
         }
     }
 
+    if (output_type != mat_a->type) {
+        // The GeMM writes the product only in the data type of the inputs,
+        // so the conversion runs as a separate op after the epilogue.
+        MatmulEpilogue in_type_epilogue{bias, epilogue.activation, residual};
+        Tensor *y = this->matmul(mat_a, mat_b, nullptr, split_k, trans_a,
+                                 trans_b, name, gran_lev, in_type_epilogue);
+        return this->cast(y, output_type, mat_y, name + "/cast");
+    }
+
     // TODO: change matmul interface to receive `spu` value instead of
     // `split_k`.
     DimType spu = math::pad(math::div_up(k, split_k), 32);
@@ -220,15 +361,39 @@ Tensor *Model::matmul(Tensor *mat_a, Tensor *mat_b, Tensor *mat_y,
             ldims_y[ldims_y.ndims() - 1], ldims_y[ldims_y.ndims() - 1],
             trans_b ? ldims_b[ndims_b - 2] : ldims_b[ndims_b - 1]};
         Dims problem_size{m, n, k};
-        MatmulOp op{
-            mat_y->type.name(), mat_a,        mat_b,   mat_y,   nca,  ncb,
-            problem_size,       leading_dims, trans_a, trans_b, name, gran_lev};
+        MatmulOp op{mat_a->type.name(), mat_a, mat_b, mat_y, nca, ncb,
+                    problem_size, leading_dims, trans_a, trans_b, name,
+                    gran_lev, bias, activation, residual};
         return this->impl->add_op(op)[0];
     } else if (split_k > k) {
         ERR(InvalidUsageError,
             "Split-K given larger than the K dimension size.");
     }
 
+    if (!epilogue.empty()) {
+        // Partial products are reduced after all shards are done, so the
+        // epilogue runs as separate ops. The last op writes into `mat_y`.
+        Tensor *y = this->matmul(mat_a, mat_b, nullptr, split_k, trans_a,
+                                 trans_b, name, gran_lev);
+        int num_ops = (bias != nullptr) + (activation != OP_UNKNOWN) +
+                      (residual != nullptr);
+        auto next_output = [&]() {
+            return (--num_ops == 0) ? mat_y : nullptr;
+        };
+        if (bias != nullptr) {
+            y = this->add(y, bias, next_output(), name + "/bias");
+        }
+        if (activation == OP_RELU) {
+            y = this->relu(y, next_output(), name + "/relu");
+        } else if (activation == OP_GELU) {
+            y = this->gelu(y, next_output(), name + "/gelu");
+        }
+        if (residual != nullptr) {
+            y = this->add(y, residual, next_output(), name + "/residual");
+        }
+        return y;
+    }
+
     // Split the inner dimension.
     Dims split_output_shape = output_shape;
     split_output_shape[0] *= split_k;
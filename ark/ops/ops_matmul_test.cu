@@ -2,6 +2,7 @@
 // Licensed under the MIT license.
 
 #include <cassert>
+#include <cmath>
 #include <type_traits>
 
 #include "gpu/gpu.h"
@@ -564,6 +565,47 @@ ark::unittest::State test_matmul_fp16_offset() {
     return ark::unittest::SUCCESS;
 }
 
+// out = gelu(a x b + bias) + residual, where the product and the epilogue
+// result are in fp16 and `out` is the result cast into fp32.
+void baseline_matmul_epilogue(std::vector<void *> &outputs,
+                              const std::vector<ark::Dims> &output_shapes,
+                              const std::vector<void *> &inputs,
+                              const std::vector<ark::Dims> &input_shapes,
+                              int) {
+    std::vector<ark::half_t> prod(output_shapes[0].size());
+    std::vector<void *> prod_outputs{prod.data()};
+    baseline_matmul_nn<ark::half_t>(prod_outputs, output_shapes, inputs,
+                                    input_shapes, 0);
+
+    float *out = static_cast<float *>(outputs[0]);
+    ark::half_t *bias = static_cast<ark::half_t *>(inputs[2]);
+    ark::half_t *residual = static_cast<ark::half_t *>(inputs[3]);
+    ark::DimType n = output_shapes[0].dims4()[3];
+    for (size_t i = 0; i < prod.size(); ++i) {
+        float x = float(prod[i]) + float(bias[i % n]);
+        x = 0.5f * x *
+            (1.0f + std::tanh(0.7978845608f * (x + 0.044715f * x * x * x)));
+        out[i] = float(ark::half_t(x + float(residual[i])));
+    }
+}
+
+ark::unittest::State test_matmul_fp16_epilogue() {
+    ark::Model m;
+    ark::Tensor *a = m.tensor(ark::Dims(256, 1024), ark::FP16);
+    ark::Tensor *b = m.tensor(ark::Dims(1024, 512), ark::FP16);
+    ark::Tensor *bias = m.tensor(ark::Dims(512), ark::FP16);
+    ark::Tensor *res = m.tensor(ark::Dims(256, 512), ark::FP16);
+    ark::Tensor *c = m.matmul(a, b, nullptr, 1, false, false, "matmul", -1,
+                              {bias, "gelu", res, ark::FP32});
+    UNITTEST_EQ(c->type, ark::FP32);
+
+    auto result = ark::op_test("matmul_fp16_epilogue", m, {a, b, bias, res},
+                               {c}, baseline_matmul_epilogue);
+    UNITTEST_LOG(result);
+    UNITTEST_TRUE(result.max_diff[0] < max_diff<ark::half_t>(0.1f, 1024));
+    return ark::unittest::SUCCESS;
+}
+
 ark::unittest::State test_matmul_fp16_perf() {
     {
         ark::Model m;
@@ -590,6 +632,7 @@ int main() {
     UNITTEST(test_matmul_fp16_batched);
     UNITTEST(test_matmul_fp16_batched_padded);
     UNITTEST(test_matmul_fp16_offset);
+    UNITTEST(test_matmul_fp16_epilogue);
     UNITTEST(test_matmul_fp16_perf);
 
     return ark::unittest::SUCCESS;
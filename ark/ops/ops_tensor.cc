@@ -19,7 +19,7 @@ Tensor *Model::tensor(const Dims &shape, const TensorType &ttype,
         buf = this->impl->create_tensor_buf();
     }
     int tensor_id = (int)this->impl->tns_storage.size();
-    this->impl->tns_storage.emplace_back(
+    Tensor *tns = this->impl->store_tensor(
         std::make_unique<Tensor>(shape, ttype, buf, ldims, offs, pads, exported,
                                  imported_rank, tensor_id, name));
     std::set<Tensor *> dep_set;
@@ -30,7 +30,7 @@ Tensor *Model::tensor(const Dims &shape, const TensorType &ttype,
     for (auto &dep : dep_set) {
         dep_vec.emplace_back(dep);
     }
-    TensorOp op{dep_vec, this->impl->tns_storage.back().get(), name};
+    TensorOp op{dep_vec, tns, name};
     return this->impl->add_op(op)[0];
 }
 
@@ -1,9 +1,11 @@
 // Copyright (c) Microsoft Corporation.
 // Licensed under the MIT license.
 
+#include <algorithm>
 #include <cstring>
 #include <numeric>
 
+#include "gpu/gpu_staging_pool.h"
 #include "include/ark.h"
 #include "unittest/unittest_utils.h"
 
@@ -129,9 +131,79 @@ ark::unittest::State test_tensor_layout() {
     return ark::unittest::SUCCESS;
 }
 
+ark::unittest::State test_tensor_memcpy_async() {
+    ark::Model model;
+    ark::Dims shape{2, 3, 4, 5};
+    ark::Dims ldims{9, 8, 7, 6};
+    ark::Dims offs{4, 3, 2, 1};
+    ark::Tensor *buffer = model.tensor(ldims, ark::FP32);
+    ark::Tensor *tns = model.tensor(shape, ark::FP32, buffer->buf, ldims, offs);
+
+    ark::Executor exe{0, 1, model, "test_tensor_memcpy_async"};
+    exe.compile();
+
+    std::vector<float> data(shape.size());
+    std::iota(data.begin(), data.end(), 1.0f);
+    ark::TensorIoHandle write_handle = tns->write_async(data.data());
+    // The host buffer can be reused right after the call.
+    std::fill(data.begin(), data.end(), 0.0f);
+    write_handle.wait();
+    UNITTEST_TRUE(write_handle.done());
+
+    // Reads on the copy stream are ordered after the write.
+    std::vector<float> res(shape.size(), 0.0f);
+    ark::TensorIoHandle read_handle = tns->read_async(res.data());
+    read_handle.wait();
+    for (size_t i = 0; i < res.size(); ++i) {
+        UNITTEST_EQ(res[i], (float)(i + 1));
+    }
+
+    // The synchronous read sees the same data.
+    std::vector<float> res2(shape.size(), 0.0f);
+    tns->read(res2.data());
+    UNITTEST_TRUE(res == res2);
+
+    // Handles that go out of scope wait for their copies.
+    std::vector<float> res3(shape.size(), 0.0f);
+    { tns->read_async(res3.data()); }
+    UNITTEST_TRUE(res == res3);
+
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_tensor_memcpy_async_staging() {
+    ark::Model model;
+    ark::Tensor *tns = model.tensor({1024, 1024}, ark::FP32);
+
+    ark::Executor exe{0, 1, model, "test_tensor_memcpy_async_staging"};
+    exe.compile();
+
+    // Nothing holds the pool between the calls, but the staging buffer of
+    // the first call is reused by the second one.
+    std::vector<float> data(tns->shape.size(), 1.0f);
+    tns->write_async(data.data()).wait();
+    size_t free_bytes = ark::GpuStagingPool::get_instance(0)->free_bytes();
+    UNITTEST_TRUE(free_bytes >= (size_t)tns->shape_bytes());
+    tns->read_async(data.data()).wait();
+    UNITTEST_EQ(ark::GpuStagingPool::get_instance(0)->free_bytes(),
+                free_bytes);
+
+    // A free buffer of more than twice the requested size is not taken.
+    auto pool = ark::GpuStagingPool::get_instance(0);
+    auto small = pool->acquire(1024);
+    UNITTEST_EQ(pool->free_bytes(), free_bytes);
+    auto large = pool->acquire(free_bytes);
+    UNITTEST_EQ(pool->free_bytes(), 0UL);
+    pool->release(std::move(small));
+    pool->release(std::move(large));
+    return ark::unittest::SUCCESS;
+}
+
 int main() {
     ark::init();
     UNITTEST(test_tensor_memcpy);
     UNITTEST(test_tensor_layout);
+    UNITTEST(test_tensor_memcpy_async);
+    UNITTEST(test_tensor_memcpy_async_staging);
     return ark::unittest::SUCCESS;
 }
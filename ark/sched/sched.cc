@@ -4,7 +4,11 @@
 #include "sched/sched.h"
 
 #include <algorithm>
+#include <sstream>
 
+#include "env.h"
+#include "gpu/gpu_offset_allocator.h"
+#include "host_trace.h"
 #include "logging.h"
 #include "math_utils.h"
 
@@ -12,155 +16,453 @@ using namespace std;
 
 namespace ark {
 
-BaseScheduler::BaseScheduler(Model &model, int gpu_id, int rank_,
+BaseScheduler::BaseScheduler(Model &model, int gpu_id_, int rank_,
                              int world_size_, int num_warps_per_sm_)
     : model{&model},
-      gpu_mgr{GpuManager::get_instance(gpu_id)},
+      gpu_mgr{GpuManager::get_instance(gpu_id_)},
+      gpu_info{gpu_mgr->info()},
+      gpu_id{gpu_id_},
       rank{rank_},
       world_size{world_size_},
       ctx{GpuContext::get_context(rank_, world_size_)} {
-    const GpuManager::Info &gpu_info = this->gpu_mgr->info();
-    int max_warps_per_sm =
-        (int)(gpu_info.max_threads_per_block / gpu_info.threads_per_warp);
+    this->init(num_warps_per_sm_);
+}
+
+BaseScheduler::BaseScheduler(Model &model, const GpuManager::Info &gpu_info_,
+                             int rank_, int world_size_, int num_warps_per_sm_)
+    : model{&model},
+      gpu_mgr{nullptr},
+      gpu_info{gpu_info_},
+      gpu_id{rank_ % get_env().num_ranks_per_host},
+      rank{rank_},
+      world_size{world_size_},
+      ctx{nullptr} {
+    LOG(INFO, "Plan-only scheduling for ", gpu_info_.arch, " (",
+        gpu_info_.num_sm, " SMs)");
+    this->init(num_warps_per_sm_);
+}
+
+void BaseScheduler::init(int num_warps_per_sm_) {
+    int max_warps_per_sm = (int)(this->gpu_info.max_threads_per_block /
+                                 this->gpu_info.threads_per_warp);
     this->num_warps_per_sm = std::min(num_warps_per_sm_, max_warps_per_sm);
-    this->codegen =
-        std::make_unique<CodeGenerator>(gpu_info, num_warps_per_sm_);
+    // The generated code records a trace of uops only if it is written.
+    int trace_records_per_sm = get_env().trace_path.empty()
+                                   ? 0
+                                   : get_env().trace_records_per_sm;
+    this->codegen = std::make_unique<CodeGenerator>(
+        this->gpu_info, num_warps_per_sm_, trace_records_per_sm);
+    this->cost_model = std::make_shared<AnalyticalCostModel>();
+    const std::string &tune_db_path = get_env().tune_db_path;
+    if (!tune_db_path.empty()) {
+        this->tune_db = std::make_shared<TuneDb>(tune_db_path);
+    }
+}
+
+size_t BaseScheduler::plan_shared_bufs() {
+    this->mem_planner.clear();
+    for (size_t i = 0; i < this->buf_infos.size(); ++i) {
+        const BufInfo &bi = this->buf_infos[i];
+        if (bi.gpu_id != this->gpu_id || bi.sid != -1 || bi.bytes == 0 ||
+            bi.tbuf == nullptr || bi.tbuf->buf != nullptr) {
+            continue;
+        }
+        auto it = this->buf_lifetimes.find(bi.tbuf);
+        if (it != this->buf_lifetimes.end()) {
+            this->mem_planner.add((int)i, bi.bytes, it->second.first,
+                                  it->second.second);
+        }
+    }
+    if (this->mem_planner.size() == 0) {
+        return 0;
+    }
+    size_t bytes = this->mem_planner.plan();
+    LOG(INFO, "Planned ", this->mem_planner.size(), " buffers into ", bytes,
+        " bytes of shared GPU memory (", this->mem_planner.get_naive_bytes(),
+        " bytes without sharing)");
+    return bytes;
 }
 
 // create context on gpu for the model
 std::shared_ptr<GpuContext> BaseScheduler::create_context() {
-    for (BufInfo &bi : this->buf_infos) {
+    if (this->is_plan_only()) {
+        ERR(InvalidUsageError,
+            "cannot create a GPU context in plan-only mode. Use "
+            "plan_context() instead.");
+    }
+    {
+        HostTraceScope scope{"allocate_buffers"};
+        // Buffers of disjoint lifetimes are carved out of a single region.
+        std::shared_ptr<GpuBuffer> shared_buf;
+        this->shared_bytes = this->plan_shared_bufs();
+        if (this->shared_bytes > 0) {
+            shared_buf = this->ctx->allocate_buffer(
+                this->shared_bytes, this->mem_planner.get_max_align());
+        }
+        for (size_t i = 0; i < this->buf_infos.size(); ++i) {
+            BufInfo &bi = this->buf_infos[i];
+            std::shared_ptr<GpuBuffer> buf;
+            if (bi.gpu_id == this->gpu_id) {
+                if (bi.tbuf->buf != nullptr) {
+                    // Already allocated.
+                    buf = bi.tbuf->buf;
+                    if (bi.sid != -1) {
+                        this->ctx->export_buffer(buf, bi.offset, bi.sid);
+                    }
+                } else if (this->mem_planner.has((int)i)) {
+                    size_t offset = shared_buf->get_offset() +
+                                    this->mem_planner.get_offset((int)i);
+                    buf = std::make_shared<GpuBuffer>(
+                        this->gpu_id, this->ctx->get_data_memory(),
+                        shared_buf->get_id(), offset, bi.bytes);
+                } else if (bi.sid == -1) {
+                    buf = this->ctx->allocate_buffer(bi.bytes, 1);
+                } else {
+                    // Align for RDMA performance.
+                    buf = this->ctx->allocate_buffer(bi.bytes, 65536);
+                    this->ctx->export_buffer(buf, bi.offset, bi.sid);
+                }
+            } else {
+                buf = this->ctx->import_buffer(bi.bytes, bi.gpu_id, bi.sid);
+            }
+            if (bi.tbuf != nullptr) {
+                bi.tbuf->buf = buf;
+            }
+        }
+    }
+    HostTraceScope scope{"GpuContext::freeze"};
+    this->ctx->freeze();
+    return this->ctx;
+}
+
+// Mirrors create_context() with host-only buffers. GpuBuffers created here
+// have no backing GpuMemory, so only their offsets are meaningful.
+void BaseScheduler::plan_context() {
+    GpuOffsetAllocator allocator;
+    int next_id = 0;
+    size_t shared_offset = 0;
+    this->shared_bytes = this->plan_shared_bufs();
+    if (this->shared_bytes > 0) {
+        shared_offset = allocator.allocate(next_id++, this->shared_bytes,
+                                           this->mem_planner.get_max_align());
+    }
+    for (size_t i = 0; i < this->buf_infos.size(); ++i) {
+        BufInfo &bi = this->buf_infos[i];
         std::shared_ptr<GpuBuffer> buf;
-        if (bi.gpu_id == this->gpu_mgr->get_gpu_id()) {
+        if (bi.gpu_id == this->gpu_id) {
             if (bi.tbuf->buf != nullptr) {
                 // Already allocated.
                 buf = bi.tbuf->buf;
-                if (bi.sid != -1) {
-                    this->ctx->export_buffer(buf, bi.offset, bi.sid);
-                }
-            } else if (bi.sid == -1) {
-                buf = this->ctx->allocate_buffer(bi.bytes, 1);
-            } else {
-                // Align for RDMA performance.
-                buf = this->ctx->allocate_buffer(bi.bytes, 65536);
-                this->ctx->export_buffer(buf, bi.offset, bi.sid);
+            } else if (this->mem_planner.has((int)i)) {
+                size_t offset =
+                    shared_offset + this->mem_planner.get_offset((int)i);
+                buf = std::make_shared<GpuBuffer>(this->gpu_id, nullptr, 0,
+                                                  offset, bi.bytes);
+            } else if (bi.bytes > 0) {
+                // Align for RDMA performance if exported.
+                int align = (bi.sid == -1) ? 1 : 65536;
+                int id = next_id++;
+                size_t offset = allocator.allocate(id, bi.bytes, align);
+                buf = std::make_shared<GpuBuffer>(this->gpu_id, nullptr, id,
+                                                  offset, bi.bytes);
             }
         } else {
-            buf = this->ctx->import_buffer(bi.bytes, bi.gpu_id, bi.sid);
+            buf = std::make_shared<GpuBuffer>(bi.gpu_id, nullptr, bi.sid, 0,
+                                              bi.bytes);
         }
         if (bi.tbuf != nullptr) {
             bi.tbuf->buf = buf;
         }
     }
-    this->ctx->freeze();
-    return this->ctx;
+    this->plan_total_bytes = allocator.get_total_bytes();
+    if (this->plan_total_bytes > this->gpu_info.gmem_total) {
+        ERR(SchedulerError, "out of GPU memory. Requested ",
+            this->plan_total_bytes, " bytes, available ",
+            this->gpu_info.gmem_total, " bytes");
+    }
 }
 
-const OpConfig *BaseScheduler::sched_op_config(const Op *op) {
+size_t BaseScheduler::get_total_bytes() const {
+    if (this->ctx != nullptr) {
+        return this->ctx->get_total_bytes();
+    }
+    return this->plan_total_bytes;
+}
+
+// In plan-only mode, derive the channel counts in the same way as
+// GpuCommSw::configure() would: one proxy channel per remote rank and one SM
+// channel per remote rank on the same host, if there is any data to share.
+int BaseScheduler::get_num_proxy_channels() const {
+    if (this->ctx != nullptr) {
+        return this->ctx->get_comm_sw()->get_proxy_channels_num();
+    }
+    if (this->plan_total_bytes == 0) {
+        return 0;
+    }
+    return this->world_size - 1;
+}
+
+int BaseScheduler::get_num_sm_channels() const {
+    if (this->ctx != nullptr) {
+        return this->ctx->get_comm_sw()->get_sm_channels_num();
+    }
+    if (this->plan_total_bytes == 0) {
+        return 0;
+    }
+    int num_ranks_per_host = get_env().num_ranks_per_host;
+    int host = this->rank / num_ranks_per_host;
+    int num_chans = 0;
+    for (int r = 0; r < this->world_size; ++r) {
+        if (r != this->rank && r / num_ranks_per_host == host) {
+            ++num_chans;
+        }
+    }
+    return num_chans;
+}
+
+void BaseScheduler::set_cost_model(std::shared_ptr<SchedCostModel> model) {
+    if (model == nullptr) {
+        ERR(InvalidUsageError, "cost model should not be null");
+    }
+    this->cost_model = model;
+}
+
+void BaseScheduler::set_tune_db(std::shared_ptr<TuneDb> db) {
+    this->tune_db = db;
+    this->tune_choices.clear();
+}
+
+void BaseScheduler::record_timing(double usec,
+                                  const std::map<int, double> &opseq_usec) {
+    if (this->tune_db == nullptr) {
+        ERR(InvalidUsageError,
+            "tuning database is not given. Set ARK_TUNE_DB to enable it.");
+    }
+    // Estimated cost of each op, and of each opseq and the whole model.
+    struct OpCost {
+        const Op *op;
+        int opseq_id;
+        double cost;
+    };
+    std::vector<OpCost> op_costs;
+    std::map<int, double> opseq_costs;
+    std::map<int, int> opseq_num_ops;
+    double total_cost = 0;
+    for (auto &opseq : this->opseqs) {
+        for (auto &sop : opseq->get_sched_ops()) {
+            const Op *op = sop.get_op();
+            if (sop.get_cfg() == nullptr || op->is_comm()) {
+                continue;
+            }
+            int gran_lev = this->get_gran_lev(op, *sop.get_cfg());
+            double cost = this->estimate_op(op, gran_lev).cost;
+            op_costs.push_back({op, opseq->get_id(), cost});
+            opseq_costs[opseq->get_id()] += cost;
+            opseq_num_ops[opseq->get_id()]++;
+            total_cost += cost;
+        }
+    }
+    // Time of each op that a decision applies to, where the ops that replace
+    // a split matmul count as one.
+    std::map<std::string, std::map<std::string, double>> key_usec;
+    for (auto &oc : op_costs) {
+        double op_usec;
+        auto it = opseq_usec.find(oc.opseq_id);
+        if (it != opseq_usec.end()) {
+            double opseq_cost = opseq_costs[oc.opseq_id];
+            op_usec = (opseq_cost > 0)
+                          ? it->second * oc.cost / opseq_cost
+                          : it->second / opseq_num_ops[oc.opseq_id];
+        } else {
+            op_usec = (total_cost > 0) ? usec * oc.cost / total_cost
+                                       : usec / op_costs.size();
+        }
+        std::string key = TuneDb::key(*oc.op, this->gpu_info.arch);
+        if (this->tune_choices.count(key) > 0) {
+            key_usec[key][oc.op->name] += op_usec;
+        }
+        for (auto &p : this->tune_split_keys) {
+            if (oc.op->name.compare(0, p.first.size() + 1, p.first + "/") ==
+                0) {
+                key_usec[p.second][p.first] += op_usec;
+            }
+        }
+    }
+    int num_records = 0;
+    for (auto &p : this->tune_choices) {
+        auto it = key_usec.find(p.first);
+        if (it == key_usec.end()) {
+            // The ops of this decision are rewritten into others.
+            LOG(DEBUG, "no op to time for tuning key ", p.first);
+            continue;
+        }
+        double sum = 0;
+        for (auto &op_usec : it->second) {
+            sum += op_usec.second;
+        }
+        this->tune_db->record(p.first, p.second, sum / it->second.size());
+        ++num_records;
+    }
+    this->tune_db->save();
+    LOG(DEBUG, "recorded ", num_records, " decisions into ",
+        this->tune_db->get_path());
+}
+
+const std::vector<OpConfig> *BaseScheduler::get_op_configs(const Op *op) const {
     if (op == nullptr || op->outputs.size() == 0) {
         ERR(SchedulerError, "unexpected error");
     }
-    Tensor *output = op->outputs[0];
-    if (output == nullptr || op->cfg_map == nullptr) {
+    if (op->outputs[0] == nullptr || op->cfg_map == nullptr) {
         return nullptr;
     }
-    const GpuManager::Info &gpu_info = this->gpu_mgr->info();
-    OpArchType arch_type = op_arch_from_string(gpu_info.arch);
+    OpArchType arch_type = op_arch_from_string(this->gpu_info.arch);
     if (arch_type == OP_ARCH_UNKNOWN) {
-        ERR(SchedulerError, "unsupported GPU architecture ", gpu_info.arch,
-            " for op: ", op->name);
+        ERR(SchedulerError, "unsupported GPU architecture ",
+            this->gpu_info.arch, " for op: ", op->name);
     }
     auto &configs = op->cfg_map->get({arch_type, op->prec_type});
     if (configs.empty()) {
         ERR(SchedulerError, "no config found for op: ", op->name,
             ", arch_type: ", arch_type, ", prec_type: ", op->prec_type);
     }
-    if (op->gran_lev >= 0) {
-        if (configs.size() > (unsigned int)op->gran_lev) {
-            return &configs[op->gran_lev];
-        }
-        ERR(SchedulerError, "invalid granularity level: ", op->gran_lev);
-    }
-    std::vector<const OpConfig *> feasible_configs;
-    for (auto &cfg : configs) {
-        if (cfg.num_warps <= this->num_warps_per_sm &&
-            cfg.smem_bytes <= gpu_info.smem_block_total) {
-            feasible_configs.push_back(&cfg);
-        }
+    return &configs;
+}
+
+std::vector<SchedOpCandidate> BaseScheduler::rank_op_configs(
+    const Op *op) const {
+    const std::vector<OpConfig> *configs = this->get_op_configs(op);
+    if (configs == nullptr) {
+        return {};
     }
-    // Heuristic auto-selection of granularity level
-    Dims shape4 = output->shape.dims4();
+    const GpuManager::Info &gpu_info = this->gpu_info;
+    Tensor *output = op->outputs[0];
     Dims ldims4 = output->ldims.dims4();
-    DimType shape_x = shape4[2];
-    DimType shape_y = shape4[3];
-    std::vector<std::tuple<const OpConfig *, Dims, int>> config_candidates;
-    for (auto &cfg : feasible_configs) {
-        assert(cfg->output_tiles.size() > 0);
-        const OpTile &ot = cfg->output_tiles[0];
+    std::vector<SchedOpCandidate> candidates;
+    std::stringstream configs_str;
+    for (int i = 0; i < (int)configs->size(); ++i) {
+        const OpConfig &cfg = (*configs)[i];
+        if (cfg.num_warps > this->num_warps_per_sm ||
+            cfg.smem_bytes > gpu_info.smem_block_total) {
+            continue;
+        }
+        assert(cfg.output_tiles.size() > 0);
+        const OpTile &ot = cfg.output_tiles[0];
         DimType ot_x = (ot.x == -1) ? ldims4[2] : ot.x;
         DimType ot_y = (ot.y == -1) ? ldims4[3] : ot.y;
+        configs_str << ((configs_str.tellp() > 0) ? ", { " : "{ ") << ot_x
+                    << ", " << ot_y << " }";
         if (output->shape.ndims() == 1 && ot_x != 1) {
             // Output is 1D, but tile is 2D. Cannot use this tile shape.
             continue;
         }
-        DimType num_tiles = shape4[0] * shape4[1];
-        num_tiles *= math::div_up(shape_x, ot_x);
-        num_tiles *= math::div_up(shape_y, ot_y);
-
-        // This config is OK to use
-        config_candidates.emplace_back(cfg, Dims(ot_x, ot_y), num_tiles);
+        candidates.emplace_back(this->estimate_op(op, i));
     }
-    if (config_candidates.empty()) {
-        stringstream configs_str;
-        if (feasible_configs.size() > 0) {
-            const OpTile &ot = feasible_configs[0]->output_tiles[0];
-            DimType ot_x = (ot.x == -1) ? ldims4[2] : ot.x;
-            DimType ot_y = (ot.y == -1) ? ldims4[3] : ot.y;
-            configs_str << "{ " << ot_x << ", " << ot_y << " }";
-        }
-        for (int i = 1; i < (int)feasible_configs.size(); ++i) {
-            const OpTile &ot = feasible_configs[i]->output_tiles[0];
-            DimType ot_x = (ot.x == -1) ? ldims4[2] : ot.x;
-            DimType ot_y = (ot.y == -1) ? ldims4[3] : ot.y;
-            configs_str << ", { " << ot_x << ", " << ot_y << " }";
-        }
+    if (candidates.empty()) {
         configs_str << ".";
         ERR(SchedulerError, "no valid tile configuration found. Output shape ",
             output->shape, ", available tiles: ", configs_str.str());
     }
-    std::vector<std::tuple<const OpConfig *, Dims, int>>
-        high_priority_candidates;
-    int min_wps = gpu_info.min_threads_per_block / gpu_info.threads_per_warp;
-    int target_concurrent_num_warps = min_wps * gpu_info.num_sm;
-    for (auto &c : config_candidates) {
-        auto &cfg = std::get<0>(c);
-        auto &tile = std::get<1>(c);
-        auto &num_tiles = std::get<2>(c);
-
-        if ((shape_x < tile[0]) || (shape_y < tile[1])) {
-            // too large tile.
-            continue;
+    // Ties are broken in favor of fewer warps in total, and then smaller
+    // tiles.
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [](const SchedOpCandidate &a, const SchedOpCandidate &b) {
+                         if (a.cost != b.cost) {
+                             return a.cost < b.cost;
+                         }
+                         DimType warps_a = a.num_tiles * a.cfg->num_warps;
+                         DimType warps_b = b.num_tiles * b.cfg->num_warps;
+                         if (warps_a != warps_b) {
+                             return warps_a < warps_b;
+                         }
+                         return a.tile_x * a.tile_y < b.tile_x * b.tile_y;
+                     });
+    return candidates;
+}
+
+SchedOpCandidate BaseScheduler::estimate_op(const Op *op, int gran_lev) const {
+    const OpConfig &cfg = (*this->get_op_configs(op))[gran_lev];
+    Tensor *output = op->outputs[0];
+    Dims shape4 = output->shape.dims4();
+    Dims ldims4 = output->ldims.dims4();
+    const OpTile &ot = cfg.output_tiles[0];
+    SchedOpCandidate cand;
+    cand.cfg = &cfg;
+    // Set before estimating, as a cost model may depend on it.
+    cand.gran_lev = gran_lev;
+    cand.tile_x = (ot.x == -1) ? ldims4[2] : ot.x;
+    cand.tile_y = (ot.y == -1) ? ldims4[3] : ot.y;
+    cand.num_tiles = shape4[0] * shape4[1] *
+                     math::div_up(shape4[2], cand.tile_x) *
+                     math::div_up(shape4[3], cand.tile_y);
+    this->cost_model->estimate(*op, this->gpu_info, this->num_warps_per_sm,
+                               cand);
+    return cand;
+}
+
+int BaseScheduler::get_gran_lev(const Op *op, const OpConfig &cfg) const {
+    return (int)(&cfg - this->get_op_configs(op)->data());
+}
+
+std::string BaseScheduler::dump_op_configs(const Op *op) const {
+    std::stringstream ss;
+    ss << op->name << " (" << op->prec_type << ", output "
+       << op->outputs[0]->shape << ")\n";
+    for (auto &cand : this->rank_op_configs(op)) {
+        ss << "  " << cand << "\n";
+    }
+    return ss.str();
+}
+
+const OpConfig *BaseScheduler::sched_op_config(const Op *op) {
+    const std::vector<OpConfig> *configs = this->get_op_configs(op);
+    if (configs == nullptr) {
+        return nullptr;
+    }
+    const OpConfig *cfg = nullptr;
+    std::string tune_key;
+    if (op->gran_lev >= 0) {
+        if (configs->size() <= (unsigned int)op->gran_lev) {
+            ERR(SchedulerError, "invalid granularity level: ", op->gran_lev);
+        }
+        cfg = &(*configs)[op->gran_lev];
+    }
+    if (this->tune_db != nullptr) {
+        tune_key = TuneDb::key(*op, this->gpu_info.arch);
+        TuneChoice tuned;
+        auto it = this->tune_choices.find(tune_key);
+        bool found = false;
+        if (it != this->tune_choices.end() && it->second.gran_lev >= 0) {
+            // Ops of the same key get the same decision.
+            tuned = it->second;
+            found = true;
+        } else if (cfg == nullptr && get_env().tune_explore) {
+            int split_k = (it != this->tune_choices.end()) ? it->second.split_k
+                                                           : 0;
+            std::vector<TuneChoice> candidates;
+            for (auto &cand : this->rank_op_configs(op)) {
+                candidates.push_back({cand.gran_lev, split_k});
+            }
+            found = this->tune_db->explore(tune_key, candidates, tuned);
         }
-        auto num_total_warps = num_tiles * cfg->num_warps;
-        if (num_total_warps >= target_concurrent_num_warps / 2) {
-            high_priority_candidates.push_back(c);
-        }
-    }
-    auto &candidates = high_priority_candidates.empty()
-                           ? config_candidates
-                           : high_priority_candidates;
-
-    std::sort(candidates.begin(), candidates.end(),
-              [](const std::tuple<const OpConfig *, Dims, int> &a,
-                 const std::tuple<const OpConfig *, Dims, int> &b) {
-                  int num_tiles_a = std::get<2>(a) * std::get<0>(a)->num_warps;
-                  int num_tiles_b = std::get<2>(b) * std::get<0>(b)->num_warps;
-                  if (num_tiles_a == num_tiles_b) {
-                      return std::get<1>(a).size() < std::get<1>(b).size();
-                  }
-                  return (num_tiles_a < num_tiles_b);
-              });
-    return std::get<0>(candidates[0]);
+        if (!found) {
+            found = this->tune_db->lookup(tune_key, tuned);
+        }
+        if (cfg == nullptr && found && tuned.gran_lev >= 0 &&
+            tuned.gran_lev < (int)configs->size()) {
+            const OpConfig &tuned_cfg = (*configs)[tuned.gran_lev];
+            if (tuned_cfg.num_warps <= this->num_warps_per_sm &&
+                tuned_cfg.smem_bytes <= this->gpu_info.smem_block_total) {
+                cfg = &tuned_cfg;
+            }
+        }
+    }
+    if (cfg == nullptr) {
+        cfg = this->rank_op_configs(op)[0].cfg;
+    }
+    if (this->tune_db != nullptr) {
+        this->tune_choices[tune_key].gran_lev = this->get_gran_lev(op, *cfg);
+    }
+    return cfg;
 }
 
 }  // namespace ark
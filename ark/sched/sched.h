@@ -4,10 +4,17 @@
 #ifndef ARK_SCHED_H_
 #define ARK_SCHED_H_
 
+#include <list>
+
 #include "include/ark.h"
 #include "sched/sched_codegen.h"
+#include "sched/sched_cost.h"
+#include "sched/sched_memory.h"
 #include "sched/sched_opgraph.h"
+#include "sched/sched_pass.h"
+#include "sched/sched_sim.h"
 #include "sched/sched_stream.h"
+#include "sched/sched_tune.h"
 
 namespace ark {
 
@@ -35,58 +42,223 @@ struct BufInfo {
 
 class BaseScheduler {
    public:
-    BaseScheduler(Model &model, int gpu_id, int rank_, int world_size_,
+    BaseScheduler(Model &model, int gpu_id_, int rank_, int world_size_,
                   int num_warps_per_sm_ = 16);
 
+    /// Construct a plan-only scheduler that targets the device described by
+    /// @p gpu_info_ without touching any GPU. Scheduling and code generation
+    /// work as usual, but @ref create_context() is not available; use
+    /// @ref plan_context() to lay out the buffers instead.
+    BaseScheduler(Model &model, const GpuManager::Info &gpu_info_, int rank_,
+                  int world_size_, int num_warps_per_sm_ = 16);
+
     // create context on gpu for the model
     std::shared_ptr<GpuContext> create_context();
 
+    /// Assign offsets to all GPU buffers exactly as @ref create_context()
+    /// would, but without allocating any device memory.
+    void plan_context();
+
+    /// Return true if this scheduler runs without a GPU.
+    bool is_plan_only() const { return this->gpu_mgr == nullptr; }
+
+    /// Total bytes of the local GPU data buffer.
+    size_t get_total_bytes() const;
+
+    const GpuManager::Info &get_gpu_info() const { return this->gpu_info; }
+    int get_num_warps_per_sm() const { return this->num_warps_per_sm; }
+    const std::vector<std::unique_ptr<SchedOpSeq>> &get_opseqs() const {
+        return this->opseqs;
+    }
+    const std::vector<BufInfo> &get_buf_infos() const {
+        return this->buf_infos;
+    }
+
+    /// Lifetimes of the local buffers that may share memory with each other,
+    /// as inclusive ranges of execution steps. Empty unless
+    /// `ARK_REUSE_BUFFERS` is set.
+    const std::map<TensorBuf *, std::pair<int, int>> &get_buf_lifetimes()
+        const {
+        return this->buf_lifetimes;
+    }
+
+    /// Layout of the buffers in @ref get_buf_lifetimes, which is decided by
+    /// @ref create_context() or @ref plan_context().
+    const SchedMemoryPlanner &get_memory_planner() const {
+        return this->mem_planner;
+    }
+
+    /// Select the @ref OpConfig of @p op. Unless the granularity level of
+    /// @p op is given, this is the candidate of the minimum estimated cost.
     const OpConfig *sched_op_config(const Op *op);
 
+    /// Feasible configurations of @p op sorted by the estimated cost.
+    std::vector<SchedOpCandidate> rank_op_configs(const Op *op) const;
+
+    /// Estimate the cost of running @p op with its config at the granularity
+    /// level @p gran_lev.
+    SchedOpCandidate estimate_op(const Op *op, int gran_lev) const;
+
+    /// Granularity level of @p cfg, one of the configs of @p op.
+    int get_gran_lev(const Op *op, const OpConfig &cfg) const;
+
+    /// Human-readable list of @ref rank_op_configs for inspection.
+    std::string dump_op_configs(const Op *op) const;
+
+    /// Replace the cost model that ranks configurations. The default is
+    /// @ref AnalyticalCostModel. Ops that the constructor has already
+    /// optimized for the default model are not revisited.
+    void set_cost_model(std::shared_ptr<SchedCostModel> model);
+
+    /// Use @p db to look up and record scheduling decisions, instead of the
+    /// database given by `ARK_TUNE_DB`. This should be called before
+    /// @ref schedule().
+    void set_tune_db(std::shared_ptr<TuneDb> db);
+
+    /// Record the time of the scheduling decisions made so far into the
+    /// tuning database and save it, given that an iteration of this model
+    /// took @p usec microseconds. The time of each opseq is taken from
+    /// @p opseq_usec, indexed by the opseq ID, if given, or is a share of
+    /// @p usec by the estimated costs of the opseqs otherwise. An opseq's
+    /// time is split among its ops by their estimated costs, and each
+    /// decision is recorded with the average time of the ops that it
+    /// applies to. The ops that replace a split matmul count as one op.
+    void record_timing(double usec,
+                       const std::map<int, double> &opseq_usec = {});
+
     virtual void schedule() = 0;
 
     //
     virtual std::vector<std::string> gen_code() = 0;
 
    protected:
+    // Number of proxy channels and SM channels that the generated code
+    // should declare.
+    int get_num_proxy_channels() const;
+    int get_num_sm_channels() const;
+
+    // Configurations of @p op for the target GPU, or nullptr if @p op does
+    // not need any.
+    const std::vector<OpConfig> *get_op_configs(const Op *op) const;
+
     Model *model;
     std::shared_ptr<GpuManager> gpu_mgr;
+    // gpu_mgr is nullptr in plan-only mode, so use these instead.
+    GpuManager::Info gpu_info;
+    int gpu_id;
     int rank;
     int world_size;
     std::shared_ptr<GpuContext> ctx;
     int num_warps_per_sm;
     std::unique_ptr<CodeGenerator> codegen;
+    std::shared_ptr<SchedCostModel> cost_model;
+    // nullptr if tuning is disabled.
+    std::shared_ptr<TuneDb> tune_db;
+    // Decisions made by this scheduler, keyed by TuneDb::key().
+    std::map<std::string, TuneChoice> tune_choices;
+    // Keys of the matmuls split by this scheduler, by the name of the
+    // original op. The ops that replace a matmul are named under it.
+    std::map<std::string, std::string> tune_split_keys;
 
     std::vector<std::unique_ptr<SchedOpSeq>> opseqs;
 
     // the information of the GPU buffers
     std::vector<BufInfo> buf_infos;
+    // total bytes of the buffer layout in plan-only mode
+    size_t plan_total_bytes = 0;
+    // bytes of the region shared by buffers of disjoint lifetimes
+    size_t shared_bytes = 0;
+    // lifetimes of the buffers that may share memory, filled by schedule()
+    std::map<TensorBuf *, std::pair<int, int>> buf_lifetimes;
+    SchedMemoryPlanner mem_planner;
+
+   private:
+    friend class ExecPlan;
+
+    void init(int num_warps_per_sm_);
+    // Plan the offsets of the buffers in buf_lifetimes inside a shared
+    // region. Returns the bytes of the region.
+    size_t plan_shared_bufs();
 };
 
 class DefaultScheduler : public BaseScheduler {
    public:
     DefaultScheduler(Model &model, int gpu_id, int rank_, int world_size_,
                      int num_warps_per_sm = 16);
+    DefaultScheduler(Model &model, const GpuManager::Info &gpu_info,
+                     int rank_, int world_size_, int num_warps_per_sm = 16);
 
     std::vector<std::string> gen_code();
     void schedule();
 
+    const std::vector<std::unique_ptr<SchedStream>> &get_comp_stream() const {
+        return this->comp_stream;
+    }
+    /// Communication streams of each stage, one for each range of
+    /// communication SMs.
+    const std::vector<std::vector<std::unique_ptr<SchedStream>>>
+        &get_comm_stream() const {
+        return this->comm_stream;
+    }
+    /// Opseqs that are dispatched through device-side work queues, chosen by
+    /// @ref schedule().
+    const std::map<int, SchedWorkQueue> &get_work_queues() const {
+        return this->work_queues;
+    }
+    /// Number of SMs for computation, which are the first SMs of the GPU.
+    int get_num_sm_comp() const { return this->num_sm_comp; }
+    /// Number of SMs for communication, which are the last SMs of the GPU.
+    int get_num_sm_comm() const { return this->num_sm_comm; }
+    /// Number of communication streams that run concurrently on disjoint
+    /// ranges of the communication SMs.
+    int get_num_comm_streams() const { return this->num_comm_streams; }
+    /// SM range [begin, end) of the communication stream @p stream_id.
+    std::pair<int, int> get_comm_sm_range(int stream_id) const;
+    /// Graph passes applied to the model by the constructor, with the
+    /// statistics of their run.
+    const GraphPassManager &get_graph_passes() const {
+        return this->graph_passes;
+    }
+    /// Estimated fraction of time that the computation SMs are idle at the
+    /// end of each stream, waiting for the busiest SM, according to the
+    /// cost model. Available after @ref schedule().
+    double get_sm_idle_ratio() const;
+    /// Estimated time of a uop of @p opseq in microseconds according to the
+    /// cost model.
+    double get_uop_cost(const SchedOpSeq &opseq) const;
+
    protected:
     void configure_gpu_buf(const std::list<Tensor *> &model_tensors);
     void heuristic_optimize_model(Model &model, Model::Impl *model_impl,
                                   const GpuManager::Info &gpu_info, int num_sm);
-    void heuristic_optimize_matmul(Model &model, Model::Impl *model_impl,
+    bool heuristic_optimize_matmul(Model &model, Model::Impl *model_impl,
                                    Op &matmul_op,
                                    const GpuManager::Info &gpu_info,
                                    int num_sm);
+    TuneChoice explore_matmul(const Op &matmul_op,
+                              const std::string &tune_key);
 
    private:
-    void recursive_schedule(std::list<OpNode *> &nodes,
-                            std::set<OpNode *> &seen_nodes);
+    void init(Model &model);
+    // Set the split of SMs between computation and communication.
+    void set_num_sm_comm(Model &model);
+    // Communication stream that runs @p op.
+    int get_comm_stream_id(const Op &op) const;
+    void schedule_nodes(const std::vector<OpNode *> &root_nodes);
+    void set_buf_lifetimes();
+    void set_work_queues();
+    // Estimated time from the start of each op to the end of the model.
+    std::map<const Op *, double> get_op_priorities();
 
+    GraphPassManager graph_passes;
+    SchedPolicy policy;
     std::unique_ptr<OpGraph> op_graph;
     std::vector<std::unique_ptr<SchedStream>> comp_stream;
-    std::vector<std::unique_ptr<SchedStream>> comm_stream;
+    std::vector<std::vector<std::unique_ptr<SchedStream>>> comm_stream;
+    int num_sm_comp;
+    int num_sm_comm;
+    int num_comm_streams;
+    std::map<int, SchedWorkQueue> work_queues;
 };
 
 }  // namespace ark
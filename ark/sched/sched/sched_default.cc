@@ -1,11 +1,19 @@
 // Copyright (c) Microsoft Corporation.
 // Licensed under the MIT license.
 
+#include <algorithm>
+#include <climits>
+#include <set>
+#include <sstream>
+#include <thread>
+
 #include "env.h"
+#include "host_trace.h"
 #include "logging.h"
 #include "math_utils.h"
 #include "model.h"
 #include "sched/sched.h"
+#include "sched/sched_fusion.h"
 
 using namespace std;
 
@@ -17,8 +25,46 @@ using namespace std;
         }                            \
     } while (0);
 
+// Bytes sent per iteration for each communication SM, when the number of
+// communication SMs is chosen automatically.
+#define COMM_BYTES_PER_SM (32UL << 20)
+
+// Number of times that each warp group grabs uops from a work queue if the
+// uops were spread evenly.
+#define WORK_QUEUE_GRABS_PER_GROUP 4
+
+// Minimum number of opseq functions in each translation unit of the generated
+// code, when the number of translation units is chosen automatically.
+#define MIN_CODE_UNITS_PER_SHARD 64
+
 namespace ark {
 
+/// Code of an opseq function, which is shared by @ref opseqs if
+/// @ref shared_id is not negative.
+struct CodeUnit {
+    std::string code;
+    std::set<int> uop_ids;
+    int shared_id = -1;
+    std::vector<const SchedOpSeq *> opseqs;
+};
+
+/// Number of translation units to split @p num_units opseq functions into.
+static int get_num_code_shards(int num_units) {
+#if defined(ARK_ROCM)
+    // Linking relocatable device code is not supported on ROCm yet.
+    return 1;
+#else
+    int num_shards = get_env().num_code_shards;
+    if (num_shards <= 0) {
+        num_shards = std::max(1, (int)std::thread::hardware_concurrency());
+        num_shards = std::min(
+            num_shards,
+            (int)math::div_up(num_units, MIN_CODE_UNITS_PER_SHARD));
+    }
+    return std::max(1, std::min(num_shards, num_units));
+#endif  // defined(ARK_ROCM)
+}
+
 /// Calculate the number of tiles for a given op and a tile.
 /// @param op input op
 /// @param tile input tile
@@ -52,6 +98,19 @@ static int calc_num_tiles(const Op &op, const OpTile &tile) {
     return num_tiles;
 }
 
+/// Get the peer rank that a communication op talks to.
+/// @param op input communication op
+/// @return peer rank, or -1 if the op talks to every rank
+static int get_comm_peer(const Op &op) {
+    if (op.type == OP_SEND || op.type == OP_SEND_DONE ||
+        op.type == OP_RECV) {
+        int peer;
+        op.args.get(&peer, 1);
+        return peer;
+    }
+    return -1;
+}
+
 /// Heuristic matmul optimization. Overwrite the input matmul op with an
 /// optimized op.
 /// @param model target model
@@ -59,7 +118,8 @@ static int calc_num_tiles(const Op &op, const OpTile &tile) {
 /// @param gpu_info GPU info to optimize for
 /// @param num_sm number of SMs to use for this op. This should be equal to or
 /// less than the number of SMs on the GPU (`gpu_info.num_sm`).
-void DefaultScheduler::heuristic_optimize_matmul(
+/// @return true if the matmul op is rewritten.
+bool DefaultScheduler::heuristic_optimize_matmul(
     Model &model, Model::Impl *model_impl, Op &matmul_op,
     const GpuManager::Info &gpu_info, int num_sm) {
     if (matmul_op.type != OP_MATMUL) {
@@ -67,7 +127,11 @@ void DefaultScheduler::heuristic_optimize_matmul(
     }
     if (matmul_op.gran_lev != -1) {
         // `gran_lev` is manually set. Do not optimize.
-        return;
+        return false;
+    }
+    if (MatmulOp::has_epilogue(matmul_op)) {
+        // Splitting would move the epilogue out of the matmul.
+        return false;
     }
     if (num_sm > gpu_info.num_sm) {
         ERR(SchedulerError,
@@ -75,6 +139,22 @@ void DefaultScheduler::heuristic_optimize_matmul(
             "requested (%d).",
             gpu_info.num_sm, num_sm);
     }
+    // A measured split_k in the tuning database takes precedence, unless
+    // exploring the ones not measured yet.
+    std::string tune_key;
+    TuneChoice tuned;
+    if (this->tune_db != nullptr) {
+        tune_key = TuneDb::key(matmul_op, gpu_info.arch);
+        if (get_env().tune_explore) {
+            tuned = this->explore_matmul(matmul_op, tune_key);
+        }
+        if (tuned.split_k > 0) {
+            // Let `sched_op_config()` take the config to explore.
+            this->tune_choices[tune_key] = tuned;
+        } else {
+            this->tune_db->lookup(tune_key, tuned);
+        }
+    }
     const OpConfig *cfg = this->sched_op_config(&matmul_op);
     assert(cfg->output_tiles.size() == 1);
     int num_tiles = calc_num_tiles(matmul_op, cfg->output_tiles[0]);
@@ -88,7 +168,9 @@ void DefaultScheduler::heuristic_optimize_matmul(
     // split_k is preferred when the number of tiles is small and the inner
     // dimension is large.
     int split_k = 1;
-    if (num_tiles < num_sm) {
+    if (tuned.split_k > 0) {
+        split_k = tuned.split_k;
+    } else if (num_tiles < num_sm) {
         // If the number of tiles is less than the number of SMs, we can
         // potentially use more SMs to compute the matmul. We can split the
         // inner dimension into multiple parts and distribute them to different
@@ -113,11 +195,17 @@ void DefaultScheduler::heuristic_optimize_matmul(
         split_k = math::div_up(inner_dim, each_part_len);
         assert(split_k > 0);
     }
+    if (this->tune_db != nullptr) {
+        this->tune_choices[tune_key].split_k = split_k;
+    }
     if (split_k == 1) {
         // No optimization is needed.
-        return;
+        return false;
     }
     LOG(DEBUG, "Optimize matmul ", matmul_op.name, " with split_k=", split_k);
+    if (this->tune_db != nullptr) {
+        this->tune_split_keys[matmul_op.name] = tune_key;
+    }
 
     Tensor *input_a = matmul_op.inputs[0];
     Tensor *input_b = matmul_op.inputs[1];
@@ -138,10 +226,39 @@ void DefaultScheduler::heuristic_optimize_matmul(
 
     model_impl->replace_tensor(tmp, output);
     model_impl->delete_tensor(tmp);
+    return true;
+}
+
+/// Choose a config and a split_k of @p matmul_op that the tuning database
+/// has not measured for @p tune_key: every feasible config without splitting,
+/// and then split_k of powers of two with the config of the lowest estimated
+/// cost.
+/// @return the choice, whose split_k is 0 if every candidate is measured.
+TuneChoice DefaultScheduler::explore_matmul(const Op &matmul_op,
+                                            const std::string &tune_key) {
+    std::vector<SchedOpCandidate> ranked = this->rank_op_configs(&matmul_op);
+    std::vector<TuneChoice> candidates;
+    for (auto &cand : ranked) {
+        candidates.push_back({cand.gran_lev, 1});
+    }
+    const Dims &fst_input_shape = matmul_op.inputs[0]->shape;
+    DimType inner_dim = fst_input_shape[fst_input_shape.ndims() - 1];
+    DimType max_split_k =
+        math::div_up(inner_dim, ranked[0].cfg->input_tiles[0].y);
+    for (int split_k = 2; split_k <= max_split_k; split_k *= 2) {
+        candidates.push_back({ranked[0].gran_lev, split_k});
+    }
+    TuneChoice choice;
+    if (!this->tune_db->explore(tune_key, candidates, choice)) {
+        return {};
+    }
+    LOG(DEBUG, "explore matmul ", matmul_op.name, " with gran_lev ",
+        choice.gran_lev, " and split_k ", choice.split_k);
+    return choice;
 }
 
 /// Heuristically optimize the model. Overwrite the model with an optimized
-/// model.
+/// model by running the graph passes in @ref graph_passes.
 /// @param model target model
 /// @param gpu_info GPU info to optimize for
 /// @param num_sm number of SMs to use for this op. This should be equal to or
@@ -149,199 +266,506 @@ void DefaultScheduler::heuristic_optimize_matmul(
 void DefaultScheduler::heuristic_optimize_model(
     Model &model, Model::Impl *model_impl, const GpuManager::Info &gpu_info,
     int num_sm) {
+    this->graph_passes.add(std::make_unique<OpRewritePass>(
+        "matmul_split_k", std::set<OpType>{OP_MATMUL},
+        [this, gpu_info, num_sm](Model &model, Model::Impl *model_impl,
+                                 Op &op) {
+            return this->heuristic_optimize_matmul(model, model_impl, op,
+                                                   gpu_info, num_sm);
+        }));
+    // The fused intermediate tensors lose their memory, while the user may
+    // still hold them, so the fusions run only if the user opts in.
+    this->graph_passes.add(std::make_unique<MatmulEpiloguePass>(), false);
+    this->graph_passes.add(std::make_unique<EwiseFusionPass>(), false);
+
     if (get_env().disable_graph_opt) {
         LOG(INFO, "Graph optimization is disabled.");
         return;
     }
-    // Make a copy of the ops because we will modify the model.
-    std::vector<Op *> ops;
-    for (auto &op : model_impl->get_ops()) {
-        ops.push_back(op);
-    }
-    for (auto &op : ops) {
-        if (op->type == OP_MATMUL) {
-            heuristic_optimize_matmul(model, model_impl, *op, gpu_info, num_sm);
-        }
-    }
+    this->graph_passes.enable_list(get_env().enable_graph_passes);
+    this->graph_passes.disable_list(get_env().disable_graph_passes);
+    int num_changes = this->graph_passes.run(model);
+    LOG(DEBUG, "Graph optimization made ", num_changes, " changes to ",
+        model_impl->get_ops().size(), " ops.");
 }
 
 DefaultScheduler::DefaultScheduler(Model &model, int gpu_id, int rank_,
                                    int world_size_, int num_warps_per_sm_)
     : BaseScheduler(model, gpu_id, rank_, world_size_, num_warps_per_sm_) {
-    const GpuManager::Info &gpu_info = this->gpu_mgr->info();
+    this->init(model);
+}
+
+DefaultScheduler::DefaultScheduler(Model &model,
+                                   const GpuManager::Info &gpu_info,
+                                   int rank_, int world_size_,
+                                   int num_warps_per_sm_)
+    : BaseScheduler(model, gpu_info, rank_, world_size_, num_warps_per_sm_) {
+    this->init(model);
+}
+
+void DefaultScheduler::init(Model &model) {
+    const GpuManager::Info &gpu_info = this->gpu_info;
 
-    // Number of SMs to use for computation. The last SM is preserved for
-    // communication only.
-    int num_sm_calc = gpu_info.num_sm - 1;
+    // The last SMs are preserved for communication only.
+    this->set_num_sm_comm(model);
 
-    heuristic_optimize_model(model, model.impl.get(), gpu_info, num_sm_calc);
+    {
+        HostTraceScope scope{"graph_passes"};
+        heuristic_optimize_model(model, model.impl.get(), gpu_info,
+                                 this->num_sm_comp);
+    }
 
+    this->policy = sched_policy_from_string(get_env().sched_policy);
+    HostTraceScope scope{"OpGraph"};
     this->op_graph = make_unique<OpGraph>(model);
 }
 
+void DefaultScheduler::set_num_sm_comm(Model &model) {
+    const GpuManager::Info &gpu_info = this->gpu_info;
+    int num_sm_comm = get_env().num_comm_sms;
+    int num_comm_streams = get_env().num_comm_streams;
+    if (num_sm_comm < 0 || num_comm_streams <= 0) {
+        ERR(InvalidUsageError, "invalid number of communication SMs (",
+            num_sm_comm, ") or streams (", num_comm_streams, ")");
+    }
+    if (num_sm_comm == 0) {
+        // Choose from the bytes that this rank sends per iteration. Models
+        // without communication use every SM for computation.
+        bool has_comm = false;
+        size_t send_bytes = 0;
+        for (auto &op : model.impl->get_ops()) {
+            if (!op->is_comm()) continue;
+            has_comm = true;
+            if (op->type == OP_SEND) {
+                size_t bytes;
+                op->args.get(&bytes, 2);
+                send_bytes += bytes;
+            }
+        }
+        if (has_comm) {
+            int max_sm_comm = std::max(num_comm_streams, gpu_info.num_sm / 8);
+            num_sm_comm = (int)math::div_up(send_bytes, COMM_BYTES_PER_SM);
+            num_sm_comm = std::max(num_sm_comm, num_comm_streams);
+            num_sm_comm = std::min(num_sm_comm, max_sm_comm);
+        } else {
+            num_comm_streams = 0;
+        }
+    }
+    if (num_sm_comm >= gpu_info.num_sm) {
+        ERR(InvalidUsageError, "too many communication SMs (", num_sm_comm,
+            "), the GPU has ", gpu_info.num_sm, " SMs");
+    } else if (num_comm_streams > num_sm_comm) {
+        ERR(InvalidUsageError, "too many communication streams (",
+            num_comm_streams, ") for ", num_sm_comm, " communication SMs");
+    }
+    this->num_sm_comp = gpu_info.num_sm - num_sm_comm;
+    this->num_sm_comm = num_sm_comm;
+    this->num_comm_streams = num_comm_streams;
+    LOG(DEBUG, "Use ", this->num_sm_comp, " SMs for computation and ",
+        num_sm_comm, " SMs for ", num_comm_streams, " communication streams");
+}
+
+std::pair<int, int> DefaultScheduler::get_comm_sm_range(int stream_id) const {
+    if (stream_id < 0 || stream_id >= this->num_comm_streams) {
+        ERR(SchedulerError, "invalid communication stream id: ", stream_id);
+    }
+    int begin = stream_id * this->num_sm_comm / this->num_comm_streams;
+    int end = (stream_id + 1) * this->num_sm_comm / this->num_comm_streams;
+    return {this->num_sm_comp + begin, this->num_sm_comp + end};
+}
+
+int DefaultScheduler::get_comm_stream_id(const Op &op) const {
+    int peer = get_comm_peer(op);
+    if (peer < 0) {
+        return 0;
+    }
+    // Peers next to this rank go to different streams.
+    int dist = (peer - this->rank - 1 + this->world_size) % this->world_size;
+    return dist % this->num_comm_streams;
+}
+
 void DefaultScheduler::schedule() {
     LOG(DEBUG, "DefaultScheduler start scheduling");
 
     auto &nodes = this->op_graph->get_nodes();
 
-    std::list<OpNode *> root_nodes;
+    std::vector<OpNode *> root_nodes;
     for (auto &node : nodes) {
         if (node->producers.empty()) {
             root_nodes.emplace_back(node.get());
         }
     }
 
-    std::set<OpNode *> seen_nodes;
-    recursive_schedule(root_nodes, seen_nodes);
-
-    this->configure_gpu_buf(this->model->impl->get_tensors());
+    {
+        HostTraceScope scope{"schedule_nodes"};
+        this->schedule_nodes(root_nodes);
+    }
+    {
+        HostTraceScope scope{"configure_gpu_buf"};
+        this->configure_gpu_buf(this->model->impl->get_tensors());
+    }
 
     if (this->comp_stream.size() != this->comm_stream.size()) {
         ERR(SchedulerError, "unexpected error");
     }
+    LOG(DEBUG, "Estimated SM idle ratio: ", this->get_sm_idle_ratio());
+
+    if (get_env().reuse_buffers) {
+        this->set_buf_lifetimes();
+    }
+    this->set_work_queues();
 }
 
-///
-void DefaultScheduler::recursive_schedule(std::list<OpNode *> &nodes,
-                                          std::set<OpNode *> &seen_nodes) {
-    if (nodes.empty()) {
+/// Choose the opseqs that are dispatched through work queues, according to
+/// `ARK_DISPATCH`. In the `auto` mode, an opseq is dispatched dynamically if
+/// its static placement gives some warp groups more uops than others, where
+/// the groups that finish early would otherwise idle until the next sync.
+/// A work queue hands out all uops of an opseq, so an opseq whose uops are
+/// split across streams is always dispatched statically.
+void DefaultScheduler::set_work_queues() {
+    this->work_queues.clear();
+    const std::string &dispatch = get_env().dispatch;
+    if (dispatch == "static") {
         return;
+    } else if (dispatch != "dynamic" && dispatch != "auto") {
+        ERR(InvalidUsageError, "unknown dispatch mode: ", dispatch,
+            ". Available modes: static, dynamic, auto");
     }
-    const GpuManager::Info &gpu_info = this->gpu_mgr->info();
-
-    std::list<OpNode *> next_nodes;
-    std::vector<SchedItem> comp_items;
-    std::vector<SchedItem> comm_items;
-    bool sync_comm = false;
-    bool sync_comp = false;
-    for (auto &node : nodes) {
-        if (node->ops.size() == 0) {
-            ERR(SchedulerError, "unexpected error: empty OpNode");
-        }
-        Op *op = node->ops[0];
-        const OpConfig *cfg = this->sched_op_config(op);
-        int opseq_id = (int)this->opseqs.size();
-        this->opseqs.emplace_back(make_unique<SchedOpSeq>(opseq_id, op, cfg));
-        SchedOpSeq *opseq = this->opseqs.back().get();
-
-        bool broke_node = false;
-        for (size_t i = 1; i < node->ops.size(); i++) {
-            // If there are multiple Ops, check if the Op configs allow merging.
-            Op *next_op = node->ops[i];
-            const OpConfig *next_cfg = this->sched_op_config(next_op);
-            bool need_sync_between_ops = cfg->sync_post || next_cfg->sync_pre;
-            bool comm_and_comp = (op->is_comm() && !next_op->is_comm()) ||
-                                 (!op->is_comm() && next_op->is_comm());
-            if (!need_sync_between_ops && !comm_and_comp) {
-                if (opseq->append(next_op, next_cfg)) {
-                    // Merge succeeded.
-                    continue;
+    // opseq_id -> number of streams that run its uops.
+    std::map<int, int> num_streams;
+    for (auto &stream : this->comp_stream) {
+        for (auto &s : stream->get_streams()) {
+            std::set<int> opseq_ids;
+            for (auto &br : s.branches) {
+                for (auto &wb : br.warp_branches) {
+                    for (auto &op : wb.branch_ops) {
+                        opseq_ids.insert(op.opseq_id);
+                    }
                 }
             }
-            // Cannot merge. Add remaining part of the OpNode to next_nodes.
-            OpNode *next_node = this->op_graph->break_node(node, i);
-            next_nodes.emplace_back(next_node);
-            broke_node = true;
-            break;
-        }
-
-        // Check if we need to sync between comp and comm.
-        if (!sync_comm && opseq->is_comm()) {
-            // Check if any producer is a computation Op.
-            for (auto &producer : node->producers) {
-                // As we do not merge computation Ops with communication Ops,
-                // we only need to check the first Op.
-                if (!producer->ops[0]->is_comm()) {
-                    sync_comm = true;
-                    break;
+            for (int opseq_id : opseq_ids) {
+                num_streams[opseq_id]++;
+            }
+        }
+    }
+    for (auto &stream : this->comp_stream) {
+        for (auto &s : stream->get_streams()) {
+            // opseq_id -> number of warp groups that run a work queue.
+            std::map<int, int> num_groups;
+            // opseq_id -> (SM ID, warp ID) of each group -> number of uops.
+            std::map<int, std::map<std::pair<int, int>, int>> group_uops;
+            for (auto &br : s.branches) {
+                int num_sm = br.sm_id_end - br.sm_id_begin;
+                for (auto &wb : br.warp_branches) {
+                    std::map<int, int> num_ops;
+                    for (auto &op : wb.branch_ops) {
+                        num_ops[op.opseq_id]++;
+                    }
+                    for (auto &op : wb.branch_ops) {
+                        if (num_ops.count(op.opseq_id) == 0) continue;
+                        int num_warps = wb.warp_id_end - wb.warp_id_begin;
+                        int num_wb_groups = num_warps / op.num_warps_per_uop;
+                        num_groups[op.opseq_id] += num_sm * num_wb_groups;
+                        auto &uops = group_uops[op.opseq_id];
+                        for (int sm = br.sm_id_begin; sm < br.sm_id_end; ++sm) {
+                            for (int w = wb.warp_id_begin; w < wb.warp_id_end;
+                                 w += op.num_warps_per_uop) {
+                                uops[{sm, w}] += num_ops[op.opseq_id];
+                            }
+                        }
+                        num_ops.erase(op.opseq_id);
+                    }
                 }
             }
-        } else if (!sync_comp && !opseq->is_comm()) {
-            // Check if any producer is a communication Op.
-            for (auto &producer : node->producers) {
-                // As we do not merge computation Ops with communication Ops,
-                // we only need to check the first Op.
-                if (producer->ops[0]->is_comm()) {
-                    sync_comp = true;
-                    break;
+            for (auto &p : num_groups) {
+                int opseq_id = p.first;
+                if (num_streams[opseq_id] > 1) {
+                    continue;
+                }
+                auto &uops = group_uops[opseq_id];
+                int min_uops = INT_MAX;
+                int max_uops = 0;
+                for (auto &q : uops) {
+                    min_uops = std::min(min_uops, q.second);
+                    max_uops = std::max(max_uops, q.second);
                 }
+                if (dispatch == "auto" && min_uops == max_uops) {
+                    continue;
+                }
+                SchedWorkQueue wq;
+                wq.num_uops = this->opseqs[opseq_id]->get_tdims_size();
+                wq.num_groups = p.second;
+                int num_grabs = wq.num_groups * WORK_QUEUE_GRABS_PER_GROUP;
+                wq.chunk_size = std::max(1, wq.num_uops / num_grabs);
+                this->work_queues[opseq_id] = wq;
             }
         }
+    }
+    LOG(DEBUG, "Dispatch ", this->work_queues.size(),
+        " opseqs through work queues");
+}
 
-        auto p = seen_nodes.emplace(node);
-        if (!p.second) {
-            ERR(SchedulerError, "unexpected error: already seen node ",
-                node->get_name(), " (", node->ops.size(), " ops)");
-        }
+/// Schedule the @ref OpGraph level by level, starting from @p root_nodes.
+/// Each level consists of nodes whose producers are all scheduled in
+/// previous levels, and is packed into the last comp/comm streams.
+/// @param root_nodes nodes that have no producer.
+void DefaultScheduler::schedule_nodes(const std::vector<OpNode *> &root_nodes) {
+    const GpuManager::Info &gpu_info = this->gpu_info;
+
+    // Indexed by OpNode::id. Grows as nodes are broken.
+    std::vector<char> seen;
+    std::vector<int> num_unseen_producers;
+    for (auto &node : this->op_graph->get_nodes()) {
+        seen.emplace_back(0);
+        num_unseen_producers.emplace_back((int)node->producers.size());
+    }
 
-        // Align shared memory size
-        int smem_bytes = opseq->get_smem_bytes();
-        int aligned_smem_bytes = math::pad(smem_bytes, gpu_info.smem_align);
+    // Communication node -> (stage, communication stream id).
+    std::map<const OpNode *, std::pair<int, int>> comm_node_streams;
 
-        // Create a scheduling item.
-        SchedItem item;
-        item.opseq_id = opseq_id;
-        item.num_uops = opseq->get_tdims_size();
-        item.num_warps_per_uop = opseq->get_num_warps();
-        item.smem_bytes_per_uop = aligned_smem_bytes;
-        if (item.num_uops <= 0) {
-            ERR(SchedulerError, "unexpected error: num_uops <= 0");
-        } else if (item.num_warps_per_uop <= 0) {
-            ERR(SchedulerError, "unexpected error: num_warps_per_uop <= 0");
-        } else if (item.smem_bytes_per_uop < 0) {
-            ERR(SchedulerError, "unexpected error: smem_bytes_per_uop < 0");
-        }
-        if (op->is_comm()) {
-            comm_items.emplace_back(item);
-        } else {
-            comp_items.emplace_back(item);
-        }
+    std::map<const Op *, double> priorities;
+    if (this->policy == SCHED_POLICY_LPT) {
+        priorities = this->get_op_priorities();
+    }
 
-        if (!broke_node) {
-            // If OpNode is completely merged, add its users to
-            // next_nodes.
-            for (auto &user_node : node->users) {
-                // If any producer is unseen, skip the user.
-                bool skip = false;
-                for (auto &producer : user_node->producers) {
-                    if (seen_nodes.find(producer) == seen_nodes.end()) {
-                        skip = true;
+    std::vector<OpNode *> nodes = root_nodes;
+    while (!nodes.empty()) {
+        std::vector<OpNode *> next_nodes;
+        std::vector<SchedItem> comp_items;
+        std::vector<std::vector<SchedItem>> comm_items(this->num_comm_streams);
+        std::vector<std::pair<const OpNode *, int>> level_comm_nodes;
+        bool sync_comm = false;
+        bool sync_comp = false;
+        for (auto &node : nodes) {
+            if (node->ops.size() == 0) {
+                ERR(SchedulerError, "unexpected error: empty OpNode");
+            }
+            Op *op = node->ops[0];
+            const OpConfig *cfg = this->sched_op_config(op);
+            int opseq_id = (int)this->opseqs.size();
+            this->opseqs.emplace_back(
+                make_unique<SchedOpSeq>(opseq_id, op, cfg));
+            SchedOpSeq *opseq = this->opseqs.back().get();
+
+            bool broke_node = false;
+            for (size_t i = 1; i < node->ops.size(); i++) {
+                // If there are multiple Ops, check if the Op configs allow
+                // merging.
+                Op *next_op = node->ops[i];
+                const OpConfig *next_cfg = this->sched_op_config(next_op);
+                bool need_sync_between_ops =
+                    cfg->sync_post || next_cfg->sync_pre;
+                bool comm_and_comp = (op->is_comm() && !next_op->is_comm()) ||
+                                     (!op->is_comm() && next_op->is_comm());
+                if (!need_sync_between_ops && !comm_and_comp) {
+                    if (opseq->append(next_op, next_cfg)) {
+                        // Merge succeeded.
+                        continue;
+                    }
+                }
+                // Cannot merge. Add remaining part of the OpNode to next_nodes.
+                OpNode *next_node = this->op_graph->break_node(node, i);
+                seen.resize(this->op_graph->get_nodes().size(), 0);
+                num_unseen_producers.resize(seen.size(), 0);
+                num_unseen_producers[next_node->id] = 1;
+                next_nodes.emplace_back(next_node);
+                broke_node = true;
+                break;
+            }
+
+            // Check if we need to sync between comp and comm, or between
+            // different comm streams.
+            int comm_stream_id = 0;
+            if (opseq->is_comm()) {
+                comm_stream_id = this->get_comm_stream_id(*op);
+                level_comm_nodes.emplace_back(node, comm_stream_id);
+            }
+            if (!sync_comm && opseq->is_comm()) {
+                // Check if any producer is a computation Op, or a
+                // communication Op on another stream of the current stage.
+                for (auto &producer : node->producers) {
+                    // As we do not merge computation Ops with communication
+                    // Ops, we only need to check the first Op.
+                    if (!producer->ops[0]->is_comm()) {
+                        sync_comm = true;
+                        break;
+                    }
+                    auto it = comm_node_streams.find(producer);
+                    if (it != comm_node_streams.end() &&
+                        it->second.first == (int)this->comm_stream.size() - 1 &&
+                        it->second.second != comm_stream_id) {
+                        sync_comm = true;
+                        break;
+                    }
+                }
+            } else if (!sync_comp && !opseq->is_comm()) {
+                // Check if any producer is a communication Op.
+                for (auto &producer : node->producers) {
+                    // As we do not merge computation Ops with communication
+                    // Ops, we only need to check the first Op.
+                    if (producer->ops[0]->is_comm()) {
+                        sync_comp = true;
                         break;
                     }
                 }
-                if (!skip) {
+            }
+
+            if (seen[node->id]) {
+                ERR(SchedulerError, "unexpected error: already seen node ",
+                    node->get_name(), " (", node->ops.size(), " ops)");
+            }
+            seen[node->id] = 1;
+
+            // Align shared memory size
+            int smem_bytes = opseq->get_smem_bytes();
+            int aligned_smem_bytes = math::pad(smem_bytes, gpu_info.smem_align);
+
+            // Create a scheduling item.
+            SchedItem item;
+            item.opseq_id = opseq_id;
+            item.num_uops = opseq->get_tdims_size();
+            item.num_warps_per_uop = opseq->get_num_warps();
+            item.smem_bytes_per_uop = aligned_smem_bytes;
+            if (!op->is_comm()) {
+                item.cost_per_uop = this->get_uop_cost(*opseq);
+            }
+            auto it = priorities.find(op);
+            if (it != priorities.end()) {
+                item.priority = it->second;
+            }
+            if (item.num_uops <= 0) {
+                ERR(SchedulerError, "unexpected error: num_uops <= 0");
+            } else if (item.num_warps_per_uop <= 0) {
+                ERR(SchedulerError, "unexpected error: num_warps_per_uop <= 0");
+            } else if (item.smem_bytes_per_uop < 0) {
+                ERR(SchedulerError, "unexpected error: smem_bytes_per_uop < 0");
+            }
+            if (op->is_comm()) {
+                comm_items[comm_stream_id].emplace_back(item);
+            } else {
+                comp_items.emplace_back(item);
+            }
+
+            // If OpNode is completely merged, add its users whose producers are
+            // all seen to next_nodes. If OpNode is broken, its only user is the
+            // remaining part, which is already in next_nodes.
+            for (auto &user_node : node->users) {
+                if (--num_unseen_producers[user_node->id] == 0 && !broke_node) {
                     next_nodes.emplace_back(user_node);
                 }
             }
         }
-    }
 
-    if (this->comp_stream.empty() || sync_comp || sync_comm) {
-        // Create a new stream.
-        this->comp_stream.emplace_back(make_unique<SchedStream>(
-            0, gpu_info.num_sm - 1, this->num_warps_per_sm,
-            gpu_info.smem_block_total));
-    }
-    if (this->comm_stream.empty() || sync_comp || sync_comm) {
-        // Create a new stream.
-        this->comm_stream.emplace_back(make_unique<SchedStream>(
-            gpu_info.num_sm - 1, gpu_info.num_sm, this->num_warps_per_sm,
-            gpu_info.smem_block_total));
+        if (this->comp_stream.empty() || sync_comp || sync_comm) {
+            // Create a new stream.
+            this->comp_stream.emplace_back(make_unique<SchedStream>(
+                0, this->num_sm_comp, this->num_warps_per_sm,
+                gpu_info.smem_block_total, this->policy));
+        }
+        if (this->comm_stream.empty() || sync_comp || sync_comm) {
+            // Create new streams, one for each range of comm SMs.
+            this->comm_stream.emplace_back();
+            for (int k = 0; k < this->num_comm_streams; ++k) {
+                auto range = this->get_comm_sm_range(k);
+                this->comm_stream.back().emplace_back(make_unique<SchedStream>(
+                    range.first, range.second, this->num_warps_per_sm,
+                    gpu_info.smem_block_total));
+            }
+        }
+        for (auto &p : level_comm_nodes) {
+            int stage = (int)this->comm_stream.size() - 1;
+            comm_node_streams[p.first] = {stage, p.second};
+        }
+
+        // Schedule the Ops.
+        this->comp_stream.back()->add_items(comp_items);
+        for (int k = 0; k < this->num_comm_streams; ++k) {
+            this->comm_stream.back()[k]->add_items(comm_items[k]);
+        }
+
+        SCHEDULE_DEBUG("scheduled ", nodes.size(), " nodes");
+        for (auto &item : comp_items) {
+            SCHEDULE_DEBUG("  comp: ", this->opseqs[item.opseq_id]->get_name());
+        }
+        for (int k = 0; k < this->num_comm_streams; ++k) {
+            for (auto &item : comm_items[k]) {
+                SCHEDULE_DEBUG("  comm ", k, ": ",
+                               this->opseqs[item.opseq_id]->get_name());
+            }
+        }
+
+        nodes = std::move(next_nodes);
     }
+}
 
-    // Schedule the Ops.
-    this->comp_stream.back()->add_items(comp_items);
-    this->comm_stream.back()->add_items(comm_items);
+double DefaultScheduler::get_uop_cost(const SchedOpSeq &opseq) const {
+    // A tile runs as long as a wave of the op, sharing the SM with the other
+    // tiles of the wave.
+    double cost = 0;
+    for (auto &sop : opseq.get_sched_ops()) {
+        if (sop.get_cfg() == nullptr) {
+            continue;
+        }
+        const Op *op = sop.get_op();
+        SchedOpCandidate cand =
+            this->estimate_op(op, this->get_gran_lev(op, *sop.get_cfg()));
+        cost += cand.cost / std::max(cand.num_waves, (DimType)1);
+    }
+    return cost;
+}
 
-    SCHEDULE_DEBUG("scheduled ", nodes.size(), " nodes");
-    for (auto &item : comp_items) {
-        SCHEDULE_DEBUG("  comp: ", this->opseqs[item.opseq_id]->get_name());
+std::map<const Op *, double> DefaultScheduler::get_op_priorities() {
+    auto &nodes = this->op_graph->get_nodes();
+    std::map<const Op *, double> priorities;
+    std::vector<double> node_priorities(nodes.size(), 0);
+    std::vector<int> num_unseen_users(nodes.size(), 0);
+    std::vector<OpNode *> ready;
+    for (auto &node : nodes) {
+        num_unseen_users[node->id] = (int)node->users.size();
+        if (node->users.empty()) {
+            ready.emplace_back(node.get());
+        }
     }
-    for (auto &item : comm_items) {
-        SCHEDULE_DEBUG("  comm: ", this->opseqs[item.opseq_id]->get_name());
+    // Visit the nodes from the end of the model.
+    while (!ready.empty()) {
+        OpNode *node = ready.back();
+        ready.pop_back();
+        double priority = 0;
+        for (auto &user : node->users) {
+            priority = std::max(priority, node_priorities[user->id]);
+        }
+        for (auto it = node->ops.rbegin(); it != node->ops.rend(); ++it) {
+            const Op *op = *it;
+            const OpConfig *cfg = this->sched_op_config(op);
+            if (cfg != nullptr && !op->is_comm()) {
+                priority +=
+                    this->estimate_op(op, this->get_gran_lev(op, *cfg)).cost;
+            }
+            priorities[op] = priority;
+        }
+        node_priorities[node->id] = priority;
+        for (auto &producer : node->producers) {
+            if (--num_unseen_users[producer->id] == 0) {
+                ready.emplace_back(producer);
+            }
+        }
     }
+    return priorities;
+}
 
-    recursive_schedule(next_nodes, seen_nodes);
+double DefaultScheduler::get_sm_idle_ratio() const {
+    double max_load = 0;
+    double avg_load = 0;
+    for (auto &stream : this->comp_stream) {
+        for (auto &s : stream->get_streams()) {
+            max_load += s.max_sm_load;
+            avg_load += s.avg_sm_load;
+        }
+    }
+    if (max_load == 0) {
+        return 0;
+    }
+    return 1 - avg_load / max_load;
 }
 
 void DefaultScheduler::configure_gpu_buf(
@@ -371,6 +795,17 @@ void DefaultScheduler::configure_gpu_buf(
             auto cfg = sop.get_cfg();
             auto tile_vec = cfg->input_tiles;
             auto tns_vec = op->inputs;
+            // Inputs without their own tiles, such as the epilogue operands
+            // of a matmul, follow the first output tile except along the
+            // dimensions where they are broadcast.
+            for (size_t i = tile_vec.size(); i < tns_vec.size(); ++i) {
+                OpTile tile = cfg->output_tiles[0];
+                const Dims &shape = tns_vec[i]->shape;
+                int ndims = shape.ndims();
+                if (ndims < 2 || shape[ndims - 2] == 1) tile.x = 1;
+                if (shape[ndims - 1] == 1) tile.y = 1;
+                tile_vec.emplace_back(tile);
+            }
             // For case which tns_vec contains less elements than tile_vec
             tile_vec.resize(tns_vec.size());
             tile_vec.insert(tile_vec.end(), cfg->output_tiles.begin(),
@@ -498,17 +933,107 @@ void DefaultScheduler::configure_gpu_buf(
             for (auto &p : search->second) {
                 Tensor *t = p.first;
                 sid = p.second;
-                this->buf_infos.emplace_back(this->gpu_mgr->get_gpu_id(),
+                this->buf_infos.emplace_back(this->gpu_id,
                                              buf->bytes, buf, sid,
                                              t->offset_bytes());
             }
         } else {
-            this->buf_infos.emplace_back(this->gpu_mgr->get_gpu_id(),
+            this->buf_infos.emplace_back(this->gpu_id,
                                          buf->bytes, buf, sid, 0);
         }
     }
 }
 
+/// Find the lifetimes of the local buffers that can share memory with each
+/// other. A step is a computation stream between two synchronizations that
+/// all computation SMs take part in, as in @ref gen_code, so everything in a
+/// step finishes before the next step starts. Buffers are excluded if they
+/// are used by communication, exported, imported, or may be written by the
+/// host, i.e., read before being written in an iteration.
+/// A buffer that is not read after its last write is kept until the last
+/// step so that the host can read it.
+void DefaultScheduler::set_buf_lifetimes() {
+    this->buf_lifetimes.clear();
+
+    // The first and the last steps of each opseq, whose uops may be split
+    // across steps. Communication opseqs are not given any.
+    std::vector<std::pair<int, int>> opseq_steps(this->opseqs.size(),
+                                                 {-1, -1});
+    int num_steps = 0;
+    for (auto &stream : this->comp_stream) {
+        for (auto &s : stream->get_streams()) {
+            for (auto &branch : s.branches) {
+                for (auto &wb : branch.warp_branches) {
+                    for (auto &bop : wb.branch_ops) {
+                        auto &steps = opseq_steps[bop.opseq_id];
+                        if (steps.first < 0) {
+                            steps.first = num_steps;
+                        }
+                        steps.second = num_steps;
+                    }
+                }
+            }
+            ++num_steps;
+        }
+    }
+    if (num_steps == 0) {
+        return;
+    }
+
+    std::set<TensorBuf *> pinned;
+    for (auto &bi : this->buf_infos) {
+        if (bi.gpu_id != this->gpu_id || bi.sid != -1) {
+            pinned.insert(bi.tbuf);
+        }
+    }
+    for (auto &tns : this->model->impl->get_tensors()) {
+        if (tns->exported || tns->imported_rank >= 0) {
+            pinned.insert(tns->buf);
+        }
+    }
+
+    struct Access {
+        int first_read = INT_MAX;
+        int last_read = -1;
+        int first_write = INT_MAX;
+        int last_write = -1;
+    };
+    std::map<TensorBuf *, Access> accesses;
+    for (auto &opseq : this->opseqs) {
+        int first = opseq_steps[opseq->get_id()].first;
+        int last = opseq_steps[opseq->get_id()].second;
+        for (auto &sop : opseq->get_sched_ops()) {
+            const Op *op = sop.get_op();
+            if (first < 0) {
+                for (auto &tns : op->inputs) pinned.insert(tns->buf);
+                for (auto &tns : op->outputs) pinned.insert(tns->buf);
+                continue;
+            }
+            for (auto &tns : op->inputs) {
+                Access &acc = accesses[tns->buf];
+                acc.first_read = std::min(acc.first_read, first);
+                acc.last_read = std::max(acc.last_read, last);
+            }
+            for (auto &tns : op->outputs) {
+                Access &acc = accesses[tns->buf];
+                acc.first_write = std::min(acc.first_write, first);
+                acc.last_write = std::max(acc.last_write, last);
+            }
+        }
+    }
+
+    for (auto &p : accesses) {
+        const Access &acc = p.second;
+        if (pinned.count(p.first) > 0 || acc.last_write < 0 ||
+            acc.first_read <= acc.first_write) {
+            continue;
+        }
+        int last_step =
+            (acc.last_read > acc.last_write) ? acc.last_read : num_steps - 1;
+        this->buf_lifetimes[p.first] = {acc.first_write, last_step};
+    }
+}
+
 std::vector<std::string> DefaultScheduler::gen_code() {
     std::stringstream code;
 
@@ -522,15 +1047,26 @@ std::vector<std::string> DefaultScheduler::gen_code() {
         this->codegen->def_remote_buf(code, rank);
     }
 
-    this->codegen->def_sync_stream(code, 0);
-    this->codegen->def_sync_stream(code, 1);
+    // Stream 0 is for computation, and the others are for communication.
+    for (int k = 0; k <= this->num_comm_streams; ++k) {
+        this->codegen->def_sync_stream(code, k);
+    }
+
+    if (!this->work_queues.empty()) {
+        this->codegen->def_work_queue_slots(code);
+    }
+    for (auto &p : this->work_queues) {
+        this->codegen->def_work_queue(code, p.first);
+    }
+    this->codegen->def_trace(code);
 
-    int num_proxy_chans = this->ctx->get_comm_sw()->get_proxy_channels_num();
+    int num_proxy_chans = this->get_num_proxy_channels();
     this->codegen->def_proxy_channels(code, num_proxy_chans);
-    int num_sm_chans = this->ctx->get_comm_sw()->get_sm_channels_num();
+    int num_sm_chans = this->get_num_sm_channels();
     this->codegen->def_sm_channels(code, num_sm_chans);
 
     std::map<std::string, int> uop_map;
+    std::vector<std::string> uop_codes;
     for (auto &opseq : this->opseqs) {
         for (auto &sop : opseq->get_sched_ops()) {
             int uop_id = (int)uop_map.size();
@@ -539,18 +1075,142 @@ std::vector<std::string> DefaultScheduler::gen_code() {
             auto p = uop_map.emplace(sop_serial, uop_id);
             if (p.second) {
                 // If this is a new function, define it.
-                this->codegen->def_uop(code, sop, uop_id);
+                std::stringstream uop_code;
+                this->codegen->def_uop(uop_code, sop, uop_id);
+                uop_codes.emplace_back(uop_code.str());
+            }
+        }
+    }
+    // Opseqs that only differ in the values of their arguments, e.g., the
+    // same layer repeated in a model, share a single function.
+    std::map<std::string, std::vector<const SchedOpSeq *>> shared_opseqs;
+    if (get_env().share_opseq_code) {
+        for (auto &opseq : this->opseqs) {
+            std::string key = this->codegen->opseq_key(*opseq, uop_map);
+            if (!key.empty()) {
+                shared_opseqs[key].emplace_back(opseq.get());
             }
         }
     }
+    std::vector<CodeUnit> units;
+    std::set<const SchedOpSeq *> shared;
+    long long code_size_saved = 0;
+    int num_shared_funcs = 0;
+    for (auto &p : shared_opseqs) {
+        if (p.second.size() < 2) continue;
+        CodeUnit unit;
+        unit.shared_id = num_shared_funcs++;
+        unit.opseqs = p.second;
+        std::stringstream shared_code;
+        std::stringstream wrapper_code;
+        std::stringstream unshared_code;
+        this->codegen->shared_opseq(shared_code, unit.shared_id, p.second,
+                                    uop_map);
+        this->codegen->shared_opseq_wrappers(wrapper_code, unit.shared_id,
+                                             p.second);
+        for (auto opseq : p.second) {
+            shared.insert(opseq);
+            this->codegen->opseq(unshared_code,
+                                 "op" + std::to_string(opseq->get_id()),
+                                 *opseq, uop_map);
+        }
+        code_size_saved += (long long)unshared_code.tellp() -
+                           (long long)shared_code.tellp() -
+                           (long long)wrapper_code.tellp();
+        unit.code = shared_code.str();
+        units.emplace_back(std::move(unit));
+    }
     for (auto &opseq : this->opseqs) {
-        this->codegen->opseq(code, "op" + std::to_string(opseq->get_id()),
-                             *opseq, uop_map);
+        if (shared.count(opseq.get()) > 0) continue;
+        CodeUnit unit;
+        unit.opseqs = {opseq.get()};
+        std::stringstream opseq_code;
+        this->codegen->opseq(opseq_code,
+                             "op" + std::to_string(opseq->get_id()), *opseq,
+                             uop_map);
+        unit.code = opseq_code.str();
+        units.emplace_back(std::move(unit));
+    }
+    for (auto &unit : units) {
+        for (auto opseq : unit.opseqs) {
+            for (auto &sop : opseq->get_sched_ops()) {
+                if (sop.is_virtual()) continue;
+                unit.uop_ids.insert(uop_map.at(sop.serialize()));
+            }
+        }
     }
 
-    const GpuManager::Info &gpu_info = this->gpu_mgr->info();
-    int num_sm_comp = gpu_info.num_sm - 1;
-    int num_sm_comm = 1;
+    std::vector<std::string> codes;
+    int num_shards = get_num_code_shards((int)units.size());
+    if (num_shards <= 1) {
+        for (auto &uop_code : uop_codes) {
+            code << uop_code;
+        }
+        for (auto &unit : units) {
+            code << unit.code;
+            if (unit.shared_id >= 0) {
+                this->codegen->shared_opseq_wrappers(code, unit.shared_id,
+                                                     unit.opseqs);
+            }
+        }
+    } else {
+        // Assign the largest units first, each to the shard with the least
+        // code so far.
+        std::vector<size_t> order(units.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return units[a].code.size() > units[b].code.size();
+        });
+        std::vector<size_t> shard_sizes(num_shards, 0);
+        std::vector<int> unit_shard(units.size());
+        for (size_t idx : order) {
+            int shard = (int)(std::min_element(shard_sizes.begin(),
+                                               shard_sizes.end()) -
+                              shard_sizes.begin());
+            unit_shard[idx] = shard;
+            shard_sizes[shard] += units[idx].code.size();
+        }
+        // The main code calls the opseqs defined in the shards, which are
+        // compiled separately and linked as relocatable device code.
+        codes.resize(num_shards + 1);
+        for (int shard = 0; shard < num_shards; ++shard) {
+            std::stringstream shard_code;
+            std::set<int> uop_ids;
+            for (size_t i = 0; i < units.size(); ++i) {
+                if (unit_shard[i] != shard) continue;
+                uop_ids.insert(units[i].uop_ids.begin(),
+                               units[i].uop_ids.end());
+            }
+            for (auto rank : imported_ranks) {
+                this->codegen->decl_remote_buf(shard_code, rank);
+            }
+            // Uops may be defined in several shards, so they are internal.
+            shard_code << "namespace {\n";
+            for (int uop_id : uop_ids) {
+                shard_code << uop_codes[uop_id];
+            }
+            shard_code << "}  // namespace\n";
+            for (size_t i = 0; i < units.size(); ++i) {
+                if (unit_shard[i] != shard) continue;
+                shard_code << units[i].code;
+            }
+            codes[shard + 1] = shard_code.str();
+        }
+        for (auto &unit : units) {
+            if (unit.shared_id >= 0) {
+                this->codegen->decl_shared_opseq(code, unit.shared_id);
+                this->codegen->shared_opseq_wrappers(code, unit.shared_id,
+                                                     unit.opseqs);
+            } else {
+                this->codegen->decl_opseq(
+                    code, "op" + std::to_string(unit.opseqs[0]->get_id()));
+            }
+        }
+        LOG(INFO, "Split the code of ", units.size(), " opseq functions into ",
+            num_shards, " translation units");
+    }
 
     code << "__device__ void ark_loop_body(char *_buf, int _iter) {\n";
     for (size_t i = 0; i < this->comp_stream.size(); ++i) {
@@ -558,23 +1218,27 @@ std::vector<std::string> DefaultScheduler::gen_code() {
         for (size_t j = 0; j < comp_streams.size(); ++j) {
             auto &stream = comp_streams[j];
             for (auto &branch : stream.branches) {
-                this->codegen->branch(code, branch);
+                this->codegen->branch(code, branch, -1, this->work_queues);
             }
             if (!stream.branches.empty() && j != comp_streams.size() - 1) {
                 code << "  ";
-                this->codegen->sync_stream(code, 0, 0, num_sm_comp);
+                this->codegen->sync_stream(code, 0, 0, this->num_sm_comp);
             }
         }
-        auto comm_streams = this->comm_stream[i]->get_streams();
-        for (size_t j = 0; j < comm_streams.size(); ++j) {
-            auto &stream = comm_streams[j];
-            for (auto &branch : stream.branches) {
-                this->codegen->branch(code, branch);
-            }
-            if (!stream.branches.empty() && j != comm_streams.size() - 1) {
-                code << "  ";
-                this->codegen->sync_stream(code, 1, num_sm_comp,
-                                           num_sm_comp + num_sm_comm);
+        for (int k = 0; k < this->num_comm_streams; ++k) {
+            auto range = this->get_comm_sm_range(k);
+            auto comm_streams = this->comm_stream[i][k]->get_streams();
+            for (size_t j = 0; j < comm_streams.size(); ++j) {
+                auto &stream = comm_streams[j];
+                for (auto &branch : stream.branches) {
+                    this->codegen->branch(code, branch);
+                }
+                if (!stream.branches.empty() &&
+                    j != comm_streams.size() - 1) {
+                    code << "  ";
+                    this->codegen->sync_stream(code, k + 1, range.first,
+                                               range.second);
+                }
             }
         }
         if (i != this->comp_stream.size() - 1) {
@@ -583,7 +1247,22 @@ std::vector<std::string> DefaultScheduler::gen_code() {
         }
     }
     code << "}\n";
-    return {code.str()};
+    if (codes.empty()) {
+        codes.emplace_back(code.str());
+    } else {
+        codes[0] = code.str();
+    }
+    if (num_shared_funcs > 0) {
+        long long code_size = 0;
+        for (auto &c : codes) {
+            code_size += (long long)c.size();
+        }
+        LOG(INFO, "Shared ", num_shared_funcs, " functions among ",
+            shared.size(), " opseqs, generated ", code_size,
+            " bytes of code (", code_size + code_size_saved,
+            " bytes without sharing)");
+    }
+    return codes;
 }
 
 }  // namespace ark
@@ -0,0 +1,67 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+// Scheduling throughput on synthetic models, without a GPU.
+// Usage: sched_bench [num_ops] [gpu_profile]
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+
+#include "cpu_timer.h"
+#include "gpu/gpu_profile.h"
+#include "include/ark.h"
+#include "logging.h"
+#include "sched/sched.h"
+
+/// Transformer-like layers: each layer runs `width` parallel branches of a
+/// few element-wise ops and accumulates them into the layer output.
+/// @return number of ops in @p model.
+static int build_model(ark::Model &model, int num_ops) {
+    const int width = 100;
+    const int branch_len = 8;
+    const int ops_per_layer = width * branch_len + width - 1;
+    int num_layers = std::max(1, num_ops / ops_per_layer);
+    ark::Tensor *x = model.relu(model.tensor({64}, ark::FP32));
+    for (int l = 0; l < num_layers; ++l) {
+        ark::Tensor *acc = nullptr;
+        for (int w = 0; w < width; ++w) {
+            ark::Tensor *b = model.relu(x);
+            for (int i = 1; i < branch_len; ++i) {
+                b = model.relu(b);
+            }
+            acc = (acc == nullptr) ? b : model.add(acc, b);
+        }
+        x = acc;
+    }
+    return 1 + num_layers * ops_per_layer;
+}
+
+int main(int argc, char **argv) {
+    int num_ops = (argc > 1) ? std::atoi(argv[1]) : 1000000;
+    std::string profile = (argc > 2) ? argv[2] : "a100";
+    if (num_ops <= 0) {
+        LOG(ark::ERROR, "invalid number of ops: ", argv[1]);
+    }
+    ark::init();
+
+    double start = ark::cpu_timer();
+    ark::Model model;
+    num_ops = build_model(model, num_ops);
+    double model_elapsed = ark::cpu_timer() - start;
+
+    start = ark::cpu_timer();
+    ark::OpGraph graph(model);
+    double graph_elapsed = ark::cpu_timer() - start;
+
+    start = ark::cpu_timer();
+    ark::DefaultScheduler sched{model, ark::gpu_profile(profile), 0, 1};
+    sched.schedule();
+    double sched_elapsed = ark::cpu_timer() - start;
+
+    LOG(ark::INFO, "ops: ", num_ops, ", nodes: ", graph.get_nodes().size(),
+        ", opseqs: ", sched.get_opseqs().size());
+    LOG(ark::INFO, "model: ", model_elapsed, " s, opgraph: ", graph_elapsed,
+        " s, opgraph + schedule: ", sched_elapsed, " s");
+    return 0;
+}
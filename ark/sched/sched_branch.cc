@@ -345,9 +345,10 @@ std::vector<OpBranchInfo> SchedBranch::Impl::get_op_branch_info(
         }
     }
 
-    // Verify if there is a missing uop.
+    // Verify if there is a missing uop. The uops of an opseq may start from
+    // a non-zero ID if the preceding ones are in an earlier branch.
     for (auto &p : this->opseq_to_uop_ids) {
-        int expected_id = 0;
+        int expected_id = *p.second.begin();
         for (int uop_id : p.second) {
             if (uop_id != expected_id) {
                 ERR(SchedulerError, "missing uop ", expected_id, " in opseq ",
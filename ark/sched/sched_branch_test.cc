@@ -496,6 +496,58 @@ ark::unittest::State test_sched_branch_errors() {
         sb.add(0, 1, 0, 1, 3);
         UNITTEST_THROW(sb.get_branches({}), ark::SchedulerError);
     }
+    {
+        // The uops may start from a non-zero ID but should not have a gap
+        ark::SchedBranch sb;
+        sb.add(0, 4, 0, 0, 1);
+        sb.add(0, 5, 0, 1, 2);
+        sb.add(0, 7, 0, 2, 3);
+        UNITTEST_THROW(sb.get_branches({}), ark::SchedulerError);
+    }
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_sched_branch_continued_opseq() {
+    std::map<int, int> sm_id_to_smem_per_warp;
+
+    // Test: the uops of opseq 0 are split between two streams, each of which
+    // has its own SchedBranch.
+    //   stream 0:
+    //     if (0 <= sm_id < 1 && 0 <= warp_id < 4) {
+    //       op = 0; uop = 1 * warp_id + 0;
+    //     }
+    //   stream 1:
+    //     if (0 <= sm_id < 1 && 0 <= warp_id < 4) {
+    //       op = 0; uop = 1 * warp_id + 4;
+    //     }
+
+    ark::SchedBranch first;
+    ark::SchedBranch second;
+    for (int uop_id = 0; uop_id < 8; ++uop_id) {
+        ark::SchedBranch &sb = (uop_id < 4) ? first : second;
+        int warp_id = uop_id % 4;
+        sb.add(/*opseq_id*/ 0, /*uop_id*/ uop_id, /*sm_id*/ 0,
+               /*warp_id_begin*/ warp_id, /*warp_id_end*/ warp_id + 1);
+    }
+
+    for (auto *sb : {&first, &second}) {
+        std::vector<ark::Branch> branches =
+            sb->get_branches(sm_id_to_smem_per_warp);
+
+        UNITTEST_EQ(branches.size(), 1UL);
+        UNITTEST_EQ(branches[0].sm_id_begin, 0);
+        UNITTEST_EQ(branches[0].sm_id_end, 1);
+        UNITTEST_EQ(branches[0].warp_branches.size(), 1UL);
+        UNITTEST_EQ(branches[0].warp_branches[0].warp_id_begin, 0);
+        UNITTEST_EQ(branches[0].warp_branches[0].warp_id_end, 4);
+        UNITTEST_EQ(branches[0].warp_branches[0].branch_ops.size(), 1UL);
+        UNITTEST_EQ(branches[0].warp_branches[0].branch_ops[0].opseq_id, 0);
+        UNITTEST_EQ(branches[0].warp_branches[0].branch_ops[0].uop_id_begin,
+                    (sb == &first) ? 0 : 4);
+        UNITTEST_EQ(branches[0].warp_branches[0].branch_ops[0].uop_id_diff, 1);
+        UNITTEST_EQ(branches[0].warp_branches[0].branch_ops[0].num_uops_per_sm,
+                    4);
+    }
     return ark::unittest::SUCCESS;
 }
 
@@ -505,5 +557,6 @@ int main() {
     UNITTEST(test_sched_branch_multi_opseq);
     UNITTEST(test_sched_branch_clear);
     UNITTEST(test_sched_branch_errors);
+    UNITTEST(test_sched_branch_continued_opseq);
     return 0;
 }
@@ -9,23 +9,28 @@
 #include <fstream>
 #include <initializer_list>
 #include <ostream>
+#include <sstream>
+#include <vector>
 
 #include "env.h"
 #include "logging.h"
 #include "math_utils.h"
 
 #define OP_PREFIX "op"
+#define SHARED_OP_PREFIX "opc"
+#define SHARED_OP_ARGS_NAME "ARK_OPSEQ_ARGS"
 #define UNIT_OP_PREFIX "uop"
 #define ALLOW_FOR_LOOP 1
 
 namespace ark {
 
 CodeGenerator::CodeGenerator(const GpuManager::Info &gpu_info_,
-                             int num_warps_per_sm_)
+                             int num_warps_per_sm_, int trace_records_per_sm_)
     : gpu_info{gpu_info_},
       sm_num{gpu_info_.num_sm},
       num_warps_per_sm{num_warps_per_sm_},
-      num_indent{0} {}
+      num_indent{0},
+      trace_records_per_sm{trace_records_per_sm_} {}
 
 size_t CodeGenerator::get_tensor_offset(const Tensor *tensor) const {
     size_t off = tensor->buf->get_buf_offset();
@@ -39,6 +44,12 @@ std::ostream &CodeGenerator::def_remote_buf(std::ostream &os,
     return os;
 }
 
+std::ostream &CodeGenerator::decl_remote_buf(std::ostream &os,
+                                             int remote_rank) const {
+    os << "extern __device__ char *" ARK_BUF_NAME << remote_rank << ";\n";
+    return os;
+}
+
 std::ostream &CodeGenerator::sync_gpu(std::ostream &os) const {
     os << "ark::sync_gpu<" << this->sm_num << ">(" ARK_LSS_NAME ");\n";
     return os;
@@ -68,6 +79,30 @@ std::ostream &CodeGenerator::sync_stream(std::ostream &os, int stream_id,
     return os;
 }
 
+std::ostream &CodeGenerator::def_work_queue(std::ostream &os,
+                                            int opseq_id) const {
+    os << "__device__ ark::sync::WorkQueue " ARK_WQ_NAME "_" << opseq_id
+       << ";\n";
+    return os;
+}
+
+std::ostream &CodeGenerator::def_work_queue_slots(std::ostream &os) const {
+    os << "__device__ int " ARK_WQ_SLOTS_NAME "["
+       << this->sm_num * this->num_warps_per_sm << "];\n";
+    return os;
+}
+
+std::ostream &CodeGenerator::def_trace(std::ostream &os) const {
+    if (this->trace_records_per_sm <= 0) {
+        return os;
+    }
+    os << "__device__ ark::TraceRecord " ARK_TRACE_NAME "["
+       << (long long)this->sm_num * this->trace_records_per_sm << "];\n"
+       << "__device__ unsigned int " ARK_TRACE_COUNTS_NAME "[" << this->sm_num
+       << "];\n";
+    return os;
+}
+
 std::ostream &CodeGenerator::tensor(std::ostream &os,
                                     const Tensor *tensor) const {
     size_t off = this->get_tensor_offset(tensor);
@@ -135,8 +170,9 @@ std::ostream &CodeGenerator::oparg(std::ostream &os, const OpArg &arg) const {
     return os;
 }
 
-std::ostream &CodeGenerator::branch(std::ostream &os, const Branch &br,
-                                    int prev_sm_id_end) const {
+std::ostream &CodeGenerator::branch(
+    std::ostream &os, const Branch &br, int prev_sm_id_end,
+    const std::map<int, SchedWorkQueue> &work_queues) const {
     if (br.warp_branches.empty()) {
         return os;
     }
@@ -175,6 +211,23 @@ std::ostream &CodeGenerator::branch(std::ostream &os, const Branch &br,
 
     for (auto &warp_branch : br.warp_branches) {
         if (warp_branch.branch_ops.empty()) continue;
+        // Opseqs dispatched by work queues run once per warp branch, and the
+        // others run as statically mapped.
+        std::vector<BranchOp> branch_ops;
+        std::vector<const BranchOp *> queue_ops;
+        for (auto &branch_op : warp_branch.branch_ops) {
+            if (work_queues.count(branch_op.opseq_id) == 0) {
+                branch_ops.emplace_back(branch_op);
+                continue;
+            }
+            bool seen = false;
+            for (auto queue_op : queue_ops) {
+                seen = seen || (queue_op->opseq_id == branch_op.opseq_id);
+            }
+            if (!seen) {
+                queue_ops.emplace_back(&branch_op);
+            }
+        }
         int thread_begin = warp_branch.warp_id_begin * tpw;
         int thread_end = warp_branch.warp_id_end * tpw;
         if (warp_branch.warp_id_begin == 0) {
@@ -244,23 +297,45 @@ std::ostream &CodeGenerator::branch(std::ostream &os, const Branch &br,
             // sm_idx = sm_id - sm_id_begin;
             // uop = uop_id_diff * (warp_idx / num_warps_per_uop +
             //                      num_uops * sm_idx) + uop_id_begin;
-            std::stringstream ss;
-            ss << OP_PREFIX << opseq_id << "(_buf, ";
+            std::stringstream uop_idx;
             if (uop_id_diff != 0) {
                 auto indexing = get_indexing(num_warps_per_uop);
                 if (!indexing.empty()) {
                     if (uop_id_diff != 1) {
-                        ss << uop_id_diff << " * ";
+                        uop_idx << uop_id_diff << " * ";
                     }
-                    ss << indexing << " + ";
+                    uop_idx << indexing << " + ";
                 }
             }
-            ss << uop_id_begin << ", " << br.smem_bytes_per_warp << ");";
+            uop_idx << uop_id_begin;
+            std::stringstream ss;
+            if (this->trace_records_per_sm <= 0) {
+                ss << OP_PREFIX << opseq_id << "(_buf, " << uop_idx.str()
+                   << ", " << br.smem_bytes_per_warp << ");";
+                return ss.str();
+            }
+            ss << "ark::trace_uop<" << num_warps_per_uop << ", "
+               << this->trace_records_per_sm
+               << ">(" ARK_TRACE_NAME ", " ARK_TRACE_COUNTS_NAME ", _iter, "
+               << opseq_id << ", " << uop_idx.str() << ", [&](int _t) { "
+               << OP_PREFIX << opseq_id << "(_buf, _t, "
+               << br.smem_bytes_per_warp << "); });";
             return ss.str();
         };
 
-        if (ALLOW_FOR_LOOP == 0 || warp_branch.branch_ops.size() < 3) {
-            for (auto &branch_op : warp_branch.branch_ops) {
+        for (auto queue_op : queue_ops) {
+            const SchedWorkQueue &wq = work_queues.at(queue_op->opseq_id);
+            os << "      ark::work_queue<" << wq.num_uops << ", "
+               << wq.chunk_size << ", " << wq.num_groups << ", "
+               << queue_op->num_warps_per_uop << ">(" ARK_WQ_NAME "_"
+               << queue_op->opseq_id << ", " ARK_WQ_SLOTS_NAME
+               << ", [&](int _u) { "
+               << uop_code(queue_op->opseq_id, 0,
+                           queue_op->num_warps_per_uop, "_u")
+               << " });\n";
+        }
+        if (ALLOW_FOR_LOOP == 0 || branch_ops.size() < 3) {
+            for (auto &branch_op : branch_ops) {
                 os << "      "
                    << uop_code(branch_op.opseq_id, branch_op.uop_id_diff,
                                branch_op.num_warps_per_uop,
@@ -269,18 +344,18 @@ std::ostream &CodeGenerator::branch(std::ostream &os, const Branch &br,
             }
         } else {
             size_t idx = 0;
-            while (idx < warp_branch.branch_ops.size() - 1) {
-                int opseq_id = warp_branch.branch_ops[idx].opseq_id;
+            while (idx < branch_ops.size() - 1) {
+                int opseq_id = branch_ops[idx].opseq_id;
                 int num_warps_per_uop =
-                    warp_branch.branch_ops[idx].num_warps_per_uop;
-                int uop_id_diff = warp_branch.branch_ops[idx].uop_id_diff;
-                int uop_id_begin = warp_branch.branch_ops[idx].uop_id_begin;
+                    branch_ops[idx].num_warps_per_uop;
+                int uop_id_diff = branch_ops[idx].uop_id_diff;
+                int uop_id_begin = branch_ops[idx].uop_id_begin;
                 int uop_id_begin_diff =
-                    warp_branch.branch_ops[idx + 1].uop_id_begin -
-                    warp_branch.branch_ops[idx].uop_id_begin;
+                    branch_ops[idx + 1].uop_id_begin -
+                    branch_ops[idx].uop_id_begin;
                 size_t idx2 = idx + 1;
-                for (; idx2 < warp_branch.branch_ops.size(); ++idx2) {
-                    auto &branch_op = warp_branch.branch_ops[idx2];
+                for (; idx2 < branch_ops.size(); ++idx2) {
+                    auto &branch_op = branch_ops[idx2];
                     if (branch_op.opseq_id != opseq_id ||
                         branch_op.num_warps_per_uop != num_warps_per_uop ||
                         branch_op.uop_id_diff != uop_id_diff ||
@@ -306,8 +381,8 @@ std::ostream &CodeGenerator::branch(std::ostream &os, const Branch &br,
                     ++idx;
                 }
             }
-            if (idx < warp_branch.branch_ops.size()) {
-                auto &branch_op = warp_branch.branch_ops[idx];
+            if (idx < branch_ops.size()) {
+                auto &branch_op = branch_ops[idx];
                 os << "      "
                    << uop_code(branch_op.opseq_id, branch_op.uop_id_diff,
                                branch_op.num_warps_per_uop,
@@ -396,6 +471,161 @@ std::ostream &CodeGenerator::opseq(std::ostream &os, const std::string &name,
     return os;
 }
 
+std::ostream &CodeGenerator::decl_opseq(std::ostream &os,
+                                        const std::string &name) const {
+    os << "__device__ void " << name
+       << "(char *_buf, int _uop_idx, int _smem_per_warp);\n";
+    return os;
+}
+
+std::string CodeGenerator::opseq_key(
+    const SchedOpSeq &opseq, std::map<std::string, int> &uop_map) const {
+    std::stringstream ss;
+    for (auto &sop : opseq.get_sched_ops()) {
+        if (sop.is_virtual()) {
+            continue;
+        }
+        auto uop_map_it = uop_map.find(sop.serialize());
+        if (uop_map_it == uop_map.end()) {
+            // Not shared.
+            return "";
+        }
+        ss << uop_map_it->second << "(";
+        OpArgs call_args = sop.get_op()->function_call_args(*sop.get_cfg());
+        for (const OpArg &arg : call_args.get_args()) {
+            // The types are determined by the uop, but a tensor may be local
+            // or imported from another rank.
+            if (arg.type == OP_ARG_TENSOR) {
+                Tensor *tns;
+                arg.get(&tns);
+                ss << tns->imported_rank;
+            }
+            ss << ",";
+        }
+        ss << ")";
+    }
+    if (ss.tellp() == 0) {
+        return "";
+    }
+    auto &tdims = opseq.get_tdims();
+    ss << tdims[0] << "," << tdims[1] << "," << tdims[2];
+    return ss.str();
+}
+
+std::ostream &CodeGenerator::shared_opseq(
+    std::ostream &os, int shared_id,
+    const std::vector<const SchedOpSeq *> &opseqs,
+    std::map<std::string, int> &uop_map) const {
+    if (opseqs.empty()) {
+        return os;
+    }
+    std::string suffix = std::to_string(shared_id);
+    std::string struct_name = "ArkOpSeqArgs" + suffix;
+    std::string table_name = SHARED_OP_ARGS_NAME "_" + suffix;
+    auto args_of = [](const SchedOp &sop) {
+        return sop.get_op()->function_call_args(*sop.get_cfg()).get_args();
+    };
+
+    // Arguments of every uop, where tensors are passed as byte offsets.
+    const SchedOpSeq &first = *opseqs[0];
+    os << "struct " << struct_name << " {";
+    int cnt_param = 0;
+    for (auto &sop : first.get_sched_ops()) {
+        if (sop.is_virtual()) continue;
+        for (const OpArg &arg : args_of(sop)) {
+            std::string name = " _" + std::to_string(cnt_param++);
+            if (arg.type == OP_ARG_TENSOR) {
+                os << " uint64_t" << name << ";";
+            } else {
+                this->def_oparg(os, arg, name) << ";";
+            }
+        }
+    }
+    os << " };\n";
+
+    // Every thread of a uop reads the same entry, which the constant cache
+    // broadcasts.
+    os << "__constant__ " << struct_name << " " << table_name << "["
+       << opseqs.size() << "] = {\n";
+    for (auto opseq : opseqs) {
+        os << "  {";
+        int cnt = 0;
+        for (auto &sop : opseq->get_sched_ops()) {
+            if (sop.is_virtual()) continue;
+            for (const OpArg &arg : args_of(sop)) {
+                os << ((cnt++ == 0) ? "" : ", ");
+                if (arg.type == OP_ARG_TENSOR) {
+                    Tensor *tns;
+                    arg.get(&tns);
+                    os << this->get_tensor_offset(tns);
+                } else if (arg.type == OP_ARG_BOOL) {
+                    bool val;
+                    arg.get(&val);
+                    os << (val ? "true" : "false");
+                } else {
+                    this->oparg(os, arg);
+                }
+            }
+        }
+        os << "},\n";
+    }
+    os << "};\n";
+
+    os << "// tile dims: (" << first.get_tdims()[0] << ", "
+       << first.get_tdims()[1] << ", " << first.get_tdims()[2] << ")\n"
+       << "__noinline__ __device__ void " SHARED_OP_PREFIX << suffix
+       << "(char *_buf, int _idx, int _uop_idx, int _smem_per_warp) {\n"
+       << "  const " << struct_name << " &_args = " << table_name
+       << "[_idx];\n";
+    cnt_param = 0;
+    for (auto &sop : first.get_sched_ops()) {
+        if (sop.is_virtual()) continue;
+        os << "  ";
+        this->uop(os, uop_map.at(sop.serialize())) << '(';
+        for (const OpArg &arg : args_of(sop)) {
+            std::string name = "_args._" + std::to_string(cnt_param++);
+            if (arg.type == OP_ARG_TENSOR) {
+                Tensor *tns;
+                arg.get(&tns);
+                std::string buf_name = "_buf";
+                if (tns->imported_rank >= 0) {
+                    buf_name =
+                        ARK_BUF_NAME + std::to_string(tns->imported_rank);
+                }
+                os << "(" << tns->type.type_str() << " *)&" << buf_name
+                   << "[" << name << "]";
+            } else {
+                os << name;
+            }
+            os << ", ";
+        }
+        os << "_uop_idx, _smem_per_warp);\n";
+    }
+    os << "}\n";
+    return os;
+}
+
+std::ostream &CodeGenerator::decl_shared_opseq(std::ostream &os,
+                                               int shared_id) const {
+    os << "__device__ void " SHARED_OP_PREFIX << shared_id
+       << "(char *_buf, int _idx, int _uop_idx, int _smem_per_warp);\n";
+    return os;
+}
+
+std::ostream &CodeGenerator::shared_opseq_wrappers(
+    std::ostream &os, int shared_id,
+    const std::vector<const SchedOpSeq *> &opseqs) const {
+    // Each opseq is a thin wrapper that selects its arguments.
+    std::string suffix = std::to_string(shared_id);
+    for (size_t idx = 0; idx < opseqs.size(); ++idx) {
+        os << "DEVICE void " OP_PREFIX << opseqs[idx]->get_id()
+           << "(char *_buf, int _uop_idx, int _smem_per_warp) { "
+           << SHARED_OP_PREFIX << suffix << "(_buf, " << idx
+           << ", _uop_idx, _smem_per_warp); }\n";
+    }
+    return os;
+}
+
 std::ostream &CodeGenerator::def_proxy_channels(std::ostream &os,
                                                 size_t num_channels) const {
     if (num_channels == 0) {
@@ -5,6 +5,8 @@
 #define ARK_SCHED_CODEGEN_H_
 
 #include <map>
+#include <string>
+#include <vector>
 
 #include "gpu/gpu_loop_kernel.h"
 #include "sched/sched_op.h"
@@ -13,12 +15,33 @@
 
 namespace ark {
 
+/// Dynamic dispatch of the uops of an opseq: the warps that the opseq is
+/// placed on grab uops from a device-side work queue, instead of running a
+/// static set of uops each.
+struct SchedWorkQueue {
+    /// Number of uops of the opseq.
+    int num_uops;
+    /// Number of consecutive uops that a group of warps grabs at a time.
+    int chunk_size;
+    /// Number of warp groups that share the queue, counted once for each
+    /// warp branch that runs it.
+    int num_groups;
+};
+
 class CodeGenerator {
    public:
-    CodeGenerator(const GpuManager::Info &gpu_info_, int num_warps_per_sm_);
+    /// If @p trace_records_per_sm_ is positive, the generated code records
+    /// the start and end time of every uop into a ring of that many records
+    /// per SM, which @ref GpuLoopKernel::get_trace reads.
+    CodeGenerator(const GpuManager::Info &gpu_info_, int num_warps_per_sm_,
+                  int trace_records_per_sm_ = 0);
 
     std::ostream &def_remote_buf(std::ostream &os, int remote_rank) const;
 
+    /// Declare the remote buffer of @p remote_rank that is defined in another
+    /// translation unit.
+    std::ostream &decl_remote_buf(std::ostream &os, int remote_rank) const;
+
     std::ostream &sync_gpu(std::ostream &os) const;
 
     std::ostream &def_sync_stream(std::ostream &os, int stream_id) const;
@@ -31,8 +54,18 @@ class CodeGenerator {
                             const std::string &name) const;
     std::ostream &oparg(std::ostream &os, const OpArg &arg) const;
 
-    std::ostream &branch(std::ostream &os, const Branch &branch,
-                         int prev_sm_id_end = -1) const;
+    std::ostream &def_work_queue(std::ostream &os, int opseq_id) const;
+    std::ostream &def_work_queue_slots(std::ostream &os) const;
+
+    /// Define the trace records and their counts per SM if the code records
+    /// a trace.
+    std::ostream &def_trace(std::ostream &os) const;
+
+    /// Generate the code of @p branch. Opseqs in @p work_queues run through
+    /// their work queue instead of the static mapping of warps to uops.
+    std::ostream &branch(
+        std::ostream &os, const Branch &branch, int prev_sm_id_end = -1,
+        const std::map<int, SchedWorkQueue> &work_queues = {}) const;
 
     std::ostream &def_uop(std::ostream &os, const SchedOp &sop,
                           int uop_id) const;
@@ -43,6 +76,33 @@ class CodeGenerator {
                         const SchedOpSeq &opseq,
                         std::map<std::string, int> &uop_map) const;
 
+    /// Key of the structure of @p opseq, which is the same for opseqs that
+    /// only differ in the values of their arguments, or empty if @p opseq
+    /// cannot share code with others.
+    std::string opseq_key(const SchedOpSeq &opseq,
+                          std::map<std::string, int> &uop_map) const;
+
+    /// Declare the function of an opseq that is defined in another
+    /// translation unit.
+    std::ostream &decl_opseq(std::ostream &os, const std::string &name) const;
+
+    /// Define a single function for @p opseqs that have the same
+    /// @ref opseq_key, which reads the arguments from a table indexed by the
+    /// opseq.
+    std::ostream &shared_opseq(std::ostream &os, int shared_id,
+                               const std::vector<const SchedOpSeq *> &opseqs,
+                               std::map<std::string, int> &uop_map) const;
+
+    /// Declare the function of @ref shared_opseq that is defined in another
+    /// translation unit.
+    std::ostream &decl_shared_opseq(std::ostream &os, int shared_id) const;
+
+    /// Define a thin wrapper of the function of @ref shared_opseq for each of
+    /// @p opseqs.
+    std::ostream &shared_opseq_wrappers(
+        std::ostream &os, int shared_id,
+        const std::vector<const SchedOpSeq *> &opseqs) const;
+
     std::ostream &def_proxy_channels(std::ostream &os,
                                      size_t num_channels) const;
 
@@ -56,6 +116,7 @@ class CodeGenerator {
     int num_warps_per_sm;
     int world_size;
     int num_indent;
+    int trace_records_per_sm;
 };
 
 }  // namespace ark
@@ -0,0 +1,100 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "sched/sched_codegen.h"
+
+#include <cstdlib>
+#include <sstream>
+
+#include "env.h"
+#include "gpu/gpu_profile.h"
+#include "include/ark.h"
+#include "sched/sched.h"
+#include "unittest/unittest_utils.h"
+
+static bool contains(const std::string &str, const std::string &sub) {
+    return str.find(sub) != std::string::npos;
+}
+
+ark::unittest::State test_sched_codegen_trace() {
+    ark::GpuManager::Info info = ark::gpu_profile("a100");
+    // Opseq 3 runs with two warps per uop on SMs [0, 4), and opseq 5 through
+    // a work queue.
+    ark::BranchOp op3{3, 0, 1, 2, 2};
+    ark::BranchOp op5{5, 0, 1, 1, 4};
+    ark::Branch br{0, 4, 0, {{0, 4, {op3}}, {4, 8, {op5}}}};
+    std::map<int, ark::SchedWorkQueue> work_queues;
+    work_queues[5] = ark::SchedWorkQueue{64, 2, 16};
+
+    ark::CodeGenerator plain{info, 8};
+    std::stringstream plain_def;
+    std::stringstream plain_code;
+    plain.def_trace(plain_def);
+    plain.branch(plain_code, br, -1, work_queues);
+    UNITTEST_TRUE(plain_def.str().empty());
+    UNITTEST_TRUE(!contains(plain_code.str(), "trace_uop"));
+
+    ark::CodeGenerator traced{info, 8, 16};
+    std::stringstream traced_def;
+    std::stringstream traced_code;
+    traced.def_trace(traced_def);
+    traced.branch(traced_code, br, -1, work_queues);
+    std::string def = traced_def.str();
+    std::string code = traced_code.str();
+    UNITTEST_TRUE(contains(def, "__device__ ark::TraceRecord ARK_TRACE[" +
+                                    std::to_string(info.num_sm * 16) + "];"));
+    UNITTEST_TRUE(contains(def, "__device__ unsigned int ARK_TRACE_COUNTS[" +
+                                    std::to_string(info.num_sm) + "];"));
+    // Statically mapped uops are recorded with their uop index.
+    UNITTEST_TRUE(contains(
+        code,
+        "ark::trace_uop<2, 16>(ARK_TRACE, ARK_TRACE_COUNTS, _iter, 3, "
+        "((blockIdx.x * 2) + (threadIdx.x >> 6)) + 0, [&](int _t) { "
+        "op3(_buf, _t, 0); });"));
+    // So are the uops that a work queue hands out.
+    UNITTEST_TRUE(contains(
+        code,
+        "[&](int _u) { ark::trace_uop<1, 16>(ARK_TRACE, ARK_TRACE_COUNTS, "
+        "_iter, 5, _u, [&](int _t) { op5(_buf, _t, 0); }); }"));
+    // Every uop call is recorded.
+    UNITTEST_TRUE(!contains(code, "op3(_buf, ((blockIdx"));
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_sched_codegen_trace_env() {
+    ::setenv("ARK_TRACE", "/tmp/ark_trace.json", 1);
+    ::setenv("ARK_TRACE_RECORDS_PER_SM", "256", 1);
+    ark::get_env(true);
+
+    ark::Model m;
+    ark::Tensor *a = m.tensor({256, 256}, ark::FP16);
+    ark::Tensor *b = m.tensor({256, 256}, ark::FP16);
+    m.add(a, b);
+
+    ark::DefaultScheduler sched{m, ark::gpu_profile("a100"), 0, 1};
+    sched.schedule();
+    sched.plan_context();
+    auto codes = sched.gen_code();
+    UNITTEST_TRUE(!codes.empty());
+    UNITTEST_TRUE(contains(codes[0], "ARK_TRACE_COUNTS["));
+    UNITTEST_TRUE(contains(codes[0], "ark::trace_uop<"));
+    UNITTEST_TRUE(contains(codes[0], ", 256>(ARK_TRACE, ARK_TRACE_COUNTS, "));
+
+    ::unsetenv("ARK_TRACE");
+    ::unsetenv("ARK_TRACE_RECORDS_PER_SM");
+    ark::get_env(true);
+
+    ark::DefaultScheduler sched2{m, ark::gpu_profile("a100"), 0, 1};
+    sched2.schedule();
+    sched2.plan_context();
+    auto codes2 = sched2.gen_code();
+    UNITTEST_TRUE(!contains(codes2[0], "ARK_TRACE"));
+    return ark::unittest::SUCCESS;
+}
+
+int main() {
+    ark::init();
+    UNITTEST(test_sched_codegen_trace);
+    UNITTEST(test_sched_codegen_trace_env);
+    return 0;
+}
@@ -0,0 +1,144 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "sched/sched_cost.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+#include "math_utils.h"
+
+namespace ark {
+
+std::ostream &operator<<(std::ostream &os, const SchedOpCandidate &cand) {
+    os << "gran_lev " << cand.gran_lev << ": tile {" << cand.tile_x << ", "
+       << cand.tile_y << "}, num_warps " << cand.cfg->num_warps
+       << ", smem_bytes " << cand.cfg->smem_bytes << ", num_tiles "
+       << cand.num_tiles << ", tiles_per_sm " << cand.tiles_per_sm
+       << ", num_waves " << cand.num_waves << ", flops/tile "
+       << cand.flops_per_tile << ", bytes/tile " << cand.bytes_per_tile
+       << ", cost " << cand.cost << " us";
+    return os;
+}
+
+// Approximate figures from public datasheets. Per-SM FLOPs are the peak
+// device FLOPs divided by the SM count and the boost clock; a ROCm "SM" is a
+// compute unit, and MI250X counts a single GCD. Link bytes are the NVLink
+// bandwidth per direction of the whole GPU, or that of the Infinity Fabric
+// link to a single peer on ROCm.
+static const std::map<std::string, AnalyticalCostModel::Params> arch_params =
+    {
+        // mma_flops_16, mma_flops_32, simt_flops, dram_bytes, link_bytes,
+        // wave_overhead
+        {"cuda_70", {1024, 128, 128, 588, 98, 2000}},
+        {"cuda_80", {2048, 1024, 128, 1418, 213, 2000}},
+        {"cuda_90", {4096, 2048, 256, 1692, 227, 2000}},
+        {"rocm_90a", {1024, 256, 128, 941, 29, 2000}},
+        {"rocm_942", {2048, 256, 256, 2524, 30, 2000}},
+};
+
+AnalyticalCostModel::Params AnalyticalCostModel::get_params(
+    const std::string &arch) {
+    auto it = arch_params.find(arch);
+    if (it == arch_params.end()) {
+        return Params{};
+    }
+    return it->second;
+}
+
+void AnalyticalCostModel::estimate(const Op &op,
+                                   const GpuManager::Info &gpu_info,
+                                   int num_warps_per_sm,
+                                   SchedOpCandidate &cand) const {
+    const Params params = get_params(gpu_info.arch);
+    if (op.is_comm()) {
+        double bytes = 0;
+        if (op.type == OP_SEND_DONE) {
+            bytes = (double)op.inputs[0]->shape_bytes();
+        } else if (op.type == OP_RECV) {
+            size_t recv_bytes;
+            op.args.get(&recv_bytes, 2);
+            bytes = (double)recv_bytes;
+        }
+        cand.flops_per_tile = 0;
+        cand.bytes_per_tile = bytes;
+        cand.tiles_per_sm = 1;
+        cand.num_waves = 1;
+        // `clk_rate` is in kHz.
+        cand.cost = (bytes / params.link_bytes + params.wave_overhead) /
+                    (gpu_info.clk_rate / 1e3);
+        return;
+    }
+    const OpConfig &cfg = *cand.cfg;
+    const Tensor *output = op.outputs[0];
+    double tile_elems = (double)cand.tile_x * cand.tile_y;
+
+    // Work of a single tile. Partial tiles at the edges cost as much as full
+    // ones, which accounts for the padding waste.
+    double throughput;
+    if (op.type == OP_MATMUL) {
+        // Each tile reads a (tile_x x K) slice of A and a (K x tile_y) slice
+        // of B, so larger tiles have higher arithmetic intensity.
+        Dims problem_size;
+        op.args.get(&problem_size, 2);
+        double k = (double)problem_size[2];
+        int in_bytes = op.inputs[0]->type_bytes();
+        cand.flops_per_tile = 2 * tile_elems * k;
+        cand.bytes_per_tile = (cand.tile_x + cand.tile_y) * k * in_bytes +
+                              tile_elems * output->type_bytes();
+        throughput = (output->type_bytes() <= 2) ? params.mma_flops_16
+                                                 : params.mma_flops_32;
+    } else {
+        // Streaming ops touch every input and output element about once.
+        double op_bytes = 0;
+        for (auto &t : op.inputs) {
+            op_bytes += (double)t->shape_bytes();
+        }
+        for (auto &t : op.outputs) {
+            op_bytes += (double)t->shape_bytes();
+        }
+        double out_elems = std::max((double)output->shape.size(), 1.0);
+        cand.flops_per_tile = tile_elems;
+        cand.bytes_per_tile = op_bytes / out_elems * tile_elems;
+        throughput = params.simt_flops;
+    }
+    // Global memory is accessed in 32-byte sectors, so narrow rows of a tile
+    // waste bandwidth.
+    double row_bytes = (double)cand.tile_y * output->type_bytes();
+    cand.bytes_per_tile *= std::ceil(row_bytes / 32) * 32 / row_bytes;
+
+    // Residency on a single SM.
+    int tiles_per_sm = num_warps_per_sm / cfg.num_warps;
+    if (cfg.smem_bytes > 0) {
+        int smem_limit = gpu_info.smem_block_total / cfg.smem_bytes;
+        tiles_per_sm = std::min(tiles_per_sm, smem_limit);
+    }
+    tiles_per_sm = std::max(tiles_per_sm, 1);
+    cand.tiles_per_sm = tiles_per_sm;
+
+    // The busiest SM runs this many tiles, in this many waves.
+    DimType max_tiles = math::div_up(cand.num_tiles, (DimType)gpu_info.num_sm);
+    cand.num_waves = math::div_up(max_tiles, (DimType)tiles_per_sm);
+
+    // Memory bandwidth is shared by the active SMs, and a single SM cannot
+    // draw much more than its fair share of it.
+    double active_sms =
+        (double)std::min(cand.num_tiles, (DimType)gpu_info.num_sm);
+    double fair_bytes = params.dram_bytes / gpu_info.num_sm;
+    double sm_bytes = std::min(params.dram_bytes / active_sms, 4 * fair_bytes);
+
+    // An SM reaches its peak only if it has enough resident warps.
+    DimType resident = std::min(max_tiles, (DimType)tiles_per_sm);
+    double saturate_warps = std::max(num_warps_per_sm / 2, 1);
+    double util = std::min(resident * cfg.num_warps / saturate_warps, 1.0);
+
+    double tile_cycles = std::max(cand.flops_per_tile / throughput,
+                                  cand.bytes_per_tile / sm_bytes);
+    double cycles = max_tiles * tile_cycles / util +
+                    cand.num_waves * params.wave_overhead;
+    // `clk_rate` is in kHz.
+    cand.cost = cycles / (gpu_info.clk_rate / 1e3);
+}
+
+}  // namespace ark
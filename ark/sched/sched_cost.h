@@ -0,0 +1,103 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#ifndef ARK_SCHED_COST_H_
+#define ARK_SCHED_COST_H_
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "gpu/gpu_manager.h"
+#include "ops/ops_common.h"
+
+namespace ark {
+
+/// A feasible @ref OpConfig of an @ref Op and its estimated cost.
+struct SchedOpCandidate {
+    /// The configuration.
+    const OpConfig *cfg = nullptr;
+    /// Index of @ref cfg in the config list of the @ref Op, i.e., the
+    /// granularity level that selects this configuration.
+    int gran_lev = -1;
+    /// Output tile shape. -1 in the @ref OpConfig is resolved into the
+    /// leading dimensions of the output.
+    DimType tile_x = 0;
+    DimType tile_y = 0;
+    /// Number of output tiles.
+    DimType num_tiles = 0;
+    /// Number of tiles that fit on a single SM at the same time, limited by
+    /// warps and shared memory.
+    int tiles_per_sm = 0;
+    /// Number of waves on the busiest SM.
+    DimType num_waves = 0;
+    /// Estimated FLOPs and global memory traffic of a single tile.
+    double flops_per_tile = 0;
+    double bytes_per_tile = 0;
+    /// Estimated latency of the @ref Op in microseconds.
+    double cost = 0;
+};
+
+std::ostream &operator<<(std::ostream &os, const SchedOpCandidate &cand);
+
+/// Estimates the latency of running an @ref Op with a given @ref OpConfig.
+/// @ref BaseScheduler::sched_op_config picks the candidate of the minimum
+/// cost, so a custom model can be plugged in via
+/// @ref BaseScheduler::set_cost_model.
+class SchedCostModel {
+   public:
+    virtual ~SchedCostModel() = default;
+
+    /// Estimate the cost of @p cand. The tile shape and the number of tiles
+    /// are already filled in; implementations set @ref SchedOpCandidate::cost
+    /// and any other estimates they make.
+    /// @param op the @ref Op to run.
+    /// @param gpu_info the target GPU.
+    /// @param num_warps_per_sm number of warps that an SM can run at a time.
+    /// @param cand the candidate to estimate.
+    virtual void estimate(const Op &op, const GpuManager::Info &gpu_info,
+                          int num_warps_per_sm,
+                          SchedOpCandidate &cand) const = 0;
+};
+
+/// Roofline-style cost model. Each tile is bounded by either the compute
+/// throughput or the memory bandwidth of an SM, and the latency of the
+/// @ref Op is that of the busiest SM, which takes the tail wave into
+/// account. Small tiles that leave an SM without enough resident warps to
+/// hide latency are penalized, and so is the padding of partial tiles.
+///
+/// Communication ops are bounded by the link to the peer GPU instead. A
+/// `send` only posts the transfer, which `send_done` on the sender and `recv`
+/// on the receiver wait for, so the latter two take the bytes of the transfer
+/// over the link bandwidth, assuming that the link is not shared. Contention
+/// with other transfers and the time spent waiting for a late peer are not
+/// modeled.
+class AnalyticalCostModel : public SchedCostModel {
+   public:
+    /// Throughput of a GPU architecture.
+    struct Params {
+        /// FLOPs per cycle per SM of matrix-multiply units for 16-bit and
+        /// 32-bit floating points.
+        double mma_flops_16 = 1024;
+        double mma_flops_32 = 256;
+        /// FLOPs per cycle per SM of scalar (non-matmul) arithmetic.
+        double simt_flops = 128;
+        /// Global memory bytes per cycle of the whole device.
+        double dram_bytes = 1024;
+        /// Bytes per cycle of the link to a peer GPU in each direction.
+        double link_bytes = 32;
+        /// Fixed cycles per wave of tiles, e.g., prologue and barriers.
+        double wave_overhead = 2000;
+    };
+
+    /// Parameters of the architecture @p arch (e.g., "cuda_80"). Unknown
+    /// architectures get conservative defaults.
+    static Params get_params(const std::string &arch);
+
+    void estimate(const Op &op, const GpuManager::Info &gpu_info,
+                  int num_warps_per_sm, SchedOpCandidate &cand) const override;
+};
+
+}  // namespace ark
+
+#endif  // ARK_SCHED_COST_H_
@@ -0,0 +1,134 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "sched/sched_cost.h"
+
+#include "gpu/gpu_profile.h"
+#include "include/ark.h"
+#include "logging.h"
+#include "sched/sched.h"
+#include "unittest/unittest_utils.h"
+
+static std::vector<const ark::Op *> get_ops(const ark::OpGraph &graph,
+                                            ark::OpType type) {
+    std::vector<const ark::Op *> ops;
+    for (auto &node : graph.get_nodes()) {
+        for (auto &op : node->ops) {
+            if (op->type == type) ops.emplace_back(op);
+        }
+    }
+    return ops;
+}
+
+ark::unittest::State test_sched_cost_matmul() {
+    for (auto &name : {"a100", "mi250x", "mi300x"}) {
+        ark::Model m;
+        // gran_lev is given to keep the scheduler from splitting them.
+        ark::Tensor *a0 = m.tensor({4096, 4096}, ark::FP16);
+        ark::Tensor *b0 = m.tensor({4096, 4096}, ark::FP16);
+        m.matmul(a0, b0, nullptr, 1, false, false, "large", 0);
+        ark::Tensor *a1 = m.tensor({256, 4096}, ark::FP16);
+        ark::Tensor *b1 = m.tensor({4096, 256}, ark::FP16);
+        m.matmul(a1, b1, nullptr, 1, false, false, "small", 0);
+
+        ark::DefaultScheduler sched{m, ark::gpu_profile(name), 0, 1};
+        ark::OpGraph graph(m);
+        auto ops = get_ops(graph, ark::OP_MATMUL);
+        UNITTEST_EQ(ops.size(), 2UL);
+        const ark::Op *large = (ops[0]->name == "large") ? ops[0] : ops[1];
+        const ark::Op *small = (ops[0]->name == "large") ? ops[1] : ops[0];
+
+        // A large matmul has enough tiles for all SMs, so it prefers the
+        // largest tile for its arithmetic intensity.
+        auto ranked = sched.rank_op_configs(large);
+        UNITTEST_TRUE(ranked.size() > 1);
+        for (auto &cand : ranked) {
+            UNITTEST_TRUE(cand.tile_x * cand.tile_y <=
+                          ranked[0].tile_x * ranked[0].tile_y);
+        }
+        for (size_t i = 1; i < ranked.size(); ++i) {
+            UNITTEST_TRUE(ranked[i - 1].cost <= ranked[i].cost);
+        }
+
+        // A small matmul prefers smaller tiles to occupy more SMs.
+        ranked = sched.rank_op_configs(small);
+        UNITTEST_TRUE(ranked.size() > 1);
+        for (auto &cand : ranked) {
+            UNITTEST_TRUE(cand.tile_x * cand.tile_y >=
+                          ranked[0].tile_x * ranked[0].tile_y);
+        }
+
+        std::string dump = sched.dump_op_configs(small);
+        LOG(ark::INFO, name, ": ", dump);
+        UNITTEST_NE(dump.find("gran_lev"), std::string::npos);
+    }
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_sched_cost_tail_wave() {
+    ark::GpuManager::Info info = ark::gpu_profile("a100");
+    ark::Model m;
+    ark::Tensor *x = m.tensor({1024, 1024}, ark::FP16);
+    m.relu(x);
+    ark::OpGraph graph(m);
+    auto ops = get_ops(graph, ark::OP_RELU);
+    UNITTEST_EQ(ops.size(), 1UL);
+
+    ark::OpConfig cfg;
+    cfg.num_warps = 4;
+    ark::AnalyticalCostModel model;
+    auto estimate = [&](ark::DimType num_tiles) {
+        ark::SchedOpCandidate cand;
+        cand.cfg = &cfg;
+        cand.tile_x = 1;
+        cand.tile_y = 1024;
+        cand.num_tiles = num_tiles;
+        model.estimate(*ops[0], info, 16, cand);
+        return cand;
+    };
+    // One more tile than a full wave costs one more wave.
+    auto full = estimate(info.num_sm * 4);
+    auto tail = estimate(info.num_sm * 4 + 1);
+    UNITTEST_EQ(full.tiles_per_sm, 4);
+    UNITTEST_EQ(full.num_waves, 1);
+    UNITTEST_EQ(tail.num_waves, 2);
+    UNITTEST_TRUE(tail.cost > full.cost);
+    return ark::unittest::SUCCESS;
+}
+
+// Prefers the finest granularity.
+class FinestCostModel : public ark::SchedCostModel {
+   public:
+    void estimate(const ark::Op &, const ark::GpuManager::Info &, int,
+                  ark::SchedOpCandidate &cand) const override {
+        cand.cost = -cand.gran_lev;
+    }
+};
+
+ark::unittest::State test_sched_cost_custom() {
+    ark::Model m;
+    ark::Tensor *a = m.tensor({4096, 4096}, ark::FP16);
+    ark::Tensor *b = m.tensor({4096, 4096}, ark::FP16);
+    m.matmul(a, b, nullptr, 1, false, false, "matmul", 0);
+
+    ark::DefaultScheduler sched{m, ark::gpu_profile("a100"), 0, 1};
+    ark::OpGraph graph(m);
+    auto ops = get_ops(graph, ark::OP_MATMUL);
+    UNITTEST_EQ(ops.size(), 1UL);
+    auto ranked = sched.rank_op_configs(ops[0]);
+    UNITTEST_EQ(ranked[0].gran_lev, 0);
+
+    sched.set_cost_model(std::make_shared<FinestCostModel>());
+    ranked = sched.rank_op_configs(ops[0]);
+    UNITTEST_EQ(ranked[0].gran_lev, (int)ranked.size() - 1);
+    UNITTEST_THROW(sched.set_cost_model(nullptr), ark::InvalidUsageError);
+    return ark::unittest::SUCCESS;
+}
+
+int main() {
+    ark::init();
+    UNITTEST(test_sched_cost_matmul);
+    UNITTEST(test_sched_cost_tail_wave);
+    UNITTEST(test_sched_cost_custom);
+    return 0;
+}
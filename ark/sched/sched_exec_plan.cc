@@ -0,0 +1,485 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "sched/sched_exec_plan.h"
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <sstream>
+
+#include "env.h"
+#include "file_io.h"
+#include "hash.h"
+#include "json.h"
+#include "logging.h"
+#include "model.h"
+#include "sched/sched.h"
+
+namespace ark {
+
+// Bump this if the format of the plan changes.
+static const int EXEC_PLAN_VERSION = 2;
+
+ExecPlan::ModelRef::ModelRef(const Model &model) {
+    for (auto buf : model.impl->get_tensor_bufs()) {
+        this->bufs.emplace_back(buf);
+        this->buf_ids.emplace_back(buf->id);
+    }
+    for (auto tns : model.impl->get_tensors()) {
+        this->tensors.emplace_back(tns);
+        this->tensor_ids.emplace_back(tns->id);
+        this->tensor_names.emplace_back(tns->name);
+    }
+}
+
+int ExecPlan::ModelRef::tensor_index(const Tensor *tns) const {
+    for (size_t i = 0; i < this->tensors.size(); ++i) {
+        if (this->tensors[i] == tns && this->tensor_ids[i] == tns->id &&
+            this->tensor_names[i] == tns->name) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+int ExecPlan::ModelRef::buf_index(const TensorBuf *buf) const {
+    for (size_t i = 0; i < this->bufs.size(); ++i) {
+        if (this->bufs[i] == buf && this->buf_ids[i] == buf->id) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+ExecPlan::ExecPlan(const ModelRef &ref, const BaseScheduler &sched,
+                   const std::vector<std::string> &codes,
+                   const std::string &hash)
+    : hash{hash},
+      arch{sched.gpu_info.arch},
+      num_sm{sched.gpu_info.num_sm},
+      smem_block_total{sched.gpu_info.smem_block_total},
+      rank{sched.rank},
+      world_size{sched.world_size},
+      num_warps_per_sm{sched.num_warps_per_sm},
+      shared_bytes{sched.shared_bytes},
+      shared_align{sched.mem_planner.get_max_align()},
+      settings{env_settings()},
+      codes{codes} {
+    const auto &buf_infos = sched.buf_infos;
+    for (size_t i = 0; i < buf_infos.size(); ++i) {
+        const BufInfo &bi = buf_infos[i];
+        Buf b;
+        b.gpu_id = bi.gpu_id;
+        b.bytes = bi.bytes;
+        b.sid = bi.sid;
+        b.export_offset = bi.offset;
+        if (bi.tbuf != nullptr) {
+            b.model_buf = ref.buf_index(bi.tbuf);
+            for (size_t j = 0; j < i; ++j) {
+                if (buf_infos[j].tbuf == bi.tbuf) {
+                    b.alias = (int)j;
+                    break;
+                }
+            }
+            if (bi.gpu_id == sched.gpu_id && bi.tbuf->buf != nullptr) {
+                b.data_offset = (long long)bi.tbuf->buf->get_offset();
+            }
+        }
+        if (bi.gpu_id == sched.gpu_id && sched.mem_planner.has((int)i)) {
+            b.shared_offset = (long long)sched.mem_planner.get_offset((int)i);
+        }
+        this->bufs.emplace_back(b);
+    }
+
+    auto cur_bufs = sched.model->impl->get_tensor_bufs();
+    for (size_t i = 0; i < ref.bufs.size(); ++i) {
+        DimType bytes = -1;
+        for (auto buf : cur_bufs) {
+            if (ref.buf_index(buf) == (int)i) {
+                bytes = buf->bytes;
+                break;
+            }
+        }
+        this->model_buf_bytes.emplace_back(bytes);
+    }
+    for (auto tns : sched.model->impl->get_tensors()) {
+        int idx = ref.tensor_index(tns);
+        if (idx == -1) continue;
+        this->tensors.emplace_back(
+            TensorLayout{idx, tns->ldims, tns->offs, tns->pads});
+    }
+
+    for (auto &opseq : sched.opseqs) {
+        OpSeqInfo info;
+        info.id = opseq->get_id();
+        info.name = opseq->get_name();
+        info.num_warps = opseq->get_num_warps();
+        info.smem_bytes = opseq->get_smem_bytes();
+        info.tdims = opseq->get_tdims();
+        for (auto &sop : opseq->get_sched_ops()) {
+            info.functions.emplace_back(sop.function_name());
+        }
+        this->opseqs.emplace_back(info);
+    }
+}
+
+// Tensors and ops refer to each other by their indices in the model, so that
+// the hash does not depend on addresses or on the ids that the model assigns.
+std::string ExecPlan::model_hash(const Model &model) {
+    std::map<const TensorBuf *, int> buf_idx;
+    std::map<const Tensor *, int> tns_idx;
+    std::stringstream ss;
+    ss << "ark-model;";
+    for (auto buf : model.impl->get_tensor_bufs()) {
+        int idx = (int)buf_idx.size();
+        buf_idx[buf] = idx;
+        ss << "b" << idx << ":" << buf->bytes << "," << buf->immutable << ";";
+    }
+    auto tensor_index = [&tns_idx](const Tensor *tns) {
+        auto it = tns_idx.find(tns);
+        return (it == tns_idx.end()) ? -1 : it->second;
+    };
+    for (auto tns : model.impl->get_tensors()) {
+        int idx = (int)tns_idx.size();
+        tns_idx[tns] = idx;
+        auto it = buf_idx.find(tns->buf);
+        ss << "t" << idx << ":" << tns->name << "," << tns->type.name() << ","
+           << tns->shape << tns->ldims << tns->offs << tns->pads << ","
+           << ((it == buf_idx.end()) ? -1 : it->second) << ","
+           << tns->exported << "," << tns->imported_rank << ";";
+    }
+    for (auto op : model.impl->get_ops()) {
+        ss << "o:" << op->type << "," << op->prec_type << "," << op->name
+           << "," << op->gran_lev << "," << op->force_inline << ",i";
+        for (auto tns : op->inputs) ss << tensor_index(tns) << ",";
+        ss << "o";
+        for (auto tns : op->outputs) ss << tensor_index(tns) << ",";
+        ss << "r";
+        for (auto tns : op->output_refs) ss << tensor_index(tns) << ",";
+        ss << "a";
+        for (auto &arg : op->args.get_args()) {
+            ss << arg.type << "=";
+            switch (arg.type) {
+                case OP_ARG_INT:
+                    ss << *static_cast<int *>(arg.val);
+                    break;
+                case OP_ARG_INT64:
+                    ss << *static_cast<long long int *>(arg.val);
+                    break;
+                case OP_ARG_UINT64:
+                    ss << *static_cast<uint64_t *>(arg.val);
+                    break;
+                case OP_ARG_BOOL:
+                    ss << *static_cast<bool *>(arg.val);
+                    break;
+                case OP_ARG_FLOAT: {
+                    // Hash the bits to tell apart floats that print the same.
+                    uint32_t bits;
+                    std::memcpy(&bits, arg.val, sizeof(bits));
+                    ss << std::hex << bits << std::dec;
+                    break;
+                }
+                case OP_ARG_DIMS:
+                    ss << *static_cast<Dims *>(arg.val);
+                    break;
+                case OP_ARG_TENSOR:
+                    ss << tensor_index(static_cast<Tensor *>(arg.val));
+                    break;
+                default:
+                    ERR(InvalidUsageError, "unknown argument type ", arg.type);
+            }
+            ss << ",";
+        }
+        ss << ";";
+    }
+    return sha256(ss.str());
+}
+
+static nlohmann::json dims_to_json(const Dims &dims) {
+    nlohmann::json j = nlohmann::json::array();
+    for (int i = 0; i < dims.ndims(); ++i) {
+        j.push_back(dims[i]);
+    }
+    return j;
+}
+
+static Dims dims_from_json(const nlohmann::json &j) {
+    return Dims(j.get<std::vector<DimType>>());
+}
+
+ExecPlan ExecPlan::load(const std::string &path) {
+    if (!is_file(path)) {
+        ERR(InvalidUsageError, "execution plan ", path, " does not exist");
+    }
+    nlohmann::json j;
+    try {
+        j = nlohmann::json::parse(read_file(path));
+    } catch (const nlohmann::json::exception &e) {
+        ERR(InvalidUsageError, "failed to parse execution plan ", path, ": ",
+            e.what());
+    }
+    if (j.value("version", 0) != EXEC_PLAN_VERSION) {
+        ERR(InvalidUsageError, "execution plan ", path,
+            " is of a different version");
+    }
+    ExecPlan plan;
+    try {
+        plan.hash = j.at("model_hash").get<std::string>();
+        plan.arch = j.at("arch").get<std::string>();
+        plan.num_sm = j.at("num_sm").get<int>();
+        plan.smem_block_total = j.at("smem_block_total").get<int>();
+        plan.rank = j.at("rank").get<int>();
+        plan.world_size = j.at("world_size").get<int>();
+        plan.num_warps_per_sm = j.at("num_warps_per_sm").get<int>();
+        plan.shared_bytes = j.at("shared_bytes").get<size_t>();
+        plan.shared_align = j.at("shared_align").get<int>();
+        plan.settings =
+            j.at("settings").get<std::map<std::string, std::string>>();
+        for (auto &jb : j.at("bufs")) {
+            Buf b;
+            b.model_buf = jb.at("model_buf").get<int>();
+            b.gpu_id = jb.at("gpu_id").get<int>();
+            b.bytes = jb.at("bytes").get<size_t>();
+            b.sid = jb.at("sid").get<int>();
+            b.export_offset = jb.at("export_offset").get<size_t>();
+            b.alias = jb.at("alias").get<int>();
+            b.shared_offset = jb.at("shared_offset").get<long long>();
+            b.data_offset = jb.at("data_offset").get<long long>();
+            plan.bufs.emplace_back(b);
+        }
+        plan.model_buf_bytes =
+            j.at("model_buf_bytes").get<std::vector<DimType>>();
+        for (auto &jt : j.at("tensors")) {
+            plan.tensors.emplace_back(TensorLayout{
+                jt.at("model_tensor").get<int>(),
+                dims_from_json(jt.at("ldims")), dims_from_json(jt.at("offs")),
+                dims_from_json(jt.at("pads"))});
+        }
+        for (auto &jo : j.at("opseqs")) {
+            OpSeqInfo info;
+            info.id = jo.at("id").get<int>();
+            info.name = jo.at("name").get<std::string>();
+            info.num_warps = jo.at("num_warps").get<int>();
+            info.smem_bytes = jo.at("smem_bytes").get<int>();
+            info.tdims = jo.at("tdims").get<std::array<int, 3>>();
+            info.functions =
+                jo.at("functions").get<std::vector<std::string>>();
+            plan.opseqs.emplace_back(info);
+        }
+        plan.codes = j.at("codes").get<std::vector<std::string>>();
+    } catch (const nlohmann::json::exception &e) {
+        ERR(InvalidUsageError, "invalid execution plan ", path, ": ",
+            e.what());
+    }
+    for (size_t i = 0; i < plan.bufs.size(); ++i) {
+        const Buf &b = plan.bufs[i];
+        if (b.alias >= (int)i ||
+            b.model_buf >= (int)plan.model_buf_bytes.size()) {
+            ERR(InvalidUsageError, "invalid execution plan ", path,
+                ": inconsistent buffer ", i);
+        }
+    }
+    if (plan.codes.empty()) {
+        ERR(InvalidUsageError, "invalid execution plan ", path, ": no code");
+    }
+    LOG(DEBUG, "loaded execution plan ", path, " with ", plan.bufs.size(),
+        " buffers and ", plan.opseqs.size(), " opseqs");
+    return plan;
+}
+
+void ExecPlan::save(const std::string &path) const {
+    nlohmann::json jbufs = nlohmann::json::array();
+    for (auto &b : this->bufs) {
+        jbufs.push_back({{"model_buf", b.model_buf},
+                         {"gpu_id", b.gpu_id},
+                         {"bytes", b.bytes},
+                         {"sid", b.sid},
+                         {"export_offset", b.export_offset},
+                         {"alias", b.alias},
+                         {"shared_offset", b.shared_offset},
+                         {"data_offset", b.data_offset}});
+    }
+    nlohmann::json jtensors = nlohmann::json::array();
+    for (auto &t : this->tensors) {
+        jtensors.push_back({{"model_tensor", t.model_tensor},
+                            {"ldims", dims_to_json(t.ldims)},
+                            {"offs", dims_to_json(t.offs)},
+                            {"pads", dims_to_json(t.pads)}});
+    }
+    nlohmann::json jopseqs = nlohmann::json::array();
+    for (auto &o : this->opseqs) {
+        jopseqs.push_back({{"id", o.id},
+                           {"name", o.name},
+                           {"num_warps", o.num_warps},
+                           {"smem_bytes", o.smem_bytes},
+                           {"tdims", o.tdims},
+                           {"functions", o.functions}});
+    }
+    nlohmann::json j;
+    j["version"] = EXEC_PLAN_VERSION;
+    j["model_hash"] = this->hash;
+    j["arch"] = this->arch;
+    j["num_sm"] = this->num_sm;
+    j["smem_block_total"] = this->smem_block_total;
+    j["rank"] = this->rank;
+    j["world_size"] = this->world_size;
+    j["num_warps_per_sm"] = this->num_warps_per_sm;
+    j["shared_bytes"] = this->shared_bytes;
+    j["shared_align"] = this->shared_align;
+    j["settings"] = this->settings;
+    j["bufs"] = jbufs;
+    j["model_buf_bytes"] = this->model_buf_bytes;
+    j["tensors"] = jtensors;
+    j["opseqs"] = jopseqs;
+    j["codes"] = this->codes;
+
+    std::string tmp_path = path + ".tmp." + std::to_string(::getpid());
+    write_file(tmp_path, j.dump(1));
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        remove_file(tmp_path);
+        ERR(SystemError, "failed to write execution plan ", path);
+    }
+}
+
+std::map<std::string, std::string> ExecPlan::env_settings() {
+    const Env &env = get_env();
+    bool trace = !env.trace_path.empty();
+    return {
+        {"ARK_DISABLE_GRAPH_OPT", std::to_string(env.disable_graph_opt)},
+        {"ARK_DISABLE_GRAPH_PASSES", env.disable_graph_passes},
+        {"ARK_DISPATCH", env.dispatch},
+        {"ARK_ENABLE_GRAPH_PASSES", env.enable_graph_passes},
+        {"ARK_NUM_CODE_SHARDS", std::to_string(env.num_code_shards)},
+        {"ARK_NUM_COMM_SMS", std::to_string(env.num_comm_sms)},
+        {"ARK_NUM_COMM_STREAMS", std::to_string(env.num_comm_streams)},
+        {"ARK_REUSE_BUFFERS", std::to_string(env.reuse_buffers)},
+        {"ARK_SCHED_POLICY", env.sched_policy},
+        {"ARK_SHARE_OPSEQ_CODE", std::to_string(env.share_opseq_code)},
+        // Only whether tracing is enabled matters, not the path.
+        {"ARK_TRACE", std::to_string(trace)},
+        {"ARK_TRACE_RECORDS_PER_SM",
+         std::to_string(trace ? env.trace_records_per_sm : 0)},
+    };
+}
+
+void ExecPlan::validate(const std::string &hash, const GpuManager::Info &info,
+                        int rank, int world_size,
+                        int num_warps_per_sm) const {
+    if (this->hash != hash) {
+        ERR(InvalidUsageError, "the execution plan is made for another model");
+    }
+    if (this->arch != info.arch || this->num_sm != info.num_sm ||
+        this->smem_block_total != info.smem_block_total) {
+        ERR(InvalidUsageError, "the execution plan is made for ", this->arch,
+            " with ", this->num_sm, " SMs and ", this->smem_block_total,
+            " bytes of shared memory per block, but the GPU is ", info.arch,
+            " with ", info.num_sm, " SMs and ", info.smem_block_total,
+            " bytes");
+    }
+    if (this->rank != rank || this->world_size != world_size) {
+        ERR(InvalidUsageError, "the execution plan is made for rank ",
+            this->rank, " of ", this->world_size, ", but this is rank ", rank,
+            " of ", world_size);
+    }
+    if (this->num_warps_per_sm != num_warps_per_sm) {
+        ERR(InvalidUsageError, "the execution plan is made for ",
+            this->num_warps_per_sm, " warps per SM, but ", num_warps_per_sm,
+            " are requested");
+    }
+    for (auto &p : env_settings()) {
+        auto it = this->settings.find(p.first);
+        if (it == this->settings.end()) {
+            ERR(InvalidUsageError, "the execution plan does not record ",
+                p.first);
+        }
+        if (it->second != p.second) {
+            ERR(InvalidUsageError, "the execution plan is made with ",
+                p.first, "=", it->second, ", but it is ", p.second, " now");
+        }
+    }
+}
+
+// Mirrors BaseScheduler::create_context().
+void ExecPlan::create_context(const ModelRef &ref,
+                              std::shared_ptr<GpuContext> ctx) const {
+    int gpu_id = ctx->get_gpu_manager()->get_gpu_id();
+    std::shared_ptr<GpuBuffer> shared_buf;
+    if (this->shared_bytes > 0) {
+        shared_buf =
+            ctx->allocate_buffer(this->shared_bytes, this->shared_align);
+    }
+    std::vector<std::shared_ptr<GpuBuffer>> gpu_bufs;
+    for (size_t i = 0; i < this->bufs.size(); ++i) {
+        const Buf &b = this->bufs[i];
+        std::shared_ptr<GpuBuffer> buf;
+        if (b.gpu_id == gpu_id) {
+            if (b.alias >= 0 && gpu_bufs[b.alias] != nullptr) {
+                buf = gpu_bufs[b.alias];
+                if (b.sid != -1) {
+                    ctx->export_buffer(buf, b.export_offset, b.sid);
+                }
+            } else if (b.shared_offset >= 0) {
+                buf = std::make_shared<GpuBuffer>(
+                    gpu_id, ctx->get_data_memory(), shared_buf->get_id(),
+                    shared_buf->get_offset() + b.shared_offset, b.bytes);
+            } else if (b.sid == -1) {
+                buf = ctx->allocate_buffer(b.bytes, 1);
+            } else {
+                buf = ctx->allocate_buffer(b.bytes, 65536);
+                ctx->export_buffer(buf, b.export_offset, b.sid);
+            }
+            long long offset =
+                (buf == nullptr) ? -1 : (long long)buf->get_offset();
+            if (b.data_offset != -1 && offset != b.data_offset) {
+                ERR(ExecutorError, "buffer ", i, " is placed at offset ",
+                    offset, ", but the execution plan expects ",
+                    b.data_offset);
+            }
+        } else {
+            buf = ctx->import_buffer(b.bytes, b.gpu_id, b.sid);
+        }
+        gpu_bufs.emplace_back(buf);
+    }
+    this->bind(ref, gpu_bufs);
+    ctx->freeze();
+}
+
+void ExecPlan::bind(
+    const ModelRef &ref,
+    const std::vector<std::shared_ptr<GpuBuffer>> &gpu_bufs) const {
+    if (gpu_bufs.size() != this->bufs.size()) {
+        ERR(InvalidUsageError, "expected ", this->bufs.size(),
+            " buffers, but got ", gpu_bufs.size());
+    }
+    if (ref.bufs.size() != this->model_buf_bytes.size()) {
+        ERR(InvalidUsageError, "the execution plan is made for a model of ",
+            this->model_buf_bytes.size(), " buffers, but the model has ",
+            ref.bufs.size());
+    }
+    for (size_t i = 0; i < ref.bufs.size(); ++i) {
+        if (this->model_buf_bytes[i] >= 0) {
+            ref.bufs[i]->bytes = this->model_buf_bytes[i];
+        }
+    }
+    for (size_t i = 0; i < this->bufs.size(); ++i) {
+        const Buf &b = this->bufs[i];
+        if (b.model_buf >= 0 && gpu_bufs[i] != nullptr) {
+            ref.bufs[b.model_buf]->buf = gpu_bufs[i];
+        }
+    }
+    for (auto &t : this->tensors) {
+        if (t.model_tensor < 0 || t.model_tensor >= (int)ref.tensors.size()) {
+            ERR(InvalidUsageError, "invalid tensor index ", t.model_tensor,
+                " in the execution plan");
+        }
+        Tensor *tns = ref.tensors[t.model_tensor];
+        tns->ldims = t.ldims;
+        tns->offs = t.offs;
+        tns->pads = t.pads;
+    }
+}
+
+}  // namespace ark
@@ -0,0 +1,146 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#ifndef ARK_SCHED_EXEC_PLAN_H_
+#define ARK_SCHED_EXEC_PLAN_H_
+
+#include <array>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gpu/gpu_context.h"
+#include "gpu/gpu_manager.h"
+#include "include/ark.h"
+
+namespace ark {
+
+class BaseScheduler;
+
+/// Everything that @ref Executor needs from the scheduler to run a model: the
+/// layout of the GPU buffers, the layout of the tensors on them, and the
+/// generated kernel code. A plan is saved into a JSON file, so that a process
+/// that runs the same model again can skip scheduling altogether.
+class ExecPlan {
+   public:
+    /// Tensors and buffers of a model as declared by the user. This should
+    /// be captured before scheduling, as the scheduler may delete tensors and
+    /// buffers of the model while optimizing it.
+    class ModelRef {
+       public:
+        ModelRef(const Model &model);
+
+        /// Index of @p tns in the original tensors, or -1 if it is not one of
+        /// them.
+        int tensor_index(const Tensor *tns) const;
+        /// Index of @p buf in the original buffers, or -1 if it is not one of
+        /// them.
+        int buf_index(const TensorBuf *buf) const;
+
+        std::vector<Tensor *> tensors;
+        std::vector<TensorBuf *> bufs;
+
+       private:
+        // Ids and names are kept to tell an original object apart from a new
+        // object that the scheduler created at the same address.
+        std::vector<int> tensor_ids;
+        std::vector<std::string> tensor_names;
+        std::vector<int> buf_ids;
+    };
+
+    struct Buf {
+        // Index of the TensorBuf in ModelRef::bufs, or -1 if the buffer
+        // belongs to a TensorBuf that the scheduler created.
+        int model_buf = -1;
+        int gpu_id = -1;
+        size_t bytes = 0;
+        int sid = -1;
+        // Offset of the exported region inside the buffer.
+        size_t export_offset = 0;
+        // Index of an earlier entry that allocated the same buffer, or -1.
+        int alias = -1;
+        // Offset in the region shared by buffers of disjoint lifetimes, or
+        // -1 if the buffer has its own memory.
+        long long shared_offset = -1;
+        // Offset of the buffer in the GPU data memory, or -1 if the buffer
+        // is not local or not allocated.
+        long long data_offset = -1;
+    };
+
+    struct TensorLayout {
+        // Index of the tensor in ModelRef::tensors.
+        int model_tensor = -1;
+        Dims ldims;
+        Dims offs;
+        Dims pads;
+    };
+
+    struct OpSeqInfo {
+        int id;
+        std::string name;
+        int num_warps;
+        int smem_bytes;
+        std::array<int, 3> tdims;
+        std::vector<std::string> functions;
+    };
+
+    ExecPlan() = default;
+
+    /// Create a plan from @p sched, which has scheduled the model of @p ref
+    /// and laid out its buffers by `create_context()` or `plan_context()`.
+    /// @p codes is the result of `gen_code()`.
+    ExecPlan(const ModelRef &ref, const BaseScheduler &sched,
+             const std::vector<std::string> &codes, const std::string &hash);
+
+    /// Structural hash of @p model, which covers the tensors, buffers and
+    /// operators of the model but not the data of the tensors.
+    static std::string model_hash(const Model &model);
+
+    /// Current values of the environment variables that change the schedule
+    /// or the generated code but not the model hash, keyed by the variable
+    /// names.
+    static std::map<std::string, std::string> env_settings();
+
+    static ExecPlan load(const std::string &path);
+    void save(const std::string &path) const;
+
+    /// Raise an error if the plan is not made for the given model and
+    /// device, or under different @ref env_settings().
+    void validate(const std::string &hash, const GpuManager::Info &info,
+                  int rank, int world_size, int num_warps_per_sm) const;
+
+    /// Allocate, export and import the GPU buffers on @p ctx in the same way
+    /// as the scheduler did, and bind the tensors of @p ref to them. This
+    /// freezes @p ctx.
+    void create_context(const ModelRef &ref,
+                        std::shared_ptr<GpuContext> ctx) const;
+
+    /// Restore the layouts of the tensors of @p ref and bind their buffers
+    /// to @p gpu_bufs, which has an element for each entry of `bufs`.
+    void bind(const ModelRef &ref,
+              const std::vector<std::shared_ptr<GpuBuffer>> &gpu_bufs) const;
+
+    std::string hash;
+    std::string arch;
+    int num_sm = 0;
+    int smem_block_total = 0;
+    int rank = 0;
+    int world_size = 1;
+    int num_warps_per_sm = 16;
+    size_t shared_bytes = 0;
+    int shared_align = 1;
+    // env_settings() when the plan is made.
+    std::map<std::string, std::string> settings;
+    std::vector<Buf> bufs;
+    // Bytes of each TensorBuf in ModelRef::bufs after scheduling, or -1 if
+    // the scheduler deleted it.
+    std::vector<DimType> model_buf_bytes;
+    std::vector<TensorLayout> tensors;
+    std::vector<OpSeqInfo> opseqs;
+    std::vector<std::string> codes;
+};
+
+}  // namespace ark
+
+#endif  // ARK_SCHED_EXEC_PLAN_H_
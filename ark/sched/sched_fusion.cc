@@ -0,0 +1,311 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "sched/sched_fusion.h"
+
+#include <map>
+
+#include "logging.h"
+
+namespace ark {
+
+bool EwiseFusionPass::is_fusable(const Op &op) {
+    size_t num_inputs;
+    switch (op.type) {
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL:
+        case OP_DIV:
+            num_inputs = 2;
+            break;
+        case OP_SCALE:
+        case OP_RELU:
+        case OP_GELU:
+        case OP_SIGMOID:
+        case OP_EXP:
+            num_inputs = 1;
+            break;
+        default:
+            return false;
+    }
+    if (op.inputs.size() != num_inputs || op.outputs.size() != 1 ||
+        op.output_refs.size() != 1) {
+        return false;
+    }
+    // Fused ops compute in `float`.
+    const TensorType &type = op.outputs[0]->type;
+    if (type != FP32 && type != FP16 && type != BF16) {
+        return false;
+    }
+    for (Tensor *input : op.inputs) {
+        if (input->type != type) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Number of tensors that refer to each buffer.
+static std::map<TensorBuf *, int> count_buf_refs(
+    const GraphPass::ModelImpl *model_impl) {
+    std::map<TensorBuf *, int> buf_refs;
+    for (Tensor *tns : model_impl->get_tensors()) {
+        buf_refs[tns->buf]++;
+    }
+    return buf_refs;
+}
+
+// True if `tns`, an input of `user`, can be passed to `user` in registers
+// instead of being written to memory by its producer.
+static bool is_fusable_tensor(const GraphPass::ModelImpl *model_impl,
+                              Tensor *tns, const Op *user,
+                              const std::map<TensorBuf *, int> &buf_refs) {
+    const Op *producer = model_impl->get_producer(tns);
+    if (producer == nullptr || producer->output_refs.size() != 1) {
+        return false;
+    }
+    if (GraphPass::get_single_user(model_impl, tns) != user) {
+        return false;
+    }
+    Tensor *ref = producer->output_refs[0];
+    if (tns->exported || tns->imported_rank >= 0 || ref->exported ||
+        ref->imported_rank >= 0) {
+        return false;
+    }
+    // The output reference should be a plain tensor that only the producer
+    // writes, and the buffer should not be shared with other tensors.
+    if (model_impl->get_users(ref).size() != 1) {
+        return false;
+    }
+    const Op *ref_producer = model_impl->get_producer(ref);
+    if (ref_producer == nullptr || ref_producer->type != OP_TENSOR ||
+        !ref_producer->inputs.empty()) {
+        return false;
+    }
+    auto it = buf_refs.find(tns->buf);
+    return it != buf_refs.end() && it->second == 2;
+}
+
+// Deletes `ops` and retires the intermediate `tensors` between them,
+// together with the output references and the buffers of the tensors. The
+// user may still hold the tensors, which are left without memory.
+static void delete_fused(GraphPass::ModelImpl *model_impl,
+                         const std::vector<Op *> &ops,
+                         const std::set<Tensor *> &tensors) {
+    std::vector<Tensor *> refs;
+    for (Tensor *tns : tensors) {
+        refs.emplace_back(model_impl->get_producer(tns)->output_refs[0]);
+    }
+    for (Op *op : ops) {
+        model_impl->delete_op(op);
+    }
+    for (Tensor *tns : tensors) {
+        model_impl->retire_tensor(tns);
+    }
+    for (Tensor *ref : refs) {
+        TensorBuf *buf = ref->buf;
+        model_impl->delete_op(const_cast<Op *>(model_impl->get_producer(ref)));
+        model_impl->retire_tensor(ref);
+        model_impl->retire_tensor_buf(buf);
+    }
+}
+
+int EwiseFusionPass::run(Model &, ModelImpl *model_impl) {
+    std::map<TensorBuf *, int> buf_refs = count_buf_refs(model_impl);
+
+    std::list<Op *> ops = model_impl->get_ops();
+    int num_changes = 0;
+    // Visit users before producers so that each chain is fused from its end.
+    for (auto it = ops.rbegin(); it != ops.rend(); ++it) {
+        Op *root = *it;
+        if (!model_impl->has_op(root) || !is_fusable(*root)) {
+            continue;
+        }
+        // Grow the chain towards the producers while the number of inputs of
+        // the fused op is within the limit.
+        std::vector<Op *> chain{root};
+        std::set<Tensor *> fused_tensors;
+        std::set<Tensor *> inputs(root->inputs.begin(), root->inputs.end());
+        for (size_t i = 0; i < chain.size(); ++i) {
+            for (Tensor *tns : chain[i]->inputs) {
+                if (fused_tensors.count(tns) > 0 ||
+                    !is_fusable_tensor(model_impl, tns, chain[i], buf_refs)) {
+                    continue;
+                }
+                Op *producer = const_cast<Op *>(model_impl->get_producer(tns));
+                if (!is_fusable(*producer)) {
+                    continue;
+                }
+                std::set<Tensor *> new_inputs = inputs;
+                new_inputs.erase(tns);
+                new_inputs.insert(producer->inputs.begin(),
+                                  producer->inputs.end());
+                if ((int)new_inputs.size() > FUSED_EWISE_MAX_INPUTS) {
+                    continue;
+                }
+                inputs.swap(new_inputs);
+                fused_tensors.insert(tns);
+                chain.emplace_back(producer);
+            }
+        }
+        if (chain.size() == 1) {
+            continue;
+        }
+
+        // Build the postfix expression by a depth-first traversal from the
+        // root. Inputs are numbered in the order of appearance.
+        OpArgs expr;
+        std::vector<Tensor *> input_list;
+        std::map<Tensor *, int> input_idx;
+        std::vector<std::pair<const Op *, size_t>> stack{{root, 0}};
+        while (!stack.empty()) {
+            const Op *op = stack.back().first;
+            size_t arg = stack.back().second++;
+            if (arg < op->inputs.size()) {
+                Tensor *tns = op->inputs[arg];
+                if (fused_tensors.count(tns) > 0) {
+                    stack.emplace_back(model_impl->get_producer(tns), 0);
+                    continue;
+                }
+                auto p = input_idx.emplace(tns, (int)input_list.size());
+                if (p.second) {
+                    input_list.emplace_back(tns);
+                }
+                expr.put(OpArg{(int)OP_TENSOR});
+                expr.put(OpArg{p.first->second});
+                continue;
+            }
+            expr.put(OpArg{(int)op->type});
+            if (op->type == OP_SCALE) {
+                float val;
+                op->args.get(&val, 0);
+                expr.put(OpArg{val});
+            }
+            stack.pop_back();
+        }
+
+        // Replace the chain with a fused op, and retire the intermediate
+        // tensors together with their buffers.
+        std::string name = root->name;
+        std::string prec_type = root->prec_type;
+        Tensor *output_ref = root->output_refs[0];
+        Tensor *output = root->outputs[0];
+        delete_fused(model_impl, chain, fused_tensors);
+        FusedEwiseOp fused{prec_type, input_list, output_ref, expr, name};
+        Tensor *tmp = model_impl->add_op(fused)[0];
+        model_impl->replace_tensor(tmp, output);
+        model_impl->delete_tensor(tmp);
+        LOG(DEBUG, "fused ", chain.size(), " element-wise ops into ", name,
+            " with ", input_list.size(), " inputs");
+        ++num_changes;
+    }
+    return num_changes;
+}
+
+int MatmulEpiloguePass::run(Model &model, ModelImpl *model_impl) {
+    std::map<TensorBuf *, int> buf_refs = count_buf_refs(model_impl);
+
+    std::list<Op *> ops = model_impl->get_ops();
+    int num_changes = 0;
+    for (Op *matmul : ops) {
+        if (!model_impl->has_op(matmul) || matmul->type != OP_MATMUL ||
+            MatmulOp::has_epilogue(*matmul) || matmul->outputs.size() != 1) {
+            continue;
+        }
+        Tensor *y = matmul->outputs[0];
+        if (y->type != FP32 && y->type != FP16 && y->type != BF16) {
+            continue;
+        }
+        DimType n = y->shape[y->shape.ndims() - 1];
+
+        // The user of `tns` if `tns` does not need to be written.
+        auto next_user = [&](Tensor *tns) -> Op * {
+            Op *user = GraphPass::get_single_user(model_impl, tns);
+            if (user == nullptr ||
+                !is_fusable_tensor(model_impl, tns, user, buf_refs)) {
+                return nullptr;
+            }
+            return user;
+        };
+        // The operand of a binary `user` other than `tns`.
+        auto other_operand = [&](const Op *user, Tensor *tns) -> Tensor * {
+            if (user->type != OP_ADD || !EwiseFusionPass::is_fusable(*user) ||
+                user->outputs[0]->shape != tns->shape) {
+                return nullptr;
+            }
+            Tensor *other = user->inputs[(user->inputs[0] == tns) ? 1 : 0];
+            return (other == tns) ? nullptr : other;
+        };
+
+        std::vector<Op *> chain{matmul};
+        std::set<Tensor *> fused_tensors;
+        auto absorb = [&](Op *user) {
+            fused_tensors.insert(y);
+            chain.emplace_back(user);
+            y = user->outputs[0];
+        };
+        Tensor *bias = nullptr;
+        std::string activation;
+        Tensor *residual = nullptr;
+
+        Op *user = next_user(y);
+        Tensor *other = (user != nullptr) ? other_operand(user, y) : nullptr;
+        if (other != nullptr && other->shape.size() == n &&
+            other->shape[other->shape.ndims() - 1] == n) {
+            bias = other;
+            absorb(user);
+            user = next_user(y);
+        }
+        if (user != nullptr &&
+            (user->type == OP_RELU || user->type == OP_GELU) &&
+            EwiseFusionPass::is_fusable(*user)) {
+            activation = (user->type == OP_RELU) ? "relu" : "gelu";
+            absorb(user);
+            user = next_user(y);
+        }
+        other = (user != nullptr) ? other_operand(user, y) : nullptr;
+        if (other != nullptr && other->shape == y->shape) {
+            residual = other;
+            absorb(user);
+        }
+        if (chain.size() == 1) {
+            continue;
+        }
+
+        // The matmul writes the result while other tiles still read the
+        // operands, so the result should not overwrite any of them.
+        Tensor *output_ref = chain.back()->output_refs[0];
+        Tensor *output = chain.back()->outputs[0];
+        bool overlaps = false;
+        for (Tensor *tns : matmul->inputs) {
+            overlaps |= (tns->buf == output_ref->buf);
+        }
+        for (Tensor *tns : {bias, residual}) {
+            overlaps |= (tns != nullptr && tns->buf == output_ref->buf);
+        }
+        if (overlaps) {
+            continue;
+        }
+
+        Tensor *mat_a = matmul->inputs[0];
+        Tensor *mat_b = matmul->inputs[1];
+        bool is_column_a;
+        bool is_column_b;
+        matmul->args.get(&is_column_a, 4);
+        matmul->args.get(&is_column_b, 5);
+        std::string name = matmul->name;
+        int gran_lev = matmul->gran_lev;
+        delete_fused(model_impl, chain, fused_tensors);
+
+        MatmulEpilogue epilogue{bias, activation, residual};
+        Tensor *tmp = model.matmul(mat_a, mat_b, output_ref, 1, is_column_a,
+                                   is_column_b, name, gran_lev, epilogue);
+        model_impl->replace_tensor(tmp, output);
+        model_impl->delete_tensor(tmp);
+        LOG(DEBUG, "absorbed ", chain.size() - 1, " ops into ", name);
+        ++num_changes;
+    }
+    return num_changes;
+}
+
+}  // namespace ark
@@ -0,0 +1,58 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#ifndef ARK_SCHED_FUSION_H_
+#define ARK_SCHED_FUSION_H_
+
+#include "sched/sched_pass.h"
+
+namespace ark {
+
+/// Fuses connected element-wise ops (add, sub, mul, div, scale, relu, gelu,
+/// sigmoid and exp) into a single @ref FusedEwiseOp.
+///
+/// An intermediate tensor is fused away only if it is read by a single op of
+/// the same chain and nothing else refers to its buffer, e.g., it is not
+/// exported and not given as an output of another op. Fused intermediate
+/// tensors are removed from the model together with their buffers, but the
+/// @ref Tensor objects stay valid until the model is destroyed (see
+/// @ref Model::Impl::retire_tensor). They have no memory, so reading or
+/// writing them after the @ref Executor is created raises an error. As the
+/// user may hold any intermediate tensor, the scheduler runs this pass only
+/// if `ARK_ENABLE_GRAPH_PASSES` names it.
+class EwiseFusionPass : public GraphPass {
+   public:
+    EwiseFusionPass() : GraphPass{"ewise_fusion"} {}
+
+    /// @return the number of created @ref FusedEwiseOp.
+    int run(Model &model, ModelImpl *model_impl) override;
+
+    /// True if @p op can be a part of a fused element-wise op.
+    static bool is_fusable(const Op &op);
+};
+
+/// Absorbs element-wise ops that follow a matmul into the epilogue of the
+/// matmul (see @ref MatmulEpilogue), so that the ops run within the matmul
+/// instead of separate ops. The epilogue is a pass over each output tile
+/// that re-reads the product right after the same threads write it, so the
+/// product still goes through memory, mostly hitting the L2 cache, but the
+/// separate launches and the extra intermediate tensors are saved.
+///
+/// Following the order of the epilogue, the pass takes an `add` of a row
+/// vector (bias), `relu` or `gelu`, and an `add` of a tensor of the output
+/// shape (residual), each of which is optional. A following `cast` is not
+/// taken, as the GeMM writes the product only in the data type of the
+/// inputs. The intermediate tensors are removed under the same conditions
+/// and left without memory in the same way as in @ref EwiseFusionPass, so
+/// the scheduler runs this pass only if `ARK_ENABLE_GRAPH_PASSES` names it.
+class MatmulEpiloguePass : public GraphPass {
+   public:
+    MatmulEpiloguePass() : GraphPass{"matmul_epilogue"} {}
+
+    /// @return the number of matmuls that absorbed any ops.
+    int run(Model &model, ModelImpl *model_impl) override;
+};
+
+}  // namespace ark
+
+#endif  // ARK_SCHED_FUSION_H_
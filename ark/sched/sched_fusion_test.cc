@@ -0,0 +1,411 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "sched/sched_fusion.h"
+
+#include "gpu/gpu_profile.h"
+#include "include/ark.h"
+#include "sched/sched.h"
+#include "unittest/unittest_utils.h"
+
+static std::vector<const ark::Op *> get_ops(ark::Model &model,
+                                            ark::OpType type) {
+    std::vector<const ark::Op *> ops;
+    ark::OpGraph graph(model);
+    for (auto &node : graph.get_nodes()) {
+        for (auto &op : node->ops) {
+            if (op->type == type) ops.emplace_back(op);
+        }
+    }
+    return ops;
+}
+
+static size_t count_bufs(ark::Model &model) {
+    std::set<ark::TensorBuf *> bufs;
+    ark::OpGraph graph(model);
+    for (auto &node : graph.get_nodes()) {
+        for (auto &op : node->ops) {
+            for (auto tns : op->inputs) bufs.insert(tns->buf);
+            for (auto tns : op->outputs) bufs.insert(tns->buf);
+        }
+    }
+    return bufs.size();
+}
+
+static int run_fusion(ark::Model &model) {
+    ark::GraphPassManager passes;
+    passes.add(std::make_unique<ark::EwiseFusionPass>());
+    return passes.run(model);
+}
+
+ark::unittest::State test_sched_fusion_chain() {
+    ark::Model model;
+    ark::Tensor *a = model.tensor({4, 64, 256}, ark::FP16);
+    ark::Tensor *b = model.tensor({1, 256}, ark::FP16);
+    ark::Tensor *t = model.relu(model.scale(model.add(a, b), 2));
+    ark::Tensor *y = model.sigmoid(model.mul(t, a));
+    // `y` has two users, so the chains below are fused separately.
+    ark::Tensor *z0 = model.exp(model.sub(y, b));
+    ark::Tensor *z1 = model.gelu(model.div(y, a));
+    UNITTEST_EQ(count_bufs(model), 11UL);
+
+    UNITTEST_EQ(run_fusion(model), 3);
+    UNITTEST_EQ(get_ops(model, ark::OP_FUSED_EWISE).size(), 3UL);
+    for (auto type : {ark::OP_ADD, ark::OP_SUB, ark::OP_MUL, ark::OP_DIV,
+                      ark::OP_SCALE, ark::OP_RELU, ark::OP_GELU,
+                      ark::OP_SIGMOID, ark::OP_EXP}) {
+        UNITTEST_EQ(get_ops(model, type).size(), 0UL);
+    }
+    // Only `a`, `b`, `y`, `z0` and `z1` are left in memory.
+    UNITTEST_EQ(count_bufs(model), 5UL);
+
+    for (auto op : get_ops(model, ark::OP_FUSED_EWISE)) {
+        ark::Tensor *out = op->outputs[0];
+        UNITTEST_TRUE(out == y || out == z0 || out == z1);
+        if (out == y) {
+            // `a` is used twice but passed once.
+            UNITTEST_EQ(op->inputs.size(), 2UL);
+            UNITTEST_TRUE(op->inputs[0] == a);
+            UNITTEST_TRUE(op->inputs[1] == b);
+
+            // A (1, 256) tile.
+            auto &cfg = op->cfg_map->get({ark::OP_ARCH_CUDA_80, "fp16"})[2];
+            std::string func = op->function_name(cfg);
+            UNITTEST_EQ(func.find("ark::fused_ewise<"), 0UL);
+            // sigmoid(mul(relu(scale(add(a, b), 2)), a))
+            UNITTEST_NE(
+                func.find(
+                    "ark::fused::Unary<ark::Sigmoid, "
+                    "ark::fused::Binary<ark::type::Mul, "
+                    "ark::fused::Unary<ark::fused::Relu, "
+                    "ark::fused::Scale<ark::fused::Binary<ark::type::Add, "
+                    "ark::fused::In<0, ark::Vec<1, 4, 64, 256>, "
+                    "ark::Vec<1, 4, 64, 256>>, "
+                    "ark::fused::In<1, ark::Vec<1, 1, 1, 256>, "
+                    "ark::Vec<1, 1, 1, 256>>>, 1073741824u>>, "
+                    "ark::fused::In<0, ark::Vec<1, 4, 64, 256>, "
+                    "ark::Vec<1, 4, 64, 256>>>>"),
+                std::string::npos);
+            UNITTEST_NE(func.find(", ark::fp16, ark::fp16, ark::fp16>"),
+                        std::string::npos);
+        } else {
+            UNITTEST_TRUE(op->inputs[0] == y);
+            UNITTEST_EQ(op->inputs.size(), 2UL);
+        }
+    }
+
+    // Nothing left to fuse.
+    UNITTEST_EQ(run_fusion(model), 0);
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_sched_fusion_boundary() {
+    {
+        // Intermediate tensors that are read elsewhere are kept.
+        ark::Model model;
+        ark::Tensor *x = model.tensor({64, 64}, ark::FP32);
+        ark::Tensor *exported =
+            model.tensor({64, 64}, ark::FP32, nullptr, {}, {}, {}, {}, true);
+        model.relu(model.relu(x, exported));
+        ark::Tensor *out = model.tensor({64, 64}, ark::FP32);
+        model.reshape(out, {4096});
+        model.exp(model.relu(x, out));
+        UNITTEST_EQ(run_fusion(model), 0);
+    }
+    {
+        // Integers are not fused.
+        ark::Model model;
+        ark::Tensor *x = model.tensor({64, 64}, ark::INT32);
+        model.add(model.add(x, x), x);
+        UNITTEST_EQ(run_fusion(model), 0);
+    }
+    {
+        // A long chain is split to keep the number of inputs within the limit.
+        ark::Model model;
+        ark::Tensor *sum = model.tensor({64, 64}, ark::FP32);
+        for (int i = 0; i < 9; ++i) {
+            sum = model.add(sum, model.tensor({64, 64}, ark::FP32));
+        }
+        UNITTEST_EQ(run_fusion(model), 2);
+        UNITTEST_EQ(get_ops(model, ark::OP_ADD).size(), 0UL);
+        for (auto op : get_ops(model, ark::OP_FUSED_EWISE)) {
+            UNITTEST_TRUE((int)op->inputs.size() <=
+                          ark::FUSED_EWISE_MAX_INPUTS);
+        }
+    }
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_sched_fusion_scheduler() {
+    ::setenv("ARK_ENABLE_GRAPH_PASSES", "ewise_fusion", 1);
+    ark::init();
+    ark::GpuManager::Info info = ark::gpu_profile("a100");
+    ark::Model model;
+    ark::Tensor *x = model.tensor({2, 128, 128}, ark::FP16);
+    ark::Tensor *b = model.tensor({128}, ark::FP16);
+    model.gelu(model.add(model.scale(x, 0.5), b));
+
+    ark::DefaultScheduler sched{model, info, 0, 1};
+    auto &stats = sched.get_graph_passes().get_stats();
+    UNITTEST_EQ(stats[2].name, "ewise_fusion");
+    UNITTEST_EQ(stats[2].num_changes, 1);
+
+    sched.schedule();
+    sched.plan_context();
+    auto codes = sched.gen_code();
+    UNITTEST_EQ(codes.size(), 1UL);
+    UNITTEST_NE(codes[0].find("ark::fused_ewise<"), std::string::npos);
+    UNITTEST_EQ(codes[0].find("ark::add<"), std::string::npos);
+    ::unsetenv("ARK_ENABLE_GRAPH_PASSES");
+    ark::init();
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_sched_fusion_default() {
+    // Fusion is opt-in, so the intermediate tensors that the user holds keep
+    // their memory by default.
+    ark::GpuManager::Info info = ark::gpu_profile("a100");
+    ark::Model model;
+    ark::Tensor *x = model.tensor({2, 128, 128}, ark::FP16);
+    ark::Tensor *b = model.tensor({128}, ark::FP16);
+    ark::Tensor *u = model.scale(x, 0.5);
+    ark::Tensor *v = model.add(u, b);
+    model.gelu(v);
+    ark::Tensor *w = model.tensor({128, 128}, ark::FP16);
+    ark::Tensor *h = model.matmul(x, w);
+    model.relu(model.add(h, b));
+
+    ark::DefaultScheduler sched{model, info, 0, 1};
+    auto &stats = sched.get_graph_passes().get_stats();
+    UNITTEST_EQ(stats[1].name, "matmul_epilogue");
+    UNITTEST_TRUE(!stats[1].enabled);
+    UNITTEST_EQ(stats[2].name, "ewise_fusion");
+    UNITTEST_TRUE(!stats[2].enabled);
+    UNITTEST_EQ(get_ops(model, ark::OP_FUSED_EWISE).size(), 0UL);
+    for (const ark::Op *op : get_ops(model, ark::OP_MATMUL)) {
+        UNITTEST_TRUE(!ark::MatmulOp::has_epilogue(*op));
+    }
+    sched.schedule();
+    sched.plan_context();
+    auto codes = sched.gen_code();
+
+    for (ark::Tensor *tns : {u, v, h}) {
+        UNITTEST_TRUE(tns->is_alloced());
+    }
+    UNITTEST_NE(codes[0].find("ark::add<"), std::string::npos);
+    UNITTEST_EQ(codes[0].find("ark::GemmEpilogue<"), std::string::npos);
+    return ark::unittest::SUCCESS;
+}
+
+static int run_matmul_epilogue(ark::Model &model) {
+    ark::GraphPassManager passes;
+    passes.add(std::make_unique<ark::MatmulEpiloguePass>());
+    return passes.run(model);
+}
+
+ark::unittest::State test_sched_fusion_matmul_epilogue() {
+    ark::Model model;
+    ark::Tensor *x = model.tensor({256, 512}, ark::FP16);
+    ark::Tensor *w = model.tensor({512, 1024}, ark::FP16);
+    ark::Tensor *b = model.tensor({1024}, ark::FP16);
+    ark::Tensor *r = model.tensor({256, 1024}, ark::FP16);
+    ark::Tensor *h = model.gelu(model.add(model.matmul(x, w), b));
+    ark::Tensor *y = model.cast(model.add(r, h), ark::FP32);
+    UNITTEST_EQ(count_bufs(model), 9UL);
+
+    UNITTEST_EQ(run_matmul_epilogue(model), 1);
+    for (auto type : {ark::OP_ADD, ark::OP_GELU}) {
+        UNITTEST_EQ(get_ops(model, type).size(), 0UL);
+    }
+    auto matmuls = get_ops(model, ark::OP_MATMUL);
+    UNITTEST_EQ(matmuls.size(), 1UL);
+    const ark::Op *op = matmuls[0];
+    UNITTEST_TRUE(ark::MatmulOp::has_epilogue(*op));
+    UNITTEST_EQ(op->inputs.size(), 4UL);
+    UNITTEST_TRUE(op->inputs[2] == b);
+    UNITTEST_TRUE(op->inputs[3] == r);
+    // The GeMM writes only in the input data type, so `cast` is left.
+    auto casts = get_ops(model, ark::OP_CAST);
+    UNITTEST_EQ(casts.size(), 1UL);
+    UNITTEST_TRUE(casts[0]->inputs[0] == op->outputs[0]);
+    UNITTEST_TRUE(casts[0]->outputs[0] == y);
+    // `x`, `w`, `b`, `r`, the matmul output, and `y`.
+    UNITTEST_EQ(count_bufs(model), 6UL);
+
+    auto &cfg = op->cfg_map->get({ark::OP_ARCH_CUDA_80, "fp16"})[0];
+    std::string func = op->function_name(cfg);
+    UNITTEST_EQ(func.find("ark::matmul<ark::Vec<1, 1, 256, 1024>, "), 0UL);
+    UNITTEST_NE(
+        func.find(", ark::fp16, ark::fp16, ark::fp16, "
+                  "ark::GemmEpilogue<ark::Vec<1, 1, 256, 1024>, "
+                  "ark::Vec<1, 1, 256, 1024>, ark::Vec<1, 1, 256, 1024>, "
+                  "ark::Vec<1, 1, 256, 1024>, ark::Gelu, true, true, "
+                  "ark::fp16, ark::fp16>>"),
+        std::string::npos);
+    // Out, A, B, Bias, Residual, C
+    UNITTEST_EQ(op->function_call_args(cfg).get_args().size(), 6UL);
+
+    // Nothing left to absorb.
+    UNITTEST_EQ(run_matmul_epilogue(model), 0);
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_sched_fusion_matmul_epilogue_boundary() {
+    {
+        // Ops out of the epilogue order are left as they are.
+        ark::Model model;
+        ark::Tensor *x = model.tensor({256, 256}, ark::FP32);
+        ark::Tensor *b = model.tensor({1, 256}, ark::FP32);
+        model.add(model.relu(model.matmul(x, x)), b);
+        UNITTEST_EQ(run_matmul_epilogue(model), 1);
+        UNITTEST_EQ(get_ops(model, ark::OP_RELU).size(), 0UL);
+        UNITTEST_EQ(get_ops(model, ark::OP_ADD).size(), 1UL);
+    }
+    {
+        // The product is read elsewhere.
+        ark::Model model;
+        ark::Tensor *x = model.tensor({256, 256}, ark::FP32);
+        ark::Tensor *y = model.matmul(x, x);
+        model.relu(y);
+        model.exp(y);
+        UNITTEST_EQ(run_matmul_epilogue(model), 0);
+    }
+    {
+        // The result would overwrite an operand.
+        ark::Model model;
+        ark::Tensor *x = model.tensor({256, 256}, ark::FP32);
+        ark::Tensor *b = model.tensor({256}, ark::FP32);
+        model.add(model.matmul(x, x), b, x);
+        UNITTEST_EQ(run_matmul_epilogue(model), 0);
+    }
+    {
+        // Split-K runs the epilogue as separate ops.
+        ark::Model model;
+        ark::Tensor *x = model.tensor({64, 4096}, ark::FP16);
+        ark::Tensor *w = model.tensor({4096, 64}, ark::FP16);
+        ark::Tensor *b = model.tensor({64}, ark::FP16);
+        ark::Tensor *y = model.matmul(x, w, nullptr, 4, false, false, "matmul",
+                                      -1, {b, "relu", nullptr, ark::FP32});
+        UNITTEST_EQ(y->type, ark::FP32);
+        UNITTEST_EQ(get_ops(model, ark::OP_MATMUL).size(), 4UL);
+        for (auto type : {ark::OP_ADD, ark::OP_RELU, ark::OP_CAST}) {
+            UNITTEST_EQ(get_ops(model, type).size(), 1UL);
+        }
+        UNITTEST_EQ(get_ops(model, ark::OP_CAST)[0]->outputs[0], y);
+    }
+    {
+        // Without Split-K, the epilogue stays in the matmul and only the
+        // conversion runs as a separate op.
+        ark::Model model;
+        ark::Tensor *x = model.tensor({256, 256}, ark::FP16);
+        ark::Tensor *b = model.tensor({256}, ark::FP16);
+        ark::Tensor *y = model.matmul(x, x, nullptr, 1, false, false, "matmul",
+                                      -1, {b, "relu", nullptr, ark::FP32});
+        UNITTEST_EQ(y->type, ark::FP32);
+        auto matmuls = get_ops(model, ark::OP_MATMUL);
+        UNITTEST_EQ(matmuls.size(), 1UL);
+        UNITTEST_TRUE(ark::MatmulOp::has_epilogue(*matmuls[0]));
+        UNITTEST_EQ(matmuls[0]->outputs[0]->type, ark::FP16);
+        UNITTEST_EQ(get_ops(model, ark::OP_ADD).size(), 0UL);
+        UNITTEST_EQ(get_ops(model, ark::OP_RELU).size(), 0UL);
+        auto casts = get_ops(model, ark::OP_CAST);
+        UNITTEST_EQ(casts.size(), 1UL);
+        UNITTEST_TRUE(casts[0]->inputs[0] == matmuls[0]->outputs[0]);
+        UNITTEST_TRUE(casts[0]->outputs[0] == y);
+    }
+    {
+        // Invalid epilogues.
+        ark::Model model;
+        ark::Tensor *x = model.tensor({64, 64}, ark::FP16);
+        ark::Tensor *b = model.tensor({64, 64}, ark::FP16);
+        UNITTEST_THROW(model.matmul(x, x, nullptr, 1, false, false, "matmul",
+                                    -1, {b}),
+                       ark::InvalidUsageError);
+        UNITTEST_THROW(model.matmul(x, x, nullptr, 1, false, false, "matmul",
+                                    -1, {nullptr, "tanh"}),
+                       ark::InvalidUsageError);
+        UNITTEST_THROW(model.matmul(x, x, nullptr, 1, false, false, "matmul",
+                                    -1, {nullptr, "", nullptr, ark::INT32}),
+                       ark::InvalidUsageError);
+    }
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_sched_fusion_matmul_epilogue_scheduler() {
+    ::setenv("ARK_ENABLE_GRAPH_PASSES", "matmul_epilogue", 1);
+    ark::init();
+    ark::GpuManager::Info info = ark::gpu_profile("a100");
+    ark::Model model;
+    ark::Tensor *x = model.tensor({2048, 1024}, ark::FP16);
+    ark::Tensor *w = model.tensor({1024, 4096}, ark::FP16);
+    ark::Tensor *b = model.tensor({4096}, ark::FP16);
+    model.relu(model.add(model.matmul(x, w), b));
+
+    ark::DefaultScheduler sched{model, info, 0, 1};
+    auto &stats = sched.get_graph_passes().get_stats();
+    UNITTEST_EQ(stats[1].name, "matmul_epilogue");
+    UNITTEST_EQ(stats[1].num_changes, 1);
+    UNITTEST_EQ(stats[2].num_changes, 0);
+
+    sched.schedule();
+    sched.plan_context();
+    auto codes = sched.gen_code();
+    UNITTEST_EQ(codes.size(), 1UL);
+    UNITTEST_NE(codes[0].find("ark::GemmEpilogue<"), std::string::npos);
+    UNITTEST_NE(codes[0].find("ark::GemmActRelu, true, false"),
+                std::string::npos);
+    UNITTEST_EQ(codes[0].find("ark::relu<"), std::string::npos);
+    ::unsetenv("ARK_ENABLE_GRAPH_PASSES");
+    ark::init();
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_sched_fusion_retired() {
+    ::setenv("ARK_ENABLE_GRAPH_PASSES", "matmul_epilogue,ewise_fusion", 1);
+    ark::init();
+    ark::GpuManager::Info info = ark::gpu_profile("a100");
+    ark::Model model;
+    ark::Tensor *x = model.tensor({2048, 1024}, ark::FP16);
+    ark::Tensor *w = model.tensor({1024, 4096}, ark::FP16);
+    ark::Tensor *b = model.tensor({4096}, ark::FP16);
+    // The user still holds the intermediate tensors after they are fused.
+    ark::Tensor *h = model.matmul(x, w);
+    model.add(h, b);
+    ark::Tensor *u = model.scale(b, 2);
+    ark::Tensor *v = model.relu(u);
+    model.exp(v);
+
+    ark::DefaultScheduler sched{model, info, 0, 1};
+    auto &stats = sched.get_graph_passes().get_stats();
+    UNITTEST_EQ(stats[1].num_changes, 1);
+    UNITTEST_EQ(stats[2].num_changes, 1);
+    sched.schedule();
+    sched.plan_context();
+    sched.gen_code();
+
+    std::vector<char> data(h->shape_bytes());
+    for (ark::Tensor *tns : {h, u, v}) {
+        UNITTEST_TRUE(tns->buf != nullptr);
+        UNITTEST_TRUE(!tns->is_alloced());
+        UNITTEST_THROW(tns->write(data.data()), ark::InvalidUsageError);
+        UNITTEST_THROW(tns->read(data.data()), ark::InvalidUsageError);
+    }
+    UNITTEST_EQ(h->shape, ark::Dims(2048, 4096));
+    UNITTEST_EQ(v->shape, b->shape);
+    ::unsetenv("ARK_ENABLE_GRAPH_PASSES");
+    ark::init();
+    return ark::unittest::SUCCESS;
+}
+
+int main() {
+    ark::init();
+    UNITTEST(test_sched_fusion_chain);
+    UNITTEST(test_sched_fusion_boundary);
+    UNITTEST(test_sched_fusion_scheduler);
+    UNITTEST(test_sched_fusion_default);
+    UNITTEST(test_sched_fusion_matmul_epilogue);
+    UNITTEST(test_sched_fusion_matmul_epilogue_boundary);
+    UNITTEST(test_sched_fusion_matmul_epilogue_scheduler);
+    UNITTEST(test_sched_fusion_retired);
+    return 0;
+}
@@ -0,0 +1,102 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "sched/sched_memory.h"
+
+#include <algorithm>
+
+#include "gpu/gpu_offset_allocator.h"
+#include "include/ark.h"
+#include "logging.h"
+#include "math_utils.h"
+
+namespace ark {
+
+void SchedMemoryPlanner::add(int id, size_t bytes, int first_step,
+                             int last_step, int align) {
+    if (this->has(id)) {
+        ERR(SchedulerError, "buffer ", id, " is already requested");
+    }
+    if (first_step > last_step) {
+        ERR(SchedulerError, "invalid lifetime of buffer ", id, ": [",
+            first_step, ", ", last_step, "]");
+    }
+    int real_align = GpuOffsetAllocator::get_align(bytes, align);
+    size_t size = (bytes == 0) ? 0 : math::pad(bytes, (size_t)real_align);
+    idx_.emplace(id, bufs_.size());
+    bufs_.push_back({id, size, first_step, last_step, real_align, 0});
+    naive_bytes_ += size;
+    max_align_ = std::max(max_align_, real_align);
+}
+
+size_t SchedMemoryPlanner::plan() {
+    std::vector<Buf *> order;
+    for (Buf &buf : bufs_) {
+        order.emplace_back(&buf);
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [](const Buf *a, const Buf *b) {
+                         if (a->bytes != b->bytes) {
+                             return a->bytes > b->bytes;
+                         }
+                         return a->first_step < b->first_step;
+                     });
+
+    total_bytes_ = 0;
+    std::vector<Buf *> placed;
+    for (Buf *buf : order) {
+        buf->offset = 0;
+        if (buf->bytes == 0) {
+            continue;
+        }
+        // Ranges occupied by the placed buffers that are live together.
+        std::vector<std::pair<size_t, size_t>> ranges;
+        for (Buf *p : placed) {
+            if (p->first_step <= buf->last_step &&
+                buf->first_step <= p->last_step) {
+                ranges.emplace_back(p->offset, p->offset + p->bytes);
+            }
+        }
+        std::sort(ranges.begin(), ranges.end());
+
+        // Find the smallest gap between the ranges that fits the buffer.
+        size_t best_offset = 0;
+        size_t best_gap = 0;
+        bool found = false;
+        size_t end = 0;
+        for (auto &range : ranges) {
+            size_t offset = math::pad(end, buf->align);
+            if (offset + buf->bytes <= range.first) {
+                size_t gap = range.first - end;
+                if (!found || gap < best_gap) {
+                    best_offset = offset;
+                    best_gap = gap;
+                    found = true;
+                }
+            }
+            end = std::max(end, range.second);
+        }
+        buf->offset = found ? best_offset : math::pad(end, buf->align);
+        total_bytes_ = std::max(total_bytes_, buf->offset + buf->bytes);
+        placed.emplace_back(buf);
+    }
+    return total_bytes_;
+}
+
+void SchedMemoryPlanner::clear() {
+    bufs_.clear();
+    idx_.clear();
+    total_bytes_ = 0;
+    naive_bytes_ = 0;
+    max_align_ = 1;
+}
+
+size_t SchedMemoryPlanner::get_offset(int id) const {
+    auto it = idx_.find(id);
+    if (it == idx_.end()) {
+        ERR(SchedulerError, "buffer ", id, " is not requested");
+    }
+    return bufs_[it->second].offset;
+}
+
+}  // namespace ark
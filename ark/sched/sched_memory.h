@@ -0,0 +1,82 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#ifndef ARK_SCHED_MEMORY_H_
+#define ARK_SCHED_MEMORY_H_
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+namespace ark {
+
+/// Lays out buffers of known lifetimes in a single memory region, so that
+/// buffers that are never live at the same time share the same bytes.
+///
+/// A lifetime is an inclusive range of execution steps. Two buffers overlap
+/// in memory only if their lifetimes do not overlap, so the caller should
+/// make sure that everything in a step finishes before the next step starts.
+///
+/// Buffers are placed in decreasing order of size, each into the smallest
+/// gap left by the already placed buffers of overlapping lifetimes that fits
+/// it (best-fit), or on top of them if no gap fits.
+class SchedMemoryPlanner {
+   public:
+    SchedMemoryPlanner() = default;
+    ~SchedMemoryPlanner() = default;
+
+    /// Request @p bytes bytes for the buffer @p id that is live from step
+    /// @p first_step to step @p last_step.
+    /// @param id unique id of the buffer.
+    /// @param bytes requested number of bytes.
+    /// @param first_step first step that the buffer is live.
+    /// @param last_step last step that the buffer is live.
+    /// @param align minimum alignment of the offset, which is applied as in
+    /// @ref GpuOffsetAllocator.
+    void add(int id, size_t bytes, int first_step, int last_step,
+             int align = 1);
+
+    /// Assign offsets to all requested buffers.
+    /// @return the number of bytes that the region needs.
+    size_t plan();
+
+    /// Remove all requests.
+    void clear();
+
+    /// True if @p id is requested.
+    bool has(int id) const { return idx_.find(id) != idx_.end(); }
+
+    /// Offset of the buffer @p id from the beginning of the region.
+    size_t get_offset(int id) const;
+
+    /// Number of bytes that the region needs, available after @ref plan.
+    size_t get_total_bytes() const { return total_bytes_; }
+
+    /// Number of bytes that the requested buffers need without sharing.
+    size_t get_naive_bytes() const { return naive_bytes_; }
+
+    /// Largest alignment of the requested buffers, which the region should
+    /// be aligned to.
+    int get_max_align() const { return max_align_; }
+
+    size_t size() const { return bufs_.size(); }
+
+   private:
+    struct Buf {
+        int id;
+        size_t bytes;
+        int first_step;
+        int last_step;
+        int align;
+        size_t offset;
+    };
+    std::vector<Buf> bufs_;
+    std::map<int, size_t> idx_;
+    size_t total_bytes_ = 0;
+    size_t naive_bytes_ = 0;
+    int max_align_ = 1;
+};
+
+}  // namespace ark
+
+#endif  // ARK_SCHED_MEMORY_H_
@@ -0,0 +1,342 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "sched/sched_memory.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+#include "env.h"
+#include "gpu/gpu_profile.h"
+#include "include/ark.h"
+#include "sched/sched.h"
+#include "unittest/unittest_utils.h"
+
+struct PlannedBuf {
+    size_t begin;
+    size_t end;
+    int first_step;
+    int last_step;
+};
+
+// True if no two buffers of overlapping lifetimes overlap in memory.
+static bool is_valid_plan(const std::vector<PlannedBuf> &bufs) {
+    for (size_t i = 0; i < bufs.size(); ++i) {
+        for (size_t j = i + 1; j < bufs.size(); ++j) {
+            const PlannedBuf &a = bufs[i];
+            const PlannedBuf &b = bufs[j];
+            bool live_together =
+                a.first_step <= b.last_step && b.first_step <= a.last_step;
+            bool overlap = a.begin < b.end && b.begin < a.end;
+            if (live_together && overlap) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+ark::unittest::State test_sched_memory_planner() {
+    ark::SchedMemoryPlanner planner;
+    planner.add(0, 1 << 20, 0, 1);
+    planner.add(1, 1 << 20, 2, 3);
+    planner.add(2, 1 << 19, 1, 2);
+    UNITTEST_EQ(planner.size(), 3UL);
+    UNITTEST_TRUE(planner.has(2));
+    UNITTEST_TRUE(!planner.has(3));
+    UNITTEST_EQ(planner.plan(), (size_t)(3 << 19));
+    UNITTEST_EQ(planner.get_naive_bytes(), (size_t)(5 << 19));
+    UNITTEST_EQ(planner.get_offset(0), 0UL);
+    UNITTEST_EQ(planner.get_offset(1), 0UL);
+    UNITTEST_EQ(planner.get_offset(2), (size_t)(1 << 20));
+
+    // The smallest fitting gap is used.
+    planner.clear();
+    planner.add(0, 4096, 0, 0);
+    planner.add(1, 2048, 0, 2);
+    planner.add(2, 1024, 0, 0);
+    planner.add(3, 1024, 1, 1);
+    planner.plan();
+    UNITTEST_EQ(planner.get_offset(0), 0UL);
+    UNITTEST_EQ(planner.get_offset(1), 4096UL);
+    UNITTEST_EQ(planner.get_offset(2), 6144UL);
+    UNITTEST_EQ(planner.get_offset(3), 0UL);
+    UNITTEST_EQ(planner.get_total_bytes(), 7168UL);
+
+    // Alignment is the same as GpuOffsetAllocator.
+    planner.clear();
+    planner.add(0, 100, 0, 0);
+    planner.add(1, 100, 0, 0, 65536);
+    planner.plan();
+    UNITTEST_EQ(planner.get_offset(0) % 128, 0UL);
+    UNITTEST_EQ(planner.get_offset(1) % 65536, 0UL);
+    UNITTEST_EQ(planner.get_max_align(), 65536);
+
+    UNITTEST_THROW(planner.add(1, 100, 0, 0), ark::SchedulerError);
+    UNITTEST_THROW(planner.add(2, 100, 1, 0), ark::SchedulerError);
+    UNITTEST_THROW(planner.get_offset(3), ark::SchedulerError);
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_sched_memory_planner_random() {
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<int> step_dist(0, 31);
+    std::uniform_int_distribution<size_t> bytes_dist(1, 1 << 20);
+    for (int iter = 0; iter < 10; ++iter) {
+        ark::SchedMemoryPlanner planner;
+        std::vector<PlannedBuf> bufs;
+        for (int i = 0; i < 200; ++i) {
+            int a = step_dist(gen);
+            int b = step_dist(gen);
+            size_t bytes = bytes_dist(gen);
+            planner.add(i, bytes, std::min(a, b), std::max(a, b));
+            bufs.push_back({0, bytes, std::min(a, b), std::max(a, b)});
+        }
+        size_t total = planner.plan();
+        UNITTEST_TRUE(total <= planner.get_naive_bytes());
+        for (int i = 0; i < (int)bufs.size(); ++i) {
+            size_t offset = planner.get_offset(i);
+            UNITTEST_EQ(offset % 128, 0UL);
+            bufs[i].begin = offset;
+            bufs[i].end += offset;
+            UNITTEST_TRUE(bufs[i].end <= total);
+        }
+        UNITTEST_TRUE(is_valid_plan(bufs));
+    }
+    return ark::unittest::SUCCESS;
+}
+
+// A chain of matmuls, where each intermediate result is dead after the next
+// matmul reads it.
+static ark::Tensor *matmul_chain(ark::Model &m, int depth,
+                                 std::vector<ark::Tensor *> &weights) {
+    ark::Tensor *x = m.tensor({1024, 1024}, ark::FP16);
+    for (int i = 0; i < depth; ++i) {
+        weights.emplace_back(m.tensor({1024, 1024}, ark::FP16));
+        x = m.matmul(x, weights.back());
+    }
+    return x;
+}
+
+ark::unittest::State test_sched_memory_reuse() {
+    ark::GpuManager::Info info = ark::gpu_profile("a100");
+
+    size_t naive_total;
+    {
+        ark::Model m;
+        std::vector<ark::Tensor *> weights;
+        matmul_chain(m, 6, weights);
+        ark::DefaultScheduler sched{m, info, 0, 1};
+        sched.schedule();
+        UNITTEST_TRUE(sched.get_buf_lifetimes().empty());
+        sched.plan_context();
+        UNITTEST_EQ(sched.get_memory_planner().size(), 0UL);
+        naive_total = sched.get_total_bytes();
+    }
+
+    ::setenv("ARK_REUSE_BUFFERS", "1", 1);
+    ark::get_env(true);
+
+    ark::Model m;
+    std::vector<ark::Tensor *> weights;
+    ark::Tensor *y = matmul_chain(m, 6, weights);
+    ark::DefaultScheduler sched{m, info, 0, 1};
+    sched.schedule();
+
+    // Weights are written by the host, so they are not shared.
+    auto &lifetimes = sched.get_buf_lifetimes();
+    UNITTEST_TRUE(!lifetimes.empty());
+    for (auto w : weights) {
+        UNITTEST_EQ(lifetimes.count(w->buf), 0UL);
+    }
+    // The result is kept until the end.
+    UNITTEST_EQ(lifetimes.count(y->buf), 1UL);
+    int last_step = 0;
+    for (auto &p : lifetimes) {
+        UNITTEST_TRUE(p.second.first <= p.second.second);
+        last_step = std::max(last_step, p.second.second);
+    }
+    UNITTEST_EQ(lifetimes.at(y->buf).second, last_step);
+
+    sched.plan_context();
+    auto &planner = sched.get_memory_planner();
+    UNITTEST_EQ(planner.size(), lifetimes.size());
+    UNITTEST_TRUE(planner.get_total_bytes() < planner.get_naive_bytes());
+    UNITTEST_TRUE(sched.get_total_bytes() < naive_total);
+
+    // Buffers overlap in memory only if their lifetimes are disjoint, and
+    // the others do not overlap with anything.
+    std::vector<PlannedBuf> bufs;
+    for (auto &bi : sched.get_buf_infos()) {
+        if (bi.tbuf == nullptr || bi.bytes == 0) continue;
+        size_t offset = bi.tbuf->get_buf_offset();
+        UNITTEST_TRUE(offset + bi.bytes <= sched.get_total_bytes());
+        auto it = lifetimes.find(bi.tbuf);
+        if (it != lifetimes.end()) {
+            bufs.push_back({offset, offset + bi.bytes, it->second.first,
+                            it->second.second});
+        } else {
+            bufs.push_back({offset, offset + bi.bytes, 0, last_step});
+        }
+    }
+    UNITTEST_TRUE(is_valid_plan(bufs));
+
+    auto codes = sched.gen_code();
+    UNITTEST_EQ(codes.size(), 1UL);
+
+    ::unsetenv("ARK_REUSE_BUFFERS");
+    ark::get_env(true);
+    return ark::unittest::SUCCESS;
+}
+
+// A small MLP of `depth` layers of `relu(x * w + b)` in FP32.
+static ark::Tensor *mlp(ark::Model &m, int depth,
+                        std::vector<ark::Tensor *> &inputs) {
+    ark::Tensor *x = m.tensor({64, 128}, ark::FP32);
+    inputs.emplace_back(x);
+    for (int i = 0; i < depth; ++i) {
+        ark::DimType n = (i == depth - 1) ? 128 : 256;
+        ark::Tensor *w = m.tensor({x->shape[1], n}, ark::FP32);
+        ark::Tensor *b = m.tensor({n}, ark::FP32);
+        inputs.emplace_back(w);
+        inputs.emplace_back(b);
+        x = m.relu(m.add(m.matmul(x, w), b));
+    }
+    return x;
+}
+
+// Pointer to the element of `tns` at the 4D index `idx` in the flat GPU
+// memory `mem` laid out by the scheduler. Dimensions of size 1 broadcast.
+static float *elem(std::vector<char> &mem, const ark::Tensor *tns,
+                   const ark::DimType idx[4]) {
+    int ndims = tns->shape.ndims();
+    ark::DimType offset = 0;
+    for (int d = 0; d < ndims; ++d) {
+        ark::DimType i = (tns->shape[d] == 1) ? 0 : idx[4 - ndims + d];
+        offset = offset * tns->ldims[d] + tns->offs[d] + i;
+    }
+    size_t bytes = tns->buf->get_buf_offset() + offset * sizeof(float);
+    return reinterpret_cast<float *>(&mem[bytes]);
+}
+
+// Run `op`, one of the ops of `mlp()`, on the host over `mem`.
+static void run_op(std::vector<char> &mem, const ark::Op *op) {
+    const ark::Tensor *a = op->inputs[0];
+    const ark::Tensor *out = op->outputs[0];
+    ark::Dims shape = out->shape.dims4();
+    ark::DimType idx[4] = {0, 0, 0, 0};
+    for (idx[2] = 0; idx[2] < shape[2]; ++idx[2]) {
+        for (idx[3] = 0; idx[3] < shape[3]; ++idx[3]) {
+            float val = 0;
+            if (op->type == ark::OP_MATMUL) {
+                ark::DimType ai[4] = {0, 0, idx[2], 0};
+                ark::DimType bi[4] = {0, 0, 0, idx[3]};
+                for (ark::DimType k = 0; k < a->shape[1]; ++k) {
+                    ai[3] = bi[2] = k;
+                    val += *elem(mem, a, ai) * *elem(mem, op->inputs[1], bi);
+                }
+            } else if (op->type == ark::OP_ADD) {
+                val = *elem(mem, a, idx) + *elem(mem, op->inputs[1], idx);
+            } else if (op->type == ark::OP_RELU) {
+                val = std::max(*elem(mem, a, idx), 0.0f);
+            } else {
+                UNITTEST_FEXIT("unexpected op ", op->name);
+            }
+            *elem(mem, out, idx) = val;
+        }
+    }
+}
+
+// Run the ops of `sched` on the host in the order of the computation
+// streams, reading and writing the buffers at the offsets planned by
+// `plan_context()`, and return the elements of `y`. Buffers that share
+// memory clobber each other here as they would on the GPU.
+static std::vector<float> run_plan(ark::DefaultScheduler &sched,
+                                   const std::vector<ark::Tensor *> &inputs,
+                                   ark::Tensor *y) {
+    std::vector<char> mem(sched.get_total_bytes());
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    for (ark::Tensor *tns : inputs) {
+        ark::Dims shape = tns->shape.dims4();
+        ark::DimType idx[4] = {0, 0, 0, 0};
+        for (idx[2] = 0; idx[2] < shape[2]; ++idx[2]) {
+            for (idx[3] = 0; idx[3] < shape[3]; ++idx[3]) {
+                *elem(mem, tns, idx) = dist(gen);
+            }
+        }
+    }
+
+    // An opseq runs entirely where its first uops are scheduled.
+    std::set<int> done;
+    for (auto &stream : sched.get_comp_stream()) {
+        for (auto &s : stream->get_streams()) {
+            for (auto &branch : s.branches) {
+                for (auto &wb : branch.warp_branches) {
+                    for (auto &bop : wb.branch_ops) {
+                        if (!done.insert(bop.opseq_id).second) continue;
+                        auto &opseq = sched.get_opseqs()[bop.opseq_id];
+                        for (auto &sop : opseq->get_sched_ops()) {
+                            run_op(mem, sop.get_op());
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    std::vector<float> res;
+    ark::DimType idx[4] = {0, 0, 0, 0};
+    for (idx[2] = 0; idx[2] < y->shape[0]; ++idx[2]) {
+        for (idx[3] = 0; idx[3] < y->shape[1]; ++idx[3]) {
+            res.emplace_back(*elem(mem, y, idx));
+        }
+    }
+    return res;
+}
+
+ark::unittest::State test_sched_memory_reuse_mlp() {
+    ark::GpuManager::Info info = ark::gpu_profile("a100");
+    // Keep the ops of the model as they are for run_plan().
+    ::setenv("ARK_DISABLE_GRAPH_OPT", "1", 1);
+
+    std::vector<std::vector<float>> results;
+    for (const char *reuse : {"0", "1"}) {
+        ::setenv("ARK_REUSE_BUFFERS", reuse, 1);
+        ark::get_env(true);
+        ark::Model m;
+        std::vector<ark::Tensor *> inputs;
+        ark::Tensor *y = mlp(m, 4, inputs);
+        ark::DefaultScheduler sched{m, info, 0, 1};
+        sched.schedule();
+        sched.plan_context();
+        if (reuse[0] == '1') {
+            // Intermediate results share memory.
+            auto &planner = sched.get_memory_planner();
+            UNITTEST_TRUE(planner.size() > 0);
+            UNITTEST_TRUE(planner.get_total_bytes() <
+                          planner.get_naive_bytes());
+        }
+        results.emplace_back(run_plan(sched, inputs, y));
+    }
+    ::unsetenv("ARK_REUSE_BUFFERS");
+    ::unsetenv("ARK_DISABLE_GRAPH_OPT");
+    ark::get_env(true);
+
+    UNITTEST_EQ(results[0].size(), 64UL * 128UL);
+    UNITTEST_EQ(results[1].size(), results[0].size());
+    UNITTEST_EQ(std::memcmp(results[0].data(), results[1].data(),
+                            results[0].size() * sizeof(float)),
+                0);
+    return ark::unittest::SUCCESS;
+}
+
+int main() {
+    ark::init();
+    UNITTEST(test_sched_memory_planner);
+    UNITTEST(test_sched_memory_planner_random);
+    UNITTEST(test_sched_memory_reuse);
+    UNITTEST(test_sched_memory_reuse_mlp);
+    return 0;
+}
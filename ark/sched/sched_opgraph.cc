@@ -4,7 +4,10 @@
 #include "sched/sched_opgraph.h"
 
 #include <algorithm>
+#include <deque>
+#include <unordered_map>
 
+#include "host_trace.h"
 #include "logging.h"
 #include "model.h"
 
@@ -18,6 +21,11 @@
 
 namespace ark {
 
+// Upper bound of the number of entries in the reachability index. If a graph
+// is too wide to be indexed within this bound, depends_on() falls back to a
+// search pruned by the topological order.
+static const size_t MAX_REACH_INDEX_ENTRIES = 1UL << 26;
+
 void OpNode::remove_self() {
     // Remove self from users and producers.
     for (auto &user : this->users) {
@@ -56,34 +64,54 @@ OpGraph::OpGraph(OpGraph &graph) {
 }
 
 OpGraph &OpGraph::operator=(const OpGraph &graph) {
-    // Copy nodes_storage
+    // Copy nodes_storage. Users and producers are redirected to the copied
+    // nodes of the same index.
     this->nodes_storage.clear();
+    for (size_t i = 0; i < graph.nodes_storage.size(); ++i) {
+        this->add_node();
+    }
     for (auto &node : graph.nodes_storage) {
-        this->nodes_storage.emplace_back(std::make_unique<OpNode>());
-        this->nodes_storage.back()->ops = node->ops;
-        this->nodes_storage.back()->users = node->users;
-        this->nodes_storage.back()->producers = node->producers;
+        OpNode *new_node = this->nodes_storage[node->id].get();
+        new_node->ops = node->ops;
+        for (auto &user : node->users) {
+            new_node->users.insert(this->nodes_storage[user->id].get());
+        }
+        for (auto &producer : node->producers) {
+            new_node->producers.insert(
+                this->nodes_storage[producer->id].get());
+        }
+        new_node->reach_id = node->reach_id;
+        new_node->reach_seq = node->reach_seq;
     }
+    this->reach_indexed = graph.reach_indexed;
+    this->reach_chain = graph.reach_chain;
+    this->reach_pos = graph.reach_pos;
+    this->reach_row_begin = graph.reach_row_begin;
+    this->reach_rows = graph.reach_rows;
     return *this;
 }
 
+/// Append a new empty @ref OpNode.
+OpNode *OpGraph::add_node() {
+    this->nodes_storage.emplace_back(std::make_unique<OpNode>());
+    OpNode *node = this->nodes_storage.back().get();
+    node->id = (int)this->nodes_storage.size() - 1;
+    return node;
+}
+
 /// Traverse the model graph and merge Ops that one of them is the only
 /// user of the other and the other is the only producer of the first.
 ///
 /// @param model The @ref Model.
 ///
 void OpGraph::create_nodes(const Model &model) {
-    std::list<OpNode *> leaf_nodes;
-    std::map<const Op *, OpNode *> op2node;
+    std::unordered_map<const Op *, OpNode *> op2node;
     // Initialize OpNode.
     OPGRAPH_DEBUG("initialize OpNode. ", model.impl->get_ops().size(), " ops");
     for (auto &op : model.impl->get_ops()) {
-        this->nodes_storage.emplace_back(std::make_unique<OpNode>());
-        this->nodes_storage.back()->ops.emplace_back(op);
-        op2node[op] = this->nodes_storage.back().get();
-        if (model.impl->get_user_ops(op).size() == 0) {
-            leaf_nodes.emplace_back(this->nodes_storage.back().get());
-        }
+        OpNode *node = this->add_node();
+        node->ops.emplace_back(op);
+        op2node[op] = node;
     }
     // Complete producers and users of OpNode.
     for (auto &node : this->nodes_storage) {
@@ -100,115 +128,102 @@ void OpGraph::create_nodes(const Model &model) {
         }
     }
 
-    std::set<OpNode *> seen_nodes;
-
     // Remove virtual Ops.
-    recursive_rm_virt(this->nodes_storage, seen_nodes, leaf_nodes);
-    seen_nodes.clear();
+    this->remove_virtual_nodes();
+    this->erase_removed_nodes();
 
-    // Recreate leaf_nodes.
-    leaf_nodes.clear();
-    for (auto &node : this->nodes_storage) {
-        if (node->users.empty()) {
-            leaf_nodes.emplace_back(node.get());
-        }
-    }
+    // Index reachability. Merging below does not change reachability between
+    // the remaining nodes, so the index stays valid.
+    this->build_reach_index();
 
     // Merge Ops.
-    recursive_merge(this->nodes_storage, seen_nodes, leaf_nodes);
+    HostTraceScope scope{"OpGraph::merge_nodes"};
+    this->merge_nodes();
+    this->erase_removed_nodes();
+}
+
+/// Helper of @ref create_nodes().
+/// Erase nodes that are marked as removed (i.e., nodes with no Op) and
+/// re-assign the index of the remaining nodes.
+void OpGraph::erase_removed_nodes() {
+    this->nodes_storage.erase(
+        std::remove_if(
+            this->nodes_storage.begin(), this->nodes_storage.end(),
+            [](const std::unique_ptr<OpNode> &node) {
+                return node->ops.empty();
+            }),
+        this->nodes_storage.end());
+    for (size_t i = 0; i < this->nodes_storage.size(); ++i) {
+        this->nodes_storage[i]->id = (int)i;
+    }
 }
 
 /// Helper of @ref create_nodes().
-/// Traverse the model graph and remove virtual Ops that perform no computation.
+/// Remove virtual Ops that perform no computation.
 ///
-/// @param nodes The list of @ref OpNode.
-/// @param boundary_nodes The list of boundary @ref OpNode.
+/// Removing a virtual node connects all of its producers to all of its users,
+/// so the result does not depend on the order of removal. Removed nodes are
+/// marked by clearing their Ops.
 ///
-void OpGraph::recursive_rm_virt(std::list<std::unique_ptr<OpNode>> &nodes,
-                                std::set<OpNode *> &seen_nodes,
-                                const std::list<OpNode *> &boundary_nodes) {
-    if (boundary_nodes.size() == 0) {
-        return;
-    }
+void OpGraph::remove_virtual_nodes() {
     OPGRAPH_DEBUG("remove virtual ops");
-    std::list<OpNode *> new_boundary_nodes;
-    for (auto &boundary_node : boundary_nodes) {
-        if (boundary_node->ops.size() == 0) {
+    for (auto &node : this->nodes_storage) {
+        if (node->ops.size() == 0) {
             ERR(SchedulerError, "unexpected error: empty OpNode");
-        } else if (boundary_node->ops.size() > 1) {
+        } else if (node->ops.size() > 1) {
             ERR(SchedulerError, "unexpected error: multiple Ops in OpNode");
         }
-        OPGRAPH_DEBUG("  boundary node");
-        OPGRAPH_DEBUG("    op: ", boundary_node->get_name());
-        for (auto &producer : boundary_node->producers) {
-            // Exception: if any user of the producer (rather than the current
-            // boundary_node) is unseen, we should not add the producer to the
-            // next boundary.
-            bool should_add = true;
-            for (auto &user : producer->users) {
-                if (user == boundary_node) {
-                    continue;
-                }
-                if (seen_nodes.find(user) == seen_nodes.end()) {
-                    should_add = false;
-                    break;
-                }
-            }
-            if (!should_add) {
-                continue;
-            }
-            if (seen_nodes.find(producer) != seen_nodes.end()) {
-                ERR(SchedulerError,
-                    "unexpected error: circular dependency detected");
-            }
-            OPGRAPH_DEBUG("      added ", producer->get_name(),
-                          " to next boundary");
-            new_boundary_nodes.emplace_back(producer);
+        if (!node->ops[0]->is_virtual()) {
+            continue;
         }
-        if (boundary_node->ops[0]->is_virtual()) {
-            OPGRAPH_DEBUG("    remove op: ", boundary_node->get_name());
-            // Remove this node from the graph.
-            boundary_node->remove_self();
-            // Remove this node from the list of nodes.
-            auto it = std::find_if(
-                nodes.begin(), nodes.end(),
-                [boundary_node](const std::unique_ptr<OpNode> &node) {
-                    return node.get() == boundary_node;
-                });
-            if (it == nodes.end()) {
-                ERR(SchedulerError, "unexpected error");
-            }
-            nodes.erase(it);
-            OPGRAPH_DEBUG("      nodes.size() ", nodes.size());
-        } else {
-            seen_nodes.insert(boundary_node);
+        OPGRAPH_DEBUG("  remove op: ", node->get_name());
+        if (node->users.count(node.get()) > 0) {
+            ERR(SchedulerError,
+                "unexpected error: circular dependency detected");
         }
+        node->remove_self();
+        node->users.clear();
+        node->producers.clear();
+        node->ops.clear();
     }
-    recursive_rm_virt(nodes, seen_nodes, new_boundary_nodes);
 }
 
 /// Helper of @ref create_nodes().
-/// Traverse the model graph and merge pairs of Ops that are the only user
-/// and producer of each other.
+/// Traverse the model graph from leaves to roots and merge pairs of Ops that
+/// are the only user and producer of each other.
 ///
-/// @param nodes The list of @ref OpNode.
-/// @param seen_nodes The set of @ref OpNode that have been seen.
-/// @param boundary_nodes The list of boundary @ref OpNode.
+/// A node is visited after all of its users are visited, i.e., either seen
+/// or merged into its producer. Each edge is visited a constant number of
+/// times except for the dependency checks between siblings.
 ///
-void OpGraph::recursive_merge(std::list<std::unique_ptr<OpNode>> &nodes,
-                              std::set<OpNode *> &seen_nodes,
-                              const std::list<OpNode *> &boundary_nodes) {
-    if (boundary_nodes.size() == 0) {
-        return;
-    }
+void OpGraph::merge_nodes() {
     OPGRAPH_DEBUG("merge ops");
-    std::list<OpNode *> new_boundary_nodes;
-    for (auto &boundary_node : boundary_nodes) {
+    size_t num_nodes = this->nodes_storage.size();
+    // Nodes that are visited and not merged into their producers.
+    std::vector<char> seen(num_nodes, 0);
+    // Number of users of each node that are not seen.
+    std::vector<int> num_unseen_users(num_nodes, 0);
+    std::deque<OpNode *> boundary_nodes;
+    for (auto &node : this->nodes_storage) {
+        num_unseen_users[node->id] = (int)node->users.size();
+        if (node->users.empty()) {
+            boundary_nodes.emplace_back(node.get());
+        }
+    }
+    auto mark_seen = [&](OpNode *node) {
+        seen[node->id] = 1;
+        for (auto &producer : node->producers) {
+            --num_unseen_users[producer->id];
+        }
+    };
+    while (!boundary_nodes.empty()) {
+        OpNode *boundary_node = boundary_nodes.front();
+        boundary_nodes.pop_front();
         OPGRAPH_DEBUG("  boundary node");
         OPGRAPH_DEBUG("    op: ", boundary_node->get_name());
         if (boundary_node->producers.size() == 0) {
             // This node is a root.
-            seen_nodes.insert(boundary_node);
+            mark_seen(boundary_node);
             OPGRAPH_DEBUG("    root");
             continue;
         }
@@ -217,24 +232,14 @@ void OpGraph::recursive_merge(std::list<std::unique_ptr<OpNode>> &nodes,
             // Exception: if any user of the producer (rather than the current
             // boundary_node) is unseen, we should not add the producer to the
             // next boundary.
-            bool should_add = true;
-            for (auto &user : producer->users) {
-                if (user == boundary_node) {
-                    continue;
-                }
-                if (seen_nodes.find(user) == seen_nodes.end()) {
-                    should_add = false;
-                    break;
-                }
-            }
-            if (!should_add) {
+            if (num_unseen_users[producer->id] != 1) {
                 continue;
             }
-            if (seen_nodes.find(producer) != seen_nodes.end()) {
+            if (seen[producer->id]) {
                 ERR(SchedulerError,
                     "unexpected error: circular dependency detected");
             }
-            new_boundary_nodes.emplace_back(producer);
+            boundary_nodes.emplace_back(producer);
         }
         OpNode *merge_candidate = nullptr;
         if (boundary_node->producers.size() > 1) {
@@ -259,7 +264,7 @@ void OpGraph::recursive_merge(std::list<std::unique_ptr<OpNode>> &nodes,
             if (merge_candidate == nullptr) {
                 // At least one producer does not depend on others.
                 // Cannot merge.
-                seen_nodes.insert(boundary_node);
+                mark_seen(boundary_node);
                 OPGRAPH_DEBUG("    multiple producers");
                 continue;
             }
@@ -286,13 +291,17 @@ void OpGraph::recursive_merge(std::list<std::unique_ptr<OpNode>> &nodes,
             if (!depends_on_one) {
                 // At least one user does not depend on the boundary_node.
                 // Cannot merge.
-                seen_nodes.insert(boundary_node);
+                mark_seen(boundary_node);
                 OPGRAPH_DEBUG("    multiple users");
                 continue;
             }
         }
         // We can merge the two nodes.
-        // Merge `boundary_node` into `merge_candidate`.
+        // Merge `boundary_node` into `merge_candidate`. `merge_candidate`
+        // depends on all other producers of `boundary_node` and all other
+        // users of `merge_candidate` depend on `boundary_node`, so the merged
+        // node has exactly the ancestors and descendants of `merge_candidate`
+        // and keeps its place in the reachability index.
         OPGRAPH_DEBUG("  merge: ", merge_candidate->get_name(), " -> ",
                       boundary_node->get_name());
         auto &ops = boundary_node->ops;
@@ -301,34 +310,33 @@ void OpGraph::recursive_merge(std::list<std::unique_ptr<OpNode>> &nodes,
         for (auto &user : boundary_node->users) {
             user->producers.erase(boundary_node);
             user->producers.insert(merge_candidate);
-            merge_candidate->users.insert(user);
+            if (merge_candidate->users.insert(user).second && !seen[user->id]) {
+                ++num_unseen_users[merge_candidate->id];
+            }
         }
         for (auto &producer : boundary_node->producers) {
             if (producer == merge_candidate) {
                 continue;
             }
             producer->users.erase(boundary_node);
-            producer->users.insert(merge_candidate);
+            --num_unseen_users[producer->id];
+            if (producer->users.insert(merge_candidate).second) {
+                ++num_unseen_users[producer->id];
+            }
             merge_candidate->producers.insert(producer);
         }
         merge_candidate->users.erase(boundary_node);
+        --num_unseen_users[merge_candidate->id];
 
-        // Remove `boundary_node` from `nodes`.
-        auto it =
-            std::find_if(nodes.begin(), nodes.end(),
-                         [boundary_node](const std::unique_ptr<OpNode> &node) {
-                             return node.get() == boundary_node;
-                         });
-        if (it == nodes.end()) {
-            ERR(SchedulerError, "unexpected error");
-        }
-        nodes.erase(it);
+        // Mark `boundary_node` as removed. It will be erased from the list of
+        // nodes at once after traversal.
+        boundary_node->ops.clear();
+        boundary_node->users.clear();
+        boundary_node->producers.clear();
 
         // Since producer is already in the next boundary and boundary_node is
-        // merged into producer, we don't need to add anything to
-        // seen_nodes here.
+        // merged into producer, we don't need to mark anything as seen here.
     }
-    recursive_merge(nodes, seen_nodes, new_boundary_nodes);
 }
 
 OpNode *OpGraph::break_node(OpNode *node, int op_idx) {
@@ -338,12 +346,16 @@ OpNode *OpGraph::break_node(OpNode *node, int op_idx) {
     if (op_idx < 0 || op_idx >= (int)node->ops.size()) {
         ERR(SchedulerError, "unexpected error: op_idx out of range");
     }
-    this->nodes_storage.emplace_back(std::make_unique<OpNode>());
-    OpNode *new_node = this->nodes_storage.back().get();
+    OpNode *new_node = this->add_node();
     new_node->ops.insert(new_node->ops.end(), node->ops.begin() + op_idx,
                          node->ops.end());
     new_node->users = node->users;
     new_node->producers.insert(node);
+    // The new node has the same ancestors and descendants as the original
+    // node except for the original node itself, so it shares the index of
+    // the original node and is ordered after it.
+    new_node->reach_id = node->reach_id;
+    new_node->reach_seq = node->reach_seq + op_idx;
     for (auto &user : node->users) {
         user->producers.erase(node);
         user->producers.insert(new_node);
@@ -354,6 +366,107 @@ OpNode *OpGraph::break_node(OpNode *node, int op_idx) {
     return new_node;
 }
 
+/// Helper of @ref create_nodes().
+/// Build the reachability index of the current nodes.
+///
+/// Nodes are visited in a topological order and each node is appended to a
+/// chain whose last node is one of its ancestors, or starts a new chain if
+/// there is no such chain. The number of chains is bounded by the number of
+/// nodes that can run in parallel, which is small for most models, so the
+/// index takes O((V + E) * C) time and O(V * C) space for C chains.
+///
+void OpGraph::build_reach_index() {
+    size_t num_nodes = this->nodes_storage.size();
+    std::vector<OpNode *> order;
+    order.reserve(num_nodes);
+    // Indexed by `reach_id`, which numbers the nodes by their position in
+    // `nodes_storage` until a node is visited and gets its topological order.
+    // The counter of a node is not used after all its producers are visited.
+    std::vector<size_t> num_unseen_producers;
+    num_unseen_producers.reserve(num_nodes);
+    for (auto &node : this->nodes_storage) {
+        node->reach_id = (int)num_unseen_producers.size();
+        node->reach_seq = 0;
+        num_unseen_producers.emplace_back(node->producers.size());
+        if (node->producers.empty()) {
+            order.emplace_back(node.get());
+        }
+    }
+    for (size_t i = 0; i < order.size(); ++i) {
+        OpNode *node = order[i];
+        node->reach_id = (int)i;
+        for (auto &user : node->users) {
+            if (--num_unseen_producers[user->reach_id] == 0) {
+                order.emplace_back(user);
+            }
+        }
+    }
+    if (order.size() != num_nodes) {
+        ERR(SchedulerError, "unexpected error: circular dependency detected");
+    }
+
+    this->reach_indexed = true;
+    this->reach_chain.assign(num_nodes, -1);
+    this->reach_pos.assign(num_nodes, -1);
+    this->reach_row_begin.assign(num_nodes + 1, 0);
+    this->reach_rows.clear();
+    // The last node of each chain.
+    std::vector<int> chain_tails;
+    std::vector<int> row;
+    for (size_t i = 0; i < num_nodes; ++i) {
+        OpNode *node = order[i];
+        int num_chains = (int)chain_tails.size();
+        row.assign(num_chains, -1);
+        for (auto &producer : node->producers) {
+            size_t begin = this->reach_row_begin[producer->reach_id];
+            size_t end = this->reach_row_begin[producer->reach_id + 1];
+            for (size_t c = 0; c < end - begin; ++c) {
+                row[c] = std::max(row[c], this->reach_rows[begin + c]);
+            }
+        }
+        // The tail of chain `c` is an ancestor if the largest position of
+        // chain `c` among the ancestors is that of the tail.
+        int chain = -1;
+        for (int c = 0; c < num_chains; ++c) {
+            if (row[c] >= 0 && row[c] == this->reach_pos[chain_tails[c]]) {
+                chain = c;
+                break;
+            }
+        }
+        int pos = 0;
+        if (chain == -1) {
+            chain = num_chains;
+            chain_tails.emplace_back(-1);
+            row.emplace_back(-1);
+        } else {
+            pos = this->reach_pos[chain_tails[chain]] + 1;
+        }
+        chain_tails[chain] = (int)i;
+        this->reach_chain[i] = chain;
+        this->reach_pos[i] = pos;
+        row[chain] = pos;
+        if (this->reach_rows.size() + row.size() > MAX_REACH_INDEX_ENTRIES) {
+            LOG(WARN, "OpGraph is too wide to index reachability (",
+                num_nodes, " nodes, ", chain_tails.size(), "+ chains)");
+            this->reach_indexed = false;
+            break;
+        }
+        this->reach_rows.insert(this->reach_rows.end(), row.begin(),
+                                row.end());
+        this->reach_row_begin[i + 1] = this->reach_rows.size();
+    }
+    if (!this->reach_indexed) {
+        this->reach_chain.clear();
+        this->reach_pos.clear();
+        this->reach_row_begin.clear();
+        this->reach_rows.clear();
+        return;
+    }
+    OPGRAPH_DEBUG("reachability index: ", num_nodes, " nodes, ",
+                  chain_tails.size(), " chains, ", this->reach_rows.size(),
+                  " entries");
+}
+
 /// Check dependencies between two @ref OpNode.
 ///
 /// @param node1 The first @ref OpNode.
@@ -363,23 +476,47 @@ bool OpGraph::depends_on(OpNode *node1, OpNode *node2) const {
     if (node1 == node2) {
         return false;
     }
+    int id1 = node1->reach_id;
+    int id2 = node2->reach_id;
+    if (id1 < 0 || id2 < 0) {
+        ERR(SchedulerError, "unexpected error: OpNode is not indexed");
+    }
+    if (id1 == id2) {
+        // Both are broken from the same node.
+        return node1->reach_seq > node2->reach_seq;
+    }
+    if (id1 < id2) {
+        // node2 comes later in the topological order.
+        return false;
+    }
+    if (this->reach_indexed) {
+        size_t begin = this->reach_row_begin[id1];
+        size_t end = this->reach_row_begin[id1 + 1];
+        size_t chain = (size_t)this->reach_chain[id2];
+        if (chain >= end - begin) {
+            return false;
+        }
+        return this->reach_rows[begin + chain] >= this->reach_pos[id2];
+    }
+    // Not indexed. Search producers of node1 that come after node2 in the
+    // topological order.
     std::set<OpNode *> seen_nodes;
-    std::list<OpNode *> boundary_nodes;
-    boundary_nodes.emplace_back(node1);
-    while (boundary_nodes.size() > 0) {
-        std::list<OpNode *> new_boundary_nodes;
-        for (auto &boundary_node : boundary_nodes) {
-            if (boundary_node == node2) {
+    std::vector<OpNode *> stack;
+    stack.emplace_back(node1);
+    while (!stack.empty()) {
+        OpNode *node = stack.back();
+        stack.pop_back();
+        for (auto &producer : node->producers) {
+            if (producer == node2) {
                 return true;
             }
-            for (auto &producer : boundary_node->producers) {
-                if (seen_nodes.find(producer) != seen_nodes.end()) {
-                    continue;
-                }
-                new_boundary_nodes.emplace_back(producer);
+            if (producer->reach_id < id2) {
+                continue;
+            }
+            if (seen_nodes.emplace(producer).second) {
+                stack.emplace_back(producer);
             }
         }
-        boundary_nodes = new_boundary_nodes;
     }
     return false;
 }
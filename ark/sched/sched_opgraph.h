@@ -4,7 +4,6 @@
 #ifndef _ARK_SCHED_OPGRAPH_H_
 #define _ARK_SCHED_OPGRAPH_H_
 
-#include <list>
 #include <memory>
 #include <set>
 #include <vector>
@@ -24,6 +23,9 @@ class OpNode {
     /// Destruct an @ref OpNode.
     ~OpNode(){};
 
+    /// Index of this @ref OpNode in @ref OpGraph::get_nodes().
+    int id = -1;
+
     /// The list of @ref Op that this @ref OpNode contains. Sorted in the
     /// execution order.
     std::vector<Op *> ops;
@@ -34,6 +36,15 @@ class OpNode {
     /// The list of @ref OpNode that this @ref OpNode depends on.
     std::set<OpNode *> producers;
 
+    /// Index of this @ref OpNode in the reachability index of the
+    /// @ref OpGraph. Nodes created by @ref OpGraph::break_node() share the
+    /// index of the original node.
+    int reach_id = -1;
+
+    /// Offset of the first op of this @ref OpNode among the ops of the
+    /// original node that shares the same @ref reach_id.
+    int reach_seq = 0;
+
     /// Remove this @ref OpNode from the graph.
     void remove_self();
 
@@ -68,9 +79,10 @@ class OpGraph {
 
     OpGraph &operator=(const OpGraph &);
 
-    /// Get the @ref OpNode list.
+    /// Get the @ref OpNode list. Each @ref OpNode is located at its
+    /// @ref OpNode::id in the list.
     /// @return The @ref OpNode list.
-    const std::list<std::unique_ptr<OpNode>> &get_nodes() const {
+    const std::vector<std::unique_ptr<OpNode>> &get_nodes() const {
         return this->nodes_storage;
     }
 
@@ -86,21 +98,35 @@ class OpGraph {
 
     /// Check dependencies between two @ref OpNode.
     ///
+    /// This is answered in constant time from the reachability index, which
+    /// is kept valid through merging and @ref break_node().
+    ///
     /// @param node1 The first @ref OpNode.
     /// @param node2 The second @ref OpNode.
     /// @return True if @p node1 depends on @p node2.
     bool depends_on(OpNode *node1, OpNode *node2) const;
 
    private:
-    std::list<std::unique_ptr<OpNode>> nodes_storage;
-
+    std::vector<std::unique_ptr<OpNode>> nodes_storage;
+
+    // Reachability index built by build_reach_index(). Indexed nodes are
+    // covered by chains, i.e., sequences of nodes where each node depends on
+    // all previous ones. For each indexed node, `reach_rows` keeps the
+    // largest position of each chain among the node itself and all of its
+    // ancestors. Chains that are created after the node cannot contain its
+    // ancestors, so each row only covers the chains that exist at the time.
+    bool reach_indexed = false;
+    std::vector<int> reach_chain;
+    std::vector<int> reach_pos;
+    std::vector<size_t> reach_row_begin;
+    std::vector<int> reach_rows;
+
+    OpNode *add_node();
     void create_nodes(const Model &model);
-    void recursive_rm_virt(std::list<std::unique_ptr<OpNode>> &nodes,
-                           std::set<OpNode *> &seen_nodes,
-                           const std::list<OpNode *> &boundary_nodes);
-    void recursive_merge(std::list<std::unique_ptr<OpNode>> &nodes,
-                         std::set<OpNode *> &seen_nodes,
-                         const std::list<OpNode *> &boundary_nodes);
+    void build_reach_index();
+    void erase_removed_nodes();
+    void remove_virtual_nodes();
+    void merge_nodes();
 };
 
 }  // namespace ark
@@ -4,8 +4,11 @@
 #include "sched_opgraph.h"
 
 #include <algorithm>
+#include <map>
+#include <random>
 
 #include "ark.h"
+#include "cpu_timer.h"
 #include "logging.h"
 #include "unittest/unittest_utils.h"
 
@@ -610,6 +613,140 @@ ark::unittest::State test_sched_opgraph_all_reduce() {
     return ark::unittest::SUCCESS;
 }
 
+// Collect the ancestors of every node by brute force.
+static std::map<ark::OpNode *, std::set<ark::OpNode *>> get_ancestors(
+    const ark::OpGraph &graph) {
+    std::map<ark::OpNode *, std::set<ark::OpNode *>> ancestors;
+    for (auto &node : graph.get_nodes()) {
+        auto &anc = ancestors[node.get()];
+        std::vector<ark::OpNode *> stack(node->producers.begin(),
+                                         node->producers.end());
+        while (!stack.empty()) {
+            ark::OpNode *n = stack.back();
+            stack.pop_back();
+            if (anc.emplace(n).second) {
+                stack.insert(stack.end(), n->producers.begin(),
+                             n->producers.end());
+            }
+        }
+    }
+    return ancestors;
+}
+
+static bool check_depends_on(const ark::OpGraph &graph) {
+    auto ancestors = get_ancestors(graph);
+    for (auto &node1 : graph.get_nodes()) {
+        auto &anc = ancestors[node1.get()];
+        for (auto &node2 : graph.get_nodes()) {
+            bool expected = anc.find(node2.get()) != anc.end();
+            if (graph.depends_on(node1.get(), node2.get()) != expected) {
+                LOG(ark::WARN, "depends_on(", node1->get_name(), ", ",
+                    node2->get_name(), ") is not ", expected);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+ark::unittest::State test_sched_opgraph_depends_on() {
+    for (int seed = 0; seed < 10; ++seed) {
+        std::mt19937 gen(seed);
+        ark::Model model;
+        std::vector<ark::Tensor *> tensors;
+        for (int i = 0; i < 4; ++i) {
+            tensors.emplace_back(model.tensor({64}, ark::FP32));
+        }
+        // A random DAG where most ops consume recent outputs.
+        for (int i = 0; i < 200; ++i) {
+            int num = (int)tensors.size();
+            auto pick = [&]() {
+                int window = (gen() % 4 == 0) ? num : std::min(num, 8);
+                return tensors[num - 1 - gen() % window];
+            };
+            if (gen() % 3 == 0) {
+                tensors.emplace_back(model.relu(pick()));
+            } else {
+                tensors.emplace_back(model.add(pick(), pick()));
+            }
+        }
+        ark::OpGraph graph(model);
+        UNITTEST_TRUE(check_depends_on(graph));
+
+        // Break every node with multiple ops in the middle.
+        std::vector<ark::OpNode *> multi_op_nodes;
+        for (auto &node : graph.get_nodes()) {
+            if (node->ops.size() > 1) {
+                multi_op_nodes.emplace_back(node.get());
+            }
+        }
+        for (auto &node : multi_op_nodes) {
+            ark::OpNode *new_node =
+                graph.break_node(node, (int)node->ops.size() / 2);
+            UNITTEST_TRUE(graph.depends_on(new_node, node));
+            UNITTEST_FALSE(graph.depends_on(node, new_node));
+            if (new_node->ops.size() > 1) {
+                graph.break_node(new_node, 1);
+            }
+        }
+        UNITTEST_TRUE(check_depends_on(graph));
+    }
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_sched_opgraph_scale() {
+    // Transformer-like layers: each layer runs `width` parallel branches of
+    // a few element-wise ops and accumulates them into the layer output.
+    for (int num_layers : {10, 100}) {
+        const int width = 100;
+        const int branch_len = 8;
+        ark::Model model;
+        ark::Tensor *x = model.relu(model.tensor({64}, ark::FP32));
+        for (int l = 0; l < num_layers; ++l) {
+            ark::Tensor *acc = nullptr;
+            for (int w = 0; w < width; ++w) {
+                ark::Tensor *b = model.relu(x);
+                for (int i = 1; i < branch_len; ++i) {
+                    b = model.relu(b);
+                }
+                acc = (acc == nullptr) ? b : model.add(acc, b);
+            }
+            x = acc;
+        }
+        int num_ops = 1 + num_layers * (width * branch_len + width - 1);
+
+        double start = ark::cpu_timer();
+        ark::OpGraph graph(model);
+        double elapsed = ark::cpu_timer() - start;
+        LOG(ark::INFO, "OpGraph of ", num_ops, " ops -> ",
+            graph.get_nodes().size(), " nodes in ", elapsed, " seconds");
+
+        // Each branch is merged into a single node.
+        UNITTEST_EQ(graph.get_nodes().size(),
+                    (size_t)(1 + num_layers * (2 * width - 1)));
+
+        ark::OpNode *first = graph.get_nodes().front().get();
+        ark::OpNode *last = nullptr;
+        for (auto &node : graph.get_nodes()) {
+            if (node->users.empty()) {
+                last = node.get();
+            }
+        }
+        UNITTEST_NE(last, (ark::OpNode *)nullptr);
+        start = ark::cpu_timer();
+        int num_deps = 0;
+        for (auto &node : graph.get_nodes()) {
+            num_deps += graph.depends_on(last, node.get());
+            num_deps += graph.depends_on(node.get(), first);
+        }
+        elapsed = ark::cpu_timer() - start;
+        LOG(ark::INFO, 2 * graph.get_nodes().size(), " queries in ", elapsed,
+            " seconds");
+        UNITTEST_EQ(num_deps, 2 * ((int)graph.get_nodes().size() - 1));
+    }
+    return ark::unittest::SUCCESS;
+}
+
 int main() {
     ark::init();
     UNITTEST(test_sched_opgraph);
@@ -620,5 +757,7 @@ int main() {
     UNITTEST(test_sched_opgraph_split_matmul);
     UNITTEST(test_sched_opgraph_cumulate);
     UNITTEST(test_sched_opgraph_all_reduce);
+    UNITTEST(test_sched_opgraph_depends_on);
+    UNITTEST(test_sched_opgraph_scale);
     return 0;
 }
@@ -0,0 +1,117 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "sched/sched_pass.h"
+
+#include <sstream>
+
+#include "cpu_timer.h"
+#include "logging.h"
+
+namespace ark {
+
+Op *GraphPass::get_single_user(const ModelImpl *model_impl, Tensor *tns) {
+    const std::set<Op *> &users = model_impl->get_users(tns);
+    if (users.size() != 1) {
+        return nullptr;
+    }
+    return *users.begin();
+}
+
+OpRewritePass::OpRewritePass(const std::string &name,
+                             const std::set<OpType> &op_types,
+                             Rewrite rewrite)
+    : GraphPass{name}, op_types_{op_types}, rewrite_{rewrite} {}
+
+int OpRewritePass::run(Model &model, ModelImpl *model_impl) {
+    std::list<Op *> ops = model_impl->get_ops();
+    int num_changes = 0;
+    for (Op *op : ops) {
+        if (!model_impl->has_op(op)) {
+            // Deleted by a previous rewrite.
+            continue;
+        }
+        if (!op_types_.empty() && op_types_.count(op->type) == 0) {
+            continue;
+        }
+        if (rewrite_(model, model_impl, *op)) {
+            ++num_changes;
+        }
+    }
+    return num_changes;
+}
+
+void GraphPassManager::add(std::unique_ptr<GraphPass> pass, bool enabled) {
+    for (auto &p : passes_) {
+        if (p->get_name() == pass->get_name()) {
+            ERR(InvalidUsageError, "duplicate graph pass: ", pass->get_name());
+        }
+    }
+    passes_.emplace_back(std::move(pass));
+    enabled_.push_back(enabled);
+}
+
+size_t GraphPassManager::find(const std::string &name) const {
+    for (size_t i = 0; i < passes_.size(); ++i) {
+        if (passes_[i]->get_name() == name) {
+            return i;
+        }
+    }
+    ERR(InvalidUsageError, "unknown graph pass: ", name);
+    return 0;
+}
+
+void GraphPassManager::enable(const std::string &name, bool enable) {
+    enabled_[this->find(name)] = enable;
+}
+
+void GraphPassManager::enable_list(const std::string &names) {
+    this->enable_list(names, true);
+}
+
+void GraphPassManager::disable_list(const std::string &names) {
+    this->enable_list(names, false);
+}
+
+void GraphPassManager::enable_list(const std::string &names, bool enable) {
+    std::stringstream ss(names);
+    std::string name;
+    while (std::getline(ss, name, ',')) {
+        if (!name.empty()) {
+            this->enable(name, enable);
+        }
+    }
+}
+
+bool GraphPassManager::is_enabled(const std::string &name) const {
+    return enabled_[this->find(name)];
+}
+
+std::vector<std::string> GraphPassManager::get_names() const {
+    std::vector<std::string> names;
+    for (auto &p : passes_) {
+        names.emplace_back(p->get_name());
+    }
+    return names;
+}
+
+int GraphPassManager::run(Model &model) {
+    Model::Impl *model_impl = model.impl.get();
+    stats_.clear();
+    int total_changes = 0;
+    for (size_t i = 0; i < passes_.size(); ++i) {
+        Stats st{passes_[i]->get_name(), enabled_[i], 0, 0};
+        if (enabled_[i]) {
+            double start = cpu_timer();
+            st.num_changes = passes_[i]->run(model, model_impl);
+            st.elapsed_sec = cpu_timer() - start;
+            total_changes += st.num_changes;
+        }
+        LOG(DEBUG, "graph pass ", st.name, (st.enabled ? "" : " (disabled)"),
+            ": ", st.num_changes, " changes in ", st.elapsed_sec, " seconds");
+        stats_.emplace_back(st);
+    }
+    return total_changes;
+}
+
+}  // namespace ark
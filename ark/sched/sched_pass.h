@@ -0,0 +1,114 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#ifndef ARK_SCHED_PASS_H_
+#define ARK_SCHED_PASS_H_
+
+#include <functional>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "model.h"
+
+namespace ark {
+
+/// A rewrite of the graph of a @ref Model.
+class GraphPass {
+   public:
+    /// Passes work on the internals of @ref Model.
+    using ModelImpl = Model::Impl;
+
+    GraphPass(const std::string &name) : name_{name} {}
+    virtual ~GraphPass() = default;
+
+    const std::string &get_name() const { return name_; }
+
+    /// Rewrite @p model.
+    /// @return the number of changes made.
+    virtual int run(Model &model, ModelImpl *model_impl) = 0;
+
+    /// The only user @ref Op of @p tns, or nullptr if @p tns has no user or
+    /// more than one user.
+    static Op *get_single_user(const ModelImpl *model_impl, Tensor *tns);
+
+   private:
+    std::string name_;
+};
+
+/// A @ref GraphPass that visits every @ref Op of the given types in the order
+/// of declaration and calls a rewrite function on it. Ops created by the
+/// rewrite function are not visited, and ops deleted by it are skipped.
+class OpRewritePass : public GraphPass {
+   public:
+    /// Returns true if it changed the model.
+    using Rewrite = std::function<bool(Model &, ModelImpl *, Op &)>;
+
+    /// @param name name of the pass.
+    /// @param op_types types of @ref Op to visit. Empty to visit all.
+    /// @param rewrite the rewrite function.
+    OpRewritePass(const std::string &name, const std::set<OpType> &op_types,
+                  Rewrite rewrite);
+
+    int run(Model &model, ModelImpl *model_impl) override;
+
+   private:
+    std::set<OpType> op_types_;
+    Rewrite rewrite_;
+};
+
+/// Runs a pipeline of @ref GraphPass in the order of registration.
+class GraphPassManager {
+   public:
+    /// Result of the last run of a pass.
+    struct Stats {
+        std::string name;
+        bool enabled;
+        int num_changes;
+        double elapsed_sec;
+    };
+
+    GraphPassManager() = default;
+    GraphPassManager(const GraphPassManager &) = delete;
+    GraphPassManager &operator=(const GraphPassManager &) = delete;
+
+    /// Append @p pass to the pipeline. Pass names should be unique. Opt-in
+    /// passes are added with @p enabled false.
+    void add(std::unique_ptr<GraphPass> pass, bool enabled = true);
+
+    /// Enable or disable the pass named @p name.
+    void enable(const std::string &name, bool enable = true);
+
+    /// Enable the passes listed in a comma-separated string, e.g., the value
+    /// of `ARK_ENABLE_GRAPH_PASSES`.
+    void enable_list(const std::string &names);
+
+    /// Disable the passes listed in a comma-separated string, e.g., the value
+    /// of `ARK_DISABLE_GRAPH_PASSES`.
+    void disable_list(const std::string &names);
+
+    bool is_enabled(const std::string &name) const;
+
+    /// Names of the registered passes.
+    std::vector<std::string> get_names() const;
+
+    /// Run all enabled passes on @p model.
+    /// @return the total number of changes.
+    int run(Model &model);
+
+    /// Statistics of the last @ref run, one per registered pass.
+    const std::vector<Stats> &get_stats() const { return stats_; }
+
+   private:
+    size_t find(const std::string &name) const;
+    void enable_list(const std::string &names, bool enable);
+
+    std::vector<std::unique_ptr<GraphPass>> passes_;
+    std::vector<bool> enabled_;
+    std::vector<Stats> stats_;
+};
+
+}  // namespace ark
+
+#endif  // ARK_SCHED_PASS_H_
@@ -0,0 +1,161 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "sched/sched_pass.h"
+
+#include "gpu/gpu_profile.h"
+#include "include/ark.h"
+#include "sched/sched.h"
+#include "unittest/unittest_utils.h"
+
+// Fold `scale(scale(x, a), b)` into `scale(x, a * b)`.
+static bool fold_scale(ark::Model &model, ark::GraphPass::ModelImpl *impl,
+                       ark::Op &op) {
+    ark::Tensor *in = op.inputs[0];
+    ark::Op *prod = const_cast<ark::Op *>(impl->get_producer(in));
+    if (prod == nullptr || prod->type != ark::OP_SCALE ||
+        ark::GraphPass::get_single_user(impl, in) != &op) {
+        return false;
+    }
+    float a;
+    float b;
+    prod->args.get(&a, 0);
+    op.args.get(&b, 0);
+    ark::Tensor *src = prod->inputs[0];
+    ark::Tensor *out_ref = op.output_refs[0];
+    ark::Tensor *out = op.outputs[0];
+    impl->delete_op(&op);
+    impl->delete_op(prod);
+    ark::Tensor *tmp = model.scale(src, a * b, out_ref);
+    impl->replace_tensor(tmp, out);
+    impl->delete_tensor(tmp);
+    return true;
+}
+
+static int count_ops(ark::Model &model, ark::OpType type) {
+    int cnt = 0;
+    ark::OpGraph graph(model);
+    for (auto &node : graph.get_nodes()) {
+        for (auto &op : node->ops) {
+            cnt += (op->type == type);
+        }
+    }
+    return cnt;
+}
+
+ark::unittest::State test_sched_pass_rewrite() {
+    ark::Model model;
+    ark::Tensor *x = model.tensor({64}, ark::FP32);
+    ark::Tensor *y = model.scale(model.scale(model.scale(x, 2), 3), 4);
+    model.relu(y);
+    // `z` has two users, so it is not folded into its user.
+    ark::Tensor *z = model.scale(x, 5);
+    model.scale(z, 6);
+    model.relu(z);
+    UNITTEST_EQ(count_ops(model, ark::OP_SCALE), 5);
+
+    ark::GraphPassManager passes;
+    passes.add(std::make_unique<ark::OpRewritePass>(
+        "fold_scale", std::set<ark::OpType>{ark::OP_SCALE}, fold_scale));
+    UNITTEST_EQ(passes.run(model), 2);
+    UNITTEST_EQ(count_ops(model, ark::OP_SCALE), 3);
+
+    auto &stats = passes.get_stats();
+    UNITTEST_EQ(stats.size(), 1UL);
+    UNITTEST_EQ(stats[0].name, "fold_scale");
+    UNITTEST_EQ(stats[0].num_changes, 2);
+    UNITTEST_TRUE(stats[0].elapsed_sec >= 0);
+
+    // Nothing left to fold.
+    UNITTEST_EQ(passes.run(model), 0);
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_sched_pass_manager() {
+    ark::GraphPassManager passes;
+    auto noop = [](ark::Model &, ark::GraphPass::ModelImpl *, ark::Op &) {
+        return true;
+    };
+    passes.add(std::make_unique<ark::OpRewritePass>(
+        "all", std::set<ark::OpType>{}, noop));
+    passes.add(std::make_unique<ark::OpRewritePass>(
+        "relu", std::set<ark::OpType>{ark::OP_RELU}, noop));
+    passes.add(std::make_unique<ark::OpRewritePass>(
+        "exp", std::set<ark::OpType>{ark::OP_EXP}, noop));
+    UNITTEST_THROW(passes.add(std::make_unique<ark::OpRewritePass>(
+                       "relu", std::set<ark::OpType>{}, noop)),
+                   ark::InvalidUsageError);
+    UNITTEST_EQ(passes.get_names().size(), 3UL);
+
+    ark::Model model;
+    model.relu(model.relu(model.tensor({64}, ark::FP32)));
+
+    // "all" visits three tensor ops and two relu ops, and "relu" visits the
+    // two relu ops.
+    UNITTEST_EQ(passes.run(model), 5 + 2);
+    passes.disable_list("all,exp");
+    UNITTEST_TRUE(!passes.is_enabled("all"));
+    UNITTEST_TRUE(passes.is_enabled("relu"));
+    UNITTEST_EQ(passes.run(model), 2);
+    UNITTEST_TRUE(!passes.get_stats()[0].enabled);
+    UNITTEST_EQ(passes.get_stats()[0].num_changes, 0);
+    passes.enable("all");
+    UNITTEST_EQ(passes.run(model), 5 + 2);
+
+    // An opt-in pass runs only after it is enabled. "tensor" visits the three
+    // tensor ops.
+    passes.add(std::make_unique<ark::OpRewritePass>(
+                   "tensor", std::set<ark::OpType>{ark::OP_TENSOR}, noop),
+               false);
+    UNITTEST_TRUE(!passes.is_enabled("tensor"));
+    UNITTEST_EQ(passes.run(model), 5 + 2);
+    passes.enable_list("tensor,relu");
+    UNITTEST_TRUE(passes.is_enabled("tensor"));
+    UNITTEST_EQ(passes.run(model), 5 + 2 + 3);
+
+    UNITTEST_THROW(passes.enable("unknown"), ark::InvalidUsageError);
+    UNITTEST_THROW(passes.enable_list("unknown"), ark::InvalidUsageError);
+    UNITTEST_THROW(passes.disable_list("relu,unknown"),
+                   ark::InvalidUsageError);
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_sched_pass_scheduler() {
+    ark::GpuManager::Info info = ark::gpu_profile("a100");
+    for (bool disable : {false, true}) {
+        if (disable) {
+            ::setenv("ARK_DISABLE_GRAPH_PASSES", "matmul_split_k", 1);
+        } else {
+            ::unsetenv("ARK_DISABLE_GRAPH_PASSES");
+        }
+        ark::init();
+
+        ark::Model model;
+        ark::Tensor *a = model.tensor({256, 4096}, ark::FP16);
+        ark::Tensor *b = model.tensor({4096, 256}, ark::FP16);
+        model.matmul(a, b);
+        ark::DefaultScheduler sched{model, info, 0, 1};
+
+        auto &stats = sched.get_graph_passes().get_stats();
+        UNITTEST_EQ(stats.size(), 3UL);
+        UNITTEST_EQ(stats[0].name, "matmul_split_k");
+        UNITTEST_EQ(stats[0].enabled, !disable);
+        UNITTEST_EQ(stats[0].num_changes, disable ? 0 : 1);
+        if (disable) {
+            UNITTEST_EQ(count_ops(model, ark::OP_MATMUL), 1);
+        } else {
+            UNITTEST_TRUE(count_ops(model, ark::OP_MATMUL) > 1);
+        }
+    }
+    ::unsetenv("ARK_DISABLE_GRAPH_PASSES");
+    ark::init();
+    return ark::unittest::SUCCESS;
+}
+
+int main() {
+    ark::init();
+    UNITTEST(test_sched_pass_rewrite);
+    UNITTEST(test_sched_pass_manager);
+    UNITTEST(test_sched_pass_scheduler);
+    return 0;
+}
@@ -0,0 +1,554 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include <cstdlib>
+
+#include "env.h"
+#include "file_io.h"
+#include "gpu/gpu_compile.h"
+#include "gpu/gpu_profile.h"
+#include "include/ark.h"
+#include "logging.h"
+#include "sched/sched.h"
+#include "sched/sched_exec_plan.h"
+#include "unittest/unittest_utils.h"
+
+ark::unittest::State test_sched_plan_profile() {
+    for (auto &name : ark::gpu_profile_names()) {
+        ark::GpuManager::Info info = ark::gpu_profile(name);
+        UNITTEST_TRUE(info.num_sm > 0);
+        UNITTEST_EQ(info.min_threads_per_block,
+                    info.max_registers_per_block /
+                        info.max_registers_per_thread);
+
+        // Round trip through JSON.
+        ark::GpuManager::Info info2 =
+            ark::gpu_profile_from_json(ark::gpu_profile_to_json(info));
+        UNITTEST_EQ(info2.arch, info.arch);
+        UNITTEST_EQ(info2.num_sm, info.num_sm);
+        UNITTEST_EQ(info2.gmem_total, info.gmem_total);
+        UNITTEST_EQ(info2.smem_block_total, info.smem_block_total);
+        UNITTEST_EQ(info2.min_threads_per_block, info.min_threads_per_block);
+    }
+    UNITTEST_EQ(ark::gpu_profile("A100").arch, "cuda_80");
+    UNITTEST_THROW(ark::gpu_profile("not_a_gpu"), ark::InvalidUsageError);
+    UNITTEST_THROW(ark::gpu_profile_from_json("{\"arch\": \"cuda_80\"}"),
+                   ark::InvalidUsageError);
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_sched_plan_only() {
+    for (auto &name : {"a100", "mi250x", "mi300x"}) {
+        ark::GpuManager::Info info = ark::gpu_profile(name);
+
+        ark::Model m;
+        ark::Tensor *x0 = m.tensor({2, 128, 128}, ark::FP16);
+        ark::Tensor *x1 = m.scale(x0, 0.7);
+        ark::Tensor *x2 = m.tensor({2, 128, 128}, ark::FP16);
+        ark::Tensor *y = m.add(x1, x2);
+        ark::Tensor *w = m.tensor({128, 256}, ark::FP16);
+        m.matmul(y, w);
+
+        ark::DefaultScheduler sched{m, info, 0, 1};
+        UNITTEST_TRUE(sched.is_plan_only());
+        UNITTEST_THROW(sched.create_context(), ark::InvalidUsageError);
+
+        sched.schedule();
+        UNITTEST_TRUE(sched.get_opseqs().size() > 0);
+        UNITTEST_TRUE(sched.get_comp_stream().size() > 0);
+        UNITTEST_EQ(sched.get_comp_stream().size(),
+                    sched.get_comm_stream().size());
+
+        sched.plan_context();
+        UNITTEST_TRUE(sched.get_total_bytes() > 0);
+
+        // Every local buffer is laid out inside the planned region without
+        // overlapping with each other.
+        std::vector<std::pair<size_t, size_t>> ranges;
+        for (auto &bi : sched.get_buf_infos()) {
+            if (bi.tbuf == nullptr || bi.bytes == 0) continue;
+            size_t offset = bi.tbuf->get_buf_offset();
+            UNITTEST_TRUE(offset + bi.bytes <= sched.get_total_bytes());
+            ranges.emplace_back(offset, offset + bi.bytes);
+        }
+        std::sort(ranges.begin(), ranges.end());
+        for (size_t i = 1; i < ranges.size(); ++i) {
+            UNITTEST_TRUE(ranges[i - 1].second <= ranges[i].first);
+        }
+
+        auto codes = sched.gen_code();
+        UNITTEST_EQ(codes.size(), 1UL);
+        UNITTEST_NE(codes[0].find("ark_loop_body"), std::string::npos);
+        for (auto &opseq : sched.get_opseqs()) {
+            std::string func = "op" + std::to_string(opseq->get_id());
+            UNITTEST_NE(codes[0].find(func), std::string::npos);
+        }
+    }
+    return ark::unittest::SUCCESS;
+}
+
+// Rank 0 of 4 sends a tensor to every peer after computing it.
+static void send_to_peers(ark::Model &m) {
+    ark::Tensor *x = m.tensor({1024, 1024}, ark::FP16);
+    ark::Tensor *y = m.scale(x, 0.5);
+    for (int peer = 1; peer < 4; ++peer) {
+        ark::Tensor *s = m.send(y, peer, peer);
+        m.send_done(s, peer, peer);
+    }
+}
+
+ark::unittest::State test_sched_plan_comm_sms() {
+    ark::GpuManager::Info info = ark::gpu_profile("a100");
+    {
+        // By default, the last SM is for communication.
+        ark::Model m;
+        send_to_peers(m);
+        ark::DefaultScheduler sched{m, info, 0, 4};
+        UNITTEST_EQ(sched.get_num_sm_comp(), info.num_sm - 1);
+        UNITTEST_EQ(sched.get_num_sm_comm(), 1);
+        UNITTEST_EQ(sched.get_num_comm_streams(), 1);
+    }
+
+    ::setenv("ARK_NUM_COMM_SMS", "4", 1);
+    ::setenv("ARK_NUM_COMM_STREAMS", "2", 1);
+    ark::get_env(true);
+    {
+        ark::Model m;
+        send_to_peers(m);
+        ark::DefaultScheduler sched{m, info, 0, 4};
+        UNITTEST_EQ(sched.get_num_sm_comp(), info.num_sm - 4);
+        auto range0 = sched.get_comm_sm_range(0);
+        auto range1 = sched.get_comm_sm_range(1);
+        UNITTEST_EQ(range0.first, info.num_sm - 4);
+        UNITTEST_EQ(range0.second, info.num_sm - 2);
+        UNITTEST_EQ(range1.first, info.num_sm - 2);
+        UNITTEST_EQ(range1.second, info.num_sm);
+        sched.schedule();
+
+        // Sends to peers 1 and 3 go to stream 0, and peer 2 to stream 1.
+        int num_comm_ops[2] = {0, 0};
+        for (auto &streams : sched.get_comm_stream()) {
+            UNITTEST_EQ(streams.size(), 2UL);
+            for (int k = 0; k < 2; ++k) {
+                auto range = sched.get_comm_sm_range(k);
+                for (auto &stream : streams[k]->get_streams()) {
+                    for (auto &br : stream.branches) {
+                        UNITTEST_TRUE(br.sm_id_begin >= range.first);
+                        UNITTEST_TRUE(br.sm_id_end <= range.second);
+                        for (auto &wb : br.warp_branches) {
+                            num_comm_ops[k] += (int)wb.branch_ops.size();
+                        }
+                    }
+                }
+            }
+        }
+        UNITTEST_EQ(num_comm_ops[0], 4);
+        UNITTEST_EQ(num_comm_ops[1], 2);
+
+        sched.plan_context();
+        auto codes = sched.gen_code();
+        UNITTEST_NE(codes[0].find("_2;"), std::string::npos);
+    }
+
+    // Every SM computes if the model does not communicate.
+    ::setenv("ARK_NUM_COMM_SMS", "0", 1);
+    ark::get_env(true);
+    {
+        ark::Model m;
+        m.scale(m.tensor({1024, 1024}, ark::FP16), 0.5);
+        ark::DefaultScheduler sched{m, info, 0, 1};
+        UNITTEST_EQ(sched.get_num_sm_comp(), info.num_sm);
+        UNITTEST_EQ(sched.get_num_comm_streams(), 0);
+        sched.schedule();
+        sched.plan_context();
+        UNITTEST_EQ(sched.gen_code().size(), 1UL);
+    }
+    {
+        ark::Model m;
+        send_to_peers(m);
+        ark::DefaultScheduler sched{m, info, 0, 4};
+        UNITTEST_EQ(sched.get_num_sm_comm(), 2);
+    }
+
+    ::setenv("ARK_NUM_COMM_SMS", "1", 1);
+    ark::get_env(true);
+    {
+        ark::Model m;
+        send_to_peers(m);
+        UNITTEST_THROW(ark::DefaultScheduler(m, info, 0, 4),
+                       ark::InvalidUsageError);
+    }
+
+    ::unsetenv("ARK_NUM_COMM_SMS");
+    ::unsetenv("ARK_NUM_COMM_STREAMS");
+    ark::get_env(true);
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_sched_plan_work_queue() {
+    ark::GpuManager::Info info = ark::gpu_profile("a100");
+    auto build = [](ark::Model &m) {
+        ark::Tensor *x = m.tensor({4096, 1000}, ark::FP16);
+        m.scale(x, 0.5);
+        ark::Tensor *y = m.tensor({64, 64}, ark::FP16);
+        m.scale(y, 0.5);
+    };
+
+    ::setenv("ARK_DISPATCH", "dynamic", 1);
+    ark::get_env(true);
+    {
+        ark::Model m;
+        build(m);
+        ark::DefaultScheduler sched{m, info, 0, 1};
+        sched.schedule();
+        auto &queues = sched.get_work_queues();
+        UNITTEST_EQ(queues.size(), sched.get_opseqs().size());
+        for (auto &p : queues) {
+            auto &opseq = sched.get_opseqs()[p.first];
+            UNITTEST_EQ(p.second.num_uops, opseq->get_tdims_size());
+            UNITTEST_TRUE(p.second.num_groups > 0);
+            UNITTEST_TRUE(p.second.chunk_size > 0);
+            LOG(ark::INFO, opseq->get_name(), ": ", p.second.num_uops,
+                " uops, ", p.second.num_groups, " groups, chunk ",
+                p.second.chunk_size);
+        }
+        sched.plan_context();
+        auto codes = sched.gen_code();
+        for (auto &p : queues) {
+            std::string name = "ARK_WORK_QUEUE_" + std::to_string(p.first);
+            UNITTEST_NE(codes[0].find("ark::sync::WorkQueue " + name + ";"),
+                        std::string::npos);
+            UNITTEST_NE(codes[0].find("(" + name + ", ARK_WORK_QUEUE_SLOTS"),
+                        std::string::npos);
+        }
+    }
+
+    ::setenv("ARK_DISPATCH", "auto", 1);
+    ark::get_env(true);
+    {
+        ark::Model m;
+        build(m);
+        ark::DefaultScheduler sched{m, info, 0, 1};
+        sched.schedule();
+        UNITTEST_EQ(sched.get_work_queues().size(), 1UL);
+    }
+
+    ::setenv("ARK_DISPATCH", "dynamic", 1);
+    ark::get_env(true);
+    {
+        // The uops of an opseq of the split-k matmuls do not fit in a stream
+        // and continue in the next one. Such an opseq is dispatched
+        // statically, and the others through work queues.
+        ark::Model m;
+        for (int i = 0; i < 6; ++i) {
+            ark::Tensor *x = m.tensor({512, 1024}, ark::FP16);
+            ark::Tensor *w = m.tensor({1024, 1024}, ark::FP16);
+            m.matmul(x, w);
+        }
+        ark::DefaultScheduler sched{m, info, 0, 1};
+        sched.schedule();
+        std::map<int, int> num_streams;
+        for (auto &stream : sched.get_comp_stream()) {
+            for (auto &s : stream->get_streams()) {
+                std::set<int> opseq_ids;
+                for (auto &br : s.branches) {
+                    for (auto &wb : br.warp_branches) {
+                        for (auto &op : wb.branch_ops) {
+                            opseq_ids.insert(op.opseq_id);
+                        }
+                    }
+                }
+                for (int id : opseq_ids) num_streams[id]++;
+            }
+        }
+        int num_split = 0;
+        auto &queues = sched.get_work_queues();
+        for (auto &p : num_streams) {
+            if (p.second > 1) {
+                ++num_split;
+                UNITTEST_EQ(queues.count(p.first), 0UL);
+            } else {
+                UNITTEST_EQ(queues.count(p.first), 1UL);
+            }
+        }
+        UNITTEST_TRUE(num_split > 0);
+        sched.plan_context();
+        auto codes = sched.gen_code();
+        UNITTEST_EQ(codes.size(), 1UL);
+    }
+
+    ::setenv("ARK_DISPATCH", "fifo", 1);
+    ark::get_env(true);
+    {
+        ark::Model m;
+        build(m);
+        ark::DefaultScheduler sched{m, info, 0, 1};
+        UNITTEST_THROW(sched.schedule(), ark::InvalidUsageError);
+    }
+
+    ::unsetenv("ARK_DISPATCH");
+    ark::get_env(true);
+    return ark::unittest::SUCCESS;
+}
+
+// Count the occurrences of @p pattern in @p str.
+static int count(const std::string &str, const std::string &pattern) {
+    int cnt = 0;
+    for (size_t pos = str.find(pattern); pos != std::string::npos;
+         pos = str.find(pattern, pos + 1)) {
+        ++cnt;
+    }
+    return cnt;
+}
+
+ark::unittest::State test_sched_plan_shared_opseq() {
+    ark::GpuManager::Info info = ark::gpu_profile("a100");
+    int num_opseqs = 0;
+    auto gen_code = [&info, &num_opseqs]() {
+        // Identical layers that only differ in their buffers and scales.
+        ark::Model m;
+        ark::Tensor *x = m.tensor({256, 1024}, ark::FP16);
+        for (int i = 0; i < 8; ++i) {
+            ark::Tensor *w = m.tensor({1024, 1024}, ark::FP16);
+            x = m.scale(m.matmul(x, w), 0.5f + i);
+        }
+        ark::DefaultScheduler sched{m, info, 0, 1};
+        sched.schedule();
+        sched.plan_context();
+        num_opseqs = (int)sched.get_opseqs().size();
+        return sched.gen_code()[0];
+    };
+
+    std::string code = gen_code();
+    UNITTEST_NE(code.find("__constant__ ArkOpSeqArgs0 ARK_OPSEQ_ARGS_0["),
+                std::string::npos);
+    UNITTEST_TRUE(count(code, "__noinline__ __device__ void opc") > 0);
+    // Every opseq is still defined, as a wrapper of a shared function.
+    UNITTEST_EQ(count(code, "__noinline__ __device__ void op") +
+                    count(code, "DEVICE void op"),
+                count(code, "__noinline__ __device__ void opc") + num_opseqs);
+    // Scales are passed as arguments.
+    UNITTEST_NE(code.find(", 7.5}"), std::string::npos);
+
+    ::setenv("ARK_SHARE_OPSEQ_CODE", "0", 1);
+    ark::get_env(true);
+    std::string unshared_code = gen_code();
+    UNITTEST_EQ(unshared_code.find("ARK_OPSEQ_ARGS"), std::string::npos);
+    UNITTEST_EQ(count(unshared_code, "__noinline__ __device__ void op"),
+                num_opseqs);
+    UNITTEST_TRUE(code.size() < unshared_code.size());
+    LOG(ark::INFO, "code size: ", code.size(), " bytes shared, ",
+        unshared_code.size(), " bytes unshared");
+
+    ::unsetenv("ARK_SHARE_OPSEQ_CODE");
+    ark::get_env(true);
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_sched_plan_code_shards() {
+#if defined(ARK_CUDA)
+    ark::GpuManager::Info info = ark::gpu_profile("a100");
+    int num_opseqs = 0;
+    auto gen_code = [&info, &num_opseqs]() {
+        ark::Model m;
+        ark::Tensor *x = m.tensor({256, 1024}, ark::FP16);
+        for (int i = 0; i < 8; ++i) {
+            ark::Tensor *w = m.tensor({1024, 1024}, ark::FP16);
+            x = m.scale(m.matmul(x, w), 0.5f + i);
+        }
+        ark::DefaultScheduler sched{m, info, 0, 1};
+        sched.schedule();
+        sched.plan_context();
+        num_opseqs = (int)sched.get_opseqs().size();
+        return sched.gen_code();
+    };
+    ::setenv("ARK_SHARE_OPSEQ_CODE", "0", 1);
+
+    // The code is a single translation unit by default.
+    ark::get_env(true);
+    UNITTEST_EQ(ark::get_env().num_code_shards, 1);
+    UNITTEST_EQ(gen_code().size(), 1UL);
+
+    // Small models are a single translation unit even if chosen
+    // automatically.
+    ::setenv("ARK_NUM_CODE_SHARDS", "0", 1);
+    ark::get_env(true);
+    UNITTEST_EQ(gen_code().size(), 1UL);
+
+    ::setenv("ARK_NUM_CODE_SHARDS", "3", 1);
+    ark::get_env(true);
+    auto codes = gen_code();
+    UNITTEST_EQ(codes.size(), 4UL);
+    // The main code only declares the opseqs that the shards define.
+    UNITTEST_NE(codes[0].find("ark_loop_body"), std::string::npos);
+    UNITTEST_EQ(count(codes[0], "__noinline__ __device__ void op"), 0);
+    UNITTEST_EQ(count(codes[0], "int _uop_idx, int _smem_per_warp);\n"),
+                num_opseqs);
+    int num_defs = 0;
+    for (size_t i = 1; i < codes.size(); ++i) {
+        UNITTEST_EQ(codes[i].find("ark_loop_body"), std::string::npos);
+        UNITTEST_NE(codes[i].find("namespace {"), std::string::npos);
+        int n = count(codes[i], "__noinline__ __device__ void op");
+        UNITTEST_TRUE(n > 0);
+        num_defs += n;
+    }
+    UNITTEST_EQ(num_defs, num_opseqs);
+
+    // Shards are compiled into relocatable device code and then linked.
+    auto cmds = ark::gpu_compile_commands({"/tmp/ark_a.cu", "/tmp/ark_b.cu"},
+                                          info.arch, 0, "/tmp/ark_ab.cubin");
+    UNITTEST_EQ(cmds.size(), 3UL);
+    UNITTEST_NE(cmds[0].find(" -dc "), std::string::npos);
+    UNITTEST_NE(cmds[0].find("-o /tmp/ark_a.o /tmp/ark_a.cu"),
+                std::string::npos);
+    UNITTEST_NE(cmds[1].find("-o /tmp/ark_b.o /tmp/ark_b.cu"),
+                std::string::npos);
+    UNITTEST_NE(cmds[2].find(" -dlink -cubin "), std::string::npos);
+    UNITTEST_NE(cmds[2].find("-o /tmp/ark_ab.cubin /tmp/ark_a.o /tmp/ark_b.o"),
+                std::string::npos);
+    cmds = ark::gpu_compile_commands({"/tmp/ark_a.cu"}, info.arch, 0,
+                                     "/tmp/ark_a.cubin");
+    UNITTEST_EQ(cmds.size(), 1UL);
+    UNITTEST_NE(cmds[0].find(" -cubin "), std::string::npos);
+    UNITTEST_EQ(cmds[0].find(" -dc "), std::string::npos);
+
+    ::unsetenv("ARK_NUM_CODE_SHARDS");
+    ::unsetenv("ARK_SHARE_OPSEQ_CODE");
+    ark::get_env(true);
+#endif  // defined(ARK_CUDA)
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_sched_plan_exec_plan() {
+    ark::GpuManager::Info info = ark::gpu_profile("a100");
+    auto build = [](ark::Model &m, float factor) {
+        ark::Tensor *x = m.tensor({2, 128, 128}, ark::FP16);
+        ark::Tensor *w = m.tensor({128, 256}, ark::FP16);
+        m.matmul(m.scale(x, factor), w);
+    };
+    ark::Model m;
+    build(m, 0.7f);
+    ark::ExecPlan::ModelRef ref{m};
+    std::string hash = ark::ExecPlan::model_hash(m);
+
+    // The hash only depends on the structure of the model.
+    ark::Model m2;
+    build(m2, 0.7f);
+    UNITTEST_EQ(ark::ExecPlan::model_hash(m2), hash);
+    ark::Model m3;
+    build(m3, 0.8f);
+    UNITTEST_NE(ark::ExecPlan::model_hash(m3), hash);
+
+    ark::DefaultScheduler sched{m, info, 0, 1};
+    sched.schedule();
+    sched.plan_context();
+    auto codes = sched.gen_code();
+    ark::ExecPlan plan{ref, sched, codes, hash};
+    UNITTEST_EQ(plan.bufs.size(), sched.get_buf_infos().size());
+    UNITTEST_EQ(plan.opseqs.size(), sched.get_opseqs().size());
+
+    std::string path = ark::get_env().path_tmp_dir + "/.test_sched_exec_plan";
+    plan.save(path);
+    ark::ExecPlan loaded = ark::ExecPlan::load(path);
+    UNITTEST_EQ(loaded.hash, hash);
+    UNITTEST_TRUE(loaded.codes == codes);
+    UNITTEST_EQ(loaded.shared_bytes, plan.shared_bytes);
+    UNITTEST_EQ(loaded.bufs.size(), plan.bufs.size());
+    for (size_t i = 0; i < plan.bufs.size(); ++i) {
+        UNITTEST_EQ(loaded.bufs[i].model_buf, plan.bufs[i].model_buf);
+        UNITTEST_EQ(loaded.bufs[i].bytes, plan.bufs[i].bytes);
+        UNITTEST_EQ(loaded.bufs[i].data_offset, plan.bufs[i].data_offset);
+    }
+    UNITTEST_EQ(loaded.tensors.size(), plan.tensors.size());
+    for (size_t i = 0; i < plan.opseqs.size(); ++i) {
+        UNITTEST_TRUE(loaded.opseqs[i].functions == plan.opseqs[i].functions);
+    }
+
+    loaded.validate(hash, info, 0, 1, 16);
+    UNITTEST_THROW(loaded.validate(ark::ExecPlan::model_hash(m3), info, 0, 1,
+                                   16),
+                   ark::InvalidUsageError);
+    UNITTEST_THROW(loaded.validate(hash, ark::gpu_profile("mi300x"), 0, 1, 16),
+                   ark::InvalidUsageError);
+    UNITTEST_THROW(loaded.validate(hash, info, 1, 2, 16),
+                   ark::InvalidUsageError);
+    UNITTEST_THROW(loaded.validate(hash, info, 0, 1, 8),
+                   ark::InvalidUsageError);
+
+    // Settings that change the generated code should be the same.
+    UNITTEST_TRUE(loaded.settings == ark::ExecPlan::env_settings());
+    std::vector<std::pair<std::string, std::string>> changes{
+        {"ARK_DISPATCH", "dynamic"},
+        {"ARK_TRACE", "/tmp/trace.json"},
+        {"ARK_SHARE_OPSEQ_CODE", "0"},
+        {"ARK_NUM_COMM_SMS", "4"},
+        {"ARK_NUM_COMM_STREAMS", "2"},
+        {"ARK_DISABLE_GRAPH_OPT", "1"},
+        {"ARK_DISABLE_GRAPH_PASSES", "matmul_split_k"},
+        {"ARK_ENABLE_GRAPH_PASSES", "ewise_fusion"},
+        {"ARK_SCHED_POLICY", "lpt"},
+        {"ARK_NUM_CODE_SHARDS", "4"}};
+    for (auto &p : changes) {
+        UNITTEST_EQ(loaded.settings.count(p.first), 1UL);
+    }
+    for (auto &p : changes) {
+        ::setenv(p.first.c_str(), p.second.c_str(), 1);
+        ark::get_env(true);
+        UNITTEST_THROW(loaded.validate(hash, info, 0, 1, 16),
+                       ark::InvalidUsageError);
+        ::unsetenv(p.first.c_str());
+        ark::get_env(true);
+    }
+    // The path of the trace does not matter.
+    ::setenv("ARK_TRACE", "/tmp/a.json", 1);
+    ark::get_env(true);
+    ark::ExecPlan traced{ref, sched, codes, hash};
+    ::setenv("ARK_TRACE", "/tmp/b.json", 1);
+    ark::get_env(true);
+    traced.validate(hash, info, 0, 1, 16);
+    ::unsetenv("ARK_TRACE");
+    ark::get_env(true);
+
+    // Binding the buffers to an unscheduled copy of the model restores the
+    // layouts that the scheduler chose.
+    ark::ExecPlan::ModelRef ref2{m2};
+    std::vector<std::shared_ptr<ark::GpuBuffer>> gpu_bufs;
+    for (auto &b : loaded.bufs) {
+        std::shared_ptr<ark::GpuBuffer> buf;
+        if (b.data_offset >= 0) {
+            buf = std::make_shared<ark::GpuBuffer>(b.gpu_id, nullptr, 0,
+                                                   b.data_offset, b.bytes);
+        }
+        gpu_bufs.emplace_back(buf);
+    }
+    loaded.bind(ref2, gpu_bufs);
+    for (auto &t : loaded.tensors) {
+        ark::Tensor *tns = ref.tensors[t.model_tensor];
+        ark::Tensor *tns2 = ref2.tensors[t.model_tensor];
+        UNITTEST_EQ(tns2->ldims, tns->ldims);
+        UNITTEST_EQ(tns2->pads, tns->pads);
+        UNITTEST_EQ(tns2->buf->bytes, tns->buf->bytes);
+        if (tns->buf->bytes > 0) {
+            UNITTEST_EQ(tns2->buf->get_buf_offset(),
+                        tns->buf->get_buf_offset());
+        }
+    }
+
+    ark::write_file(path, "{\"version\": 1}");
+    UNITTEST_THROW(ark::ExecPlan::load(path), ark::InvalidUsageError);
+    ark::remove_file(path);
+    UNITTEST_THROW(ark::ExecPlan::load(path), ark::InvalidUsageError);
+    return ark::unittest::SUCCESS;
+}
+
+int main() {
+    ark::init();
+    UNITTEST(test_sched_plan_profile);
+    UNITTEST(test_sched_plan_only);
+    UNITTEST(test_sched_plan_comm_sms);
+    UNITTEST(test_sched_plan_work_queue);
+    UNITTEST(test_sched_plan_shared_opseq);
+    UNITTEST(test_sched_plan_code_shards);
+    UNITTEST(test_sched_plan_exec_plan);
+    return 0;
+}
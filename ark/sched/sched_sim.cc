@@ -0,0 +1,301 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "sched/sched_sim.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <queue>
+#include <set>
+
+#include "logging.h"
+#include "sched/sched.h"
+
+namespace ark {
+
+double SchedSimResult::avg_utilization() const {
+    if (this->sm_utilization.empty()) {
+        return 0;
+    }
+    double sum = 0;
+    for (double u : this->sm_utilization) {
+        sum += u;
+    }
+    return sum / this->sm_utilization.size();
+}
+
+std::ostream &operator<<(std::ostream &os, const SchedSimResult &res) {
+    os << "makespan " << res.makespan << " us, " << res.num_uops
+       << " uops, SM utilization avg " << std::fixed << std::setprecision(3)
+       << res.avg_utilization();
+    if (!res.sm_utilization.empty()) {
+        auto minmax = std::minmax_element(res.sm_utilization.begin(),
+                                          res.sm_utilization.end());
+        os << " min " << *minmax.first << " max " << *minmax.second;
+    }
+    os << std::defaultfloat << ", critical path:";
+    // Consecutive uops of the same opseq are shown as one.
+    size_t i = 0;
+    while (i < res.critical_path.size()) {
+        size_t j = i + 1;
+        auto &first = res.critical_path[i];
+        while (j < res.critical_path.size() &&
+               res.critical_path[j].opseq_id == first.opseq_id) {
+            ++j;
+        }
+        os << " op" << first.opseq_id << " x" << (j - i) << " ["
+           << first.start << ", " << res.critical_path[j - 1].end << ")";
+        i = j;
+    }
+    return os;
+}
+
+SchedSimulator::SchedSimulator(int num_sm, int num_warps_per_sm,
+                               CostFn cost_fn)
+    : num_sm{num_sm},
+      num_warps_per_sm{num_warps_per_sm},
+      cost_fn{cost_fn},
+      clocks(num_sm * num_warps_per_sm, 0),
+      lasts(num_sm * num_warps_per_sm, -1) {
+    if (num_sm <= 0 || num_warps_per_sm <= 0) {
+        ERR(InvalidUsageError, "invalid number of SMs ", num_sm,
+            " or warps per SM ", num_warps_per_sm);
+    }
+    if (!this->cost_fn) {
+        ERR(InvalidUsageError, "cost function is not given");
+    }
+}
+
+double SchedSimulator::run_uop(int opseq_id, int uop_id, int sm_id,
+                               int warp_id_begin, int warp_id_end,
+                               double duration) {
+    if (sm_id < 0 || sm_id >= this->num_sm || warp_id_begin < 0 ||
+        warp_id_end > this->num_warps_per_sm) {
+        ERR(SchedulerError, "uop ", uop_id, " of opseq ", opseq_id,
+            " runs on SM ", sm_id, " warps [", warp_id_begin, ", ",
+            warp_id_end, ") out of range");
+    }
+    int base = sm_id * this->num_warps_per_sm;
+    int slowest = base + warp_id_begin;
+    for (int w = slowest; w < base + warp_id_end; ++w) {
+        if (this->clocks[w] > this->clocks[slowest]) {
+            slowest = w;
+        }
+    }
+    double start = this->clocks[slowest];
+    int pred = this->lasts[slowest];
+    double end = start + duration;
+    int idx = (int)this->uops.size();
+    this->uops.push_back(
+        {opseq_id, uop_id, sm_id, warp_id_begin, warp_id_end, start, end});
+    this->preds.push_back(pred);
+    for (int w = base + warp_id_begin; w < base + warp_id_end; ++w) {
+        this->clocks[w] = end;
+        this->lasts[w] = idx;
+    }
+    return end;
+}
+
+void SchedSimulator::sync(int sm_id_begin, int sm_id_end) {
+    int begin = sm_id_begin * this->num_warps_per_sm;
+    int end = sm_id_end * this->num_warps_per_sm;
+    if (begin >= end) {
+        return;
+    }
+    int slowest = begin;
+    for (int w = begin; w < end; ++w) {
+        if (this->clocks[w] > this->clocks[slowest]) {
+            slowest = w;
+        }
+    }
+    double t = this->clocks[slowest];
+    int last = this->lasts[slowest];
+    for (int w = begin; w < end; ++w) {
+        this->clocks[w] = t;
+        this->lasts[w] = last;
+    }
+}
+
+void SchedSimulator::sync_gpu() { this->sync(0, this->num_sm); }
+
+void SchedSimulator::run_work_queue(const std::vector<Stream> &streams,
+                                    size_t stream_idx, size_t branch_idx,
+                                    const BranchOp &queue_op,
+                                    const SchedWorkQueue &wq) {
+    struct Group {
+        int sm_id;
+        int warp_id_begin;
+        int warp_id_end;
+    };
+    std::vector<Group> groups;
+    auto &branches = streams[stream_idx].branches;
+    for (size_t b = branch_idx; b < branches.size(); ++b) {
+        auto &br = branches[b];
+        for (int sm_id = br.sm_id_begin; sm_id < br.sm_id_end; ++sm_id) {
+            for (auto &wb : br.warp_branches) {
+                auto it = std::find_if(
+                    wb.branch_ops.begin(), wb.branch_ops.end(),
+                    [&](const BranchOp &op) {
+                        return op.opseq_id == queue_op.opseq_id;
+                    });
+                if (it == wb.branch_ops.end()) continue;
+                int nwarps = it->num_warps_per_uop;
+                for (int w = wb.warp_id_begin; w + nwarps <= wb.warp_id_end;
+                     w += nwarps) {
+                    groups.push_back({sm_id, w, w + nwarps});
+                }
+            }
+        }
+    }
+    if (groups.empty()) {
+        return;
+    }
+    // Each chunk goes to the group that becomes free the earliest.
+    using Entry = std::pair<double, size_t>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> ready;
+    for (size_t g = 0; g < groups.size(); ++g) {
+        int base = groups[g].sm_id * this->num_warps_per_sm;
+        double t = 0;
+        for (int w = groups[g].warp_id_begin; w < groups[g].warp_id_end; ++w) {
+            t = std::max(t, this->clocks[base + w]);
+        }
+        ready.emplace(t, g);
+    }
+    double cost = this->cost_fn(queue_op.opseq_id);
+    int chunk_size = std::max(wq.chunk_size, 1);
+    for (int u = 0; u < wq.num_uops; u += chunk_size) {
+        int n = std::min(chunk_size, wq.num_uops - u);
+        size_t g = ready.top().second;
+        ready.pop();
+        double end =
+            this->run_uop(queue_op.opseq_id, u, groups[g].sm_id,
+                          groups[g].warp_id_begin, groups[g].warp_id_end,
+                          cost * n);
+        ready.emplace(end, g);
+    }
+}
+
+void SchedSimulator::run_streams(
+    const std::vector<Stream> &streams, int sm_id_begin, int sm_id_end,
+    const std::map<int, SchedWorkQueue> &work_queues) {
+    for (size_t s = 0; s < streams.size(); ++s) {
+        auto &branches = streams[s].branches;
+        std::set<int> queued;
+        for (size_t b = 0; b < branches.size(); ++b) {
+            auto &br = branches[b];
+            for (int sm_id = br.sm_id_begin; sm_id < br.sm_id_end; ++sm_id) {
+                int sm_idx = sm_id - br.sm_id_begin;
+                for (auto &wb : br.warp_branches) {
+                    // The generated code runs the work queues of a warp
+                    // branch before its statically mapped uops.
+                    for (auto &op : wb.branch_ops) {
+                        auto it = work_queues.find(op.opseq_id);
+                        if (it == work_queues.end() ||
+                            !queued.insert(op.opseq_id).second) {
+                            continue;
+                        }
+                        this->run_work_queue(streams, s, b, op, it->second);
+                    }
+                    int num_warps = wb.warp_id_end - wb.warp_id_begin;
+                    for (auto &op : wb.branch_ops) {
+                        if (work_queues.count(op.opseq_id) > 0) continue;
+                        double cost = this->cost_fn(op.opseq_id);
+                        int num_uops = num_warps / op.num_warps_per_uop;
+                        for (int i = 0; i < num_uops; ++i) {
+                            int warp_id =
+                                wb.warp_id_begin + i * op.num_warps_per_uop;
+                            int uop_id =
+                                op.uop_id_diff * (i + num_uops * sm_idx) +
+                                op.uop_id_begin;
+                            this->run_uop(op.opseq_id, uop_id, sm_id, warp_id,
+                                          warp_id + op.num_warps_per_uop,
+                                          cost);
+                        }
+                    }
+                }
+            }
+        }
+        if (!branches.empty() && s != streams.size() - 1) {
+            this->sync(sm_id_begin, sm_id_end);
+        }
+    }
+}
+
+SchedSimResult SchedSimulator::get_result() {
+    this->sync_gpu();
+    SchedSimResult res;
+    res.makespan = this->clocks[0];
+    res.num_uops = this->uops.size();
+    for (int idx = this->lasts[0]; idx >= 0; idx = this->preds[idx]) {
+        res.critical_path.push_back(this->uops[idx]);
+    }
+    std::reverse(res.critical_path.begin(), res.critical_path.end());
+
+    // Merge the busy intervals of each SM.
+    std::vector<std::vector<std::pair<double, double>>> intervals(this->num_sm);
+    for (auto &uop : this->uops) {
+        if (uop.end > uop.start) {
+            intervals[uop.sm_id].emplace_back(uop.start, uop.end);
+        }
+    }
+    res.sm_busy.resize(this->num_sm, 0);
+    res.sm_utilization.resize(this->num_sm, 0);
+    for (int sm_id = 0; sm_id < this->num_sm; ++sm_id) {
+        auto &iv = intervals[sm_id];
+        std::sort(iv.begin(), iv.end());
+        double busy = 0;
+        double cur_begin = 0;
+        double cur_end = -1;
+        for (auto &p : iv) {
+            if (p.first > cur_end) {
+                if (cur_end > cur_begin) busy += cur_end - cur_begin;
+                cur_begin = p.first;
+                cur_end = p.second;
+            } else {
+                cur_end = std::max(cur_end, p.second);
+            }
+        }
+        if (cur_end > cur_begin) busy += cur_end - cur_begin;
+        res.sm_busy[sm_id] = busy;
+        if (res.makespan > 0) {
+            res.sm_utilization[sm_id] = busy / res.makespan;
+        }
+    }
+    return res;
+}
+
+SchedSimResult SchedSimulator::simulate(const DefaultScheduler &sched,
+                                        CostFn cost_fn) {
+    auto &opseqs = sched.get_opseqs();
+    if (!cost_fn) {
+        // Estimates are cached as the cost model is not cheap.
+        auto costs = std::make_shared<std::vector<double>>(opseqs.size(), -1);
+        cost_fn = [&sched, &opseqs, costs](int opseq_id) {
+            double &cost = costs->at(opseq_id);
+            if (cost < 0) {
+                cost = sched.get_uop_cost(*opseqs[opseq_id]);
+            }
+            return cost;
+        };
+    }
+    int num_sm_comp = sched.get_num_sm_comp();
+    SchedSimulator sim{num_sm_comp + sched.get_num_sm_comm(),
+                       sched.get_num_warps_per_sm(), cost_fn};
+    auto &comp_stream = sched.get_comp_stream();
+    auto &comm_stream = sched.get_comm_stream();
+    for (size_t i = 0; i < comp_stream.size(); ++i) {
+        sim.run_streams(comp_stream[i]->get_streams(), 0, num_sm_comp,
+                        sched.get_work_queues());
+        for (int k = 0; k < sched.get_num_comm_streams(); ++k) {
+            auto range = sched.get_comm_sm_range(k);
+            sim.run_streams(comm_stream[i][k]->get_streams(), range.first,
+                            range.second);
+        }
+        // Stages are separated by `sync_gpu`, and so are the iterations of
+        // the loop kernel.
+        sim.sync_gpu();
+    }
+    return sim.get_result();
+}
+
+}  // namespace ark
@@ -0,0 +1,117 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#ifndef ARK_SCHED_SIM_H_
+#define ARK_SCHED_SIM_H_
+
+#include <functional>
+#include <map>
+#include <ostream>
+#include <vector>
+
+#include "sched/sched_codegen.h"
+#include "sched/sched_stream.h"
+
+namespace ark {
+
+class DefaultScheduler;
+
+/// A uop, or a chunk of uops of a work queue, that the simulator ran.
+struct SchedSimUop {
+    int opseq_id;
+    /// The uop ID, or the first uop ID of a chunk.
+    int uop_id;
+    int sm_id;
+    /// The warp ID range [warp_id_begin, warp_id_end) that ran the uop.
+    int warp_id_begin;
+    int warp_id_end;
+    /// Start and end time in microseconds from the start of the iteration.
+    double start;
+    double end;
+};
+
+/// Predicted execution of an iteration of the loop body.
+struct SchedSimResult {
+    /// Time until the last SM finishes the iteration in microseconds.
+    double makespan = 0;
+    /// Time that each SM runs at least one uop in microseconds.
+    std::vector<double> sm_busy;
+    /// Fraction of the makespan that each SM runs at least one uop.
+    std::vector<double> sm_utilization;
+    /// Chain of uops that decides the makespan, in the order of execution.
+    /// Each uop starts when the previous one ends, either on the same warps
+    /// or by a barrier.
+    std::vector<SchedSimUop> critical_path;
+    /// Number of simulated uops and chunks.
+    size_t num_uops = 0;
+
+    /// Average of @ref sm_utilization.
+    double avg_utilization() const;
+};
+
+std::ostream &operator<<(std::ostream &os, const SchedSimResult &res);
+
+/// Discrete-event simulator of the generated loop body. Each warp of each SM
+/// runs the uops of its branches one after another as the generated code
+/// does, where a uop starts when all of its warps are free and takes the time
+/// given by the cost function. `sync_stream` and `sync_gpu` barriers hold the
+/// SMs they cover until the slowest of them arrives.
+///
+/// Uops of an opseq in @ref SchedWorkQueue are handed out in chunks to the
+/// warp groups that become free the earliest, assuming that all of the groups
+/// reach the queue in the first branch that runs it.
+class SchedSimulator {
+   public:
+    /// Time of a single uop of an opseq in microseconds.
+    using CostFn = std::function<double(int opseq_id)>;
+
+    SchedSimulator(int num_sm, int num_warps_per_sm, CostFn cost_fn);
+
+    /// Run @p streams one after another on the SMs [sm_id_begin, sm_id_end)
+    /// with a barrier of the SMs between them.
+    void run_streams(const std::vector<Stream> &streams, int sm_id_begin,
+                     int sm_id_end,
+                     const std::map<int, SchedWorkQueue> &work_queues = {});
+
+    /// Barrier of the SMs [sm_id_begin, sm_id_end).
+    void sync(int sm_id_begin, int sm_id_end);
+
+    /// Barrier of all SMs.
+    void sync_gpu();
+
+    /// Result of the uops run so far, after a barrier of all SMs.
+    SchedSimResult get_result();
+
+    /// Simulate an iteration of the loop body that @p sched generates. Uops
+    /// take @ref DefaultScheduler::get_uop_cost unless @p cost_fn is given,
+    /// which for communication opseqs is the transfer time over the link to
+    /// the peer (see @ref AnalyticalCostModel). Peers are not simulated, so a
+    /// `recv` never waits longer for a late sender.
+    static SchedSimResult simulate(const DefaultScheduler &sched,
+                                   CostFn cost_fn = nullptr);
+
+   private:
+    // Run a uop on the warps [warp_id_begin, warp_id_end) of `sm_id` from
+    // their earliest common free time. Returns the end time.
+    double run_uop(int opseq_id, int uop_id, int sm_id, int warp_id_begin,
+                   int warp_id_end, double duration);
+    void run_work_queue(const std::vector<Stream> &streams, size_t stream_idx,
+                        size_t branch_idx, const BranchOp &queue_op,
+                        const SchedWorkQueue &wq);
+
+    int num_sm;
+    int num_warps_per_sm;
+    CostFn cost_fn;
+    // Time that each warp becomes free, indexed by sm_id * num_warps_per_sm
+    // + warp_id.
+    std::vector<double> clocks;
+    // Index of the uop in `uops` that each warp waits for, or -1.
+    std::vector<int> lasts;
+    std::vector<SchedSimUop> uops;
+    // Index of the uop in `uops` that each uop waited for, or -1.
+    std::vector<int> preds;
+};
+
+}  // namespace ark
+
+#endif  // ARK_SCHED_SIM_H_
@@ -0,0 +1,188 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "sched/sched_sim.h"
+
+#include "gpu/gpu_profile.h"
+#include "include/ark.h"
+#include "sched/sched.h"
+#include "unittest/unittest_utils.h"
+
+// A branch of a single warp branch that runs one op on every SM of
+// [sm_id_begin, sm_id_end).
+static ark::Branch make_branch(int sm_id_begin, int sm_id_end,
+                               int warp_id_begin, int warp_id_end,
+                               int opseq_id, int num_warps_per_uop) {
+    ark::BranchOp op{opseq_id, 0, 1, num_warps_per_uop, 1};
+    ark::WarpBranch wb{warp_id_begin, warp_id_end, {op}};
+    return ark::Branch{sm_id_begin, sm_id_end, 0, {wb}};
+}
+
+static ark::SchedSimulator::CostFn cost_of(const std::vector<double> &costs) {
+    return [costs](int opseq_id) { return costs.at(opseq_id); };
+}
+
+ark::unittest::State test_sched_sim_warps() {
+    // Two groups of two warps on each of two SMs run op 0 and then op 1.
+    ark::Stream stream;
+    stream.branches.push_back(make_branch(0, 2, 0, 4, 0, 2));
+    stream.branches.push_back(make_branch(0, 2, 0, 4, 1, 2));
+
+    ark::SchedSimulator sim{2, 4, cost_of({3, 2})};
+    sim.run_streams({stream}, 0, 2);
+    auto res = sim.get_result();
+    UNITTEST_EQ(res.makespan, 5.0);
+    UNITTEST_EQ(res.num_uops, 8UL);
+    UNITTEST_EQ(res.sm_busy.size(), 2UL);
+    UNITTEST_EQ(res.sm_utilization[0], 1.0);
+    UNITTEST_EQ(res.sm_utilization[1], 1.0);
+    UNITTEST_EQ(res.critical_path.size(), 2UL);
+    UNITTEST_EQ(res.critical_path[0].opseq_id, 0);
+    UNITTEST_EQ(res.critical_path[1].opseq_id, 1);
+    UNITTEST_EQ(res.critical_path[1].start, 3.0);
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_sched_sim_barrier() {
+    // SM 0 runs a long op and SM 1 a short one before a barrier.
+    ark::Stream s0;
+    s0.branches.push_back(make_branch(0, 1, 0, 1, 0, 1));
+    s0.branches.push_back(make_branch(1, 2, 0, 1, 1, 1));
+    ark::Stream s1;
+    s1.branches.push_back(make_branch(0, 2, 0, 1, 2, 1));
+
+    ark::SchedSimulator sim{2, 1, cost_of({5, 1, 1})};
+    sim.run_streams({s0, s1}, 0, 2);
+    auto res = sim.get_result();
+    UNITTEST_EQ(res.makespan, 6.0);
+    UNITTEST_EQ(res.sm_busy[0], 6.0);
+    UNITTEST_EQ(res.sm_busy[1], 2.0);
+    UNITTEST_EQ(res.critical_path.size(), 2UL);
+    UNITTEST_EQ(res.critical_path[0].opseq_id, 0);
+    UNITTEST_EQ(res.critical_path[1].opseq_id, 2);
+
+    // Without the barrier, SM 1 starts op 2 right after op 1.
+    ark::Stream s2;
+    s2.branches = s0.branches;
+    s2.branches.push_back(make_branch(1, 2, 0, 1, 2, 1));
+    ark::SchedSimulator sim2{2, 1, cost_of({5, 1, 1})};
+    sim2.run_streams({s2}, 0, 2);
+    auto res2 = sim2.get_result();
+    UNITTEST_EQ(res2.makespan, 5.0);
+    UNITTEST_EQ(res2.critical_path.size(), 1UL);
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_sched_sim_work_queue() {
+    // SM 0 is busy with op 0 when the groups reach the queue of op 1, so
+    // SM 1 takes more of its uops.
+    ark::Stream stream;
+    stream.branches.push_back(make_branch(0, 1, 0, 2, 0, 2));
+    stream.branches.push_back(make_branch(0, 2, 0, 2, 1, 1));
+    std::map<int, ark::SchedWorkQueue> work_queues;
+    work_queues[1] = ark::SchedWorkQueue{10, 1, 4};
+
+    ark::SchedSimulator sim{2, 2, cost_of({2, 1})};
+    sim.run_streams({stream}, 0, 2, work_queues);
+    auto res = sim.get_result();
+    UNITTEST_EQ(res.makespan, 4.0);
+    UNITTEST_EQ(res.num_uops, 11UL);
+    // SM 1 runs 2 + 2 + 2 uops in [0, 3), and SM 0 runs op 0 in [0, 2) and
+    // 2 + 2 uops in [2, 4).
+    UNITTEST_EQ(res.sm_busy[0], 4.0);
+    UNITTEST_EQ(res.sm_busy[1], 3.0);
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_sched_sim_schedule() {
+    ark::GpuManager::Info info = ark::gpu_profile("a100");
+
+    ark::Model m;
+    ark::Tensor *x0 = m.tensor({4, 256, 256}, ark::FP16);
+    ark::Tensor *x1 = m.scale(x0, 0.7);
+    ark::Tensor *w = m.tensor({256, 1024}, ark::FP16);
+    ark::Tensor *y = m.matmul(x1, w);
+    m.relu(y);
+
+    ark::DefaultScheduler sched{m, info, 0, 1};
+    sched.schedule();
+
+    auto res = ark::SchedSimulator::simulate(sched);
+    UNITTEST_TRUE(res.makespan > 0);
+    UNITTEST_EQ(res.sm_utilization.size(), (size_t)info.num_sm);
+    for (double u : res.sm_utilization) {
+        UNITTEST_TRUE(u >= 0 && u <= 1);
+    }
+    UNITTEST_TRUE(res.avg_utilization() > 0);
+
+    // Every uop of every opseq runs once.
+    size_t num_uops = 0;
+    for (auto &opseq : sched.get_opseqs()) {
+        if (!opseq->is_virtual()) {
+            num_uops += opseq->get_tdims_size();
+        }
+    }
+    UNITTEST_EQ(res.num_uops, num_uops);
+
+    // The critical path is a gapless chain from the start to the end.
+    UNITTEST_TRUE(!res.critical_path.empty());
+    UNITTEST_EQ(res.critical_path.front().start, 0.0);
+    UNITTEST_EQ(res.critical_path.back().end, res.makespan);
+    for (size_t i = 1; i < res.critical_path.size(); ++i) {
+        UNITTEST_EQ(res.critical_path[i].start,
+                    res.critical_path[i - 1].end);
+    }
+
+    // No SM finishes earlier than the longest uop.
+    for (auto &opseq : sched.get_opseqs()) {
+        if (opseq->is_virtual()) continue;
+        UNITTEST_TRUE(res.makespan >= sched.get_uop_cost(*opseq));
+    }
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_sched_sim_comm() {
+    ark::GpuManager::Info info = ark::gpu_profile("a100");
+    // Cost of the comm opseqs of rank 0 that sends and receives `bytes`.
+    auto comm_costs = [&info](ark::DimType bytes) {
+        ark::Model m;
+        ark::Tensor *x = m.tensor({bytes / 2}, ark::FP16);
+        ark::Tensor *s = m.send(m.scale(x, 0.5), 0, 1);
+        m.send_done(s, 0, 1);
+        m.recv(1, 1, bytes);
+        ark::DefaultScheduler sched{m, info, 0, 2};
+        sched.schedule();
+        auto res = ark::SchedSimulator::simulate(sched);
+        std::map<ark::OpType, double> costs;
+        for (auto &opseq : sched.get_opseqs()) {
+            if (!opseq->is_comm()) continue;
+            double cost = sched.get_uop_cost(*opseq);
+            UNITTEST_TRUE(res.makespan >= cost);
+            costs[opseq->get_sched_ops()[0].get_op()->type] = cost;
+        }
+        return costs;
+    };
+    auto small = comm_costs(1 << 20);
+    auto large = comm_costs(1 << 24);
+    // Sends only post the transfer, while send_done and recv wait for it.
+    for (auto type : {ark::OP_SEND, ark::OP_SEND_DONE, ark::OP_RECV}) {
+        UNITTEST_EQ(small.count(type), 1UL);
+        UNITTEST_TRUE(small[type] > 0);
+    }
+    UNITTEST_EQ(large[ark::OP_SEND], small[ark::OP_SEND]);
+    for (auto type : {ark::OP_SEND_DONE, ark::OP_RECV}) {
+        UNITTEST_TRUE(small[type] > small[ark::OP_SEND]);
+        UNITTEST_TRUE(large[type] > 10 * small[type]);
+    }
+    return ark::unittest::SUCCESS;
+}
+
+int main() {
+    ark::init();
+    UNITTEST(test_sched_sim_warps);
+    UNITTEST(test_sched_sim_barrier);
+    UNITTEST(test_sched_sim_work_queue);
+    UNITTEST(test_sched_sim_schedule);
+    UNITTEST(test_sched_sim_comm);
+    return 0;
+}
@@ -6,8 +6,10 @@
 #include <algorithm>
 #include <list>
 #include <map>
+#include <set>
 #include <vector>
 
+#include "host_trace.h"
 #include "include/ark.h"
 #include "logging.h"
 #include "math_utils.h"
@@ -21,17 +23,33 @@ class SchedStream::Impl {
     int sm_id_end;
     int num_warps_per_sm;
     int smem_bytes_per_sm;
+    SchedPolicy policy;
 
     struct BranchInfo {
         SchedBranch sched_branch;
         std::map<int, int> sm_id_to_smem_per_warp;
+        /// sm_id -> estimated busy time of the SM
+        std::map<int, double> sm_id_to_load;
+        /// sm_id -> estimated time when each warp becomes free
+        std::map<int, std::vector<double>> sm_id_to_warp_loads;
+        /// sm_id -> the end of the warp IDs in use
+        std::map<int, int> sm_id_to_warp_end;
     };
 
     std::vector<std::unique_ptr<BranchInfo>> branch_infos;
 
+    // Number of warps that can be used on @p sm_id for an item of
+    // @p smem_per_warp bytes of shared memory per warp, or zero if none.
+    int get_max_warps(const BranchInfo &branch_info, int sm_id,
+                      int smem_per_warp) const;
+    // Add a uop of @p item to @p branch_info.
+    void add_uop(BranchInfo &branch_info, const SchedItem &item, int uop_idx,
+                 int sm_id, int warp_id_begin, int max_warps);
+    void add_items_lpt(const std::vector<SchedItem> &items);
+
    public:
     Impl(int sm_id_begin, int sm_id_end, int num_warps_per_sm,
-         int smem_bytes_per_sm);
+         int smem_bytes_per_sm, SchedPolicy policy);
     ~Impl();
 
    protected:
@@ -44,12 +62,23 @@ class SchedStream::Impl {
     friend class SchedStream;
 };
 
+SchedPolicy sched_policy_from_string(const std::string &name) {
+    if (name == "lpt") {
+        return SCHED_POLICY_LPT;
+    } else if (name != "greedy") {
+        ERR(InvalidUsageError, "unknown scheduling policy: ", name,
+            ". Available policies: greedy, lpt");
+    }
+    return SCHED_POLICY_GREEDY;
+}
+
 SchedStream::Impl::Impl(int sm_id_begin_, int sm_id_end_, int num_warps_per_sm_,
-                        int smem_bytes_per_sm_)
+                        int smem_bytes_per_sm_, SchedPolicy policy_)
     : sm_id_begin{sm_id_begin_},
       sm_id_end{sm_id_end_},
       num_warps_per_sm{num_warps_per_sm_},
-      smem_bytes_per_sm{smem_bytes_per_sm_} {}
+      smem_bytes_per_sm{smem_bytes_per_sm_},
+      policy{policy_} {}
 
 SchedStream::Impl::~Impl() {}
 
@@ -71,6 +100,10 @@ void SchedStream::Impl::add_items(const std::vector<SchedItem> &items) {
     }
 
     this->sync();
+    if (this->policy == SCHED_POLICY_LPT) {
+        this->add_items_lpt(items);
+        return;
+    }
     BranchInfo *branch_info = this->branch_infos.back().get();
 
     // Sort items in decreasing order of smem_bytes_per_uop / num_warps_per_uop.
@@ -159,17 +192,14 @@ void SchedStream::Impl::add_items(const std::vector<SchedItem> &items) {
                         continue;
                     }
                 }
-                branch_info->sm_id_to_smem_per_warp[current_sm_idx] =
-                    max_smem_per_warp;
-
-                // Schedule this uop on this SM
-                branch_info->sched_branch.add(
-                    item.opseq_id, uop_idx, current_sm_idx, current_warp_idx,
-                    current_warp_idx + item.num_warps_per_uop);
                 if (current_warp_idx + item.num_warps_per_uop >
                     this->num_warps_per_sm) {
                     ERR(SchedulerError, "unexpected error");
                 }
+
+                // Schedule this uop on this SM
+                this->add_uop(*branch_info, item, uop_idx, current_sm_idx,
+                              current_warp_idx, this->num_warps_per_sm);
                 n_remaining_warps[current_sm_idx - this->sm_id_begin] -=
                     item.num_warps_per_uop;
                 current_warp_idx += item.num_warps_per_uop;
@@ -200,6 +230,138 @@ void SchedStream::Impl::add_items(const std::vector<SchedItem> &items) {
     }
 }
 
+int SchedStream::Impl::get_max_warps(const BranchInfo &branch_info,
+                                     int sm_id, int smem_per_warp) const {
+    auto it = branch_info.sm_id_to_smem_per_warp.find(sm_id);
+    if (it != branch_info.sm_id_to_smem_per_warp.end()) {
+        smem_per_warp = std::max(smem_per_warp, it->second);
+    }
+    int max_warps = this->num_warps_per_sm;
+    if (smem_per_warp > 0) {
+        max_warps =
+            std::min(max_warps, this->smem_bytes_per_sm / smem_per_warp);
+    }
+    // Warps already in use should not exceed the shared memory limit.
+    auto it2 = branch_info.sm_id_to_warp_end.find(sm_id);
+    if (it2 != branch_info.sm_id_to_warp_end.end() &&
+        it2->second > max_warps) {
+        return 0;
+    }
+    return max_warps;
+}
+
+void SchedStream::Impl::add_uop(BranchInfo &branch_info, const SchedItem &item,
+                                int uop_idx, int sm_id, int warp_id_begin,
+                                int max_warps) {
+    int num_warps = item.num_warps_per_uop;
+    int smem_per_warp = math::div_up(item.smem_bytes_per_uop, num_warps);
+    int &sm_smem_per_warp = branch_info.sm_id_to_smem_per_warp[sm_id];
+    sm_smem_per_warp = std::max(sm_smem_per_warp, smem_per_warp);
+    int &warp_end = branch_info.sm_id_to_warp_end[sm_id];
+    warp_end = std::max(warp_end, warp_id_begin + num_warps);
+    branch_info.sched_branch.add(item.opseq_id, uop_idx, sm_id, warp_id_begin,
+                                 warp_id_begin + num_warps);
+
+    // The uop shares the SM with the uops on the other warps, so it keeps
+    // the SM busy for its share of the warps.
+    branch_info.sm_id_to_load[sm_id] +=
+        item.cost_per_uop * num_warps / max_warps;
+    std::vector<double> &warp_loads = branch_info.sm_id_to_warp_loads[sm_id];
+    warp_loads.resize(this->num_warps_per_sm, 0);
+    double start = *std::max_element(warp_loads.begin() + warp_id_begin,
+                                     warp_loads.begin() + warp_id_begin +
+                                         num_warps);
+    std::fill(warp_loads.begin() + warp_id_begin,
+              warp_loads.begin() + warp_id_begin + num_warps,
+              start + item.cost_per_uop);
+}
+
+/// Distribute the uops of each item over SMs so that the estimated busy time
+/// of the busiest SM is minimized, in the manner of longest processing time
+/// first scheduling. Every uop of an item has the same cost, so the number
+/// of uops of each SM is decided first and then consecutive uops are placed
+/// on each SM in order, which keeps the generated branches compact.
+void SchedStream::Impl::add_items_lpt(const std::vector<SchedItem> &items) {
+    std::vector<SchedItem> sorted_items(items);
+    std::stable_sort(sorted_items.begin(), sorted_items.end(),
+                     [](const SchedItem &a, const SchedItem &b) {
+                         if (a.priority != b.priority) {
+                             return a.priority > b.priority;
+                         }
+                         return a.cost_per_uop > b.cost_per_uop;
+                     });
+
+    int num_sms = this->sm_id_end - this->sm_id_begin;
+    for (auto &item : sorted_items) {
+        int num_warps = item.num_warps_per_uop;
+        int smem_per_warp = math::div_up(item.smem_bytes_per_uop, num_warps);
+        // Items without an estimate still count the number of uops.
+        double cost = (item.cost_per_uop > 0) ? item.cost_per_uop : 1e-3;
+
+        BranchInfo *branch_info = this->branch_infos.back().get();
+        std::vector<int> max_warps(num_sms);
+        // (estimated load, sm_id) of the SMs that can run this item.
+        std::set<std::pair<double, int>> loads;
+        for (int retry = 0; retry < 2 && loads.empty(); ++retry) {
+            if (retry > 0) {
+                // No SM can run this item together with the previous items
+                // due to shared memory. Start a new SchedBranch.
+                this->sync();
+                branch_info = this->branch_infos.back().get();
+            }
+            for (int i = 0; i < num_sms; ++i) {
+                int sm_id = this->sm_id_begin + i;
+                max_warps[i] = this->get_max_warps(*branch_info, sm_id,
+                                                   smem_per_warp);
+                if (max_warps[i] >= num_warps) {
+                    loads.emplace(branch_info->sm_id_to_load[sm_id], sm_id);
+                }
+            }
+        }
+        if (loads.empty()) {
+            ERR(SchedulerError, "unexpected error: no SM can run opseq ",
+                item.opseq_id);
+        }
+
+        // Give each uop to the SM that would finish it the earliest.
+        std::vector<int> num_uops(num_sms, 0);
+        for (int u = 0; u < item.num_uops; ++u) {
+            auto it = loads.begin();
+            double load = it->first;
+            int sm_id = it->second;
+            loads.erase(it);
+            int i = sm_id - this->sm_id_begin;
+            num_uops[i]++;
+            loads.emplace(load + cost * num_warps / max_warps[i], sm_id);
+        }
+
+        // Place consecutive uops on each SM, each on the warps that become
+        // free the earliest.
+        int uop_idx = 0;
+        for (int i = 0; i < num_sms; ++i) {
+            int sm_id = this->sm_id_begin + i;
+            for (int n = 0; n < num_uops[i]; ++n) {
+                std::vector<double> &warp_loads =
+                    branch_info->sm_id_to_warp_loads[sm_id];
+                warp_loads.resize(this->num_warps_per_sm, 0);
+                int best_warp = 0;
+                double best_start = -1;
+                for (int w = 0; w + num_warps <= max_warps[i]; w += num_warps) {
+                    double start = *std::max_element(
+                        warp_loads.begin() + w,
+                        warp_loads.begin() + w + num_warps);
+                    if (best_start < 0 || start < best_start) {
+                        best_start = start;
+                        best_warp = w;
+                    }
+                }
+                this->add_uop(*branch_info, item, uop_idx++, sm_id, best_warp,
+                              max_warps[i]);
+            }
+        }
+    }
+}
+
 void SchedStream::Impl::sync() {
     this->branch_infos.emplace_back(std::make_unique<BranchInfo>());
 }
@@ -208,10 +370,15 @@ void SchedStream::Impl::clear() { this->branch_infos.clear(); }
 
 std::vector<Stream> SchedStream::Impl::get_streams() {
     std::vector<Stream> streams;
+    int num_sms = this->sm_id_end - this->sm_id_begin;
     for (auto &branch_info : this->branch_infos) {
         Stream stream;
         stream.branches = branch_info->sched_branch.get_branches(
             branch_info->sm_id_to_smem_per_warp);
+        for (auto &p : branch_info->sm_id_to_load) {
+            stream.max_sm_load = std::max(stream.max_sm_load, p.second);
+            stream.avg_sm_load += p.second / num_sms;
+        }
         streams.emplace_back(std::move(stream));
     }
     return streams;
@@ -222,14 +389,15 @@ int SchedStream::Impl::get_num_sm() const {
 }
 
 SchedStream::SchedStream(int sm_id_begin, int sm_id_end, int num_warps_per_sm,
-                         int smem_bytes_per_sm) {
-    this->impl = std::make_unique<Impl>(sm_id_begin, sm_id_end,
-                                        num_warps_per_sm, smem_bytes_per_sm);
+                         int smem_bytes_per_sm, SchedPolicy policy) {
+    this->impl = std::make_unique<Impl>(
+        sm_id_begin, sm_id_end, num_warps_per_sm, smem_bytes_per_sm, policy);
 }
 
 SchedStream::~SchedStream() {}
 
 void SchedStream::add_items(const std::vector<SchedItem> &items) {
+    HostTraceScope scope{"SchedStream::add_items"};
     this->impl->add_items(items);
 }
 
@@ -6,6 +6,7 @@
 
 #include <map>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "sched_branch.h"
@@ -17,19 +18,47 @@ struct SchedItem {
     int num_uops;
     int num_warps_per_uop;
     int smem_bytes_per_uop;
+    /// Estimated time of a single uop in microseconds, or zero if unknown.
+    double cost_per_uop = 0;
+    /// Items of a higher priority are placed first by
+    /// @ref SCHED_POLICY_LPT, e.g., the estimated time from the start of the
+    /// item to the end of the model.
+    double priority = 0;
 };
 
+/// How @ref SchedStream::add_items places uops on SMs.
+typedef enum {
+    /// Pack uops in the decreasing order of shared memory bytes per warp,
+    /// spreading the warps evenly over SMs.
+    SCHED_POLICY_GREEDY,
+    /// List scheduling of the longest processing time first: items are
+    /// placed in the decreasing order of their priority and then their cost
+    /// per uop, and each uop goes to the warps that become free the earliest
+    /// according to @ref SchedItem::cost_per_uop.
+    SCHED_POLICY_LPT,
+} SchedPolicy;
+
+/// Get the @ref SchedPolicy of @p name ("greedy" or "lpt").
+SchedPolicy sched_policy_from_string(const std::string &name);
+
 struct Stream {
     /// Ordered list of branches in the stream
     std::vector<Branch> branches;
     /// sm_id -> assigned smem bytes per warp
     std::map<int, int> sm_id_to_smem_per_warp;
+    /// Estimated time until the busiest SM finishes the stream, according
+    /// to @ref SchedItem::cost_per_uop.
+    double max_sm_load = 0;
+    /// Estimated time until an SM finishes the stream on average. The SMs
+    /// idle for (max_sm_load - avg_sm_load) on average at the end.
+    double avg_sm_load = 0;
 };
 
 class SchedStream {
    public:
     SchedStream(int sm_id_begin, int sm_id_end, int num_warps_per_sm,
-                int smem_bytes_per_sm);
+                int smem_bytes_per_sm,
+                SchedPolicy policy = SCHED_POLICY_GREEDY);
     ~SchedStream();
 
     void add_items(const std::vector<SchedItem> &items);
@@ -1,11 +1,170 @@
 // Copyright (c) Microsoft Corporation.
 // Licensed under the MIT license.
 
-#include "ark.h"
+#include "sched/sched_stream.h"
+
+#include <cstdlib>
+#include <set>
+
+#include "env.h"
+#include "gpu/gpu_profile.h"
+#include "include/ark.h"
 #include "logging.h"
+#include "sched/sched.h"
 #include "unittest/unittest_utils.h"
 
+// Items of very different costs per uop that fit in a single stream.
+static std::vector<ark::SchedItem> unequal_items() {
+    std::vector<ark::SchedItem> items;
+    items.push_back({0, 6, 1, 0, 10.0, 0});
+    items.push_back({1, 10, 1, 0, 1.0, 0});
+    items.push_back({2, 8, 2, 0, 4.0, 0});
+    return items;
+}
+
+// Ids of the uops of @p opseq_id that run on every SM and warp.
+static std::multiset<int> get_uop_ids(const std::vector<ark::Stream> &streams,
+                                      int opseq_id) {
+    std::multiset<int> uop_ids;
+    for (auto &stream : streams) {
+        for (auto &br : stream.branches) {
+            for (auto &wb : br.warp_branches) {
+                for (auto &op : wb.branch_ops) {
+                    if (op.opseq_id != opseq_id) continue;
+                    int num_uops = (wb.warp_id_end - wb.warp_id_begin) /
+                                   op.num_warps_per_uop;
+                    for (int sm_idx = 0; sm_idx < br.sm_id_end - br.sm_id_begin;
+                         ++sm_idx) {
+                        for (int i = 0; i < num_uops; ++i) {
+                            uop_ids.insert(op.uop_id_diff *
+                                               (i + num_uops * sm_idx) +
+                                           op.uop_id_begin);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return uop_ids;
+}
+
+// True if every uop of @p item runs exactly once.
+static bool is_placed_once(const std::vector<ark::Stream> &streams,
+                           const ark::SchedItem &item) {
+    auto uop_ids = get_uop_ids(streams, item.opseq_id);
+    std::multiset<int> expected;
+    for (int i = 0; i < item.num_uops; ++i) {
+        expected.insert(i);
+    }
+    return uop_ids == expected;
+}
+
+ark::unittest::State test_sched_stream_policy() {
+    UNITTEST_EQ(ark::sched_policy_from_string("greedy"),
+                ark::SCHED_POLICY_GREEDY);
+    UNITTEST_EQ(ark::sched_policy_from_string("lpt"), ark::SCHED_POLICY_LPT);
+    UNITTEST_THROW(ark::sched_policy_from_string("fifo"),
+                   ark::InvalidUsageError);
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_sched_stream_lpt() {
+    auto items = unequal_items();
+
+    ark::SchedStream greedy{0, 3, 4, 65536};
+    greedy.add_items(items);
+    auto greedy_streams = greedy.get_streams();
+
+    ark::SchedStream lpt{0, 3, 4, 65536, ark::SCHED_POLICY_LPT};
+    lpt.add_items(items);
+    auto lpt_streams = lpt.get_streams();
+
+    UNITTEST_EQ(greedy_streams.size(), 1UL);
+    UNITTEST_EQ(lpt_streams.size(), 1UL);
+    UNITTEST_TRUE(lpt_streams[0].avg_sm_load > 0);
+    UNITTEST_TRUE(lpt_streams[0].avg_sm_load <= lpt_streams[0].max_sm_load);
+    UNITTEST_TRUE(lpt_streams[0].max_sm_load <
+                  greedy_streams[0].max_sm_load);
+    LOG(ark::INFO, "max SM load: greedy ", greedy_streams[0].max_sm_load,
+        ", lpt ", lpt_streams[0].max_sm_load, ", average ",
+        lpt_streams[0].avg_sm_load);
+
+    // Every uop is placed exactly once.
+    for (auto &item : items) {
+        UNITTEST_TRUE(is_placed_once(greedy_streams, item));
+        UNITTEST_TRUE(is_placed_once(lpt_streams, item));
+    }
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_sched_stream_lpt_smem() {
+    // Items that do not fit together in shared memory are split into
+    // separate streams.
+    std::vector<ark::SchedItem> items;
+    items.push_back({0, 4, 2, 32768, 1.0, 1.0});
+    items.push_back({1, 4, 2, 32768, 1.0, 0});
+    ark::SchedStream lpt{0, 3, 4, 65536, ark::SCHED_POLICY_LPT};
+    lpt.add_items(items);
+    auto streams = lpt.get_streams();
+    UNITTEST_TRUE(!streams.empty());
+    for (auto &item : items) {
+        UNITTEST_TRUE(is_placed_once(streams, item));
+    }
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_sched_stream_greedy_smem() {
+    // Split-k matmuls of a transformer layer on an A100. The items of more
+    // shared memory per warp occupy every SM first, so the uops of the other
+    // items that do not fit continue in a new branch.
+    std::vector<ark::SchedItem> items;
+    for (int i = 0; i < 18; ++i) {
+        if (i % 6 == 5) {
+            items.push_back({i, 16, 8, 147456});
+        } else {
+            items.push_back({i, 32, 4, 98304});
+        }
+    }
+    ark::SchedStream greedy{0, 107, 16, 166912};
+    greedy.add_items(items);
+    auto streams = greedy.get_streams();
+    UNITTEST_TRUE(streams.size() > 1);
+    for (auto &item : items) {
+        UNITTEST_TRUE(is_placed_once(streams, item));
+    }
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_sched_stream_lpt_model() {
+    ::setenv("ARK_SCHED_POLICY", "lpt", 1);
+    ark::get_env(true);
+
+    ark::Model m;
+    ark::Tensor *a = m.tensor({1024, 1024}, ark::FP16);
+    ark::Tensor *b = m.tensor({1024, 1024}, ark::FP16);
+    ark::Tensor *c = m.matmul(a, b);
+    ark::Tensor *d = m.add(a, b);
+    m.mul(c, d);
+
+    ark::DefaultScheduler sched{m, ark::gpu_profile("a100"), 0, 1};
+    sched.schedule();
+    double idle_ratio = sched.get_sm_idle_ratio();
+    UNITTEST_TRUE(idle_ratio >= 0 && idle_ratio < 1);
+    sched.plan_context();
+    auto codes = sched.gen_code();
+    UNITTEST_EQ(codes.size(), 1UL);
+
+    ::unsetenv("ARK_SCHED_POLICY");
+    ark::get_env(true);
+    return ark::unittest::SUCCESS;
+}
+
 int main() {
     ark::init();
+    UNITTEST(test_sched_stream_policy);
+    UNITTEST(test_sched_stream_lpt);
+    UNITTEST(test_sched_stream_lpt_smem);
+    UNITTEST(test_sched_stream_greedy_smem);
+    UNITTEST(test_sched_stream_lpt_model);
     return 0;
 }
@@ -3,6 +3,10 @@
 
 #include "sched/sched.h"
 
+#include <cstdlib>
+#include <cstring>
+
+#include "env.h"
 #include "include/ark.h"
 #include "logging.h"
 #include "ops/ops_test_common.h"
@@ -108,11 +112,60 @@ ark::unittest::State test_sched_graph_opt() {
     return ark::unittest::SUCCESS;
 }
 
+// Run a small MLP of `relu(x * w + b)` layers and return the result.
+static std::vector<float> run_mlp(const std::string &name) {
+    ark::Model m;
+    ark::Tensor *x = m.tensor({128, 256}, ark::FP32);
+    std::vector<ark::Tensor *> inputs{x};
+    for (int i = 0; i < 4; ++i) {
+        ark::DimType n = (i == 3) ? 256 : 512;
+        ark::Tensor *w = m.tensor({x->shape[1], n}, ark::FP32);
+        ark::Tensor *b = m.tensor({n}, ark::FP32);
+        inputs.emplace_back(w);
+        inputs.emplace_back(b);
+        x = m.relu(m.add(m.matmul(x, w), b));
+    }
+
+    ark::Executor exe{0, 1, m, name};
+    exe.compile();
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        std::vector<float> data(inputs[i]->shape.size());
+        for (size_t j = 0; j < data.size(); ++j) {
+            data[j] = float((i * 131 + j * 7) % 17) / 17 - 0.5f;
+        }
+        inputs[i]->write(data.data());
+    }
+    exe.launch();
+    exe.run(3);
+    exe.stop();
+
+    std::vector<float> res(x->shape.size());
+    x->read(res.data());
+    return res;
+}
+
+ark::unittest::State test_sched_reuse_buffers() {
+    std::vector<float> res = run_mlp("sched_reuse_buffers_off");
+
+    ::setenv("ARK_REUSE_BUFFERS", "1", 1);
+    ark::get_env(true);
+    std::vector<float> res_reuse = run_mlp("sched_reuse_buffers_on");
+    ::unsetenv("ARK_REUSE_BUFFERS");
+    ark::get_env(true);
+
+    UNITTEST_EQ(res.size(), res_reuse.size());
+    UNITTEST_EQ(std::memcmp(res.data(), res_reuse.data(),
+                            res.size() * sizeof(float)),
+                0);
+    return ark::unittest::SUCCESS;
+}
+
 int main() {
     ark::init();
     UNITTEST(test_sched_many_comm_ops);
     UNITTEST(test_sched_mixed_precision);
     UNITTEST(test_sched_parallel_matmul);
     UNITTEST(test_sched_graph_opt);
+    UNITTEST(test_sched_reuse_buffers);
     return 0;
 }
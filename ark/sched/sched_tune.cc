@@ -0,0 +1,174 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "sched/sched_tune.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+#include "file_io.h"
+#include "json.h"
+#include "logging.h"
+
+namespace ark {
+
+// Bump this if the key format changes.
+static const int TUNE_DB_VERSION = 1;
+
+TuneDb::TuneDb(const std::string &path) : path_{path} {
+    if (!is_file(path)) {
+        LOG(DEBUG, "tuning database ", path, " does not exist yet");
+        return;
+    }
+    this->load(entries_);
+    LOG(DEBUG, "loaded ", entries_.size(), " entries from ", path);
+}
+
+void TuneDb::load(Entries &entries) const {
+    nlohmann::json j;
+    try {
+        j = nlohmann::json::parse(read_file(path_));
+    } catch (const nlohmann::json::exception &e) {
+        ERR(InvalidUsageError, "failed to parse tuning database ", path_, ": ",
+            e.what());
+    }
+    if (j.value("version", 0) != TUNE_DB_VERSION) {
+        LOG(WARN, "ignore tuning database ", path_, " of a different version");
+        return;
+    }
+    try {
+        for (auto &item : j.at("entries").items()) {
+            auto &records = entries[item.key()];
+            for (auto &r : item.value()) {
+                Record rec;
+                rec.choice.gran_lev = r.at("gran_lev").get<int>();
+                rec.choice.split_k = r.at("split_k").get<int>();
+                rec.usec = r.at("usec").get<double>();
+                rec.count = r.value("count", 1);
+                records.emplace_back(rec);
+            }
+        }
+    } catch (const nlohmann::json::exception &e) {
+        ERR(InvalidUsageError, "invalid tuning database ", path_, ": ",
+            e.what());
+    }
+}
+
+std::string TuneDb::key(const Op &op, const std::string &arch) {
+    std::stringstream ss;
+    ss << arch << ";" << op.type << ";" << op.prec_type << ";";
+    for (auto &t : op.inputs) {
+        ss << t->shape << t->ldims << t->type << ",";
+    }
+    ss << ";";
+    for (auto &t : op.outputs) {
+        ss << t->shape << t->ldims << t->type << ",";
+    }
+    return ss.str();
+}
+
+bool TuneDb::lookup(const std::string &key, TuneChoice &choice) const {
+    auto it = entries_.find(key);
+    if (it == entries_.end() || it->second.empty()) {
+        return false;
+    }
+    const Record *best = &it->second[0];
+    for (auto &rec : it->second) {
+        if (rec.usec < best->usec) {
+            best = &rec;
+        }
+    }
+    choice = best->choice;
+    return true;
+}
+
+bool TuneDb::has(const std::string &key, const TuneChoice &choice) const {
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+        return false;
+    }
+    for (auto &rec : it->second) {
+        if (rec.choice.gran_lev == choice.gran_lev &&
+            rec.choice.split_k == choice.split_k) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TuneDb::explore(const std::string &key,
+                     const std::vector<TuneChoice> &candidates,
+                     TuneChoice &choice) const {
+    for (auto &cand : candidates) {
+        if (!this->has(key, cand)) {
+            choice = cand;
+            return true;
+        }
+    }
+    return false;
+}
+
+void TuneDb::add_record(std::vector<Record> &records, const Record &rec) {
+    for (auto &r : records) {
+        if (r.choice.gran_lev == rec.choice.gran_lev &&
+            r.choice.split_k == rec.choice.split_k) {
+            r.usec = std::min(r.usec, rec.usec);
+            r.count += rec.count;
+            return;
+        }
+    }
+    records.emplace_back(rec);
+}
+
+void TuneDb::record(const std::string &key, const TuneChoice &choice,
+                    double usec) {
+    if (usec < 0) {
+        ERR(InvalidUsageError, "invalid elapsed time: ", usec);
+    }
+    add_record(entries_[key], Record{choice, usec, 1});
+    add_record(updates_[key], Record{choice, usec, 1});
+}
+
+void TuneDb::save() {
+    FileLock lock{path_ + ".lock"};
+    // Start from what is on the disk, which other processes may have updated
+    // since this database was loaded.
+    Entries merged;
+    if (is_file(path_)) {
+        this->load(merged);
+    }
+    for (auto &p : updates_) {
+        for (auto &rec : p.second) {
+            add_record(merged[p.first], rec);
+        }
+    }
+
+    nlohmann::json entries = nlohmann::json::object();
+    for (auto &p : merged) {
+        nlohmann::json records = nlohmann::json::array();
+        for (auto &rec : p.second) {
+            records.push_back({{"gran_lev", rec.choice.gran_lev},
+                               {"split_k", rec.choice.split_k},
+                               {"usec", rec.usec},
+                               {"count", rec.count}});
+        }
+        entries[p.first] = records;
+    }
+    nlohmann::json j;
+    j["version"] = TUNE_DB_VERSION;
+    j["entries"] = entries;
+
+    std::string tmp_path = path_ + ".tmp." + std::to_string(::getpid());
+    write_file(tmp_path, j.dump(1));
+    if (std::rename(tmp_path.c_str(), path_.c_str()) != 0) {
+        remove_file(tmp_path);
+        ERR(SystemError, "failed to write tuning database ", path_);
+    }
+    entries_ = std::move(merged);
+    updates_.clear();
+}
+
+}  // namespace ark
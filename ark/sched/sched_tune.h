@@ -0,0 +1,88 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#ifndef ARK_SCHED_TUNE_H_
+#define ARK_SCHED_TUNE_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "ops/ops_common.h"
+
+namespace ark {
+
+/// A scheduling decision of a single @ref Op.
+struct TuneChoice {
+    /// Index of the selected @ref OpConfig, or -1 if not decided.
+    int gran_lev = -1;
+    /// Split-K factor of a matmul, or 0 if not decided.
+    int split_k = 0;
+};
+
+/// On-disk database of measured scheduling decisions. Each entry is keyed by
+/// the op type, precision, input/output shapes and leading dimensions, and
+/// the GPU architecture (see @ref key), and keeps the best measured time of
+/// every @ref TuneChoice tried for it.
+///
+/// The database is a JSON file, e.g.
+/// {"version": 1, "entries": {"<key>": [{"gran_lev": 0, "split_k": 1,
+///  "usec": 12.5, "count": 3}, ...]}}.
+class TuneDb {
+   public:
+    /// Load the database from @p path if it exists. Otherwise, start with an
+    /// empty database that will be saved to @p path.
+    TuneDb(const std::string &path);
+
+    /// Key of @p op on the architecture @p arch.
+    static std::string key(const Op &op, const std::string &arch);
+
+    /// Get the choice of the best measured time for @p key.
+    /// @return false if nothing is recorded for @p key.
+    bool lookup(const std::string &key, TuneChoice &choice) const;
+
+    /// Whether @p choice has been measured for @p key.
+    bool has(const std::string &key, const TuneChoice &choice) const;
+
+    /// Get the first of @p candidates that has not been measured for @p key.
+    /// @return false if every candidate has been measured.
+    bool explore(const std::string &key,
+                 const std::vector<TuneChoice> &candidates,
+                 TuneChoice &choice) const;
+
+    /// Record that @p choice took @p usec microseconds for @p key. Only the
+    /// best time of each choice is kept.
+    void record(const std::string &key, const TuneChoice &choice, double usec);
+
+    /// Write the database to its path. The records made since the last load
+    /// or save are merged into the file under the lock file `<path>.lock`,
+    /// so concurrent processes do not lose each other's records. The file is
+    /// replaced atomically, so concurrent readers never see a partial file.
+    /// This database is then updated with what the others have saved.
+    void save();
+
+    const std::string &get_path() const { return path_; }
+    size_t size() const { return entries_.size(); }
+
+   private:
+    struct Record {
+        TuneChoice choice;
+        double usec;
+        int count;
+    };
+    using Entries = std::map<std::string, std::vector<Record>>;
+
+    // Read the file at `path_` into @p entries.
+    void load(Entries &entries) const;
+    // Add @p rec to @p records, merging it with a record of the same choice.
+    static void add_record(std::vector<Record> &records, const Record &rec);
+
+    std::string path_;
+    Entries entries_;
+    // Records made since the last load or save.
+    Entries updates_;
+};
+
+}  // namespace ark
+
+#endif  // ARK_SCHED_TUNE_H_
@@ -0,0 +1,270 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "sched/sched_tune.h"
+
+#include <set>
+
+#include "env.h"
+#include "file_io.h"
+#include "gpu/gpu_profile.h"
+#include "include/ark.h"
+#include "json.h"
+#include "sched/sched.h"
+#include "unittest/unittest_utils.h"
+
+static std::vector<const ark::Op *> get_matmul_ops(ark::Model &model) {
+    std::vector<const ark::Op *> ops;
+    ark::OpGraph graph(model);
+    for (auto &node : graph.get_nodes()) {
+        for (auto &op : node->ops) {
+            if (op->type == ark::OP_MATMUL) ops.emplace_back(op);
+        }
+    }
+    return ops;
+}
+
+ark::unittest::State test_sched_tune_db() {
+    std::string path = ark::get_env().path_tmp_dir + "/.test_sched_tune_db";
+    ark::remove_file(path);
+
+    ark::TuneDb db(path);
+    ark::TuneChoice choice;
+    UNITTEST_EQ(db.size(), 0UL);
+    UNITTEST_TRUE(!db.lookup("key", choice));
+
+    db.record("key", {0, 1}, 30.0);
+    db.record("key", {1, 1}, 20.0);
+    db.record("key", {0, 1}, 10.0);
+    db.record("key", {2, 4}, 15.0);
+    db.record("other", {-1, 2}, 5.0);
+    UNITTEST_THROW(db.record("key", {0, 1}, -1.0), ark::InvalidUsageError);
+    UNITTEST_TRUE(db.lookup("key", choice));
+    UNITTEST_EQ(choice.gran_lev, 0);
+    UNITTEST_EQ(choice.split_k, 1);
+    db.save();
+
+    // Reload from the disk.
+    ark::TuneDb db2(path);
+    UNITTEST_EQ(db2.size(), 2UL);
+    UNITTEST_TRUE(db2.lookup("key", choice));
+    UNITTEST_EQ(choice.gran_lev, 0);
+    UNITTEST_TRUE(db2.lookup("other", choice));
+    UNITTEST_EQ(choice.gran_lev, -1);
+    UNITTEST_EQ(choice.split_k, 2);
+
+    // Saving merges what others have saved in the meantime.
+    ark::TuneDb db3(path);
+    db2.record("key", {1, 1}, 5.0);
+    db3.record("new", {0, 0}, 1.0);
+    db2.save();
+    db3.save();
+    ark::TuneDb db4(path);
+    UNITTEST_EQ(db4.size(), 3UL);
+    UNITTEST_TRUE(db4.lookup("key", choice));
+    UNITTEST_EQ(choice.gran_lev, 1);
+    UNITTEST_TRUE(db4.has("new", {0, 0}));
+    UNITTEST_TRUE(db3.has("key", {1, 1}));
+    UNITTEST_TRUE(!db4.has("new", {0, 1}));
+    UNITTEST_TRUE(db4.explore("key", {{0, 1}, {3, 1}, {4, 1}}, choice));
+    UNITTEST_EQ(choice.gran_lev, 3);
+    UNITTEST_TRUE(!db4.explore("key", {{0, 1}, {1, 1}}, choice));
+
+    // A database of another version is ignored.
+    ark::write_file(path, "{\"version\": 0, \"entries\": {}}");
+    UNITTEST_EQ(ark::TuneDb(path).size(), 0UL);
+    ark::write_file(path, "not a json");
+    UNITTEST_THROW(ark::TuneDb{path}, ark::InvalidUsageError);
+
+    ark::remove_file(path);
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_sched_tune_scheduler() {
+    std::string path = ark::get_env().path_tmp_dir + "/.test_sched_tune_sched";
+    ark::remove_file(path);
+    ::setenv("ARK_TUNE_DB", path.c_str(), 1);
+    ark::init();
+
+    ark::GpuManager::Info info = ark::gpu_profile("a100");
+    // The heuristics split a small matmul.
+    std::string matmul_key;
+    {
+        ark::Model m;
+        ark::Tensor *a = m.tensor({256, 4096}, ark::FP16);
+        ark::Tensor *b = m.tensor({4096, 256}, ark::FP16);
+        m.matmul(a, b);
+        matmul_key = ark::TuneDb::key(*get_matmul_ops(m)[0], info.arch);
+
+        ark::DefaultScheduler sched{m, info, 0, 1};
+        sched.schedule();
+        UNITTEST_TRUE(get_matmul_ops(m).size() > 1);
+        sched.record_timing(100.0);
+    }
+    ark::TuneChoice choice;
+    UNITTEST_TRUE(ark::TuneDb(path).lookup(matmul_key, choice));
+    UNITTEST_TRUE(choice.split_k > 1);
+
+    // A faster measurement without splitting overrides the heuristics.
+    {
+        ark::TuneDb db(path);
+        db.record(matmul_key, {2, 1}, 50.0);
+        db.save();
+    }
+    {
+        ark::Model m;
+        ark::Tensor *a = m.tensor({256, 4096}, ark::FP16);
+        ark::Tensor *b = m.tensor({4096, 256}, ark::FP16);
+        m.matmul(a, b);
+
+        ark::DefaultScheduler sched{m, info, 0, 1};
+        sched.schedule();
+        auto ops = get_matmul_ops(m);
+        UNITTEST_EQ(ops.size(), 1UL);
+        auto &configs =
+            ops[0]->cfg_map->get({ark::OP_ARCH_CUDA_80, ops[0]->prec_type});
+        UNITTEST_EQ(sched.sched_op_config(ops[0]), &configs[2]);
+    }
+
+    // Without the database, the scheduler cannot record.
+    ::unsetenv("ARK_TUNE_DB");
+    ark::init();
+    {
+        ark::Model m;
+        m.relu(m.tensor({64}, ark::FP32));
+        ark::DefaultScheduler sched{m, info, 0, 1};
+        sched.schedule();
+        UNITTEST_THROW(sched.record_timing(1.0), ark::InvalidUsageError);
+    }
+    ark::remove_file(path);
+    return ark::unittest::SUCCESS;
+}
+
+// Recorded time of @p choice for @p key in the database at @p path.
+static double recorded_usec(const std::string &path, const std::string &key,
+                            const ark::TuneChoice &choice) {
+    auto j = nlohmann::json::parse(ark::read_file(path));
+    for (auto &r : j.at("entries").at(key)) {
+        if (r.at("gran_lev") == choice.gran_lev &&
+            r.at("split_k") == choice.split_k) {
+            return r.at("usec").get<double>();
+        }
+    }
+    return -1;
+}
+
+ark::unittest::State test_sched_tune_per_op() {
+    std::string path = ark::get_env().path_tmp_dir + "/.test_sched_tune_op";
+    ark::remove_file(path);
+    auto db = std::make_shared<ark::TuneDb>(path);
+    ark::GpuManager::Info info = ark::gpu_profile("a100");
+
+    ark::Model m;
+    ark::Tensor *a = m.tensor({4096, 4096}, ark::FP16);
+    ark::Tensor *b = m.tensor({4096, 4096}, ark::FP16);
+    m.matmul(a, b);
+    m.relu(m.tensor({4096, 1024}, ark::FP16));
+    std::string matmul_key =
+        ark::TuneDb::key(*get_matmul_ops(m)[0], info.arch);
+    ark::DefaultScheduler sched{m, info, 0, 1};
+    sched.set_tune_db(db);
+    sched.schedule();
+    std::string relu_key;
+    for (auto &opseq : sched.get_opseqs()) {
+        for (auto &sop : opseq->get_sched_ops()) {
+            if (sop.get_op()->type == ark::OP_RELU) {
+                relu_key = ark::TuneDb::key(*sop.get_op(), info.arch);
+            }
+        }
+    }
+    UNITTEST_TRUE(!relu_key.empty());
+
+    // The estimated costs split the time of an iteration.
+    sched.record_timing(100.0);
+    ark::TuneChoice matmul_choice;
+    ark::TuneChoice relu_choice;
+    UNITTEST_TRUE(db->lookup(matmul_key, matmul_choice));
+    UNITTEST_TRUE(db->lookup(relu_key, relu_choice));
+    double matmul_usec = recorded_usec(path, matmul_key, matmul_choice);
+    double relu_usec = recorded_usec(path, relu_key, relu_choice);
+    UNITTEST_TRUE(matmul_usec > relu_usec);
+    UNITTEST_TRUE(relu_usec > 0);
+    UNITTEST_TRUE(matmul_usec + relu_usec <= 100.0 + 1e-6);
+
+    // Measured times of opseqs take precedence.
+    std::map<int, double> opseq_usec;
+    for (auto &opseq : sched.get_opseqs()) {
+        opseq_usec[opseq->get_id()] = 1.0;
+    }
+    sched.record_timing(100.0, opseq_usec);
+    UNITTEST_TRUE(recorded_usec(path, relu_key, relu_choice) <= 1.0);
+
+    ark::remove_file(path);
+    return ark::unittest::SUCCESS;
+}
+
+ark::unittest::State test_sched_tune_explore() {
+    std::string path = ark::get_env().path_tmp_dir + "/.test_sched_tune_exp";
+    ark::remove_file(path);
+    ::setenv("ARK_TUNE_DB", path.c_str(), 1);
+    ::setenv("ARK_TUNE_EXPLORE", "1", 1);
+    ark::init();
+
+    ark::GpuManager::Info info = ark::gpu_profile("a100");
+    auto build = [](ark::Model &m) {
+        ark::Tensor *a = m.tensor({256, 1024}, ark::FP16);
+        ark::Tensor *b = m.tensor({1024, 256}, ark::FP16);
+        m.matmul(a, b);
+    };
+    std::string matmul_key;
+    std::vector<int> gran_levs;
+    {
+        ark::Model m;
+        build(m);
+        const ark::Op *op = get_matmul_ops(m)[0];
+        matmul_key = ark::TuneDb::key(*op, info.arch);
+        ark::DefaultScheduler sched{m, info, 0, 1};
+        for (auto &cand : sched.rank_op_configs(op)) {
+            gran_levs.push_back(cand.gran_lev);
+        }
+    }
+    // Every round measures a new candidate until all are measured.
+    auto num_records = [&]() {
+        auto j = nlohmann::json::parse(ark::read_file(path));
+        return j.at("entries").at(matmul_key).size();
+    };
+    std::set<int> split_ks;
+    size_t num_measured = 0;
+    for (int round = 0; round < 100; ++round) {
+        ark::Model m;
+        build(m);
+        ark::DefaultScheduler sched{m, info, 0, 1};
+        sched.schedule();
+        split_ks.insert((int)get_matmul_ops(m).size());
+        sched.record_timing(100.0 + round);
+        if (num_records() == num_measured) break;
+        num_measured = num_records();
+    }
+    ark::TuneDb db(path);
+    for (int gran_lev : gran_levs) {
+        UNITTEST_TRUE(db.has(matmul_key, {gran_lev, 1}));
+    }
+    UNITTEST_TRUE(db.has(matmul_key, {gran_levs[0], 2}));
+    UNITTEST_EQ(num_measured, gran_levs.size() + split_ks.size() - 1);
+    UNITTEST_TRUE(split_ks.size() > 2);
+
+    ::unsetenv("ARK_TUNE_EXPLORE");
+    ::unsetenv("ARK_TUNE_DB");
+    ark::init();
+    ark::remove_file(path);
+    return ark::unittest::SUCCESS;
+}
+
+int main() {
+    ark::init();
+    UNITTEST(test_sched_tune_db);
+    UNITTEST(test_sched_tune_scheduler);
+    UNITTEST(test_sched_tune_per_op);
+    UNITTEST(test_sched_tune_explore);
+    return 0;
+}
@@ -3,12 +3,18 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <functional>
+#include <mutex>
 #include <string>
 
 #include "ark.h"
 #include "gpu/gpu_buffer.h"
+#include "gpu/gpu_logging.h"
+#include "gpu/gpu_staging_pool.h"
 #include "logging.h"
 #include "math_utils.h"
+#include "tensor.h"
 
 #define DEBUG_PADDING 0
 #define PADDING_DEBUG(...)           \
@@ -182,6 +188,83 @@ bool tensor_reshape_helper(const Dims &shape, const Dims &ldims,
     return true;
 }
 
+size_t TensorCopyPlan::num_copies() const {
+    size_t num = 1;
+    for (size_t i = 0; i + 1 < this->counts.size(); ++i) {
+        num *= this->counts[i];
+    }
+    return num;
+}
+
+TensorCopyPlan tensor_copy_plan(const Dims &shape, const Dims &ldims,
+                                const Dims &offs, int type_bytes) {
+    int ndims = shape.ndims();
+    assert(ndims > 0);
+    assert(ldims.ndims() == ndims && offs.ndims() == ndims);
+    // Bytes between consecutive indices of each dimension.
+    std::vector<size_t> pitch(ndims);
+    pitch[ndims - 1] = type_bytes;
+    for (int i = ndims - 2; i >= 0; --i) {
+        pitch[i] = pitch[i + 1] * ldims[i + 1];
+    }
+    TensorCopyPlan plan;
+    for (int i = 0; i < ndims; ++i) {
+        plan.offset += offs[i] * pitch[i];
+    }
+    plan.run_bytes = shape[ndims - 1] * pitch[ndims - 1];
+    int i = ndims - 2;
+    for (; i >= 0; --i) {
+        if (shape[i] == 1) {
+            continue;
+        }
+        if (plan.run_bytes != pitch[i]) {
+            break;
+        }
+        plan.run_bytes *= shape[i];
+    }
+    // Levels from the innermost one.
+    for (; i >= 0; --i) {
+        if (shape[i] == 1) {
+            continue;
+        }
+        if (!plan.counts.empty() &&
+            plan.counts.back() * plan.pitches.back() == pitch[i]) {
+            plan.counts.back() *= shape[i];
+            continue;
+        }
+        plan.counts.push_back(shape[i]);
+        plan.pitches.push_back(pitch[i]);
+    }
+    std::reverse(plan.counts.begin(), plan.counts.end());
+    std::reverse(plan.pitches.begin(), plan.pitches.end());
+    return plan;
+}
+
+// Call `func(offset, rows, pitch)` for each 2D block of runs of `plan` in
+// order, where `offset` is the buffer offset of the first run, `rows` is the
+// number of runs, and `pitch` is the distance between the runs in bytes.
+static void tensor_copy_plan_blocks(
+    const TensorCopyPlan &plan,
+    const std::function<void(size_t, size_t, size_t)> &func) {
+    if (plan.counts.empty()) {
+        func(plan.offset, 1, plan.run_bytes);
+        return;
+    }
+    size_t nlev = plan.counts.size();
+    size_t rows = plan.counts[nlev - 1];
+    size_t pitch = plan.pitches[nlev - 1];
+    size_t num = plan.num_copies();
+    for (size_t b = 0; b < num; ++b) {
+        size_t offset = plan.offset;
+        size_t rem = b;
+        for (size_t l = nlev - 1; l-- > 0;) {
+            offset += (rem % plan.counts[l]) * plan.pitches[l];
+            rem /= plan.counts[l];
+        }
+        func(offset, rows, pitch);
+    }
+}
+
 // Helper for `Tensor::update_pads()`.
 static Dims calc_pads(const Dims &tile, const Dims &ldims) {
     // 1. Match the number of dimensions. If `tile` has more dimensions than
@@ -384,54 +467,18 @@ void Tensor::write(const void *buf) {
         ERR(InvalidUsageError, "failed to get GPU buffer for tensor ",
             this->name);
     }
-    size_t bytes = this->shape_bytes();
-    int ndims = this->ndims();
-    char *ptr = (char *)buf;
-    if (ndims == 1) {
-        gbuf->from_host(this->offset_bytes(0), ptr, 0, bytes);
-        return;
-    }
+    const char *ptr = (const char *)buf;
+    TensorCopyPlan plan = tensor_copy_plan(this->shape, this->ldims,
+                                           this->offs, this->type_bytes());
     size_t done = 0;
-    size_t rem = bytes;
-    for (DimType i = 0; i < this->shape[0]; ++i) {
-        if (ndims == 2) {
-            size_t cb =
-                std::min(rem, (size_t)this->shape[1] * this->type_bytes());
-            gbuf->from_host(this->offset_bytes(i, 0), &ptr[done], 0, cb);
-            rem -= cb;
-            done += cb;
-            if (rem == 0) {
-                break;
-            }
-            continue;
-        }
-        for (DimType j = 0; j < this->shape[1]; ++j) {
-            if (ndims == 3) {
-                size_t cb =
-                    std::min(rem, (size_t)this->shape[2] * this->type_bytes());
-                gbuf->from_host(this->offset_bytes(i, j, 0), &ptr[done], 0, cb);
-                rem -= cb;
-                done += cb;
-                if (rem == 0) {
-                    break;
-                }
-                continue;
-            }
-            for (DimType k = 0; k < this->shape[2]; ++k) {
-                size_t cb =
-                    std::min(rem, (size_t)this->shape[3] * this->type_bytes());
-                gbuf->from_host(this->offset_bytes(i, j, k, 0), &ptr[done], 0,
-                                cb);
-                rem -= cb;
-                done += cb;
-                if (rem == 0) {
-                    break;
-                }
-            }
-        }
-    }
-    assert(rem == 0);
-    assert(done == bytes);
+    tensor_copy_plan_blocks(plan, [&](size_t offset, size_t rows,
+                                      size_t pitch) {
+        gbuf->from_host_2d(offset, pitch, &ptr[done], plan.run_bytes,
+                           plan.run_bytes, rows, true);
+        done += rows * plan.run_bytes;
+    });
+    gbuf->sync();
+    assert(done == (size_t)this->shape_bytes());
 }
 
 void *Tensor::read(void *buf) {
@@ -441,7 +488,6 @@ void *Tensor::read(void *buf) {
             this->id);
     }
     size_t bytes = this->shape_bytes();
-    int ndims = this->ndims();
     if (buf == nullptr) {
         buf = ::malloc(bytes);
         if (buf == nullptr) {
@@ -449,52 +495,147 @@ void *Tensor::read(void *buf) {
         }
     }
     char *ptr = (char *)buf;
-    if (ndims == 1) {
-        gbuf->to_host(ptr, 0, this->offset_bytes(0), bytes);
-        return ptr;
+    TensorCopyPlan plan = tensor_copy_plan(this->shape, this->ldims,
+                                           this->offs, this->type_bytes());
+    size_t done = 0;
+    tensor_copy_plan_blocks(plan, [&](size_t offset, size_t rows,
+                                      size_t pitch) {
+        gbuf->to_host_2d(&ptr[done], plan.run_bytes, offset, pitch,
+                         plan.run_bytes, rows, true);
+        done += rows * plan.run_bytes;
+    });
+    gbuf->sync();
+    assert(done == bytes);
+    return buf;
+}
+
+class TensorIoHandle::Impl {
+   public:
+    Impl(std::shared_ptr<GpuStagingPool> pool, GpuStagingPool::Staging staging,
+         void *dst, size_t bytes);
+    ~Impl();
+
+    bool done();
+    void wait();
+
+   private:
+    void finish();
+
+    std::mutex mtx_;
+    std::shared_ptr<GpuStagingPool> pool_;
+    GpuStagingPool::Staging staging_;
+    std::shared_ptr<GpuEvent> event_;
+    // Host buffer to fill from the staging buffer on completion, or nullptr
+    // for a write.
+    void *dst_;
+    size_t bytes_;
+    bool finished_ = false;
+};
+
+TensorIoHandle::Impl::Impl(std::shared_ptr<GpuStagingPool> pool,
+                           GpuStagingPool::Staging staging, void *dst,
+                           size_t bytes)
+    : pool_(pool), staging_(staging), dst_(dst), bytes_(bytes) {
+    // Mark the completion of all copies issued so far on the copy stream.
+    event_ = pool_->manager().create_event(true);
+    event_->record(pool_->stream());
+}
+
+TensorIoHandle::Impl::~Impl() { this->wait(); }
+
+bool TensorIoHandle::Impl::done() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (finished_) {
+        return true;
+    }
+    gpuError err = event_->query();
+    if (err == gpuErrorNotReady) {
+        return false;
+    }
+    GLOG(err);
+    this->finish();
+    return true;
+}
+
+void TensorIoHandle::Impl::wait() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (finished_) {
+        return;
+    }
+    event_->sync();
+    this->finish();
+}
+
+void TensorIoHandle::Impl::finish() {
+    if (dst_ != nullptr) {
+        std::memcpy(dst_, staging_.memory->ref<char>(), bytes_);
+    }
+    pool_->release(std::move(staging_));
+    finished_ = true;
+}
+
+TensorIoHandle::TensorIoHandle(std::shared_ptr<Impl> impl) : impl_(impl) {}
+
+bool TensorIoHandle::done() { return impl_->done(); }
+
+void TensorIoHandle::wait() { impl_->wait(); }
+
+TensorIoHandle Tensor::write_async(const void *buf) {
+    if (buf == nullptr) {
+        ERR(InvalidUsageError, "the given host buffer is null");
     }
+    std::shared_ptr<GpuBuffer> gbuf = this->buf->buf;
+    if (gbuf == nullptr) {
+        ERR(InvalidUsageError, "failed to get GPU buffer for tensor ",
+            this->name);
+    }
+    size_t bytes = this->shape_bytes();
+    auto pool = GpuStagingPool::get_instance(gbuf->get_gpu_id());
+    auto staging = pool->acquire(bytes);
+    char *ptr = staging.memory->ref<char>();
+    std::memcpy(ptr, buf, bytes);
+    TensorCopyPlan plan = tensor_copy_plan(this->shape, this->ldims,
+                                           this->offs, this->type_bytes());
     size_t done = 0;
-    size_t rem = bytes;
-    for (DimType i = 0; i < this->shape[0]; ++i) {
-        if (ndims == 2) {
-            size_t cb =
-                std::min(rem, (size_t)this->shape[1] * this->type_bytes());
-            gbuf->to_host(&ptr[done], 0, this->offset_bytes(i, 0), cb);
-            rem -= cb;
-            done += cb;
-            if (rem == 0) {
-                break;
-            }
-            continue;
-        }
-        for (DimType j = 0; j < this->shape[1]; ++j) {
-            if (ndims == 3) {
-                size_t cb =
-                    std::min(rem, (size_t)this->shape[2] * this->type_bytes());
-                gbuf->to_host(&ptr[done], 0, this->offset_bytes(i, j, 0), cb);
-                rem -= cb;
-                done += cb;
-                if (rem == 0) {
-                    break;
-                }
-                continue;
-            }
-            for (DimType k = 0; k < this->shape[2]; ++k) {
-                size_t cb =
-                    std::min(rem, (size_t)this->shape[3] * this->type_bytes());
-                gbuf->to_host(&ptr[done], 0, this->offset_bytes(i, j, k, 0),
-                              cb);
-                rem -= cb;
-                done += cb;
-                if (rem == 0) {
-                    break;
-                }
-            }
-        }
+    tensor_copy_plan_blocks(plan, [&](size_t offset, size_t rows,
+                                      size_t pitch) {
+        pool->manager().memcpy_htod_2d(gbuf->ref(offset), pitch, &ptr[done],
+                                       plan.run_bytes, plan.run_bytes, rows,
+                                       true, pool->stream());
+        done += rows * plan.run_bytes;
+    });
+    assert(done == bytes);
+    return TensorIoHandle(std::make_shared<TensorIoHandle::Impl>(
+        pool, std::move(staging), nullptr, bytes));
+}
+
+TensorIoHandle Tensor::read_async(void *buf) {
+    if (buf == nullptr) {
+        ERR(InvalidUsageError, "the given host buffer is null");
     }
-    assert(rem == 0);
+    std::shared_ptr<GpuBuffer> gbuf = this->buf->buf;
+    if (gbuf == nullptr) {
+        ERR(InvalidUsageError, "failed to get GPU buffer for tensor ",
+            this->id);
+    }
+    size_t bytes = this->shape_bytes();
+    auto pool = GpuStagingPool::get_instance(gbuf->get_gpu_id());
+    auto staging = pool->acquire(bytes);
+    char *ptr = staging.memory->ref<char>();
+    TensorCopyPlan plan = tensor_copy_plan(this->shape, this->ldims,
+                                           this->offs, this->type_bytes());
+    size_t done = 0;
+    tensor_copy_plan_blocks(plan, [&](size_t offset, size_t rows,
+                                      size_t pitch) {
+        pool->manager().memcpy_dtoh_2d(&ptr[done], plan.run_bytes,
+                                       gbuf->ref(offset), pitch,
+                                       plan.run_bytes, rows, true,
+                                       pool->stream());
+        done += rows * plan.run_bytes;
+    });
     assert(done == bytes);
-    return buf;
+    return TensorIoHandle(std::make_shared<TensorIoHandle::Impl>(
+        pool, std::move(staging), buf, bytes));
 }
 
 void *Tensor::read_raw(void *buf) {
@@ -520,57 +661,15 @@ void Tensor::clear() {
         ERR(InvalidUsageError, "failed to get GPU buffer for tensor ",
             this->name);
     }
-    int ndims = this->ndims();
-    size_t bytes = this->shape_bytes();
-    assert(bytes % 4 == 0);
-    size_t num = bytes >> 2;
-    if (ndims == 1) {
-        buf->memset_d32(this->offset_bytes(0), 0, num);
-        return;
-    }
-    size_t done = 0;
-    size_t rem = num;
-    for (DimType i = 0; i < this->shape[0]; ++i) {
-        if (ndims == 2) {
-            bytes = (size_t)this->shape[1] * this->type_bytes();
-            assert(bytes % 4 == 0);
-            size_t cn = std::min(rem, bytes >> 2);
-            buf->memset_d32(this->offset_bytes(i, 0), 0, cn);
-            rem -= cn;
-            done += cn;
-            if (rem == 0) {
-                break;
-            }
-            continue;
+    TensorCopyPlan plan = tensor_copy_plan(this->shape, this->ldims,
+                                           this->offs, this->type_bytes());
+    assert(plan.run_bytes % 4 == 0);
+    tensor_copy_plan_blocks(plan, [&](size_t offset, size_t rows,
+                                      size_t pitch) {
+        for (size_t r = 0; r < rows; ++r) {
+            buf->memset_d32(0, offset + r * pitch, plan.run_bytes >> 2);
         }
-        for (DimType j = 0; j < this->shape[1]; ++j) {
-            if (ndims == 3) {
-                bytes = (size_t)this->shape[2] * this->type_bytes();
-                assert(bytes % 4 == 0);
-                size_t cn = std::min(rem, bytes >> 2);
-                buf->memset_d32(this->offset_bytes(i, j, 0), 0, cn);
-                rem -= cn;
-                done += cn;
-                if (rem == 0) {
-                    break;
-                }
-                continue;
-            }
-            for (DimType k = 0; k < this->shape[2]; ++k) {
-                bytes = (size_t)this->shape[3] * this->type_bytes();
-                assert(bytes % 4 == 0);
-                size_t cn = std::min(rem, bytes >> 2);
-                buf->memset_d32(this->offset_bytes(i, j, k, 0), 0, cn);
-                rem -= cn;
-                done += cn;
-                if (rem == 0) {
-                    break;
-                }
-            }
-        }
-    }
-    assert(rem == 0);
-    assert(done == num);
+    });
 }
 
 }  // namespace ark
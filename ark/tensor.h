@@ -14,6 +14,32 @@ bool tensor_reshape_helper(const Dims &shape, const Dims &ldims,
                            const Dims &offs, const Dims &new_shape,
                            Dims &new_ldims, Dims &new_offs);
 
+/// How to copy the elements of a tensor between its buffer and a packed host
+/// buffer with as few copies as possible. The elements form contiguous runs of
+/// `run_bytes` in the buffer, and the runs are laid out by up to three strided
+/// levels.
+struct TensorCopyPlan {
+    /// Offset of the first element in the buffer in bytes.
+    size_t offset = 0;
+    /// Bytes of each contiguous run.
+    size_t run_bytes = 0;
+    /// Number of steps and the distance between the steps in bytes of each
+    /// strided level, outermost first. Empty if the tensor is a single run.
+    std::vector<size_t> counts;
+    std::vector<size_t> pitches;
+
+    /// Number of 2D copies that the plan takes, each of which copies all runs
+    /// of the innermost level.
+    size_t num_copies() const;
+};
+
+/// Merge the dimensions of a tensor into the fewest runs and levels. A
+/// dimension is merged into the run if the inner dimensions cover their
+/// leading dimensions entirely, and into the level inside it if the level
+/// covers its leading dimension entirely.
+TensorCopyPlan tensor_copy_plan(const Dims &shape, const Dims &ldims,
+                                const Dims &offs, int type_bytes);
+
 }  // namespace ark
 
 #endif  // ARK_TENSOR_H_
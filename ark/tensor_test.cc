@@ -3,6 +3,8 @@
 
 #include "tensor.h"
 
+#include <array>
+
 #include "include/ark.h"
 #include "unittest/unittest_utils.h"
 
@@ -53,8 +55,120 @@ ark::unittest::State test_tensor_reshape_helper() {
     return ark::unittest::SUCCESS;
 }
 
+// Buffer offsets of the elements of a tensor in the order of the plan.
+static std::vector<size_t> plan_offsets(const ark::TensorCopyPlan &plan,
+                                        int type_bytes) {
+    std::vector<size_t> offsets;
+    size_t nlev = plan.counts.size();
+    std::vector<size_t> idx(nlev, 0);
+    while (true) {
+        size_t off = plan.offset;
+        for (size_t l = 0; l < nlev; ++l) {
+            off += idx[l] * plan.pitches[l];
+        }
+        for (size_t b = 0; b < plan.run_bytes; b += type_bytes) {
+            offsets.push_back(off + b);
+        }
+        size_t l = nlev;
+        while (l > 0 && ++idx[l - 1] == plan.counts[l - 1]) {
+            idx[--l] = 0;
+        }
+        if (l == 0) break;
+    }
+    return offsets;
+}
+
+// Buffer offsets of the elements of a 4D tensor in row-major order.
+static std::vector<size_t> tensor_offsets(const ark::Dims &shape,
+                                          const ark::Dims &ldims,
+                                          const ark::Dims &offs,
+                                          int type_bytes) {
+    std::vector<size_t> offsets;
+    for (ark::DimType i = 0; i < shape[0]; ++i) {
+        for (ark::DimType j = 0; j < shape[1]; ++j) {
+            for (ark::DimType k = 0; k < shape[2]; ++k) {
+                for (ark::DimType l = 0; l < shape[3]; ++l) {
+                    size_t off = (((offs[0] + i) * ldims[1] + offs[1] + j) *
+                                      ldims[2] +
+                                  offs[2] + k) *
+                                     ldims[3] +
+                                 offs[3] + l;
+                    offsets.push_back(off * type_bytes);
+                }
+            }
+        }
+    }
+    return offsets;
+}
+
+ark::unittest::State test_tensor_copy_plan() {
+    {
+        // Sequential tensors take a single copy.
+        auto plan = ark::tensor_copy_plan({4, 64, 128}, {4, 64, 128}, {0, 0, 0},
+                                          2);
+        UNITTEST_EQ(plan.offset, 0UL);
+        UNITTEST_EQ(plan.run_bytes, 4UL * 64 * 128 * 2);
+        UNITTEST_EQ(plan.counts.size(), 0UL);
+        UNITTEST_EQ(plan.num_copies(), 1UL);
+    }
+    {
+        // A slice of rows is sequential as well.
+        auto plan = ark::tensor_copy_plan({1, 64}, {8, 128}, {2, 0}, 2);
+        UNITTEST_EQ(plan.offset, 2UL * 128 * 2);
+        UNITTEST_EQ(plan.run_bytes, 64UL * 2);
+        UNITTEST_EQ(plan.counts.size(), 0UL);
+    }
+    {
+        // Padded rows are strided runs of a single level.
+        auto plan = ark::tensor_copy_plan({4, 64, 100}, {4, 64, 128},
+                                          {0, 0, 0}, 2);
+        UNITTEST_EQ(plan.run_bytes, 200UL);
+        UNITTEST_TRUE(plan.counts == std::vector<size_t>({256}));
+        UNITTEST_TRUE(plan.pitches == std::vector<size_t>({256}));
+        UNITTEST_EQ(plan.num_copies(), 1UL);
+    }
+    {
+        // Whole rows of a slice are merged into a run.
+        auto plan = ark::tensor_copy_plan({4, 2, 1024}, {4, 8, 1024},
+                                          {0, 3, 0}, 2);
+        UNITTEST_EQ(plan.offset, 3UL * 1024 * 2);
+        UNITTEST_EQ(plan.run_bytes, 2UL * 1024 * 2);
+        UNITTEST_TRUE(plan.counts == std::vector<size_t>({4}));
+        UNITTEST_TRUE(plan.pitches == std::vector<size_t>({8 * 1024 * 2}));
+    }
+    {
+        // Nothing is merged if every dimension is padded.
+        auto plan = ark::tensor_copy_plan({2, 3, 4, 5}, {3, 4, 5, 6},
+                                          {1, 1, 1, 1}, 4);
+        UNITTEST_EQ(plan.offset, 480UL + 120 + 24 + 4);
+        UNITTEST_EQ(plan.run_bytes, 20UL);
+        UNITTEST_TRUE(plan.counts == std::vector<size_t>({2, 3, 4}));
+        UNITTEST_TRUE(plan.pitches == std::vector<size_t>({480, 120, 24}));
+        UNITTEST_EQ(plan.num_copies(), 6UL);
+    }
+    {
+        // Plans cover the same elements in the same order as the tensor.
+        std::vector<std::array<ark::Dims, 3>> cases = {
+            {ark::Dims{2, 3, 4, 5}, ark::Dims{2, 3, 4, 5}, ark::Dims{0, 0, 0, 0}},
+            {ark::Dims{2, 3, 4, 5}, ark::Dims{2, 3, 4, 8}, ark::Dims{0, 0, 0, 3}},
+            {ark::Dims{2, 3, 4, 5}, ark::Dims{2, 6, 4, 5}, ark::Dims{0, 2, 0, 0}},
+            {ark::Dims{2, 1, 4, 5}, ark::Dims{4, 3, 4, 5}, ark::Dims{1, 2, 0, 0}},
+            {ark::Dims{2, 3, 1, 5}, ark::Dims{2, 3, 4, 9}, ark::Dims{0, 0, 3, 1}},
+            {ark::Dims{1, 3, 2, 5}, ark::Dims{3, 3, 4, 5}, ark::Dims{2, 0, 1, 0}},
+            {ark::Dims{2, 3, 4, 5}, ark::Dims{3, 4, 5, 6}, ark::Dims{1, 1, 1, 1}},
+        };
+        for (auto &c : cases) {
+            auto plan = ark::tensor_copy_plan(c[0], c[1], c[2], 2);
+            UNITTEST_TRUE(plan_offsets(plan, 2) ==
+                          tensor_offsets(c[0], c[1], c[2], 2));
+        }
+    }
+    return ark::unittest::SUCCESS;
+}
+
 int main() {
     ark::init();
     UNITTEST(test_tensor_reshape_helper);
+    UNITTEST(test_tensor_copy_plan);
     return 0;
 }
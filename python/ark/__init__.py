@@ -43,7 +43,29 @@ def set_world_size(world_size):
     Model.set_world_size(world_size)
 
 
-from .tensor import Dims, Tensor, TensorBuf, Parameter
+def host_trace():
+    """
+    Returns the phases of host-side work recorded so far, such as scheduling
+    and compiling a model, in the order of their start time. Each phase has
+    `name`, `start` and `end` in seconds, `depth` of nesting, and `thread_id`.
+    """
+    return _ark_core.host_trace()
+
+
+def host_trace_clear():
+    """Discards the phases of host-side work recorded so far."""
+    _ark_core.host_trace_clear()
+
+
+def host_trace_json() -> str:
+    """
+    Returns the phases of host-side work recorded so far in the Chrome trace
+    format, which Perfetto and chrome://tracing can open.
+    """
+    return _ark_core.host_trace_json()
+
+
+from .tensor import Dims, Tensor, TensorBuf, TensorIoHandle, Parameter
 from .module import Module
 from .runtime import Runtime
 from .serialize import save, load
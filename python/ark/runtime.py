@@ -41,11 +41,15 @@ class Runtime:
         self.executor = None
         self.state = _RuntimeStateType.destroy
 
-    def launch(self, num_warps_per_sm: int = 16):
+    def launch(self, num_warps_per_sm: int = 16, plan_path: str = ""):
         """
         Create an executor and schedule the ARK model. The scheduler will generate
         the CUDA kernels. The GPU context and the connection between GPUs will be
         initialized. The executor will compile the cuda kernels and launch the ARK runtime.
+        If `plan_path` is given, the execution plan saved in it is used instead of
+        scheduling the model if it matches the model, and otherwise the plan of the
+        model is saved into it. Ranks other than 0 use `plan_path` followed by
+        `.<rank>` instead.
         """
         if (
             self.state != _RuntimeStateType.init
@@ -64,6 +68,7 @@ class Runtime:
                 Model.get_model(),
                 "DefaultRuntime",
                 num_warps_per_sm,
+                plan_path,
             )
             self.executor.compile()
         self.executor.launch()
@@ -107,3 +112,13 @@ class Runtime:
         elapsed = self.executor.stop()
         self.state = _RuntimeStateType.stop
         return elapsed
+
+    def record_timing(self, elapsed_msec: float):
+        """
+        Record the elapsed time of an iteration in milliseconds into the
+        tuning database given by `ARK_TUNE_DB`.
+        """
+        if self.executor is None:
+            logging.error("ARK runtime is not launched")
+            raise RuntimeError("ARK runtime is not launched")
+        self.executor.record_timing(elapsed_msec)
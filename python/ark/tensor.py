@@ -2,14 +2,15 @@
 # Licensed under the MIT license.
 
 import numpy as np
-from typing import List
+from typing import List, Tuple
 
-from ._ark_core import _Dims, _Tensor, _TensorBuf
+from ._ark_core import _Dims, _Tensor, _TensorBuf, _TensorIoHandle
 from .data_type import DataType
 
 
 Dims = _Dims
 TensorBuf = _TensorBuf
+TensorIoHandle = _TensorIoHandle
 
 
 class Tensor:
@@ -123,6 +124,49 @@ class Tensor:
         self._tensor.write(ndarray)
         return self
 
+    def to_numpy_async(
+        self, ndarray: np.ndarray = None
+    ) -> Tuple[np.ndarray, TensorIoHandle]:
+        """
+        Asynchronous version of `to_numpy()`. Returns the numpy array and a
+        handle of the copy. The array is filled when `handle.done()` returns
+        True or `handle.wait()` returns.
+        """
+        if not self._tensor.is_alloced():
+            raise RuntimeError(
+                "Tensor is not allocated yet. `Tensor.to_numpy_async()` is "
+                "usable only after you call `Runtime.launch()`."
+            )
+        np_type = self.dtype().to_numpy()
+        if ndarray is None:
+            ndarray = np.zeros(self.shape(), dtype=np_type)
+        elif not ndarray.flags["C_CONTIGUOUS"]:
+            raise ValueError("ndarray is not contiguous in memory")
+        elif ndarray.shape != self.shape():
+            raise ValueError("ndarray shape does not match the tensor")
+        elif ndarray.dtype != np_type:
+            raise ValueError("ndarray dtype does not match the tensor")
+        elif ndarray.nbytes != self._tensor.shape_bytes():
+            raise ValueError("ndarray size does not match the tensor")
+        return ndarray, self._tensor.read_async(ndarray)
+
+    def from_numpy_async(self, ndarray: np.ndarray) -> TensorIoHandle:
+        """
+        Asynchronous version of `from_numpy()`. Returns a handle of the copy.
+        `ndarray` can be modified as soon as this returns.
+        """
+        if not self._tensor.is_alloced():
+            raise RuntimeError(
+                "Tensor is not allocated yet. `Tensor.from_numpy_async()` is "
+                "usable only after you call `Runtime.launch()`."
+            )
+        ndarray = ndarray.astype(self.dtype().to_numpy())
+        if not ndarray.flags["C_CONTIGUOUS"]:
+            ndarray = np.ascontiguousarray(ndarray)
+        if ndarray.nbytes != self._tensor.shape_bytes():
+            raise ValueError("ndarray size does not match the tensor")
+        return self._tensor.write_async(ndarray)
+
 
 class Parameter(Tensor):
     """
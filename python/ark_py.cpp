@@ -25,6 +25,20 @@ PYBIND11_MODULE(_ark_core, m) {
     m.def("srand", &ark::srand, py::arg("seed") = -1);
     m.def("rand", &ark::rand);
 
+    py::class_<ark::HostTraceSpan>(m, "_HostTraceSpan")
+        .def_readonly("name", &ark::HostTraceSpan::name)
+        .def_readonly("start", &ark::HostTraceSpan::start)
+        .def_readonly("end", &ark::HostTraceSpan::end)
+        .def_readonly("depth", &ark::HostTraceSpan::depth)
+        .def_readonly("thread_id", &ark::HostTraceSpan::thread_id)
+        .def("__repr__", [](const ark::HostTraceSpan &span) {
+            return "<HostTraceSpan " + span.name + " " +
+                   std::to_string(span.end - span.start) + "s>";
+        });
+    m.def("host_trace", &ark::host_trace);
+    m.def("host_trace_clear", &ark::host_trace_clear);
+    m.def("host_trace_json", &ark::host_trace_json);
+
     register_dims(m);
     register_tensor_type(m);
     register_tensor(m);
@@ -11,12 +11,16 @@ namespace py = pybind11;
 
 void register_executor(py::module &m) {
     py::class_<ark::Executor>(m, "_Executor")
-        .def(py::init<int, int, ark::Model &, const std::string &, int>(),
+        .def(py::init<int, int, ark::Model &, const std::string &, int,
+                      const std::string &>(),
              py::arg("rank"), py::arg("world_size"), py::arg("model"),
-             py::arg("name"), py::arg("num_warps_per_sm") = 16)
+             py::arg("name"), py::arg("num_warps_per_sm") = 16,
+             py::arg("plan_path") = "")
         .def("compile", &ark::Executor::compile)
         .def("launch", &ark::Executor::launch)
         .def("run", &ark::Executor::run, py::arg("iter"))
         .def("wait", &ark::Executor::wait)
-        .def("stop", &ark::Executor::stop);
+        .def("stop", &ark::Executor::stop)
+        .def("record_timing", &ark::Executor::record_timing,
+             py::arg("elapsed_msec"));
 }
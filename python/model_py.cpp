@@ -10,6 +10,16 @@
 namespace py = pybind11;
 
 void register_model(py::module &m) {
+    py::class_<ark::MatmulEpilogue>(m, "_MatmulEpilogue")
+        .def(py::init<ark::Tensor *, const std::string &, ark::Tensor *,
+                      const ark::TensorType &>(),
+             py::arg("bias") = nullptr, py::arg("activation") = "",
+             py::arg("residual") = nullptr, py::arg("output_type") = ark::NONE)
+        .def_readwrite("bias", &ark::MatmulEpilogue::bias)
+        .def_readwrite("activation", &ark::MatmulEpilogue::activation)
+        .def_readwrite("residual", &ark::MatmulEpilogue::residual)
+        .def_readonly("output_type", &ark::MatmulEpilogue::output_type);
+
     py::class_<ark::Model>(m, "_Model")
         .def(py::init<int>(), py::arg("rank") = 0)
         .def("tensor", &ark::Model::tensor,
@@ -82,7 +92,8 @@ void register_model(py::module &m) {
              py::arg("other"), py::arg("output") = nullptr,
              py::arg("splitk") = 1, py::arg("trans_input") = false,
              py::arg("trans_other") = false, py::arg("name") = "matmul",
-             py::arg("gran_lev") = -1)
+             py::arg("gran_lev") = -1,
+             py::arg("epilogue") = ark::MatmulEpilogue())
         .def("im2col", &ark::Model::im2col,
              "Implements the 'im2col' method for 2D convolution layers, which "
              "takes an `input` tensor and reshapes it to a 2D matrix by "
@@ -259,5 +270,12 @@ void register_model(py::module &m) {
         .def("cast", &ark::Model::cast, "Tensor type casting.",
              py::return_value_policy::reference_internal, py::arg("input"),
              py::arg("ttype"), py::arg("output") = nullptr,
-             py::arg("name") = "cast");
+             py::arg("name") = "cast")
+        .def("save", &ark::Model::save,
+             "Save the graph of the model into a binary file.",
+             py::arg("path"))
+        .def("load", &ark::Model::load,
+             "Load a graph saved by `save` into an empty model. Returns the "
+             "tensors of the model in the order of their creation.",
+             py::return_value_policy::reference_internal, py::arg("path"));
 }
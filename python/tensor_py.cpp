@@ -19,7 +19,25 @@ void tensor_read(ark::Tensor *tns, py::buffer host_buffer) {
     tns->read(info.ptr);
 }
 
+ark::TensorIoHandle tensor_write_async(ark::Tensor *tns,
+                                       py::buffer host_buffer) {
+    py::buffer_info info = host_buffer.request();
+    return tns->write_async(info.ptr);
+}
+
+ark::TensorIoHandle tensor_read_async(ark::Tensor *tns,
+                                      py::buffer host_buffer) {
+    py::buffer_info info = host_buffer.request();
+    return tns->read_async(info.ptr);
+}
+
 void register_tensor(py::module &m) {
+    py::class_<ark::TensorIoHandle>(m, "_TensorIoHandle")
+        .def("done", &ark::TensorIoHandle::done,
+             py::call_guard<py::gil_scoped_release>())
+        .def("wait", &ark::TensorIoHandle::wait,
+             py::call_guard<py::gil_scoped_release>());
+
     py::class_<ark::TensorBuf>(m, "_TensorBuf")
         .def(py::init<const ark::DimType &, int>(), py::arg("bytes") = 0,
              py::arg("id") = -1)
@@ -55,6 +73,11 @@ void register_tensor(py::module &m) {
                                [](const ark::Tensor &t) { return t.type; })
         .def("write", &tensor_write, py::arg("buf"))
         .def("read", &tensor_read, py::arg("buf"))
+        .def("write_async", &tensor_write_async, py::arg("buf"))
+        // Keep the host buffer alive until the handle is gone, as the read
+        // fills it on completion.
+        .def("read_async", &tensor_read_async, py::arg("buf"),
+             py::keep_alive<0, 2>())
         .def("clear", &ark::Tensor::clear)
         .def("offset", &ark::Tensor::offset, py::arg("i0") = 0,
              py::arg("i1") = 0, py::arg("i2") = 0, py::arg("i3") = 0)